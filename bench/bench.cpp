@@ -0,0 +1,277 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "bench.h"
+
+
+// STL
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+
+static const void* volatile pBenchSink = nullptr;
+
+static std::string sBenchFilter;
+
+
+// JSON strings here are benchmark names, only quotes and backslashes need escaping.
+static std::string escapeJSON(const std::string& sText)
+{
+    std::string sOut;
+
+    for (char c : sText)
+    {
+        if ( (c == '"') || (c == '\\') )
+        {
+            sOut += '\\';
+        }
+
+        sOut += c;
+    }
+
+    return sOut;
+}
+
+static bool readJSONNumber(const std::string& sLine, const std::string& sKey, double& dOut)
+{
+    size_t iPos = sLine.find("\"" + sKey + "\":");
+    if (iPos == std::string::npos)
+    {
+        return true;
+    }
+
+    dOut = std::stod(sLine.substr(iPos + sKey.size() + 3));
+
+    return false;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+BenchResult runBench(const std::string& sName, const std::function<void()>& function, size_t iBytesPerOp, unsigned int iMinTimeMs)
+{
+    // Warm-up (caches, allocator, branch predictors).
+
+    function();
+
+
+    size_t iBatch      = 1;
+    size_t iIterations = 0;
+
+    std::chrono::nanoseconds elapsed(0);
+
+    const size_t iAllocationsBefore = getAllocationCount();
+
+    while (elapsed < std::chrono::milliseconds(iMinTimeMs))
+    {
+        std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < iBatch; i++)
+        {
+            function();
+        }
+
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        iIterations += iBatch;
+
+        // Grow the batch so that the clock is read rarely for fast functions.
+        if (iBatch < 1000000)
+        {
+            iBatch *= 2;
+        }
+    }
+
+    const size_t iAllocations = getAllocationCount() - iAllocationsBefore;
+
+
+    BenchResult result;
+    result.sName             = sName;
+    result.iIterations       = iIterations;
+    result.dNsPerOp          = static_cast<double>(elapsed.count()) / iIterations;
+    result.dAllocationsPerOp = static_cast<double>(iAllocations) / iIterations;
+
+    if (iBytesPerOp > 0)
+    {
+        result.dNsPerByte = result.dNsPerOp / iBytesPerOp;
+    }
+
+    return result;
+}
+
+void addBench(std::vector<BenchResult>& vResults, const std::string& sName, const std::function<void()>& function, size_t iBytesPerOp)
+{
+    if (isBenchSelected(sName) == false)
+    {
+        return;
+    }
+
+    addBenchResult(vResults, runBench(sName, function, iBytesPerOp));
+}
+
+void addBenchResult(std::vector<BenchResult>& vResults, const BenchResult& result)
+{
+    vResults.push_back(result);
+
+    printBenchResult(result);
+}
+
+void printBenchResult(const BenchResult& result)
+{
+    std::printf("%-44s %14.1f ns/op", result.sName.c_str(), result.dNsPerOp);
+
+    if (result.dNsPerByte > 0.0)
+    {
+        std::printf(" %8.2f ns/B", result.dNsPerByte);
+    }
+    else
+    {
+        std::printf("             ");
+    }
+
+    std::printf(" %8.1f allocs/op %10zu iterations\n", result.dAllocationsPerOp, result.iIterations);
+    std::fflush(stdout);
+}
+
+void setBenchFilter(const std::string& sFilter)
+{
+    sBenchFilter = sFilter;
+}
+
+bool isBenchSelected(const std::string& sName)
+{
+    return sBenchFilter.empty() || (sName.find(sBenchFilter) != std::string::npos);
+}
+
+bool writeBenchResultsJSON(const std::vector<BenchResult>& vResults, const std::string& sPath)
+{
+    std::ofstream file(sPath);
+    if (file.is_open() == false)
+    {
+        return true;
+    }
+
+    file << "[\n";
+
+    for (size_t i = 0; i < vResults.size(); i++)
+    {
+        char vLine[512];
+
+        std::snprintf(vLine, sizeof(vLine),
+                      "  {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ns_per_byte\": %.4f, \"allocs_per_op\": %.3f, \"iterations\": %zu}%s\n",
+                      escapeJSON(vResults[i].sName).c_str(),
+                      vResults[i].dNsPerOp,
+                      vResults[i].dNsPerByte,
+                      vResults[i].dAllocationsPerOp,
+                      vResults[i].iIterations,
+                      (i + 1 < vResults.size()) ? "," : "");
+
+        file << vLine;
+    }
+
+    file << "]\n";
+
+    return file.fail();
+}
+
+bool readBenchResultsJSON(const std::string& sPath, std::vector<BenchResult>& vResults)
+{
+    std::ifstream file(sPath);
+    if (file.is_open() == false)
+    {
+        return true;
+    }
+
+    std::string sLine;
+
+    while (std::getline(file, sLine))
+    {
+        const std::string sNameKey = "\"name\": \"";
+
+        size_t iNameStart = sLine.find(sNameKey);
+        if (iNameStart == std::string::npos)
+        {
+            continue;
+        }
+
+        BenchResult result;
+
+        for (size_t i = iNameStart + sNameKey.size(); (i < sLine.size()) && (sLine[i] != '"'); i++)
+        {
+            if ( (sLine[i] == '\\') && (i + 1 < sLine.size()) )
+            {
+                i++;
+            }
+
+            result.sName += sLine[i];
+        }
+
+        double dIterations = 0.0;
+
+        if ( readJSONNumber(sLine, "ns_per_op",     result.dNsPerOp)
+             || readJSONNumber(sLine, "ns_per_byte",   result.dNsPerByte)
+             || readJSONNumber(sLine, "allocs_per_op", result.dAllocationsPerOp)
+             || readJSONNumber(sLine, "iterations",    dIterations) )
+        {
+            return true;
+        }
+
+        result.iIterations = static_cast<size_t>(dIterations);
+
+        vResults.push_back(result);
+    }
+
+    return false;
+}
+
+bool compareBenchResults(const std::vector<BenchResult>& vBaseline, const std::vector<BenchResult>& vResults, double dMaxRegressionPercent)
+{
+    bool bRegression = false;
+
+    std::printf("\n%-44s %14s %14s %9s\n", "compared to baseline", "baseline ns", "current ns", "change");
+
+    for (const BenchResult& current : vResults)
+    {
+        for (const BenchResult& baseline : vBaseline)
+        {
+            if (baseline.sName != current.sName)
+            {
+                continue;
+            }
+
+            double dChangePercent = 0.0;
+            if (baseline.dNsPerOp > 0.0)
+            {
+                dChangePercent = (current.dNsPerOp - baseline.dNsPerOp) / baseline.dNsPerOp * 100.0;
+            }
+
+            const bool bSlower     = dChangePercent > dMaxRegressionPercent;
+            const bool bMoreAllocs = current.dAllocationsPerOp > baseline.dAllocationsPerOp + 0.5;
+
+            std::printf("%-44s %14.1f %14.1f %+8.1f%%%s%s\n",
+                        current.sName.c_str(), baseline.dNsPerOp, current.dNsPerOp, dChangePercent,
+                        bSlower ? "  REGRESSION" : "",
+                        bMoreAllocs ? "  MORE ALLOCATIONS" : "");
+
+            if (bSlower || bMoreAllocs)
+            {
+                bRegression = true;
+            }
+
+            break;
+        }
+    }
+
+    return bRegression;
+}
+
+void benchSink(const void* pValue)
+{
+    pBenchSink = pValue;
+}
@@ -0,0 +1,96 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// Minimal time spent in one benchmark (after warm-up).
+#define BENCH_MIN_TIME_MS 300
+
+// Default for --max-regression (percent).
+#define BENCH_DEFAULT_MAX_REGRESSION 10.0
+
+
+struct BenchResult
+{
+    std::string  sName;
+    double       dNsPerOp          = 0.0;
+    double       dNsPerByte        = 0.0;  // 0 if the benchmark does not process a buffer
+    double       dAllocationsPerOp = 0.0;  // operator new calls
+    size_t       iIterations       = 0;
+};
+
+
+// Calls the function until at least iMinTimeMs has passed and returns the mean time per call.
+BenchResult runBench              (const std::string& sName, const std::function<void()>& function, size_t iBytesPerOp = 0, unsigned int iMinTimeMs = BENCH_MIN_TIME_MS);
+
+// runBench() + print + store, skipped if the name does not match the --filter.
+void        addBench              (std::vector<BenchResult>& vResults, const std::string& sName, const std::function<void()>& function, size_t iBytesPerOp = 0);
+
+// Print + store for results measured by the caller (one-time costs).
+void        addBenchResult        (std::vector<BenchResult>& vResults, const BenchResult& result);
+
+void        printBenchResult      (const BenchResult& result);
+
+
+void        setBenchFilter        (const std::string& sFilter);
+bool        isBenchSelected       (const std::string& sName);
+
+
+// Machine-readable output, one result object per line.
+// Return true if failed.
+bool        writeBenchResultsJSON (const std::vector<BenchResult>& vResults, const std::string& sPath);
+bool        readBenchResultsJSON  (const std::string& sPath, std::vector<BenchResult>& vResults);
+
+// Prints the change of every result present in both runs.
+// Returns true if something got slower (or allocates more) than dMaxRegressionPercent allows.
+bool        compareBenchResults   (const std::vector<BenchResult>& vBaseline, const std::vector<BenchResult>& vResults, double dMaxRegressionPercent);
+
+
+// Keeps the compiler from throwing away the result of the measured code.
+void        benchSink             (const void* pValue);
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+// bench_alloc.cpp (replaces the global operator new/delete)
+size_t      getAllocationCount    ();
+
+// bench_integer.cpp
+void        benchInteger          (std::vector<BenchResult>& vResults);
+
+// bench_handshake.cpp
+// Returns true if the client's part of the key exchange is over its target (HANDSHAKE_CLIENT_TARGET_MS) for some group.
+bool        benchHandshake        (std::vector<BenchResult>& vResults);
+
+// bench_connect.cpp
+// Connects to a loopback server (with a simulated round trip) and reports the time until it got our first voice packet.
+void        benchConnect          (std::vector<BenchResult>& vResults);
+
+// bench_aes.cpp
+void        benchAES              (std::vector<BenchResult>& vResults);
+
+// bench_audio.cpp
+void        benchAudioBackend     (std::vector<BenchResult>& vResults);
+
+// bench_input.cpp
+void        benchInputSource      (std::vector<BenchResult>& vResults);
+
+// bench_dsp.cpp
+// Also checks that the SIMD kernels give the same samples as the scalar code
+// and that the noise suppressor fits its CPU budget (returns true if not).
+bool        benchDSP              (std::vector<BenchResult>& vResults);
+
+// bench_latency.cpp
+// Runs a test tone through capture -> AES -> "network" thread -> AES -> mixer -> real-time output (~4 sec.)
+// and reports the voice latency (per stage and mouth-to-ear).
+void        benchLatency          (std::vector<BenchResult>& vResults);
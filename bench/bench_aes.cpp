@@ -0,0 +1,113 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "bench.h"
+
+
+// STL
+#include <random>
+
+// External
+#include "AES/AES.h"
+
+
+// A voice packet (679 samples * 2 bytes, padded to the AES block) and a short text message.
+static const unsigned int vPayloadSizes[] = {1360, 64};
+
+
+void benchAES(std::vector<BenchResult>& vResults)
+{
+    std::mt19937 generator(51337);
+
+    const int vKeySizes[] = {128, 192, 256};
+
+    for (int iKeySize : vKeySizes)
+    {
+        AES aes(iKeySize);
+
+        unsigned char vKey[32];
+        unsigned char vIV[16];
+
+        for (size_t i = 0; i < sizeof(vKey); i++)
+        {
+            vKey[i] = static_cast<unsigned char>(generator());
+        }
+
+        for (size_t i = 0; i < sizeof(vIV); i++)
+        {
+            vIV[i] = static_cast<unsigned char>(generator());
+        }
+
+
+        for (unsigned int iPayloadSize : vPayloadSizes)
+        {
+            std::vector<unsigned char> vPlain(iPayloadSize);
+
+            for (size_t i = 0; i < vPlain.size(); i++)
+            {
+                vPlain[i] = static_cast<unsigned char>(generator());
+            }
+
+            const std::string sSuffix = " " + std::to_string(iKeySize) + " " + std::to_string(iPayloadSize) + "B";
+
+            unsigned int iOutSize = 0;
+
+
+            // Ciphertexts for the decrypt benchmarks.
+
+            unsigned char* pCipherECB = aes.EncryptECB(vPlain.data(), iPayloadSize, vKey, iOutSize);
+            unsigned char* pCipherCBC = aes.EncryptCBC(vPlain.data(), iPayloadSize, vKey, vIV, iOutSize);
+            unsigned char* pCipherCFB = aes.EncryptCFB(vPlain.data(), iPayloadSize, vKey, vIV, iOutSize);
+
+
+            addBench(vResults, "aes encrypt ecb" + sSuffix, [&]()
+            {
+                unsigned char* pOut = aes.EncryptECB(vPlain.data(), iPayloadSize, vKey, iOutSize);
+                benchSink(pOut);
+                delete[] pOut;
+            }, iPayloadSize);
+
+            addBench(vResults, "aes decrypt ecb" + sSuffix, [&]()
+            {
+                unsigned char* pOut = aes.DecryptECB(pCipherECB, iPayloadSize, vKey);
+                benchSink(pOut);
+                delete[] pOut;
+            }, iPayloadSize);
+
+            addBench(vResults, "aes encrypt cbc" + sSuffix, [&]()
+            {
+                unsigned char* pOut = aes.EncryptCBC(vPlain.data(), iPayloadSize, vKey, vIV, iOutSize);
+                benchSink(pOut);
+                delete[] pOut;
+            }, iPayloadSize);
+
+            addBench(vResults, "aes decrypt cbc" + sSuffix, [&]()
+            {
+                unsigned char* pOut = aes.DecryptCBC(pCipherCBC, iPayloadSize, vKey, vIV);
+                benchSink(pOut);
+                delete[] pOut;
+            }, iPayloadSize);
+
+            addBench(vResults, "aes encrypt cfb" + sSuffix, [&]()
+            {
+                unsigned char* pOut = aes.EncryptCFB(vPlain.data(), iPayloadSize, vKey, vIV, iOutSize);
+                benchSink(pOut);
+                delete[] pOut;
+            }, iPayloadSize);
+
+            addBench(vResults, "aes decrypt cfb" + sSuffix, [&]()
+            {
+                unsigned char* pOut = aes.DecryptCFB(pCipherCFB, iPayloadSize, vKey, vIV);
+                benchSink(pOut);
+                delete[] pOut;
+            }, iPayloadSize);
+
+
+            delete[] pCipherECB;
+            delete[] pCipherCBC;
+            delete[] pCipherCFB;
+        }
+    }
+}
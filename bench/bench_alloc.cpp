@@ -0,0 +1,80 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "bench.h"
+
+
+// STL
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+// Every operator new in the bench executable goes through here so that
+// runBench() can report allocations per call.
+
+static std::atomic<size_t> iAllocationCount(0);
+
+
+size_t getAllocationCount()
+{
+    return iAllocationCount.load(std::memory_order_relaxed);
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+void* operator new(size_t iSize)
+{
+    iAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    void* pMemory = std::malloc(iSize > 0 ? iSize : 1);
+    if (pMemory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return pMemory;
+}
+
+void* operator new[](size_t iSize)
+{
+    return operator new(iSize);
+}
+
+void* operator new(size_t iSize, const std::nothrow_t&) noexcept
+{
+    iAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    return std::malloc(iSize > 0 ? iSize : 1);
+}
+
+void* operator new[](size_t iSize, const std::nothrow_t& tag) noexcept
+{
+    return operator new(iSize, tag);
+}
+
+void operator delete(void* pMemory) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+    std::free(pMemory);
+}
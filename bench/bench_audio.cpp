@@ -0,0 +1,555 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "bench.h"
+
+
+// STL
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+
+// Custom
+#include "Model/AudioService/Backend/nullaudiobackend.h"
+#include "Model/AudioService/Backend/wavfileaudiobackend.h"
+#include "Model/AudioService/Backend/switchableaudiostream.h"
+#include "Model/AudioService/FramePool/audioframepool.h"
+#include "Model/AudioService/Mixer/audiomixer.h"
+#include "Model/AudioService/Recorder/sessionrecorder.h"
+#include "Model/AudioService/Sounds/notificationsounds.h"
+
+// External
+#include "AES/AES.h"
+
+
+// Same as in AudioService.
+static const unsigned int iSampleRate       = 19400;
+static const int          iSamplesPerPacket = 679;
+
+static const char*        pInputPath        = "SilentBench_input.wav";
+static const char*        pOutputPrefix     = "SilentBench_output_";
+static const char*        pSoundPath        = "SilentBench_sound.wav";
+static const char*        pRecordingsPath   = "SilentBench_recordings/";
+
+
+// ~0.7 sec.
+#define REAL_TIME_CAPTURE_PACKETS 20
+
+// Packets before and after a device switch (real time).
+#define DEVICE_SWITCH_PACKETS     10
+
+
+namespace
+{
+    // A device that is unplugged after some packets.
+
+    class UnpluggedCaptureStream : public AudioCaptureStream
+    {
+    public:
+
+        UnpluggedCaptureStream(AudioCaptureStream* pDeviceStream, int iPacketsLeft)
+        {
+            this->pDeviceStream = pDeviceStream;
+            this->iPacketsLeft  = iPacketsLeft;
+        }
+
+        ~UnpluggedCaptureStream() override
+        {
+            delete pDeviceStream;
+        }
+
+        bool start() override
+        {
+            return pDeviceStream->start();
+        }
+
+        bool read(short* pSamples) override
+        {
+            if (iPacketsLeft == 0)
+            {
+                return true;
+            }
+
+            iPacketsLeft--;
+
+            return pDeviceStream->read(pSamples);
+        }
+
+        void              stop           () override       { pDeviceStream->stop(); }
+        int               getBufferCount () const override { return pDeviceStream->getBufferCount(); }
+        AudioCaptureStats getStats       () const override { return pDeviceStream->getStats(); }
+        std::string       getLastError   () const override { return "unplugged"; }
+
+    private:
+
+        AudioCaptureStream* pDeviceStream;
+        int                 iPacketsLeft;
+    };
+
+
+    class UnpluggedPlaybackStream : public AudioPlaybackStream
+    {
+    public:
+
+        UnpluggedPlaybackStream(AudioPlaybackStream* pDeviceStream, int iPacketsLeft)
+        {
+            this->pDeviceStream = pDeviceStream;
+            this->iPacketsLeft  = iPacketsLeft;
+        }
+
+        ~UnpluggedPlaybackStream() override
+        {
+            delete pDeviceStream;
+        }
+
+        bool write(const short* pSamples) override
+        {
+            if (iPacketsLeft == 0)
+            {
+                return true;
+            }
+
+            iPacketsLeft--;
+
+            return pDeviceStream->write(pSamples);
+        }
+
+        size_t      getQueuedPacketCount () override       { return pDeviceStream->getQueuedPacketCount(); }
+        void        drain                () override       { pDeviceStream->drain(); }
+        void        reset                () override       { pDeviceStream->reset(); }
+        void        setVolume            (unsigned short iVolume) override { pDeviceStream->setVolume(iVolume); }
+        std::string getLastError         () const override { return "unplugged"; }
+
+    private:
+
+        AudioPlaybackStream* pDeviceStream;
+        int                  iPacketsLeft;
+    };
+
+
+    void addDeviceSwitchResult(std::vector<BenchResult>& vResults, const std::string& sName, const std::vector<AudioDeviceSwitch>& vSwitches)
+    {
+        if ( (vSwitches.size() != 1) || vSwitches[0].bFailed )
+        {
+            std::printf("%s: %zu switches (expected 1)%s\n", sName.c_str(), vSwitches.size(),
+                        vSwitches.empty() ? "" : (", " + vSwitches[0].sErrorText).c_str());
+            return;
+        }
+
+        std::printf("%s: %.2f ms, %llu packets lost\n", sName.c_str(), vSwitches[0].dSwitchMs, vSwitches[0].iLostPackets);
+
+        // As "ns/op" so that --baseline catches a slower switch.
+
+        BenchResult result;
+        result.sName       = sName;
+        result.dNsPerOp    = vSwitches[0].dSwitchMs * 1000000.0;
+        result.iIterations = 1;
+
+        addBenchResult(vResults, result);
+    }
+}
+
+
+void benchAudioBackend(std::vector<BenchResult>& vResults)
+{
+    AudioFormat format;
+    format.iSampleRate       = iSampleRate;
+    format.iSamplesPerPacket = iSamplesPerPacket;
+
+
+    // 1 second of 440 Hz as the microphone.
+
+    std::vector<short> vTone(iSampleRate);
+
+    for (size_t i = 0; i < vTone.size(); i++)
+    {
+        vTone[i] = static_cast<short>( 8000.0 * std::sin(2.0 * 3.14159265358979 * 440.0 * i / iSampleRate) );
+    }
+
+    if ( WavFileAudioBackend::writeWavFile(pInputPath, vTone, iSampleRate) )
+    {
+        std::printf("Could not write %s, skipping the audio backend benchmarks.\n", pInputPath);
+        return;
+    }
+
+
+    std::string sErrorText;
+
+    WavFileAudioBackend wavBackend(pInputPath, pOutputPrefix, false);
+    NullAudioBackend    nullBackend(false);
+
+    std::unique_ptr<AudioCaptureStream>  pWavCapture  ( wavBackend.openCapture(L"", format, sErrorText) );
+    std::unique_ptr<AudioPlaybackStream> pWavPlayback ( wavBackend.openPlayback(format, sErrorText) );
+    std::unique_ptr<AudioCaptureStream>  pNullCapture ( nullBackend.openCapture(L"", format, sErrorText) );
+    std::unique_ptr<AudioPlaybackStream> pNullPlayback( nullBackend.openPlayback(format, sErrorText) );
+
+    // Device at 48000 Hz, converted by us (as AudioService does by default).
+
+    AudioFormat resampledFormat = format;
+    resampledFormat.iDeviceSampleRate = AUDIO_DEVICE_SAMPLE_RATE;
+
+    std::unique_ptr<AudioCaptureStream>  pResampledCapture ( nullBackend.openResampledCapture(L"", resampledFormat, sErrorText) );
+    std::unique_ptr<AudioPlaybackStream> pResampledPlayback( nullBackend.openResampledPlayback(resampledFormat, sErrorText) );
+
+    if ( (pWavCapture == nullptr) || (pWavPlayback == nullptr) || (pNullCapture == nullptr) || (pNullPlayback == nullptr)
+         || (pResampledCapture == nullptr) || (pResampledPlayback == nullptr) )
+    {
+        std::printf("Could not open the audio streams (%s), skipping the audio backend benchmarks.\n", sErrorText.c_str());
+        std::remove(pInputPath);
+        return;
+    }
+
+    pWavCapture      ->start();
+    pNullCapture     ->start();
+    pResampledCapture->start();
+
+
+    const size_t iPacketSizeInBytes = iSamplesPerPacket * sizeof(short);
+
+    std::vector<short> vPacket(iSamplesPerPacket);
+
+    addBench(vResults, "audio null capture read", [&]()
+    {
+        pNullCapture->read(vPacket.data());
+        benchSink(vPacket.data());
+    }, iPacketSizeInBytes);
+
+    addBench(vResults, "audio null capture read at 48000 Hz", [&]()
+    {
+        pResampledCapture->read(vPacket.data());
+        benchSink(vPacket.data());
+    }, iPacketSizeInBytes);
+
+    addBench(vResults, "audio null playback write at 48000 Hz", [&]()
+    {
+        pResampledPlayback->write(vPacket.data());
+    }, iPacketSizeInBytes);
+
+    addBench(vResults, "audio wav capture read", [&]()
+    {
+        pWavCapture->read(vPacket.data());
+        benchSink(vPacket.data());
+    }, iPacketSizeInBytes);
+
+    addBench(vResults, "audio wav capture to null playback", [&]()
+    {
+        pWavCapture  ->read(vPacket.data());
+        pNullPlayback->write(vPacket.data());
+    }, iPacketSizeInBytes);
+
+    addBench(vResults, "audio wav capture to wav playback", [&]()
+    {
+        pWavCapture ->read(vPacket.data());
+        pWavPlayback->write(vPacket.data());
+    }, iPacketSizeInBytes);
+
+
+    pWavCapture      ->stop();
+    pNullCapture     ->stop();
+    pResampledCapture->stop();
+
+
+    // A frame per packet: from the pool and from the heap (as AudioService did before the pool).
+
+    {
+        AudioFramePool framePool(iSamplesPerPacket);
+
+        addBench(vResults, "audio frame pool acquire and release", [&]()
+        {
+            AudioFrame frame = framePool.acquire();
+            benchSink(frame.getSamples());
+        });
+
+        addBench(vResults, "audio frame new and delete", [&]()
+        {
+            short* pSamples = new short[iSamplesPerPacket];
+            benchSink(pSamples);
+            delete[] pSamples;
+        });
+    }
+
+
+    // A notification sound (1.5 sec. at 44100 Hz as in res/sounds): read and converted on every play
+    // (as PlaySound() did) and played by the mixer from memory (the same sound is still playing - dropped).
+
+    {
+        const unsigned int iSoundSampleRate = 44100;
+
+        std::vector<short> vSound(iSoundSampleRate * 3 / 2);
+
+        for (size_t i = 0; i < vSound.size(); i++)
+        {
+            vSound[i] = static_cast<short>( 8000.0 * std::sin(2.0 * 3.14159265358979 * 880.0 * i / iSoundSampleRate) );
+        }
+
+        if ( WavFileAudioBackend::writeWavFile(pSoundPath, vSound, iSoundSampleRate) == false )
+        {
+            std::vector<short> vSamples;
+
+            addBench(vResults, "audio notification sound read from disk", [&]()
+            {
+                NotificationSounds::readSound(pSoundPath, iSampleRate, vSamples, sErrorText);
+                benchSink(vSamples.data());
+            }, vSound.size() * sizeof(short));
+
+            MixerSound sound;
+            sound.vSamples = vSamples;
+
+            AudioMixer mixer(nullBackend.openPlayback(format, sErrorText), format);
+
+            addBench(vResults, "audio notification sound play preloaded", [&]()
+            {
+                mixer.playSound(&sound);
+            }, vSound.size() * sizeof(short));
+        }
+
+        std::remove(pSoundPath);
+    }
+
+
+    // The receive path of AudioService for 12 talking users (decryption + the mixer): everyone is mixed
+    // and only the 4 loudest are (the packets of the others are skipped before the decryption, see AudioMixer::skipCappedPacket()).
+    // The output is real time so that the render thread has time to cap the speakers before the measurement.
+
+    for (const size_t iMaxSpeakers : { static_cast<size_t>(0), static_cast<size_t>(4) })
+    {
+        const std::string sName = iMaxSpeakers ? "audio mixer receive 12 speakers, 4 mixed" : "audio mixer receive 12 speakers, all mixed";
+
+        if ( isBenchSelected(sName) == false )
+        {
+            continue;
+        }
+
+        const size_t iSpeakerCount = 12;
+
+        NullAudioBackend realTimeBackend(true);
+
+        AudioMixer mixer(realTimeBackend.openPlayback(format, sErrorText), format);
+        mixer.setMaxSpeakers(iMaxSpeakers);
+
+        AES aes(128);
+
+        unsigned char vKey[16];
+
+        for (size_t i = 0; i < sizeof(vKey); i++)
+        {
+            vKey[i] = static_cast<unsigned char>(i * 37 + 11);
+        }
+
+        // Each speaker is louder than the previous one, so the same 4 stay mixed.
+
+        std::vector<MixerSpeaker*>              vSpeakers;
+        std::vector<std::vector<unsigned char>> vEncrypted;
+
+        for (size_t k = 0; k < iSpeakerCount; k++)
+        {
+            vSpeakers.push_back( mixer.addSpeaker([](bool) {}) );
+
+            std::vector<short> vSpeakerPacket(iSamplesPerPacket);
+
+            for (int i = 0; i < iSamplesPerPacket; i++)
+            {
+                vSpeakerPacket[i] = static_cast<short>( 1000.0 * (k + 1) * std::sin(2.0 * 3.14159265358979 * 440.0 * i / iSampleRate) );
+            }
+
+            unsigned int   iEncryptedSize = 0;
+            unsigned char* pEncrypted     = aes.EncryptECB(reinterpret_cast<unsigned char*>(vSpeakerPacket.data()),
+                                                           static_cast<unsigned int>(iPacketSizeInBytes), vKey, iEncryptedSize);
+
+            vEncrypted.push_back( std::vector<unsigned char>(pEncrypted, pEncrypted + iEncryptedSize) );
+
+            delete[] pEncrypted;
+        }
+
+        std::vector<unsigned char> vDecrypted(vEncrypted[0].size());
+
+        auto receive = [&]()
+        {
+            for (size_t k = 0; k < iSpeakerCount; k++)
+            {
+                if ( mixer.skipCappedPacket(vSpeakers[k]) )
+                {
+                    continue;
+                }
+
+                aes.DecryptECB(vEncrypted[k].data(), static_cast<unsigned int>(vEncrypted[k].size()), vKey, vDecrypted.data());
+
+                mixer.pushPacket(vSpeakers[k], reinterpret_cast<short*>(vDecrypted.data()));
+            }
+        };
+
+        for (int i = 0; i < AUDIO_MIXER_PREBUFFER_PACKETS + 2; i++)
+        {
+            receive();
+        }
+
+        std::this_thread::sleep_for( std::chrono::milliseconds(200) );
+
+        mixer.resetStats();
+
+        addBench(vResults, sName, receive, iSpeakerCount * iPacketSizeInBytes);
+
+        const AudioMixerStats stats = mixer.getStats();
+
+        std::printf("%s: %llu speaker packets mixed, %llu capped, %llu of them not decrypted\n", sName.c_str(),
+                    stats.iSpeakerPacketCount, stats.iCappedPacketCount, stats.iSkippedPacketCount);
+
+        for (MixerSpeaker* pSpeaker : vSpeakers)
+        {
+            mixer.removeSpeaker(pSpeaker);
+        }
+    }
+
+
+    // What the mixer's render thread pays per recorded packet (the writer thread writes to the disk meanwhile,
+    // packets are given much faster than in real time so some are dropped when the queue is full).
+    // The position is the same for all (appended), otherwise the dropped ones would be written as silence.
+
+    if ( isBenchSelected("audio session recorder write mix and speaker") )
+    {
+        SessionRecorder recorder(format);
+
+        if ( recorder.start(pRecordingsPath, sErrorText) == false )
+        {
+            const size_t iMixStream     = recorder.addStream("mix");
+            const size_t iSpeakerStream = recorder.addStream("speaker");
+
+            const unsigned long long iPosition = recorder.nextPacketPosition();
+
+            addBench(vResults, "audio session recorder write mix and speaker", [&]()
+            {
+                recorder.writePacket(iMixStream,     iPosition, vPacket.data());
+                recorder.writePacket(iSpeakerStream, iPosition, vPacket.data());
+            }, 2 * iPacketSizeInBytes);
+
+            recorder.stop();
+
+            SessionRecorderStats stats = recorder.getStats();
+
+            std::printf("audio session recorder: %llu packets, %llu dropped (queue full), %llu write errors, %zu of %d queued max\n",
+                        stats.iPacketCount, stats.iDroppedPacketCount, stats.iWriteErrorCount,
+                        stats.iMaxQueuedPackets, SESSION_RECORDER_QUEUE_PACKETS);
+        }
+
+        std::error_code error;
+        std::filesystem::remove_all(pRecordingsPath, error);
+    }
+
+
+    // How long the capture thread sleeps past the packet deadline (real-time pacing, like a device).
+
+    if ( isBenchSelected("audio real-time capture latency") )
+    {
+        NullAudioBackend realTimeBackend(true);
+
+        std::unique_ptr<AudioCaptureStream> pRealTimeCapture( realTimeBackend.openCapture(L"", format, sErrorText) );
+
+        pRealTimeCapture->start();
+
+        for (int i = 0; i < REAL_TIME_CAPTURE_PACKETS; i++)
+        {
+            pRealTimeCapture->read(vPacket.data());
+        }
+
+        pRealTimeCapture->stop();
+
+        AudioCaptureStats stats = pRealTimeCapture->getStats();
+
+        std::printf("audio real-time capture latency: %llu packets, %.2f wakeups per packet, %.3f ms average / %.3f ms max\n",
+                    stats.iPacketCount, stats.getWakeupsPerPacket(), stats.getAverageLatencyMs(), stats.dMaxLatencyMs);
+    }
+
+    // A device switch in the middle of a recording / a device that is lost (the packets are real time,
+    // the time is from the request or the failure until the new device gave/took the first packet).
+
+    if ( isBenchSelected("audio device switch") )
+    {
+        NullAudioBackend realTimeBackend(true);
+
+        std::vector<AudioDeviceSwitch> vSwitches;
+
+        auto onSwitched = [&](const AudioDeviceSwitch& deviceSwitch)
+        {
+            vSwitches.push_back(deviceSwitch);
+        };
+
+
+        {
+            SwitchableCaptureStream capture(realTimeBackend.openCapture(L"", format, sErrorText), L"", format,
+                [&](const std::wstring& sDeviceName, std::string& sOpenErrorText)
+                {
+                    return realTimeBackend.openCapture(sDeviceName, format, sOpenErrorText);
+                },
+                onSwitched);
+
+            capture.start();
+
+            for (int i = 0; i < 2 * DEVICE_SWITCH_PACKETS; i++)
+            {
+                if (i == DEVICE_SWITCH_PACKETS)
+                {
+                    capture.switchDevice(L"Null");
+                }
+
+                capture.read(vPacket.data());
+            }
+
+            capture.stop();
+
+            addDeviceSwitchResult(vResults, "audio device switch capture", vSwitches);
+        }
+
+
+        vSwitches.clear();
+
+        {
+            SwitchableCaptureStream capture(new UnpluggedCaptureStream(realTimeBackend.openCapture(L"", format, sErrorText), DEVICE_SWITCH_PACKETS),
+                L"", format,
+                [&](const std::wstring& sDeviceName, std::string& sOpenErrorText)
+                {
+                    return realTimeBackend.openCapture(sDeviceName, format, sOpenErrorText);
+                },
+                onSwitched);
+
+            capture.start();
+
+            for (int i = 0; i < 2 * DEVICE_SWITCH_PACKETS; i++)
+            {
+                capture.read(vPacket.data());
+            }
+
+            capture.stop();
+
+            addDeviceSwitchResult(vResults, "audio device switch after capture failure", vSwitches);
+        }
+
+
+        vSwitches.clear();
+
+        {
+            SwitchablePlaybackStream playback(new UnpluggedPlaybackStream(realTimeBackend.openPlayback(format, sErrorText), DEVICE_SWITCH_PACKETS),
+                [&](std::string& sOpenErrorText)
+                {
+                    return realTimeBackend.openPlayback(format, sOpenErrorText);
+                },
+                onSwitched);
+
+            for (int i = 0; i < 2 * DEVICE_SWITCH_PACKETS; i++)
+            {
+                playback.write(vPacket.data());
+            }
+
+            addDeviceSwitchResult(vResults, "audio device switch after playback failure", vSwitches);
+        }
+    }
+
+    pWavPlayback.reset();
+
+    std::remove(pInputPath);
+    std::remove( (std::string(pOutputPrefix) + "0.wav").c_str() );
+}
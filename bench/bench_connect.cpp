@@ -0,0 +1,569 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "bench.h"
+
+
+// STL
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib,"Ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+// Custom
+#include "Model/Crypto/dhgroup.h"
+#include "Model/NetworkService/handshakemessages.h"
+#include "Model/net_params.h"
+#include "AES/AES.h"
+
+
+// Every answer of the loopback server comes this much later (a round trip of a typical connection).
+#define CONNECT_SIMULATED_RTT_MS   20
+
+// The median of this many connections is reported.
+#define CONNECT_RUNS               5
+
+
+namespace
+{
+#if defined(_WIN32)
+    using BenchSocket = SOCKET;
+    const BenchSocket INVALID_BENCH_SOCKET = INVALID_SOCKET;
+
+    void closeBenchSocket(BenchSocket sock) { closesocket(sock); }
+#else
+    using BenchSocket = int;
+    const BenchSocket INVALID_BENCH_SOCKET = -1;
+
+    void closeBenchSocket(BenchSocket sock) { close(sock); }
+#endif
+
+
+    // Same as in NetworkService (also change in server).
+    const char  CM_SERVER_INFO     = 4;
+    const char  SM_CAN_START_UDP   = 2;
+    const char  UDP_SM_PREPARE     = -1;
+    const char  VM_DEFAULT_MESSAGE = 1;
+
+    // Same as in AudioService.
+    const int   iSamplesPerPacket  = 679;
+
+    // Room list and users (a small server).
+    const size_t iChatInfoSize     = 300;
+
+
+    using Clock = std::chrono::steady_clock;
+
+
+    // Return true if failed.
+
+    bool sendAll(BenchSocket sock, const void* pData, size_t iSize)
+    {
+        const char* pBytes = static_cast<const char*>(pData);
+
+        while (iSize > 0)
+        {
+            const int iSent = send(sock, pBytes, static_cast<int>(iSize), 0);
+
+            if (iSent <= 0)
+            {
+                return true;
+            }
+
+            pBytes += iSent;
+            iSize  -= static_cast<size_t>(iSent);
+        }
+
+        return false;
+    }
+
+    bool recvAll(BenchSocket sock, void* pData, size_t iSize)
+    {
+        char* pBytes = static_cast<char*>(pData);
+
+        while (iSize > 0)
+        {
+            const int iReceived = recv(sock, pBytes, static_cast<int>(iSize), 0);
+
+            if (iReceived <= 0)
+            {
+                return true;
+            }
+
+            pBytes += iReceived;
+            iSize  -= static_cast<size_t>(iReceived);
+        }
+
+        return false;
+    }
+
+    bool sendOpenKey(BenchSocket sock, const DHGroup* pGroup, const integer& privateKey)
+    {
+        std::vector<char> vOpenKey;
+        HandshakeMessages::appendOpenKey(vOpenKey, pGroup, privateKey);
+
+        return sendAll(sock, vOpenKey.data(), vOpenKey.size());
+    }
+
+    bool recvOpenKey(BenchSocket sock, std::string& sOpenKey)
+    {
+        unsigned short iKeySize = 0;
+
+        if ( recvAll(sock, &iKeySize, sizeof(iKeySize)) || (iKeySize == 0) || (iKeySize > DH_MAX_OPEN_KEY_SIZE) )
+        {
+            return true;
+        }
+
+        sOpenKey.resize(iKeySize);
+
+        return recvAll(sock, &sOpenKey[0], iKeySize);
+    }
+
+    bool deriveKey(const DHGroup* pGroup, const std::string& sPeerOpenKey, const integer& privateKey, unsigned char* pKey)
+    {
+        return HandshakeMessages::deriveSessionKey(pGroup, integer(sPeerOpenKey, 256), privateKey, pKey, 16);
+    }
+
+
+    // A server that talks just enough of the protocol to let one client send one voice packet.
+    // The messages are made by HandshakeMessages (as in NetworkService), the order of the steps is the same as in
+    // NetworkService::setupChatConnection() when bPipelined: the hello carries the client's open key
+    // and the UDP "prepare" packet is sent with it, otherwise every step waits for the previous answer
+    // (the protocol before 3.6.0, for comparison).
+
+    struct LoopbackServer
+    {
+        BenchSocket       listenSocket = INVALID_BENCH_SOCKET;
+        BenchSocket       udpSocket    = INVALID_BENCH_SOCKET;
+        sockaddr_in       tcpAddress;
+        sockaddr_in       udpAddress;
+
+        std::promise<Clock::time_point> promiseVoiceReceived;
+        std::atomic<bool> bKeysMatch {false};
+        std::atomic<bool> bFailed    {false};
+
+
+        bool open()
+        {
+            listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            udpSocket    = socket(AF_INET, SOCK_DGRAM,  IPPROTO_UDP);
+
+            if ( (listenSocket == INVALID_BENCH_SOCKET) || (udpSocket == INVALID_BENCH_SOCKET) )
+            {
+                return true;
+            }
+
+            sockaddr_in address;
+            std::memset(&address, 0, sizeof(address));
+            address.sin_family      = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port        = 0;
+
+            socklen_t iAddressSize = sizeof(address);
+
+            if ( bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) || listen(listenSocket, 1)
+                 || getsockname(listenSocket, reinterpret_cast<sockaddr*>(&tcpAddress), &iAddressSize) )
+            {
+                return true;
+            }
+
+            iAddressSize = sizeof(address);
+
+            if ( bind(udpSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address))
+                 || getsockname(udpSocket, reinterpret_cast<sockaddr*>(&udpAddress), &iAddressSize) )
+            {
+                return true;
+            }
+
+            return false;
+        }
+
+        void close()
+        {
+            closeBenchSocket(listenSocket);
+            closeBenchSocket(udpSocket);
+        }
+
+        void serve(bool bPipelined, const DHGroup* pGroup, const std::vector<short>& vVoice)
+        {
+            BenchSocket clientSocket = accept(listenSocket, nullptr, nullptr);
+
+            if ( (clientSocket == INVALID_BENCH_SOCKET) || serveClient(clientSocket, bPipelined, pGroup, vVoice) )
+            {
+                bFailed = true;
+                promiseVoiceReceived.set_value(Clock::now());
+            }
+
+            if (clientSocket != INVALID_BENCH_SOCKET)
+            {
+                closeBenchSocket(clientSocket);
+            }
+        }
+
+        bool serveClient(BenchSocket sock, bool bPipelined, const DHGroup* pGroup, const std::vector<short>& vVoice)
+        {
+            // Hello: version, user name, password (wchar_t), [group id, open key B].
+
+            char vHello[256];
+
+            for (int iField = 0; iField < 3; iField++)
+            {
+                unsigned char iSize = 0;
+
+                if ( recvAll(sock, &iSize, sizeof(iSize))
+                     || recvAll(sock, vHello, iSize * (iField == 2 ? sizeof(wchar_t) : 1)) )
+                {
+                    return true;
+                }
+            }
+
+            std::string sOpenKeyB;
+
+            if (bPipelined)
+            {
+                char iGroupId = 0;
+
+                if ( recvAll(sock, &iGroupId, sizeof(iGroupId)) || recvOpenKey(sock, sOpenKeyB) )
+                {
+                    return true;
+                }
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_SIMULATED_RTT_MS));
+
+
+            integer a = pGroup->generatePrivateKey();
+
+            unsigned char vKey[16];
+
+            if ( bPipelined && deriveKey(pGroup, sOpenKeyB, a, vKey) )
+            {
+                // The key is derived before the answer is sent.
+                return true;
+            }
+
+            std::vector<char> vAnswer = {CM_SERVER_INFO, pGroup->getGroupId()};
+            HandshakeMessages::appendOpenKey(vAnswer, pGroup, a);
+
+            if ( sendAll(sock, vAnswer.data(), vAnswer.size()) )
+            {
+                return true;
+            }
+
+            if (bPipelined == false)
+            {
+                // Open key B, then "finished connecting".
+
+                if ( recvOpenKey(sock, sOpenKeyB) || deriveKey(pGroup, sOpenKeyB, a, vKey) )
+                {
+                    return true;
+                }
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_SIMULATED_RTT_MS));
+
+                const char cFinished = 1;
+
+                if ( sendAll(sock, &cFinished, sizeof(cFinished)) )
+                {
+                    return true;
+                }
+            }
+
+
+            // Chat info.
+
+            const unsigned short iInfoSize = static_cast<unsigned short>(iChatInfoSize);
+            std::vector<char>    vInfo(iChatInfoSize, 'r');
+
+            if ( sendAll(sock, &iInfoSize, sizeof(iInfoSize)) || sendAll(sock, vInfo.data(), vInfo.size()) )
+            {
+                return true;
+            }
+
+
+            // UDP "prepare" (already here if it was sent with the hello).
+
+            char vDatagram[4096];
+
+            sockaddr_in clientAddress;
+            socklen_t   iAddressSize = sizeof(clientAddress);
+
+            int iReceived = recvfrom(udpSocket, vDatagram, sizeof(vDatagram), 0, reinterpret_cast<sockaddr*>(&clientAddress), &iAddressSize);
+
+            if ( (iReceived <= 0) || (vDatagram[0] != UDP_SM_PREPARE) )
+            {
+                return true;
+            }
+
+            if (bPipelined == false)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_SIMULATED_RTT_MS));
+            }
+
+            if ( sendAll(sock, &SM_CAN_START_UDP, sizeof(SM_CAN_START_UDP)) )
+            {
+                return true;
+            }
+
+
+            // The first voice packet.
+
+            iReceived = recvfrom(udpSocket, vDatagram, sizeof(vDatagram), 0, nullptr, nullptr);
+
+            const Clock::time_point voiceTime = Clock::now();
+
+            if ( (iReceived <= 1) || (vDatagram[0] != VM_DEFAULT_MESSAGE) )
+            {
+                return true;
+            }
+
+            AES aes(128);
+
+            unsigned char* pDecrypted = aes.DecryptECB(reinterpret_cast<unsigned char*>(vDatagram + 1), static_cast<unsigned int>(iReceived - 1), vKey);
+
+            bKeysMatch = ( std::memcmp(pDecrypted, vVoice.data(), vVoice.size() * sizeof(short)) == 0 );
+
+            delete[] pDecrypted;
+
+            promiseVoiceReceived.set_value(voiceTime);
+
+            return false;
+        }
+    };
+
+
+    // From connect() until the server got our first voice packet, negative if failed.
+
+    double measureConnectToFirstVoice(bool bPipelined, const DHGroup* pGroup)
+    {
+        std::vector<short> vVoice(iSamplesPerPacket);
+
+        for (size_t i = 0; i < vVoice.size(); i++)
+        {
+            vVoice[i] = static_cast<short>(i * 31);
+        }
+
+        LoopbackServer server;
+
+        if ( server.open() )
+        {
+            server.close();
+            return -1.0;
+        }
+
+        std::future<Clock::time_point> voiceReceived = server.promiseVoiceReceived.get_future();
+
+        std::thread serverThread(&LoopbackServer::serve, &server, bPipelined, pGroup, std::cref(vVoice));
+
+
+        const Clock::time_point startTime = Clock::now();
+
+        BenchSocket tcpSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        BenchSocket udpSocket = socket(AF_INET, SOCK_DGRAM,  IPPROTO_UDP);
+
+        bool bError = ( connect(tcpSocket, reinterpret_cast<sockaddr*>(&server.tcpAddress), sizeof(server.tcpAddress)) != 0 );
+
+        int iNoDelay = 1;
+        setsockopt(tcpSocket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char*>(&iNoDelay), sizeof(iNoDelay));
+
+        // TCP handshake over the "network".
+        std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_SIMULATED_RTT_MS));
+
+
+        // Hello (no password).
+
+        std::vector<char> vHello;
+
+        integer b;
+
+        if (bPipelined)
+        {
+            b = pGroup->generatePrivateKey();
+
+            vHello = HandshakeMessages::buildHello(CLIENT_VERSION, "user", L"", pGroup, b);
+        }
+        else
+        {
+            HandshakeMessages::appendUserInfo(vHello, CLIENT_VERSION, "user", L"");
+        }
+
+        const char vPrepare[2] = {UDP_SM_PREPARE, 0};
+
+        bError = bError || sendAll(tcpSocket, vHello.data(), vHello.size());
+
+        if (bPipelined)
+        {
+            bError = bError || connect(udpSocket, reinterpret_cast<sockaddr*>(&server.udpAddress), sizeof(server.udpAddress))
+                            || (send(udpSocket, vPrepare, sizeof(vPrepare), 0) != sizeof(vPrepare));
+        }
+
+
+        // Answer with the server's open key A.
+
+        char        vAnswer[2] = {0, 0};
+        std::string sOpenKeyA;
+
+        bError = bError || recvAll(tcpSocket, vAnswer, sizeof(vAnswer)) || (vAnswer[0] != CM_SERVER_INFO) || recvOpenKey(tcpSocket, sOpenKeyA);
+
+        if ( (bError == false) && (bPipelined == false) )
+        {
+            b = pGroup->generatePrivateKey();
+
+            char cFinished = 0;
+
+            bError = sendOpenKey(tcpSocket, pGroup, b) || recvAll(tcpSocket, &cFinished, sizeof(cFinished));
+        }
+
+        unsigned char vKey[16];
+
+        bError = bError || deriveKey(pGroup, sOpenKeyA, b, vKey);
+
+
+        // Chat info, then wait for "can start UDP".
+
+        unsigned short    iInfoSize = 0;
+        std::vector<char> vInfo;
+
+        bError = bError || recvAll(tcpSocket, &iInfoSize, sizeof(iInfoSize));
+
+        if (bError == false)
+        {
+            vInfo.resize(iInfoSize);
+            bError = recvAll(tcpSocket, vInfo.data(), vInfo.size());
+        }
+
+        if (bPipelined == false)
+        {
+            bError = bError || connect(udpSocket, reinterpret_cast<sockaddr*>(&server.udpAddress), sizeof(server.udpAddress))
+                            || (send(udpSocket, vPrepare, sizeof(vPrepare), 0) != sizeof(vPrepare));
+        }
+
+        char cCanStart = 0;
+
+        bError = bError || recvAll(tcpSocket, &cCanStart, sizeof(cCanStart)) || (cCanStart != SM_CAN_START_UDP);
+
+
+        // The first voice packet.
+
+        if (bError == false)
+        {
+            AES aes(128);
+
+            unsigned int   iEncryptedSize = 0;
+            unsigned char* pEncrypted     = aes.EncryptECB(reinterpret_cast<unsigned char*>(vVoice.data()),
+                                                           static_cast<unsigned int>(vVoice.size() * sizeof(short)), vKey, iEncryptedSize);
+
+            std::vector<char> vDatagram(1 + iEncryptedSize);
+            vDatagram[0] = VM_DEFAULT_MESSAGE;
+            std::memcpy(vDatagram.data() + 1, pEncrypted, iEncryptedSize);
+
+            delete[] pEncrypted;
+
+            bError = ( send(udpSocket, vDatagram.data(), static_cast<int>(vDatagram.size()), 0) != static_cast<int>(vDatagram.size()) );
+        }
+
+        if (bError)
+        {
+            // Wakes up the server.
+            closeBenchSocket(tcpSocket);
+            closeBenchSocket(udpSocket);
+            server.close();
+
+            serverThread.join();
+
+            return -1.0;
+        }
+
+        const Clock::time_point voiceTime = voiceReceived.get();
+
+        serverThread.join();
+
+        closeBenchSocket(tcpSocket);
+        closeBenchSocket(udpSocket);
+        server.close();
+
+        if ( server.bFailed || (server.bKeysMatch == false) )
+        {
+            return -1.0;
+        }
+
+        return std::chrono::duration<double, std::milli>(voiceTime - startTime).count();
+    }
+}
+
+
+void benchConnect(std::vector<BenchResult>& vResults)
+{
+    if (isBenchSelected("connect to first voice") == false)
+    {
+        return;
+    }
+
+#if defined(_WIN32)
+    WSADATA wsaData;
+
+    if ( WSAStartup(MAKEWORD(2, 2), &wsaData) != 0 )
+    {
+        std::printf("WSAStartup() failed, skipping the connect benchmarks.\n");
+        return;
+    }
+#endif
+
+    const DHGroup* pGroup = DHGroup::getGroup(DH_PREFERRED_GROUP);
+
+    for (bool bPipelined : {true, false})
+    {
+        std::vector<double> vTimesMs;
+
+        for (int i = 0; i < CONNECT_RUNS; i++)
+        {
+            const double dTimeMs = measureConnectToFirstVoice(bPipelined, pGroup);
+
+            if (dTimeMs < 0.0)
+            {
+                std::printf("connect to first voice: the loopback connection failed.\n");
+                break;
+            }
+
+            vTimesMs.push_back(dTimeMs);
+        }
+
+        if (vTimesMs.size() != CONNECT_RUNS)
+        {
+            continue;
+        }
+
+        std::sort(vTimesMs.begin(), vTimesMs.end());
+
+        // As "ns/op" so that --baseline catches a slower connect.
+
+        BenchResult result;
+        result.sName       = std::string("connect to first voice ") + (bPipelined ? "pipelined" : "one step at a time")
+                             + " (" + std::to_string(CONNECT_SIMULATED_RTT_MS) + " ms RTT)";
+        result.dNsPerOp    = vTimesMs[vTimesMs.size() / 2] * 1000000.0;
+        result.iIterations = vTimesMs.size();
+
+        addBenchResult(vResults, result);
+    }
+
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
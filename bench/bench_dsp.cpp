@@ -0,0 +1,1123 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "bench.h"
+
+
+// STL
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <cstdlib>
+#include <algorithm>
+
+// Custom
+#include "Model/AudioService/DSP/audiogain.h"
+#include "Model/AudioService/DSP/audiomix.h"
+#include "Model/AudioService/DSP/levelmeter.h"
+#include "Model/AudioService/DSP/voiceactivitydetector.h"
+#include "Model/AudioService/DSP/noisesuppressor.h"
+#include "Model/AudioService/DSP/automaticgaincontrol.h"
+#include "Model/AudioService/DSP/resampler.h"
+#include "Model/AudioService/DSP/driftcompensator.h"
+
+
+// Same as in AudioService.
+static const int          iSamplesPerPacket = 679;
+static const unsigned int iSampleRate       = 19400;
+
+
+// Every int16 value through every gain AudioService uses (master 1.45, input volume 0-200%, user volume),
+// at lengths that hit the SIMD tails. Returns true if the kernel differs from the scalar code.
+
+static bool checkGainKernel()
+{
+    const float vGains[] = { 0.0f, 0.01f, 0.5f, 0.99f, 1.0f, 1.01f, 1.45f, 1.5f, 2.0f, 2.45f, 3.7f, 100.0f };
+
+    std::vector<short> vInput(65536 + 15);
+
+    for (size_t i = 0; i < vInput.size(); i++)
+    {
+        vInput[i] = static_cast<short>( static_cast<int>(i % 65536) - 32768 );
+    }
+
+    std::vector<short> vExpected(vInput.size());
+    std::vector<short> vActual  (vInput.size());
+
+    for (float fGain : vGains)
+    {
+        for (float fSecondGain : vGains)
+        {
+            for (size_t iLength = vInput.size() - 15; iLength <= vInput.size(); iLength++)
+            {
+                std::memcpy(vExpected.data(), vInput.data(), iLength * sizeof(short));
+                std::memcpy(vActual.data(),   vInput.data(), iLength * sizeof(short));
+
+                AudioGain::applyScalar(vExpected.data(), iLength, fGain, fSecondGain);
+                AudioGain::apply      (vActual.data(),   iLength, fGain, fSecondGain);
+
+                if ( std::memcmp(vExpected.data(), vActual.data(), iLength * sizeof(short)) != 0 )
+                {
+                    std::printf("dsp gain: the %s kernel differs from the scalar one (gain %g, second gain %g, %zu samples).\n",
+                                AudioGain::getKernelName(), static_cast<double>(fGain), static_cast<double>(fSecondGain), iLength);
+
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+
+// Full-scale noise (with SHRT_MIN in it) at lengths that hit the SIMD tails.
+// Returns true if the kernel differs from the scalar code.
+
+static bool checkLevelKernel()
+{
+    std::vector<short> vNoise(4096 + 31);
+
+    unsigned int iState = 1;
+
+    for (size_t i = 0; i < vNoise.size(); i++)
+    {
+        iState = iState * 1103515245 + 12345;
+        vNoise[i] = static_cast<short>(iState >> 16);
+    }
+
+    vNoise[1000] = SHRT_MIN;
+
+    for (size_t iLength = 0; iLength <= vNoise.size(); iLength++)
+    {
+        const AudioLevel expected = LevelMeter::measureScalar(vNoise.data(), iLength);
+        const AudioLevel actual   = LevelMeter::measure      (vNoise.data(), iLength);
+
+        if ( (expected.iPeak != actual.iPeak) || (expected.dRMS != actual.dRMS) )
+        {
+            std::printf("dsp level: the %s kernel differs from the scalar one (%zu samples).\n", LevelMeter::getKernelName(), iLength);
+
+            return true;
+        }
+    }
+
+
+    // The threshold must give the same answer as the dBFS compare it replaces.
+
+    for (int iDBFS = -60; iDBFS <= 0; iDBFS++)
+    {
+        const int iThreshold = LevelMeter::getPeakThreshold(iDBFS);
+
+        for (int iPeak = 0; iPeak <= -SHRT_MIN; iPeak++)
+        {
+            const double dPeakDBFS = (iPeak == 0) ? LEVEL_METER_SILENCE_DBFS : 20 * log10(static_cast<double>(iPeak) / SHRT_MAX);
+
+            if ( (static_cast<int>(dPeakDBFS) >= iDBFS) != (iPeak >= iThreshold) )
+            {
+                std::printf("dsp level: wrong peak threshold for %d dBFS (peak %d).\n", iDBFS, iPeak);
+
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+// Device rate <-> wire rate both ways, in packets of the device and of the wire.
+// The SIMD dot products sum in another order, so 1 LSB is allowed. Returns true if the kernel is further off.
+
+static bool checkResamplerKernel()
+{
+    const unsigned int vDeviceRates[] = { 44100, 48000 };
+
+    for (unsigned int iDeviceRate : vDeviceRates)
+    {
+        for (int iDirection = 0; iDirection < 2; iDirection++)
+        {
+            const unsigned int iInputRate  = (iDirection == 0) ? iDeviceRate : iSampleRate;
+            const unsigned int iOutputRate = (iDirection == 0) ? iSampleRate : iDeviceRate;
+            const size_t       iPacketSize = static_cast<size_t>(iSamplesPerPacket) * iInputRate / iSampleRate;
+
+            Resampler scalarResampler(iInputRate, iOutputRate, true);
+            Resampler resampler      (iInputRate, iOutputRate);
+
+            std::vector<short> vInput   (iPacketSize);
+            std::vector<short> vExpected(resampler.getMaxOutputCount(iPacketSize));
+            std::vector<short> vActual  (resampler.getMaxOutputCount(iPacketSize));
+
+            for (int iPacket = 0; iPacket < 20; iPacket++)
+            {
+                for (size_t i = 0; i < vInput.size(); i++)
+                {
+                    // Speech-like, loud enough to clip after the filter.
+                    const double dTime = static_cast<double>(iPacket * iPacketSize + i) / iInputRate;
+
+                    vInput[i] = static_cast<short>( 32767.0 * std::sin(2 * 3.14159265358979 * 300 * dTime) * std::sin(2 * 3.14159265358979 * 7 * dTime) );
+                }
+
+                const size_t iExpectedCount = scalarResampler.process(vInput.data(), vInput.size(), vExpected.data());
+                const size_t iActualCount   = resampler      .process(vInput.data(), vInput.size(), vActual.data());
+
+                bool bMismatch = (iExpectedCount != iActualCount);
+
+                for (size_t i = 0; (i < iActualCount) && (bMismatch == false); i++)
+                {
+                    bMismatch = std::abs(vExpected[i] - vActual[i]) > 1;
+                }
+
+                if (bMismatch)
+                {
+                    std::printf("dsp resample: the %s kernel differs from the scalar one (%u Hz -> %u Hz, packet %d).\n",
+                                Resampler::getKernelName(), iInputRate, iOutputRate, iPacket);
+
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+
+// Every int16 value summed with the user gains AudioService uses (and enough speakers to clip),
+// at lengths that hit the SIMD tails. Returns true if the kernel differs from the scalar code.
+
+static bool checkMixKernel()
+{
+    const float vGains[] = { 0.0f, 0.45f, 1.0f, 1.45f, 2.45f, 100.0f };
+
+    std::vector<short> vInput(65536 + 15);
+
+    for (size_t i = 0; i < vInput.size(); i++)
+    {
+        vInput[i] = static_cast<short>( static_cast<int>( (i * 7919) % 65536 ) - 32768 );
+    }
+
+    std::vector<float> vExpectedMix(vInput.size());
+    std::vector<float> vActualMix  (vInput.size());
+    std::vector<short> vExpected   (vInput.size());
+    std::vector<short> vActual     (vInput.size());
+
+    for (size_t iLength = vInput.size() - 15; iLength <= vInput.size(); iLength++)
+    {
+        std::fill(vExpectedMix.begin(), vExpectedMix.end(), 0.0f);
+        std::fill(vActualMix.begin(),   vActualMix.end(),   0.0f);
+
+        for (size_t iSpeaker = 0; iSpeaker < sizeof(vGains) / sizeof(vGains[0]); iSpeaker++)
+        {
+            // Each speaker starts at another sample.
+            const short* pSamples = vInput.data() + iSpeaker;
+            const size_t iCount   = iLength - iSpeaker;
+
+            AudioMix::accumulateScalar(vExpectedMix.data(), pSamples, iCount, vGains[iSpeaker]);
+            AudioMix::accumulate      (vActualMix.data(),   pSamples, iCount, vGains[iSpeaker]);
+
+            AudioMix::toPCM16Scalar(vExpectedMix.data(), vExpected.data(), iLength);
+            AudioMix::toPCM16      (vActualMix.data(),   vActual.data(),   iLength);
+
+            if ( (std::memcmp(vExpectedMix.data(), vActualMix.data(), iLength * sizeof(float)) != 0)
+                 || (std::memcmp(vExpected.data(), vActual.data(), iLength * sizeof(short)) != 0) )
+            {
+                std::printf("dsp mix: the %s kernel differs from the scalar one (%zu speakers, %zu samples).\n",
+                            AudioMix::getKernelName(), iSpeaker + 1, iLength);
+
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+// 10 minutes of one speaker whose sound card is 300 ppm faster than ours (with the network jitter and 1% loss),
+// the time is simulated. Returns true if the drift is not found or the queue does not stay near the target.
+
+static bool checkDriftCompensator()
+{
+    const double dPacketMs       = 1000.0 * iSamplesPerPacket / iSampleRate;
+    const double dSenderPeriodMs = dPacketMs / (1.0 + 300e-6);
+    const double dTargetLevel    = 2.0;
+    const int    iPacketCount    = static_cast<int>(10 * 60 * 1000 / dSenderPeriodMs);
+
+    DriftCompensator driftCompensator(iSamplesPerPacket, dPacketMs, dTargetLevel);
+
+    std::vector<short> vPacket(iSamplesPerPacket, 1000);
+    std::vector<short> vOutput(iSamplesPerPacket);
+
+    // Arrival times (sorted, the jitter is smaller than the period).
+    std::vector<double> vArrivals;
+    unsigned int iRandom = 12345;
+
+    for (int i = 0; i < iPacketCount; i++)
+    {
+        iRandom = iRandom * 1103515245 + 12345;
+
+        if ( (iRandom >> 16) % 100 == 0 )
+        {
+            continue; // lost
+        }
+
+        vArrivals.push_back( i * dSenderPeriodMs + 20.0 + static_cast<double>((iRandom >> 8) % 1000) / 100.0 );
+    }
+
+    size_t iArrived = 0;
+    size_t iQueued  = 0;
+    double dMinLevel = 1000.0;
+    double dMaxLevel = 0.0;
+
+    // Starts after the prebuffer (as AudioMixer).
+    for (double dTimeMs = vArrivals[1]; iArrived < vArrivals.size(); dTimeMs += dPacketMs)
+    {
+        while ( (iArrived < vArrivals.size()) && (vArrivals[iArrived] <= dTimeMs) )
+        {
+            driftCompensator.onPacketArrived(vArrivals[iArrived]);
+            iArrived++;
+            iQueued++;
+        }
+
+        while ( (driftCompensator.canProduce() == false) && (iQueued > 0) )
+        {
+            driftCompensator.addInput(vPacket.data());
+            iQueued--;
+        }
+
+        driftCompensator.produce(vOutput.data(), static_cast<double>(iQueued), dTimeMs);
+
+        // After the first minute (the estimate is settled).
+        if (dTimeMs > 60000.0)
+        {
+            dMinLevel = std::min(dMinLevel, driftCompensator.getLevelInPackets());
+            dMaxLevel = std::max(dMaxLevel, driftCompensator.getLevelInPackets());
+        }
+    }
+
+    if ( (std::abs(driftCompensator.getDriftPPM() - 300.0) > 30.0) || (dMinLevel < 0.5) || (dMaxLevel > 4.0) )
+    {
+        std::printf("dsp drift: estimated %.0f ppm (300 expected), the queue was %.2f - %.2f packets (%.0f expected).\n",
+                    driftCompensator.getDriftPPM(), dMinLevel, dMaxLevel, dTargetLevel);
+
+        return true;
+    }
+
+    return false;
+}
+
+
+// For the behaviour checks below: repeatable noise and rounding to int16.
+
+static unsigned int iNoiseRandom = 1;
+
+static double getNoiseSample()
+{
+    // Uniform in [-1, 1), RMS = 1 / sqrt(3).
+    iNoiseRandom = iNoiseRandom * 1103515245 + 12345;
+
+    return ( static_cast<int>((iNoiseRandom >> 16) & 0x7fff) - 16384 ) / 16384.0;
+}
+
+static short toSample(double dValue)
+{
+    return static_cast<short>( std::max(static_cast<double>(SHRT_MIN), std::min(static_cast<double>(SHRT_MAX), std::round(dValue))) );
+}
+
+
+// Noise (-50 dBFS), then full-scale clicks on top of it, then soft voiced speech (a 150 Hz voice with a 4 Hz syllable rate,
+// ~11 dB above the noise in the speech band - below VAD_SPEECH_MARGIN_DB). Returns true if the detector opens for a click,
+// opens late (or drops out) for the speech or doesn't close after the hangover.
+
+static bool checkVoiceActivityDetector()
+{
+    const double dPi          = 3.14159265358979;
+    const double dNoiseAmp    = std::pow(10.0, -50.0 / 20.0) * SHRT_MAX * std::sqrt(3.0);
+    const double dSpeechAmp   = std::pow(10.0, -35.0 / 20.0) * SHRT_MAX * 0.8;
+
+    const int    iClickStart  = 30;   // packets
+    const int    iSpeechStart = 90;
+    const int    iSpeechEnd   = 120;
+    const int    iEnd         = 150;
+
+    const int    iHangoverPackets = static_cast<int>( std::ceil(VAD_DEFAULT_HANGOVER_MS / (1000.0 * iSamplesPerPacket / iSampleRate)) );
+
+    VoiceActivityDetector voiceActivityDetector(iSampleRate);
+
+    std::vector<short> vPacket(iSamplesPerPacket);
+
+    iNoiseRandom = 1;
+
+    long long iTime = 0;
+
+    int iOpenOnClicks      = 0;
+    int iSpeechPackets     = 0;
+    int iFirstSpeechPacket = -1;
+    int iLastOpenPacket    = -1;
+
+    for (int iPacket = 0; iPacket < iEnd; iPacket++)
+    {
+        for (int i = 0; i < iSamplesPerPacket; i++, iTime++)
+        {
+            double dValue = getNoiseSample() * dNoiseAmp;
+
+            if ( (iPacket >= iClickStart) && (iPacket < iSpeechStart) && (iPacket % 5 == 0) && (i >= 300) && (i < 310) )
+            {
+                dValue += (i % 2) ? 30000 : -30000;
+            }
+
+            if ( (iPacket >= iSpeechStart) && (iPacket < iSpeechEnd) )
+            {
+                double dVoice = 0.0;
+
+                for (int iHarmonic = 1; iHarmonic * 150 < 3000; iHarmonic++)
+                {
+                    dVoice += std::sin(2 * dPi * 150 * iHarmonic * iTime / iSampleRate) / iHarmonic;
+                }
+
+                dValue += dVoice * (0.6 + 0.4 * std::sin(2 * dPi * 4 * iTime / iSampleRate)) * dSpeechAmp;
+            }
+
+            vPacket[i] = toSample(dValue);
+        }
+
+        // The start level is not tested here.
+        const bool bSend = voiceActivityDetector.process(vPacket.data(), vPacket.size(), true);
+
+        if (bSend == false)
+        {
+            continue;
+        }
+
+        iLastOpenPacket = iPacket;
+
+        if (iPacket < iSpeechStart)
+        {
+            iOpenOnClicks++;
+        }
+        else if (iPacket < iSpeechEnd)
+        {
+            iSpeechPackets++;
+
+            if (iFirstSpeechPacket < 0)
+            {
+                iFirstSpeechPacket = iPacket - iSpeechStart;
+            }
+        }
+    }
+
+    const int iSpeechPacketCount = iSpeechEnd - iSpeechStart;
+
+    if ( (iOpenOnClicks > 0) || (iFirstSpeechPacket < 0) || (iFirstSpeechPacket > 3)
+         || (iSpeechPackets < iSpeechPacketCount * 9 / 10) || (iLastOpenPacket >= iSpeechEnd + iHangoverPackets + 2) )
+    {
+        std::printf("dsp vad: %d packets sent for the clicks (0 expected), soft speech: opened after %d packets (3 max), "
+                    "%d of %d sent (90%% min), the last one sent %d packets after the speech (%d max).\n",
+                    iOpenOnClicks, iFirstSpeechPacket, iSpeechPackets, iSpeechPacketCount, iLastOpenPacket - iSpeechEnd + 1, iHangoverPackets + 2);
+
+        return true;
+    }
+
+    return false;
+}
+
+// Noise (-50 dBFS), then a 440 Hz tone (-30 dBFS) that starts in the last quarter of a packet: that packet
+// has fewer than VAD_MIN_ACTIVE_SUBBLOCKS loud sub-blocks, so the detector opens on the next one.
+// Returns true if the onset packet is not sent (by process() or as the pre-roll of the next packet, as recordOnTalk() does)
+// or if something before it is sent.
+
+static bool checkVoiceActivityOnset()
+{
+    const double dPi          = 3.14159265358979;
+    const double dNoiseAmp    = std::pow(10.0, -50.0 / 20.0) * SHRT_MAX * std::sqrt(3.0);
+    const double dToneAmp     = std::pow(10.0, -30.0 / 20.0) * SHRT_MAX * std::sqrt(2.0);
+
+    const int    iOnsetPacket = 30;
+    const int    iOnsetSample = iSamplesPerPacket * 3 / 4;
+    const int    iEnd         = 40;
+
+    VoiceActivityDetector voiceActivityDetector(iSampleRate);
+
+    std::vector<short> vPacket(iSamplesPerPacket);
+    std::vector<bool>  vSent(iEnd, false);
+
+    iNoiseRandom = 1;
+
+    long long iTime        = 0;
+    int       iOpenPacket  = -1;
+    bool      bOpenOnOnset = false;
+
+    for (int iPacket = 0; iPacket < iEnd; iPacket++)
+    {
+        for (int i = 0; i < iSamplesPerPacket; i++, iTime++)
+        {
+            double dValue = getNoiseSample() * dNoiseAmp;
+
+            if ( (iPacket > iOnsetPacket) || ((iPacket == iOnsetPacket) && (i >= iOnsetSample)) )
+            {
+                dValue += std::sin(2 * dPi * 440.0 * iTime / iSampleRate) * dToneAmp;
+            }
+
+            vPacket[i] = toSample(dValue);
+        }
+
+        if ( voiceActivityDetector.process(vPacket.data(), vPacket.size(), true) == false )
+        {
+            continue;
+        }
+
+        vSent[iPacket] = true;
+
+        if ( voiceActivityDetector.isOnset() && (iPacket > 0) )
+        {
+            vSent[iPacket - 1] = true;
+        }
+
+        if (iOpenPacket < 0)
+        {
+            iOpenPacket  = iPacket;
+            bOpenOnOnset = voiceActivityDetector.isOnset();
+        }
+    }
+
+    // The pre-roll may be the packet before the onset if the detector opens on the onset packet itself.
+
+    const bool bSentEarly = std::find(vSent.begin(), vSent.begin() + iOnsetPacket - 1, true) != vSent.begin() + iOnsetPacket - 1;
+
+    if ( (vSent[iOnsetPacket] == false) || bSentEarly )
+    {
+        std::printf("dsp vad onset: a tone from sample %d of packet %d opened the detector on packet %d (onset: %s), "
+                    "the onset packet was%s sent, %s was sent before it.\n",
+                    iOnsetSample, iOnsetPacket, iOpenPacket, bOpenOnOnset ? "yes" : "no",
+                    vSent[iOnsetPacket] ? "" : " not", bSentEarly ? "noise" : "nothing");
+
+        return true;
+    }
+
+    return false;
+}
+
+// Amplitude of one frequency (Goertzel).
+
+static double getToneAmplitude(const short* pSamples, size_t iSampleCount, double dFrequency)
+{
+    const double dW      = 2 * 3.14159265358979 * dFrequency / iSampleRate;
+    const double dCoeff  = 2 * std::cos(dW);
+
+    double dState1 = 0.0;
+    double dState2 = 0.0;
+
+    for (size_t i = 0; i < iSampleCount; i++)
+    {
+        const double dState = pSamples[i] + dCoeff * dState1 - dState2;
+
+        dState2 = dState1;
+        dState1 = dState;
+    }
+
+    const double dReal = dState1 - dState2 * std::cos(dW);
+    const double dImag = dState2 * std::sin(dW);
+
+    return std::sqrt(dReal * dReal + dImag * dImag) / (iSampleCount / 2.0);
+}
+
+static double getRMS(const short* pSamples, size_t iSampleCount)
+{
+    double dSumOfSquares = 0.0;
+
+    for (size_t i = 0; i < iSampleCount; i++)
+    {
+        dSumOfSquares += static_cast<double>(pSamples[i]) * pSamples[i];
+    }
+
+    return std::sqrt(dSumOfSquares / iSampleCount);
+}
+
+
+// 4 sec. of white noise at -50, -40 and -30 dBFS, then the same with a 1 kHz tone 20 dB above the noise
+// starting after 1 sec. (the noise is learned first). The last 2 sec. are measured.
+// Returns true if the noise is lowered by less than NOISE_SUPPRESSOR_NOISE_REDUCTION_DB or the tone loses more than 1 dB.
+
+static bool checkNoiseSuppressor()
+{
+    const double dPi           = 3.14159265358979;
+    const int    iPacketCount  = static_cast<int>(4.0 * iSampleRate / iSamplesPerPacket);
+    const size_t iMeasureStart = 2 * iSampleRate;
+
+    std::vector<short> vInput (static_cast<size_t>(iPacketCount) * iSamplesPerPacket);
+    std::vector<short> vOutput(vInput.size());
+
+    bool bFailed = false;
+
+    for (double dNoiseDBFS : {-50.0, -40.0, -30.0})
+    {
+        const double dNoiseAmp = std::pow(10.0, dNoiseDBFS / 20.0) * SHRT_MAX * std::sqrt(3.0);
+        const double dToneAmp  = std::pow(10.0, (dNoiseDBFS + 20.0) / 20.0) * SHRT_MAX * std::sqrt(2.0);
+
+        double dNoiseReductionDB = 0.0;
+        double dToneLossDB       = 0.0;
+
+        for (bool bTone : {false, true})
+        {
+            NoiseSuppressor noiseSuppressor(iSampleRate, iSamplesPerPacket);
+
+            iNoiseRandom = 1;
+
+            for (size_t i = 0; i < vInput.size(); i++)
+            {
+                double dValue = getNoiseSample() * dNoiseAmp;
+
+                if ( bTone && (i >= iSampleRate) )
+                {
+                    dValue += dToneAmp * std::sin(2 * dPi * 1000 * i / iSampleRate);
+                }
+
+                vInput[i] = toSample(dValue);
+            }
+
+            vOutput = vInput;
+
+            for (int iPacket = 0; iPacket < iPacketCount; iPacket++)
+            {
+                noiseSuppressor.process(vOutput.data() + static_cast<size_t>(iPacket) * iSamplesPerPacket, iSamplesPerPacket);
+            }
+
+            // The output is delayed (getLatencyInSamples()), it's noise or a steady tone, so it doesn't matter.
+
+            const size_t iMeasureCount = vInput.size() - iMeasureStart;
+
+            if (bTone)
+            {
+                dToneLossDB = 20 * std::log10( getToneAmplitude(vInput.data() + iMeasureStart, iMeasureCount, 1000)
+                                               / getToneAmplitude(vOutput.data() + iMeasureStart, iMeasureCount, 1000) );
+            }
+            else
+            {
+                dNoiseReductionDB = 20 * std::log10( getRMS(vInput.data() + iMeasureStart, iMeasureCount)
+                                                     / getRMS(vOutput.data() + iMeasureStart, iMeasureCount) );
+            }
+        }
+
+        if ( (dNoiseReductionDB < NOISE_SUPPRESSOR_NOISE_REDUCTION_DB) || (dToneLossDB > 1.0) )
+        {
+            std::printf("dsp noise suppressor: the noise at %.0f dBFS is lowered by %.1f dB (%.0f dB expected), "
+                        "a tone 20 dB above it loses %.2f dB (1 dB max).\n",
+                        dNoiseDBFS, dNoiseReductionDB, NOISE_SUPPRESSOR_NOISE_REDUCTION_DB, dToneLossDB);
+
+            bFailed = true;
+        }
+    }
+
+    return bFailed;
+}
+
+// A 440 Hz voice at -35 dBFS (RMS) for 3 release times, at -5 dBFS for 3 attack times, then at -35 dBFS again.
+// Returns true if the output is not within 2 dB of the target at the end of each part (95% of the way)
+// or a sample goes above AGC_PEAK_LIMIT_DBFS.
+
+static bool checkAutomaticGainControl()
+{
+    const double dPi       = 3.14159265358979;
+    const double dPacketMs = 1000.0 * iSamplesPerPacket / iSampleRate;
+
+    struct AGCCheckPart
+    {
+        const char* pName;
+        double      dInputDBFS;
+        double      dDurationMs;
+    };
+
+    const AGCCheckPart vParts[] =
+    {
+        {"quiet voice (release)", -35.0, 3 * AGC_RELEASE_MS},
+        {"loud voice (attack)",    -5.0, 3 * AGC_ATTACK_MS},
+        {"quiet voice again",     -35.0, 3 * AGC_RELEASE_MS}
+    };
+
+    const int iPeakLimit = static_cast<int>( std::pow(10.0, AGC_PEAK_LIMIT_DBFS / 20.0) * SHRT_MAX ) + 1;
+
+    AutomaticGainControl automaticGainControl(iSampleRate, AGC_DEFAULT_TARGET_DBFS);
+
+    std::vector<short> vPacket(iSamplesPerPacket);
+
+    long long iTime = 0;
+    int       iPeak = 0;
+
+    bool bFailed = false;
+
+    for (const AGCCheckPart& part : vParts)
+    {
+        const int    iPacketCount = static_cast<int>( std::ceil(part.dDurationMs / dPacketMs) );
+        const double dAmp         = std::pow(10.0, part.dInputDBFS / 20.0) * SHRT_MAX * std::sqrt(2.0);
+
+        double dOutputDBFS = 0.0;
+
+        for (int iPacket = 0; iPacket < iPacketCount; iPacket++)
+        {
+            for (int i = 0; i < iSamplesPerPacket; i++, iTime++)
+            {
+                vPacket[i] = toSample( dAmp * std::sin(2 * dPi * 440 * iTime / iSampleRate) );
+            }
+
+            automaticGainControl.process(vPacket.data(), vPacket.size());
+
+            for (short sample : vPacket)
+            {
+                iPeak = std::max(iPeak, std::abs(static_cast<int>(sample)));
+            }
+
+            dOutputDBFS = 20 * std::log10( getRMS(vPacket.data(), vPacket.size()) / SHRT_MAX );
+        }
+
+        if (std::abs(dOutputDBFS - AGC_DEFAULT_TARGET_DBFS) > 2.0)
+        {
+            std::printf("dsp agc: %s at %.0f dBFS is at %.1f dBFS after %.0f ms (%d dBFS expected).\n",
+                        part.pName, part.dInputDBFS, dOutputDBFS, part.dDurationMs, AGC_DEFAULT_TARGET_DBFS);
+
+            bFailed = true;
+        }
+    }
+
+    if (iPeak > iPeakLimit)
+    {
+        std::printf("dsp agc: the peak went to %.2f dBFS (%.0f dBFS max).\n", 20 * std::log10(iPeak / static_cast<double>(SHRT_MAX)), AGC_PEAK_LIMIT_DBFS);
+
+        bFailed = true;
+    }
+
+    return bFailed;
+}
+
+// 0.5 sec. of a tone at -1 dBFS through the resampler, the last 0.25 sec. of the output are measured
+// (so the frequency must be a multiple of 4 Hz for the fit). dGainDB - of the tone (if it's below the output Nyquist frequency),
+// dOtherDB - everything else in the output (aliases, images), both relative to the input tone.
+
+static void measureResamplerTone(unsigned int iInputRate, unsigned int iOutputRate, double dFrequency, double& dGainDB, double& dOtherDB)
+{
+    const double dPi = 3.14159265358979;
+    const double dAmp = std::pow(10.0, -1.0 / 20.0) * SHRT_MAX;
+
+    Resampler resampler(iInputRate, iOutputRate);
+
+    std::vector<short> vInput(iInputRate / 2);
+
+    for (size_t i = 0; i < vInput.size(); i++)
+    {
+        vInput[i] = toSample( dAmp * std::sin(2 * dPi * dFrequency * i / iInputRate) );
+    }
+
+    std::vector<short> vOutput(resampler.getMaxOutputCount(vInput.size()));
+
+    const size_t iOutputCount = resampler.process(vInput.data(), vInput.size(), vOutput.data());
+
+
+    // Without the start (the filter history is silence), the tone is fitted (sin + cos) and subtracted.
+
+    const size_t iCount = iOutputRate / 4;
+    const size_t iStart = iOutputCount - iCount;
+
+    const bool   bPassed = dFrequency < iOutputRate / 2.0;
+    const double dW      = 2 * dPi * dFrequency / iOutputRate;
+
+    double dSin = 0.0;
+    double dCos = 0.0;
+
+    if (bPassed)
+    {
+        for (size_t i = iStart; i < iOutputCount; i++)
+        {
+            dSin += vOutput[i] * std::sin(dW * i);
+            dCos += vOutput[i] * std::cos(dW * i);
+        }
+
+        dSin *= 2.0 / iCount;
+        dCos *= 2.0 / iCount;
+    }
+
+    double dOtherSumOfSquares = 0.0;
+
+    for (size_t i = iStart; i < iOutputCount; i++)
+    {
+        const double dOther = vOutput[i] - dSin * std::sin(dW * i) - dCos * std::cos(dW * i);
+
+        dOtherSumOfSquares += dOther * dOther;
+    }
+
+    dGainDB  = 20 * std::log10( std::max(std::sqrt(dSin * dSin + dCos * dCos), 1e-9) / dAmp );
+    dOtherDB = 20 * std::log10( std::max(std::sqrt(2 * dOtherSumOfSquares / iCount), 1e-9) / dAmp );
+}
+
+
+// Tones through the resamplers AudioService uses (device rate <-> wire rate).
+// Returns true if the passband (up to RESAMPLER_PASSBAND_PART of the lower Nyquist frequency) is not flat
+// within RESAMPLER_PASSBAND_RIPPLE_DB, or something above the lower Nyquist frequency is not RESAMPLER_STOPBAND_DB down.
+
+static bool checkResamplerResponse()
+{
+    const unsigned int vDeviceRates[] = { 48000, 44100 };
+
+    bool bFailed = false;
+
+    for (unsigned int iDeviceRate : vDeviceRates)
+    {
+        for (bool bCapture : {true, false})
+        {
+            const unsigned int iInputRate  = bCapture ? iDeviceRate : iSampleRate;
+            const unsigned int iOutputRate = bCapture ? iSampleRate : iDeviceRate;
+
+            const double dNyquist = std::min(iInputRate, iOutputRate) / 2.0;
+
+            double dMinGainDB           = 0.0;
+            double dMaxGainDB           = 0.0;
+            double dWorstOtherDB        = -1000.0;
+            double dWorstOtherFrequency = 0.0;
+
+            // Passband (and the images of it when upsampling).
+
+            for (double dPart = 0.05; dPart <= RESAMPLER_PASSBAND_PART + 0.001; dPart += 0.04)
+            {
+                const double dFrequency = 4.0 * std::floor(dPart * dNyquist / 4.0);
+
+                double dGainDB  = 0.0;
+                double dOtherDB = 0.0;
+
+                measureResamplerTone(iInputRate, iOutputRate, dFrequency, dGainDB, dOtherDB);
+
+                dMinGainDB = std::min(dMinGainDB, dGainDB);
+                dMaxGainDB = std::max(dMaxGainDB, dGainDB);
+
+                if ( (bCapture == false) && (dOtherDB > dWorstOtherDB) )
+                {
+                    dWorstOtherDB        = dOtherDB;
+                    dWorstOtherFrequency = dFrequency;
+                }
+            }
+
+            // Above the wire Nyquist frequency (would alias).
+
+            if (bCapture)
+            {
+                for (double dFrequency = dNyquist; dFrequency < iInputRate / 2.0 * 0.98; dFrequency += 150.0)
+                {
+                    double dGainDB  = 0.0;
+                    double dOtherDB = 0.0;
+
+                    measureResamplerTone(iInputRate, iOutputRate, dFrequency, dGainDB, dOtherDB);
+
+                    if (dOtherDB > dWorstOtherDB)
+                    {
+                        dWorstOtherDB        = dOtherDB;
+                        dWorstOtherFrequency = dFrequency;
+                    }
+                }
+            }
+
+            if ( (dMaxGainDB - dMinGainDB > RESAMPLER_PASSBAND_RIPPLE_DB) || (dWorstOtherDB > -RESAMPLER_STOPBAND_DB) )
+            {
+                std::printf("dsp resample: %u Hz -> %u Hz: the passband ripple is %.3f dB (%.1f dB max), "
+                            "%s %.1f dB down (at %.0f Hz, %.0f dB expected).\n",
+                            iInputRate, iOutputRate, dMaxGainDB - dMinGainDB, RESAMPLER_PASSBAND_RIPPLE_DB,
+                            bCapture ? "the aliases are" : "the images are", -dWorstOtherDB, dWorstOtherFrequency, RESAMPLER_STOPBAND_DB);
+
+                bFailed = true;
+            }
+        }
+    }
+
+    return bFailed;
+}
+
+bool benchDSP(std::vector<BenchResult>& vResults)
+{
+    bool bCheckFailed = false;
+
+    if ( isBenchSelected("dsp gain") )
+    {
+        bCheckFailed = checkGainKernel();
+    }
+
+    if ( isBenchSelected("dsp level") )
+    {
+        bCheckFailed |= checkLevelKernel();
+    }
+
+    if ( isBenchSelected("dsp resample") )
+    {
+        bCheckFailed |= checkResamplerKernel();
+        bCheckFailed |= checkResamplerResponse();
+    }
+
+    if ( isBenchSelected("dsp mix") )
+    {
+        bCheckFailed |= checkMixKernel();
+    }
+
+    if ( isBenchSelected("dsp drift") )
+    {
+        bCheckFailed |= checkDriftCompensator();
+    }
+
+    if ( isBenchSelected("dsp vad") )
+    {
+        bCheckFailed |= checkVoiceActivityDetector();
+        bCheckFailed |= checkVoiceActivityOnset();
+    }
+
+    if ( isBenchSelected("dsp noise suppressor") )
+    {
+        bCheckFailed |= checkNoiseSuppressor();
+    }
+
+    if ( isBenchSelected("dsp agc") )
+    {
+        bCheckFailed |= checkAutomaticGainControl();
+    }
+
+
+    // Speech-like packet (loud enough to clip at the master volume).
+
+    std::vector<short> vSource(iSamplesPerPacket);
+
+    for (size_t i = 0; i < vSource.size(); i++)
+    {
+        vSource[i] = static_cast<short>( 30000.0 * std::sin(0.05 * i) * std::sin(0.0031 * i) );
+    }
+
+    std::vector<short> vPacket(vSource);
+
+    const size_t iPacketSizeInBytes = iSamplesPerPacket * sizeof(short);
+
+    const std::string sKernelName = AudioGain::getKernelName();
+
+
+    // The copy keeps the samples from saturating after the first iterations.
+
+    addBench(vResults, "dsp gain scalar", [&]()
+    {
+        std::memcpy(vPacket.data(), vSource.data(), iPacketSizeInBytes);
+        AudioGain::applyScalar(vPacket.data(), vPacket.size(), 1.45f);
+        benchSink(vPacket.data());
+    }, iPacketSizeInBytes);
+
+    addBench(vResults, "dsp gain " + sKernelName, [&]()
+    {
+        std::memcpy(vPacket.data(), vSource.data(), iPacketSizeInBytes);
+        AudioGain::apply(vPacket.data(), vPacket.size(), 1.45f);
+        benchSink(vPacket.data());
+    }, iPacketSizeInBytes);
+
+    addBench(vResults, "dsp gain scalar two gains", [&]()
+    {
+        std::memcpy(vPacket.data(), vSource.data(), iPacketSizeInBytes);
+        AudioGain::applyScalar(vPacket.data(), vPacket.size(), 1.45f, 0.8f);
+        benchSink(vPacket.data());
+    }, iPacketSizeInBytes);
+
+    addBench(vResults, "dsp gain " + sKernelName + " two gains", [&]()
+    {
+        std::memcpy(vPacket.data(), vSource.data(), iPacketSizeInBytes);
+        AudioGain::apply(vPacket.data(), vPacket.size(), 1.45f, 0.8f);
+        benchSink(vPacket.data());
+    }, iPacketSizeInBytes);
+
+
+    // One mixer output packet with 8 speakers (bytes are of the speaker packets).
+
+    std::vector<float> vMix(iSamplesPerPacket);
+
+    addBench(vResults, "dsp mix 8 speakers scalar", [&]()
+    {
+        std::fill(vMix.begin(), vMix.end(), 0.0f);
+
+        for (int i = 0; i < 8; i++)
+        {
+            AudioMix::accumulateScalar(vMix.data(), vSource.data(), vMix.size(), 1.45f);
+        }
+
+        AudioMix::toPCM16Scalar(vMix.data(), vPacket.data(), vPacket.size());
+        benchSink(vPacket.data());
+    }, 8 * iPacketSizeInBytes);
+
+    addBench(vResults, std::string("dsp mix 8 speakers ") + AudioMix::getKernelName(), [&]()
+    {
+        std::fill(vMix.begin(), vMix.end(), 0.0f);
+
+        for (int i = 0; i < 8; i++)
+        {
+            AudioMix::accumulate(vMix.data(), vSource.data(), vMix.size(), 1.45f);
+        }
+
+        AudioMix::toPCM16(vMix.data(), vPacket.data(), vPacket.size());
+        benchSink(vPacket.data());
+    }, 8 * iPacketSizeInBytes);
+
+
+
+    // What sendAudioDataVolume() did before: log10() for every sample.
+
+    addBench(vResults, "dsp level log10 per sample", [&]()
+    {
+        double dMaxDBFS = LEVEL_METER_SILENCE_DBFS;
+
+        for (size_t i = 0; i < vSource.size(); i++)
+        {
+            double dSampleInDBFS = 20 * log10(std::abs(static_cast<double>(vSource[i]) / SHRT_MAX));
+
+            if (dSampleInDBFS > dMaxDBFS)
+            {
+                dMaxDBFS = dSampleInDBFS;
+            }
+        }
+
+        benchSink(&dMaxDBFS);
+    }, iPacketSizeInBytes);
+
+    addBench(vResults, "dsp level scalar", [&]()
+    {
+        AudioLevel level = LevelMeter::measureScalar(vSource.data(), vSource.size());
+        double dPeakDBFS = level.getPeakDBFS();
+        benchSink(&dPeakDBFS);
+    }, iPacketSizeInBytes);
+
+    addBench(vResults, "dsp level " + std::string(LevelMeter::getKernelName()), [&]()
+    {
+        AudioLevel level = LevelMeter::measure(vSource.data(), vSource.size());
+        double dPeakDBFS = level.getPeakDBFS();
+        benchSink(&dPeakDBFS);
+    }, iPacketSizeInBytes);
+
+
+
+    // Runs for every recorded packet in the "Talk to Record" mode.
+
+    VoiceActivityDetector voiceActivityDetector(iSampleRate);
+
+    addBench(vResults, "dsp vad", [&]()
+    {
+        bool bSend = voiceActivityDetector.process(vSource.data(), vSource.size(), true);
+        benchSink(&bSend);
+    }, iPacketSizeInBytes);
+
+
+
+    // Runs on the capture thread for every packet, must stay well inside its CPU budget
+    // (a part of the packet duration, one core).
+
+    NoiseSuppressor noiseSuppressor(iSampleRate, iSamplesPerPacket);
+
+    addBench(vResults, "dsp noise suppressor", [&]()
+    {
+        std::memcpy(vPacket.data(), vSource.data(), iPacketSizeInBytes);
+        noiseSuppressor.process(vPacket.data(), vPacket.size());
+        benchSink(vPacket.data());
+    }, iPacketSizeInBytes);
+
+    if ( (vResults.empty() == false) && (vResults.back().sName == "dsp noise suppressor") )
+    {
+        const double dTimeUs   = vResults.back().dNsPerOp / 1000.0;
+        const double dPacketUs = 1000000.0 * iSamplesPerPacket / iSampleRate;
+
+        std::printf("dsp noise suppressor: %.1f us per %.0f us packet (%.2f%%), the budget is %.0f us.\n",
+                    dTimeUs, dPacketUs, dTimeUs / dPacketUs * 100, noiseSuppressor.getCPUBudgetUs());
+
+        if (dTimeUs > noiseSuppressor.getCPUBudgetUs())
+        {
+            std::printf("dsp noise suppressor: over the CPU budget.\n");
+
+            bCheckFailed = true;
+        }
+    }
+
+
+
+    AutomaticGainControl automaticGainControl(iSampleRate);
+
+    addBench(vResults, "dsp agc", [&]()
+    {
+        std::memcpy(vPacket.data(), vSource.data(), iPacketSizeInBytes);
+        automaticGainControl.process(vPacket.data(), vPacket.size());
+        benchSink(vPacket.data());
+    }, iPacketSizeInBytes);
+
+
+
+
+    // Per speaker packet in the mixer (the speed is a bit off so the input is resampled).
+
+    DriftCompensator driftCompensator(iSamplesPerPacket, 1000.0 * iSamplesPerPacket / iSampleRate, 2.0);
+    double           dDriftTimeMs = 0.0;
+
+    addBench(vResults, "dsp drift compensator", [&]()
+    {
+        while (driftCompensator.canProduce() == false)
+        {
+            driftCompensator.addInput(vSource.data());
+        }
+
+        // Above the target - a bit faster.
+        driftCompensator.produce(vPacket.data(), 1.0, dDriftTimeMs);
+        dDriftTimeMs += 35.0;
+
+        benchSink(vPacket.data());
+    }, iPacketSizeInBytes);
+
+
+
+
+    // Per packet (35 ms): the capture converts a device packet to the wire rate, playback does the opposite.
+
+    const std::string sResamplerKernelName = Resampler::getKernelName();
+
+    const unsigned int vDeviceRates[] = { 48000, 44100 };
+
+    for (unsigned int iDeviceRate : vDeviceRates)
+    {
+        const size_t iDevicePacketSize = static_cast<size_t>(iSamplesPerPacket) * iDeviceRate / iSampleRate;
+
+        std::vector<short> vDevicePacket(iDevicePacketSize);
+
+        for (size_t i = 0; i < vDevicePacket.size(); i++)
+        {
+            vDevicePacket[i] = vSource[i % vSource.size()];
+        }
+
+        const std::string sCapture  = std::to_string(iDeviceRate) + " to " + std::to_string(iSampleRate);
+        const std::string sPlayback = std::to_string(iSampleRate) + " to " + std::to_string(iDeviceRate);
+
+        Resampler scalarCaptureResampler (iDeviceRate, iSampleRate, true);
+        Resampler captureResampler       (iDeviceRate, iSampleRate);
+        Resampler scalarPlaybackResampler(iSampleRate, iDeviceRate, true);
+        Resampler playbackResampler      (iSampleRate, iDeviceRate);
+
+        std::vector<short> vOutput(captureResampler.getMaxOutputCount(iDevicePacketSize) + playbackResampler.getMaxOutputCount(vSource.size()));
+
+        addBench(vResults, "dsp resample " + sCapture + " scalar", [&]()
+        {
+            scalarCaptureResampler.process(vDevicePacket.data(), vDevicePacket.size(), vOutput.data());
+            benchSink(vOutput.data());
+        }, iDevicePacketSize * sizeof(short));
+
+        addBench(vResults, "dsp resample " + sCapture + " " + sResamplerKernelName, [&]()
+        {
+            captureResampler.process(vDevicePacket.data(), vDevicePacket.size(), vOutput.data());
+            benchSink(vOutput.data());
+        }, iDevicePacketSize * sizeof(short));
+
+        addBench(vResults, "dsp resample " + sPlayback + " scalar", [&]()
+        {
+            scalarPlaybackResampler.process(vSource.data(), vSource.size(), vOutput.data());
+            benchSink(vOutput.data());
+        }, iPacketSizeInBytes);
+
+        addBench(vResults, "dsp resample " + sPlayback + " " + sResamplerKernelName, [&]()
+        {
+            playbackResampler.process(vSource.data(), vSource.size(), vOutput.data());
+            benchSink(vOutput.data());
+        }, iPacketSizeInBytes);
+    }
+
+    return bCheckFailed;
+}
@@ -0,0 +1,118 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "bench.h"
+
+
+// STL
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// Custom
+#include "Model/Crypto/dhgroup.h"
+#include "Model/Crypto/sha256.h"
+#include "Model/net_params.h"
+
+
+// Target for the client's part of the key exchange (all groups, see benchHandshake()).
+#define HANDSHAKE_CLIENT_TARGET_MS  5.0
+
+
+// Everything NetworkService::establishSecureConnection() computes (without the network).
+static void clientHandshake(const DHGroup* pGroup, const std::string& sServerOpenKey, unsigned char* pOutAESKey)
+{
+    integer b = pGroup->generatePrivateKey();
+    integer B = pGroup->computePublicKey(b);
+
+    std::string sOpenKeyB = B.str(256, pGroup->getPrimeSizeInBytes());
+    benchSink(&sOpenKeyB);
+
+    integer A(sServerOpenKey, 256);
+
+    std::string sSecret = pGroup->computeSharedSecret(A, b).str(256, pGroup->getPrimeSizeInBytes());
+
+    SHA256::hkdf(nullptr, 0,
+                 reinterpret_cast<const unsigned char*>(sSecret.c_str()), sSecret.size(),
+                 reinterpret_cast<const unsigned char*>(DH_KDF_INFO), strlen(DH_KDF_INFO),
+                 pOutAESKey, 16);
+}
+
+
+bool benchHandshake(std::vector<BenchResult>& vResults)
+{
+    bool bOverTarget = false;
+
+    for (char iGroupId : DHGroup::getSupportedGroupIds())
+    {
+        // One-time cost of the fixed-base table (normally hidden by NetworkService's precompute thread).
+
+        std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+
+        const DHGroup* pGroup = DHGroup::getGroup(iGroupId);
+
+        BenchResult tableResult;
+        tableResult.sName       = "dh table " + pGroup->getGroupName();
+        tableResult.dNsPerOp    = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        tableResult.iIterations = 1;
+
+        if (isBenchSelected(tableResult.sName))
+        {
+            addBenchResult(vResults, tableResult);
+        }
+
+
+        const integer     serverPrivateKey = pGroup->generatePrivateKey();
+        const std::string sServerOpenKey   = pGroup->computePublicKey(serverPrivateKey).str(256, pGroup->getPrimeSizeInBytes());
+
+        unsigned char vAESKey[16];
+
+
+        addBench(vResults, "dh public key " + pGroup->getGroupName(), [&]()
+        {
+            integer B = pGroup->computePublicKey(serverPrivateKey);
+            benchSink(&B);
+        });
+
+
+        addBench(vResults, "dh shared secret " + pGroup->getGroupName(), [&]()
+        {
+            integer secret = pGroup->computeSharedSecret(integer(sServerOpenKey, 256), serverPrivateKey);
+            benchSink(&secret);
+        });
+
+
+        addBench(vResults, "handshake client " + pGroup->getGroupName(), [&]()
+        {
+            clientHandshake(pGroup, sServerOpenKey, vAESKey);
+            benchSink(vAESKey);
+        });
+
+        if ( (vResults.empty() == false)
+             && (vResults.back().sName == "handshake client " + pGroup->getGroupName())
+             && (vResults.back().dNsPerOp > HANDSHAKE_CLIENT_TARGET_MS * 1000000.0) )
+        {
+            std::printf("    ^ over the %.1f ms target\n", HANDSHAKE_CLIENT_TARGET_MS);
+
+            bOverTarget = true;
+        }
+
+
+        // Both sides, as seen by the user pressing "Connect" (minus the round trips).
+
+        addBench(vResults, "handshake both sides " + pGroup->getGroupName(), [&]()
+        {
+            integer a = pGroup->generatePrivateKey();
+            std::string sOpenKeyA = pGroup->computePublicKey(a).str(256, pGroup->getPrimeSizeInBytes());
+
+            clientHandshake(pGroup, sOpenKeyA, vAESKey);
+
+            integer secret = pGroup->computeSharedSecret(pGroup->computePublicKey(serverPrivateKey), a);
+            benchSink(&secret);
+        });
+    }
+
+    return bOverTarget;
+}
@@ -0,0 +1,110 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "bench.h"
+
+
+// STL
+#include <cstdio>
+
+// Custom
+#include "Model/InputSource/scriptedinputsource.h"
+
+
+// T button (the default push-to-talk button).
+static const int iKey = 0x54;
+
+
+// 20 presses, 1 sec.
+#define SCRIPTED_PRESS_COUNT       20
+#define SCRIPTED_PRESS_INTERVAL_MS 25
+
+
+void benchInputSource(std::vector<BenchResult>& vResults)
+{
+    std::string sErrorText;
+
+
+    // Cost of one edge (the hook thread pays for pushEdge(), the audio thread for popEvent()).
+
+    {
+        ScriptedInputSource inputSource;
+        inputSource.start({iKey}, sErrorText);
+
+        InputEvent event;
+
+        addBench(vResults, "input edge push and pop", [&]()
+        {
+            inputSource.pressKey(iKey);
+            inputSource.popEvent(event);
+
+            inputSource.releaseKey(iKey);
+            inputSource.popEvent(event);
+
+            benchSink(&event);
+        });
+
+        inputSource.stop();
+    }
+
+
+    // How late the thread waiting in waitForEvent() (recordOnPush()) wakes up after the edge.
+
+    if ( isBenchSelected("input edge wakeup latency") )
+    {
+        std::vector<ScriptedInputStep> vSteps;
+
+        for (int i = 0; i < SCRIPTED_PRESS_COUNT; i++)
+        {
+            ScriptedInputStep step;
+            step.iKey  = iKey;
+            step.iAtMs = i * 2 * SCRIPTED_PRESS_INTERVAL_MS;
+            step.bDown = true;
+
+            vSteps.push_back(step);
+
+            step.iAtMs += SCRIPTED_PRESS_INTERVAL_MS;
+            step.bDown = false;
+
+            vSteps.push_back(step);
+        }
+
+        ScriptedInputSource inputSource;
+        inputSource.setScript(vSteps);
+        inputSource.start({iKey}, sErrorText);
+
+        size_t iEventCount     = 0;
+        size_t iWrongOrder     = 0;
+        double dTotalLatencyMs = 0.0;
+        double dMaxLatencyMs   = 0.0;
+
+        InputEvent event;
+
+        while ( (iEventCount < vSteps.size()) && inputSource.waitForEvent(event) )
+        {
+            const double dLatencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - event.time).count();
+
+            if (event.bDown != vSteps[iEventCount].bDown)
+            {
+                iWrongOrder++;
+            }
+
+            iEventCount++;
+
+            dTotalLatencyMs += dLatencyMs;
+
+            if (dLatencyMs > dMaxLatencyMs)
+            {
+                dMaxLatencyMs = dLatencyMs;
+            }
+        }
+
+        inputSource.waitForScriptEnd();
+        inputSource.stop();
+
+        std::printf("input edge wakeup latency: %zu edges (%zu out of order), %.3f ms average / %.3f ms max\n",
+                    iEventCount, iWrongOrder, iEventCount ? dTotalLatencyMs / iEventCount : 0.0, dMaxLatencyMs);
+    }
+}
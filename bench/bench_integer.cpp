@@ -0,0 +1,94 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "bench.h"
+
+
+// STL
+#include <random>
+
+// External
+#include "integer/integer.h"
+
+
+// Random positive number with exactly iBits bits.
+static integer randomInteger(std::mt19937_64& generator, size_t iBits)
+{
+    integer::REP vLimbs((iBits + 63) / 64);
+
+    for (size_t i = 0; i < vLimbs.size(); i++)
+    {
+        vLimbs[i] = generator();
+    }
+
+    if (iBits % 64)
+    {
+        vLimbs.back() &= (1ULL << (iBits % 64)) - 1;
+    }
+
+    vLimbs.back() |= 1ULL << ((iBits - 1) % 64);
+
+    return integer(vLimbs);
+}
+
+
+void benchInteger(std::vector<BenchResult>& vResults)
+{
+    std::mt19937_64 generator(51337);
+
+    const size_t vBits[] = {256, 1024, 2048};
+
+    for (size_t iBits : vBits)
+    {
+        const std::string sBits = std::to_string(iBits);
+
+        const integer a        = randomInteger(generator, iBits);
+        const integer b        = randomInteger(generator, iBits);
+        const integer modulus  = randomInteger(generator, iBits);
+        const integer product  = a * b;
+        const integer exponent = randomInteger(generator, 256);
+
+        integer out;
+
+
+        addBench(vResults, "integer mul " + sBits, [&]()
+        {
+            out = a * b;
+            benchSink(&out);
+        });
+
+        // 2N-bit value reduced by an N-bit modulus, as after a multiplication in modpow.
+        addBench(vResults, "integer mod " + sBits, [&]()
+        {
+            out = product % modulus;
+            benchSink(&out);
+        });
+
+        addBench(vResults, "integer str(10) " + sBits, [&]()
+        {
+            std::string sValue = a.str(10);
+            benchSink(&sValue);
+        });
+
+        addBench(vResults, "integer str(256) " + sBits, [&]()
+        {
+            std::string sValue = a.str(256);
+            benchSink(&sValue);
+        });
+
+        addBench(vResults, "integer parse(10) " + sBits, [&]()
+        {
+            out = integer(a.str(10), 10);
+            benchSink(&out);
+        });
+
+        // The generic square-and-multiply pow() from integer.h with a DH-sized (256 bit) exponent.
+        addBench(vResults, "integer pow-mod 256-bit exp " + sBits, [&]()
+        {
+            out = pow(a, exponent, modulus);
+            benchSink(&out);
+        });
+    }
+}
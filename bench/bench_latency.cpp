@@ -0,0 +1,348 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "bench.h"
+
+
+// STL
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <condition_variable>
+
+// Custom
+#include "Model/AudioService/Backend/nullaudiobackend.h"
+#include "Model/AudioService/Backend/wavfileaudiobackend.h"
+#include "Model/AudioService/Mixer/audiomixer.h"
+#include "Model/AudioService/Latency/voicelatency.h"
+
+// External
+#include "AES/AES.h"
+
+
+// Same as in AudioService.
+static const unsigned int iSampleRate       = 19400;
+static const int          iSamplesPerPacket = 679;
+
+static const char*        pTonePath         = "SilentBench_latency_tone.wav";
+
+
+// The test tone: a 1 kHz beep of LATENCY_TONE_LENGTH_MS every LATENCY_TONE_PERIOD_MS.
+#define LATENCY_TONE_PERIOD_MS        500
+#define LATENCY_TONE_LENGTH_MS        100
+#define LATENCY_TONE_AMPLITUDE        8000
+
+// A beep starts in the output when a sample is above this after LATENCY_TONE_SILENCE_MS of samples below LATENCY_TONE_SILENCE_LEVEL.
+#define LATENCY_TONE_ONSET_LEVEL      2000
+#define LATENCY_TONE_SILENCE_LEVEL    500
+#define LATENCY_TONE_SILENCE_MS       50
+
+// Real time (~3 sec.).
+#define LATENCY_LOOPBACK_PACKETS      90
+
+
+namespace
+{
+    // Remembers when each packet starts to play (and its samples) for the beep onsets.
+
+    class RecordingPlaybackStream : public AudioPlaybackStream
+    {
+    public:
+
+        RecordingPlaybackStream(AudioPlaybackStream* pOutput, double dPacketMs)
+        {
+            this->pOutput   = pOutput;
+            this->dPacketMs = dPacketMs;
+        }
+
+        ~RecordingPlaybackStream() override
+        {
+            delete pOutput;
+        }
+
+        bool write(const short* pSamples) override
+        {
+            mtxRecorded.lock();
+
+            // Starts to play after the queued packets (same as the mixer's VLP_OUTPUT).
+            vPlayTimesMs.push_back( VoiceTimestamps::now() + static_cast<double>(pOutput->getQueuedPacketCount()) * dPacketMs );
+            vSamples.insert(vSamples.end(), pSamples, pSamples + iSamplesPerPacket);
+
+            mtxRecorded.unlock();
+
+            return pOutput->write(pSamples);
+        }
+
+        size_t      getQueuedPacketCount () override       { return pOutput->getQueuedPacketCount(); }
+        void        drain                () override       { pOutput->drain(); }
+        void        reset                () override       { pOutput->reset(); }
+        void        setVolume            (unsigned short iVolume) override { pOutput->setVolume(iVolume); }
+        std::string getLastError         () const override { return pOutput->getLastError(); }
+
+
+        std::mutex          mtxRecorded;
+        std::vector<double> vPlayTimesMs;
+        std::vector<short>  vSamples;
+
+    private:
+
+        AudioPlaybackStream* pOutput;
+
+        double               dPacketMs;
+    };
+
+
+    struct LoopbackPacket
+    {
+        std::vector<unsigned char> vEncrypted;
+        VoiceTimestamps            timestamps;
+    };
+}
+
+
+void benchLatency(std::vector<BenchResult>& vResults)
+{
+    if (isBenchSelected("latency loopback") == false)
+    {
+        return;
+    }
+
+
+    // One period of the tone, the capture loops it.
+
+    const size_t iTonePeriod = static_cast<size_t>(iSampleRate) * LATENCY_TONE_PERIOD_MS / 1000;
+    const size_t iToneLength = static_cast<size_t>(iSampleRate) * LATENCY_TONE_LENGTH_MS / 1000;
+
+    std::vector<short> vTone(iTonePeriod, 0);
+
+    for (size_t i = 0; i < iToneLength; i++)
+    {
+        vTone[i] = static_cast<short>( LATENCY_TONE_AMPLITUDE * std::sin(2.0 * 3.14159265358979 * 1000.0 * i / iSampleRate) );
+    }
+
+    if ( WavFileAudioBackend::writeWavFile(pTonePath, vTone, iSampleRate) )
+    {
+        std::printf("Could not write %s, skipping the latency loopback.\n", pTonePath);
+        return;
+    }
+
+
+    AudioFormat format;
+    format.iSampleRate       = iSampleRate;
+    format.iSamplesPerPacket = iSamplesPerPacket;
+
+    std::string sErrorText;
+
+    WavFileAudioBackend captureBackend(pTonePath, "", true);
+    NullAudioBackend    playbackBackend(true);
+
+    std::unique_ptr<AudioCaptureStream> pCapture( captureBackend.openCapture(L"", format, sErrorText) );
+    AudioPlaybackStream*                pDevice = playbackBackend.openPlayback(format, sErrorText);
+
+    if ( (pCapture == nullptr) || (pDevice == nullptr) )
+    {
+        std::printf("Could not open the audio streams (%s), skipping the latency loopback.\n", sErrorText.c_str());
+        delete pDevice;
+        std::remove(pTonePath);
+        return;
+    }
+
+    RecordingPlaybackStream* pOutput = new RecordingPlaybackStream(pDevice, 1000.0 * iSamplesPerPacket / iSampleRate);
+
+    AudioMixer     mixer(pOutput, format);
+    MixerSpeaker*  pSpeaker = mixer.addSpeaker([](bool) {});
+
+    unsigned char vKey[16];
+
+    for (size_t i = 0; i < sizeof(vKey); i++)
+    {
+        vKey[i] = static_cast<unsigned char>(i * 37 + 11);
+    }
+
+
+    // The "network": sender -> receiver thread (as NetworkService's UDP thread).
+
+    std::mutex                 mtxNetwork;
+    std::condition_variable    cvNetwork;
+    std::deque<LoopbackPacket> vInFlight;
+    bool                       bSenderFinished = false;
+
+    std::thread receiverThread([&]()
+    {
+        AES aes(128);
+
+        std::vector<short> vSamples(iSamplesPerPacket);
+
+        while (true)
+        {
+            std::unique_lock<std::mutex> lock(mtxNetwork);
+            cvNetwork.wait(lock, [&]() { return bSenderFinished || (vInFlight.empty() == false); });
+
+            if (vInFlight.empty())
+            {
+                break;
+            }
+
+            LoopbackPacket packet = std::move(vInFlight.front());
+            vInFlight.pop_front();
+
+            lock.unlock();
+
+            packet.timestamps.mark(VLP_RECEIVED);
+
+            unsigned char* pDecrypted = aes.DecryptECB(packet.vEncrypted.data(), static_cast<unsigned int>(packet.vEncrypted.size()), vKey);
+            std::memcpy(vSamples.data(), pDecrypted, vSamples.size() * sizeof(short));
+            delete[] pDecrypted;
+
+            packet.timestamps.mark(VLP_DECRYPTED);
+
+            mixer.pushPacket(pSpeaker, vSamples.data(), packet.timestamps);
+        }
+
+        mixer.pushLastPacket(pSpeaker);
+    });
+
+
+    // Capture and send.
+
+    AES aes(128);
+
+    std::vector<short>  vPacket(iSamplesPerPacket);
+    std::vector<double> vCaptureTimesMs;
+
+    pCapture->start();
+
+    for (int i = 0; i < LATENCY_LOOPBACK_PACKETS; i++)
+    {
+        pCapture->read(vPacket.data());
+
+        LoopbackPacket packet;
+        packet.timestamps.mark(VLP_CAPTURED);
+
+        vCaptureTimesMs.push_back(packet.timestamps.vTimesMs[VLP_CAPTURED]);
+
+        unsigned int   iEncryptedSize = 0;
+        unsigned char* pEncrypted     = aes.EncryptECB(reinterpret_cast<unsigned char*>(vPacket.data()),
+                                                       static_cast<unsigned int>(vPacket.size() * sizeof(short)), vKey, iEncryptedSize);
+
+        packet.vEncrypted.assign(pEncrypted, pEncrypted + iEncryptedSize);
+        delete[] pEncrypted;
+
+        packet.timestamps.mark(VLP_SENT);
+
+        mtxNetwork.lock();
+        vInFlight.push_back(std::move(packet));
+        mtxNetwork.unlock();
+
+        cvNetwork.notify_one();
+    }
+
+    pCapture->stop();
+
+    mtxNetwork.lock();
+    bSenderFinished = true;
+    mtxNetwork.unlock();
+
+    cvNetwork.notify_one();
+
+    receiverThread.join();
+
+
+    // Let the mixer play the rest.
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    const VoiceLatencyStats latency = mixer.getSpeakerLatency(pSpeaker);
+
+
+    // Beep onsets: in the input - from the capture times (the beeps start every iTonePeriod samples of the capture),
+    // in the output - from the play times of the mixed packets.
+
+    std::vector<double> vInputOnsetsMs;
+
+    for (size_t iSample = 0; iSample < vCaptureTimesMs.size() * iSamplesPerPacket; iSample += iTonePeriod)
+    {
+        const size_t iPacket = iSample / iSamplesPerPacket;
+        const size_t iOffset = iSample % iSamplesPerPacket;
+
+        // The packet was complete at its capture time.
+        vInputOnsetsMs.push_back( vCaptureTimesMs[iPacket] - 1000.0 * static_cast<double>(iSamplesPerPacket - iOffset) / iSampleRate );
+    }
+
+    std::vector<double> vOnsetLatenciesMs;
+
+    {
+        std::lock_guard<std::mutex> lock(pOutput->mtxRecorded);
+
+        const size_t iSilenceCount = static_cast<size_t>(iSampleRate) * LATENCY_TONE_SILENCE_MS / 1000;
+        size_t       iQuietCount   = iSilenceCount; // the output starts with silence
+
+        for (size_t i = 0; i < pOutput->vSamples.size(); i++)
+        {
+            const int iLevel = std::abs(static_cast<int>(pOutput->vSamples[i]));
+
+            if ( (iLevel > LATENCY_TONE_ONSET_LEVEL) && (iQuietCount >= iSilenceCount) )
+            {
+                const double dOutputMs = pOutput->vPlayTimesMs[i / iSamplesPerPacket]
+                                         + 1000.0 * static_cast<double>(i % iSamplesPerPacket) / iSampleRate;
+
+                // The last beep that was captured before it.
+                for (size_t iBeep = vInputOnsetsMs.size(); iBeep > 0; iBeep--)
+                {
+                    if (vInputOnsetsMs[iBeep - 1] < dOutputMs)
+                    {
+                        vOnsetLatenciesMs.push_back(dOutputMs - vInputOnsetsMs[iBeep - 1]);
+                        break;
+                    }
+                }
+            }
+
+            iQuietCount = (iLevel < LATENCY_TONE_SILENCE_LEVEL) ? iQuietCount + 1 : 0;
+        }
+    }
+
+    mixer.removeSpeaker(pSpeaker);
+
+    std::remove(pTonePath);
+
+
+    std::printf("latency loopback (capture -> AES -> receiver thread -> AES -> mixer -> real-time null output):\n%s",
+                latency.toString("    ").c_str());
+
+    if (vOnsetLatenciesMs.empty())
+    {
+        std::printf("latency loopback: no beeps in the output.\n");
+        return;
+    }
+
+    std::sort(vOnsetLatenciesMs.begin(), vOnsetLatenciesMs.end());
+
+    const double dOnsetMedianMs = vOnsetLatenciesMs[vOnsetLatenciesMs.size() / 2];
+
+    std::printf("    tone onset (%zu beeps): median %.2f / max %.2f ms\n",
+                vOnsetLatenciesMs.size(), dOnsetMedianMs, vOnsetLatenciesMs.back());
+
+
+    // As "ns/op" so that --baseline catches a latency regression.
+
+    BenchResult totalResult;
+    totalResult.sName       = "latency loopback total p50";
+    totalResult.dNsPerOp    = latency.getTotal().getPercentileMs(0.5) * 1000000.0;
+    totalResult.iIterations = static_cast<size_t>(latency.getTotal().getCount());
+
+    addBenchResult(vResults, totalResult);
+
+    BenchResult onsetResult;
+    onsetResult.sName       = "latency loopback tone onset";
+    onsetResult.dNsPerOp    = dOnsetMedianMs * 1000000.0;
+    onsetResult.iIterations = vOnsetLatenciesMs.size();
+
+    addBenchResult(vResults, onsetResult);
+}
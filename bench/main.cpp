@@ -0,0 +1,96 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+// STL
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Custom
+#include "bench.h"
+
+
+// Usage: SilentBench [--filter <text>] [--json <out file>] [--baseline <json file>] [--max-regression <percent>]
+//
+// --json writes the results so that a later run can be compared against them with --baseline,
+// the exit code is 1 if some benchmark got slower than --max-regression percent (or allocates more)
+// or if a SIMD kernel does not match the scalar code (or the noise suppressor does not fit its CPU budget)
+// or if the client's part of the handshake is over its target.
+
+int main(int argc, char* argv[])
+{
+    std::string sJSONPath;
+    std::string sBaselinePath;
+    double      dMaxRegressionPercent = BENCH_DEFAULT_MAX_REGRESSION;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string sArg = argv[i];
+
+        if (i + 1 >= argc)
+        {
+            std::printf("Missing value for %s.\n", sArg.c_str());
+            return 2;
+        }
+
+        if (sArg == "--filter")
+        {
+            setBenchFilter(argv[++i]);
+        }
+        else if (sArg == "--json")
+        {
+            sJSONPath = argv[++i];
+        }
+        else if (sArg == "--baseline")
+        {
+            sBaselinePath = argv[++i];
+        }
+        else if (sArg == "--max-regression")
+        {
+            dMaxRegressionPercent = std::stod(argv[++i]);
+        }
+        else
+        {
+            std::printf("Unknown argument %s.\n", sArg.c_str());
+            return 2;
+        }
+    }
+
+
+    std::vector<BenchResult> vBaseline;
+
+    if ( (sBaselinePath.empty() == false) && readBenchResultsJSON(sBaselinePath, vBaseline) )
+    {
+        std::printf("Could not read the baseline from %s.\n", sBaselinePath.c_str());
+        return 2;
+    }
+
+
+    std::vector<BenchResult> vResults;
+
+    benchInteger(vResults);
+    const bool bHandshakeOverTarget = benchHandshake(vResults);
+    benchConnect(vResults);
+    benchAES(vResults);
+    benchAudioBackend(vResults);
+    benchInputSource(vResults);
+    benchLatency(vResults);
+
+    const bool bDSPCheckFailed = benchDSP(vResults);
+
+
+    if ( (sJSONPath.empty() == false) && writeBenchResultsJSON(vResults, sJSONPath) )
+    {
+        std::printf("Could not write the results to %s.\n", sJSONPath.c_str());
+        return 2;
+    }
+
+    if ( (sBaselinePath.empty() == false) && compareBenchResults(vBaseline, vResults, dMaxRegressionPercent) )
+    {
+        return 1;
+    }
+
+    return (bDSPCheckFailed || bHandshakeOverTarget) ? 1 : 0;
+}
@@ -57,6 +57,16 @@ unsigned char * AES::DecryptECB(unsigned char in[], unsigned int inLen, unsigned
   return out;
 }
 
+void AES::DecryptECB(unsigned char in[], unsigned int inLen, unsigned  char key[], unsigned char out[])
+{
+  unsigned char roundKeys[4 * 4 * (14 + 1)]; // 4 * Nb * (Nr + 1) for the longest key
+  KeyExpansion(key, roundKeys);
+  for (unsigned int i = 0; i < inLen; i+= blockBytesLen)
+  {
+    DecryptBlock(in + i, out + i, roundKeys);
+  }
+}
+
 
 unsigned char *AES::EncryptCBC(unsigned char in[], unsigned int inLen, unsigned  char key[], unsigned char * iv, unsigned int &outLen)
 {
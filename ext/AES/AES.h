@@ -65,6 +65,9 @@ public:
 
   unsigned char *DecryptECB(unsigned char in[], unsigned int inLen, unsigned  char key[]);
 
+  // Same, but to out (inLen bytes) instead of a new buffer.
+  void DecryptECB(unsigned char in[], unsigned int inLen, unsigned  char key[], unsigned char out[]);
+
   unsigned char *EncryptCBC(unsigned char in[], unsigned int inLen, unsigned  char key[], unsigned char * iv, unsigned int &outLen);
 
   unsigned char *DecryptCBC(unsigned char in[], unsigned int inLen, unsigned  char key[], unsigned char * iv);
@@ -1,6 +1,11 @@
 ﻿#include "integer.h"
 
 #include <algorithm>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h>
+#endif
 
 constexpr INTEGER_DIGIT_T integer::NEG1;
 constexpr std::size_t     integer::OCTETS;
@@ -9,9 +14,185 @@ constexpr INTEGER_DIGIT_T integer::HIGH_BIT;
 constexpr integer::Sign   integer::POSITIVE;
 constexpr integer::Sign   integer::NEGATIVE;
 
-integer & integer::trim(){                  // remove top 0 digits to save memory
-    while (!_value.empty() && !_value[0]){
-        _value.pop_front();
+// ------------------------------------------------------------------------------------------------
+// 64-bit limb helpers
+// ------------------------------------------------------------------------------------------------
+
+namespace {
+
+typedef INTEGER_DIGIT_T limb;
+
+// full 64 x 64 -> 128 bit product, returns the low half
+inline limb mul_hilo(limb a, limb b, limb & hi){
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 p = static_cast <unsigned __int128> (a) * b;
+    hi = static_cast <limb> (p >> 64);
+    return static_cast <limb> (p);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return _umul128(a, b, &hi);
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+    hi = __umulh(a, b);
+    return a * b;
+#else
+    const limb a_lo = a & 0xffffffffULL, a_hi = a >> 32;
+    const limb b_lo = b & 0xffffffffULL, b_hi = b >> 32;
+
+    const limb p0 = a_lo * b_lo;
+    const limb p1 = a_lo * b_hi;
+    const limb p2 = a_hi * b_lo;
+    const limb p3 = a_hi * b_hi;
+
+    const limb mid = (p0 >> 32) + (p1 & 0xffffffffULL) + (p2 & 0xffffffffULL);
+    hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+    return (mid << 32) | (p0 & 0xffffffffULL);
+#endif
+}
+
+// number of leading zero bits, x must not be 0
+inline unsigned int clz(limb x){
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast <unsigned int> (__builtin_clzll(x));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return 63 - static_cast <unsigned int> (index);
+#else
+    unsigned int n = 0;
+    while (!(x & (static_cast <limb> (1) << 63))){
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// (u1:u0) / v where u1 < v, returns the quotient and stores the remainder in r
+inline limb div_2by1(limb u1, limb u0, limb v, limb & r){
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 u = (static_cast <unsigned __int128> (u1) << 64) | u0;
+    r = static_cast <limb> (u % v);
+    return static_cast <limb> (u / v);
+#elif defined(_MSC_VER) && (_MSC_VER >= 1920) && defined(_M_X64)
+    return _udiv128(u1, u0, v, &r);
+#else
+    // Hacker's Delight, divlu
+    const limb b = static_cast <limb> (1) << 32;
+
+    const unsigned int s = clz(v);
+    v <<= s;
+    const limb vn1 = v >> 32;
+    const limb vn0 = v & 0xffffffffULL;
+
+    const limb un32 = s ? ((u1 << s) | (u0 >> (64 - s))) : u1;
+    const limb un10 = u0 << s;
+    const limb un1  = un10 >> 32;
+    const limb un0  = un10 & 0xffffffffULL;
+
+    limb q1   = un32 / vn1;
+    limb rhat = un32 - q1 * vn1;
+    while ((q1 >= b) || (q1 * vn0 > b * rhat + un1)){
+        q1--;
+        rhat += vn1;
+        if (rhat >= b){
+            break;
+        }
+    }
+
+    const limb un21 = un32 * b + un1 - q1 * v;
+
+    limb q0 = un21 / vn1;
+    rhat = un21 - q0 * vn1;
+    while ((q0 >= b) || (q0 * vn0 > b * rhat + un0)){
+        q0--;
+        rhat += vn1;
+        if (rhat >= b){
+            break;
+        }
+    }
+
+    r = (un21 * b + un0 - q0 * v) >> s;
+    return q1 * b + q0;
+#endif
+}
+
+// out[0..n) = a[0..n) + b[0..n), returns the carry
+inline limb add_n(limb * out, const limb * a, const limb * b, std::size_t n){
+    limb carry = 0;
+    for(std::size_t i = 0; i < n; i++){
+        const limb s = a[i] + carry;
+        carry = (s < carry);
+        out[i] = s + b[i];
+        carry += (out[i] < s);
+    }
+    return carry;
+}
+
+// out[0..n) = a[0..n) - b[0..n), returns the borrow
+inline limb sub_n(limb * out, const limb * a, const limb * b, std::size_t n){
+    limb borrow = 0;
+    for(std::size_t i = 0; i < n; i++){
+        const limb d = a[i] - b[i];
+        const limb nb = (a[i] < b[i]);
+        out[i] = d - borrow;
+        borrow = nb + (d < borrow);
+    }
+    return borrow;
+}
+
+// a[0..n) += carry, returns the carry out of the top limb
+inline limb add_1(limb * a, std::size_t n, limb carry){
+    for(std::size_t i = 0; (i < n) && carry; i++){
+        a[i] += carry;
+        carry = (a[i] < carry);
+    }
+    return carry;
+}
+
+// a[0..n) -= borrow, returns the borrow out of the top limb
+inline limb sub_1(limb * a, std::size_t n, limb borrow){
+    for(std::size_t i = 0; (i < n) && borrow; i++){
+        const limb old = a[i];
+        a[i] -= borrow;
+        borrow = (old < borrow);
+    }
+    return borrow;
+}
+
+// compare magnitudes stored least significant limb first (no leading zero limbs)
+inline int cmp_mag(const integer::REP & a, const integer::REP & b){
+    if (a.size() != b.size()){
+        return (a.size() < b.size())?-1:1;
+    }
+    for(std::size_t i = a.size(); i > 0; i--){
+        if (a[i - 1] != b[i - 1]){
+            return (a[i - 1] < b[i - 1])?-1:1;
+        }
+    }
+    return 0;
+}
+
+// the largest power of base that fits into a limb and its exponent
+inline void chunk_base(limb base, limb & power, unsigned int & count){
+    power = base;
+    count = 1;
+    limb hi;
+    for(;;){
+        const limb next = mul_hilo(power, base, hi);
+        if (hi){
+            break;
+        }
+        power = next;
+        count++;
+    }
+}
+
+}
+
+// ------------------------------------------------------------------------------------------------
+
+integer & integer::trim(){                  // remove top 0 limbs to save memory
+    while (!_value.empty() && !_value.back()){
+        _value.pop_back();
     }
     if (_value.empty()){                    // change sign to false if _value is 0
         _sign = integer::POSITIVE;
@@ -34,10 +215,11 @@ integer::integer(const integer & copy) :
 }
 
 integer::integer(integer && copy) :
-    _sign(std::move(copy._sign)),
+    _sign(copy._sign),
     _value(std::move(copy._value))
 {
-    copy = 0;
+    copy._value.clear();
+    copy._sign = integer::POSITIVE;
     trim();
 }
 
@@ -81,18 +263,25 @@ integer::integer(const std::string & str, const integer & base) : integer()
             index++;
         }
 
+        const limb b = static_cast <uint64_t> (base);
+
+        // digits are gathered into one limb ("chunk") and then
+        // the whole value is multiplied by base^count at once
+        limb chunk       = 0;
+        limb chunk_power = 1;
+
         // process characters
         for(; index < str.size(); index++){
             uint8_t d = tolower(str[index]);
             if (isdigit(d)){       // 0-9
                 d -= '0';
-                if (d >= base){
+                if (d >= b){
                     throw std::runtime_error(std::string("Error: Not a digit in base ") + base.str(10) + ": '"+ str[index] + "'");
                 }
             }
             else if (isxdigit(d)){ // a-f
                 d -= 'a' - 10;
-                if (d >= base){
+                if (d >= b){
                     throw std::runtime_error(std::string("Error: Not a digit in base ") + base.str(10) + ": '"+ str[index] + "'");
                 }
             }
@@ -100,15 +289,51 @@ integer::integer(const std::string & str, const integer & base) : integer()
                 throw std::runtime_error(std::string("Error: Not a digit in base ") + base.str(10) + ": '"+ str[index] + "'");
             }
 
-            *this = (*this * base) + d;
+            limb hi;
+            const limb next_power = mul_hilo(chunk_power, b, hi);
+            if (hi){
+                // chunk is full, flush it
+                limb carry = chunk;
+                for(limb & v : _value){
+                    limb phi;
+                    const limb plo = mul_hilo(v, chunk_power, phi);
+                    v = plo + carry;
+                    carry = phi + (v < plo);
+                }
+                if (carry){
+                    _value.push_back(carry);
+                }
+
+                chunk       = d;
+                chunk_power = b;
+            }
+            else{
+                chunk       = chunk * b + d;
+                chunk_power = next_power;
+            }
+        }
+
+        // flush the last chunk
+        limb carry = chunk;
+        for(limb & v : _value){
+            limb phi;
+            const limb plo = mul_hilo(v, chunk_power, phi);
+            v = plo + carry;
+            carry = phi + (v < plo);
+        }
+        if (carry){
+            _value.push_back(carry);
         }
 
         _sign = sign;
     }
     else if (base == 256){
-        // process characters
-        for(unsigned char const & c : str){
-            *this = (*this << 8) | (c & 0xff);
+        // process characters, the first character is the most significant byte
+        _value.assign((str.size() + integer::OCTETS - 1) / integer::OCTETS, 0);
+
+        std::size_t byte = 0;
+        for(std::string::size_type i = str.size(); i > 0; i--, byte++){
+            _value[byte / integer::OCTETS] |= static_cast <limb> (static_cast <unsigned char> (str[i - 1])) << ((byte % integer::OCTETS) * 8);
         }
     }
     else{
@@ -128,10 +353,11 @@ integer & integer::operator=(const integer & rhs){
 }
 
 integer & integer::operator=(integer && rhs){
-    if (*this != rhs){
+    if (this != &rhs){
         _sign = rhs._sign;
-        _value = rhs._value;
-        rhs = 0;
+        _value = std::move(rhs._value);
+        rhs._value.clear();
+        rhs._sign = integer::POSITIVE;
     }
     return trim();
 }
@@ -142,96 +368,57 @@ integer::operator bool() const {
 }
 
 integer::operator uint8_t() const {
-    const uint8_t out = static_cast <uint8_t> (_value.empty()?0:_value.back() & 255);
+    const uint8_t out = static_cast <uint8_t> (_value.empty()?0:_value[0]);
     return _sign?-out:out;
 }
 
 integer::operator uint16_t() const {
-    uint16_t out = 0;
-
-    const integer::REP_SIZE_T d = std::min(digits(), std::max((integer::REP_SIZE_T) 2 / integer::OCTETS, (integer::REP_SIZE_T) 1));
-    for(integer::REP_SIZE_T x = 0; x < d; x++){
-        out += static_cast <uint16_t> (_value[digits() - x - 1]) << (x * integer::BITS);
-    }
-
+    const uint16_t out = static_cast <uint16_t> (_value.empty()?0:_value[0]);
     return _sign?-out:out;
 }
 
 integer::operator uint32_t() const {
-    uint32_t out = 0;
-
-    const integer::REP_SIZE_T d = std::min(digits(), std::max((integer::REP_SIZE_T) 4 / integer::OCTETS, (integer::REP_SIZE_T) 1));
-    for(integer::REP_SIZE_T x = 0; x < d; x++){
-        out += static_cast <uint32_t> (_value[digits() - x - 1]) << (x * integer::BITS);
-    }
-
+    const uint32_t out = static_cast <uint32_t> (_value.empty()?0:_value[0]);
     return _sign?-out:out;
 }
 
 integer::operator uint64_t() const {
-    uint64_t out = 0;
-
-    const integer::REP_SIZE_T d = std::min(digits(), std::max((integer::REP_SIZE_T) 8 / integer::OCTETS, (integer::REP_SIZE_T) 1));
-    for(integer::REP_SIZE_T x = 0; x < d; x++){
-        out += static_cast <uint64_t> (_value[digits() - x - 1]) << (x * integer::BITS);
-    }
-
+    const uint64_t out = static_cast <uint64_t> (_value.empty()?0:_value[0]);
     return _sign?-out:out;
 }
 
 integer::operator int8_t() const {
-    const int8_t out = static_cast <int8_t> (_value.empty()?0:_value.back() & 255);
+    const int8_t out = static_cast <int8_t> (_value.empty()?0:_value[0]);
     return _sign?-out:out;
 }
 
 integer::operator int16_t() const {
-    int16_t out = 0;
-
-    const integer::REP_SIZE_T d = std::min(digits(), std::max((integer::REP_SIZE_T) 2 / integer::OCTETS, (integer::REP_SIZE_T) 1));
-    for(integer::REP_SIZE_T x = 0; x < d; x++){
-        out += static_cast <int16_t> (_value[digits() - x - 1]) << (x * integer::BITS);
-    }
-
+    const int16_t out = static_cast <int16_t> (_value.empty()?0:_value[0]);
     return _sign?-out:out;
 }
 
 integer::operator int32_t() const {
-    int32_t out = 0;
-
-    const integer::REP_SIZE_T d = std::min(digits(), std::max((integer::REP_SIZE_T) 4 / integer::OCTETS, (integer::REP_SIZE_T) 1));
-    for(integer::REP_SIZE_T x = 0; x < d; x++){
-        out += static_cast <int32_t> (_value[digits() - x - 1]) << (x * integer::BITS);
-    }
-
+    const int32_t out = static_cast <int32_t> (_value.empty()?0:_value[0]);
     return _sign?-out:out;
 }
 
 integer::operator int64_t() const {
-    int64_t out = 0;
-
-    const integer::REP_SIZE_T d = std::min(digits(), std::max((integer::REP_SIZE_T) 8 / integer::OCTETS, (integer::REP_SIZE_T) 1));
-    for(integer::REP_SIZE_T x = 0; x < d; x++){
-        out += static_cast <int64_t> (_value[digits() - x - 1]) << (x * integer::BITS);
-    }
-
-    return _sign?-out:out;
+    const uint64_t out = static_cast <uint64_t> (_value.empty()?0:_value[0]);
+    return static_cast <int64_t> (_sign?(0 - out):out);
 }
 
 // Bitwise Operators
 integer integer::operator&(const integer & rhs) const {
-    integer::REP out;
-
     const integer::REP_SIZE_T max_bits = std::max(bits(), rhs.bits());
     const integer             left     = (    _sign == integer::POSITIVE)?*this:twos_complement(max_bits);
     const integer             right    = (rhs._sign == integer::POSITIVE)?rhs:rhs.twos_complement(max_bits);
 
-    // AND matching digits
-    for(integer::REP::const_reverse_iterator i = left._value.rbegin(), j = right._value.rbegin(); (i != left._value.rend()) && (j != right._value.rend()); i++, j++){
-        out.push_front(*i & *j);
+    // AND matching limbs, drop any limbs that don't match up
+    integer::REP out(std::min(left._value.size(), right._value.size()));
+    for(integer::REP_SIZE_T i = 0; i < out.size(); i++){
+        out[i] = left._value[i] & right._value[i];
     }
 
-    // drop any digits that don't match up
-
     integer OUT(out, integer::POSITIVE);
     if (_sign & rhs._sign){
         OUT = OUT.twos_complement(max_bits);
@@ -249,22 +436,13 @@ integer integer::operator|(const integer & rhs) const {
     const integer             left     = (    _sign == integer::POSITIVE)?*this:twos_complement(max_bits);
     const integer             right    = (rhs._sign == integer::POSITIVE)?rhs:rhs.twos_complement(max_bits);
 
-    integer::REP out;
-    integer::REP::const_reverse_iterator i = left._value.rbegin(), j = right._value.rbegin();
-
-    // OR matching digits
-    for(; (i != left._value.rend()) && (j != right._value.rend()); i++, j++){
-        out.push_front(*i | *j);
-    }
-
-    // push rest of *this into value
-    while (i != left._value.rend()){
-        out.push_front(*i++);
-    }
+    // OR matching limbs, the rest comes from the longer value
+    const integer & longer  = (left._value.size() >= right._value.size())?left:right;
+    const integer & shorter = (left._value.size() >= right._value.size())?right:left;
 
-    // push rest of rhs into value
-    while (j != right._value.rend()){
-        out.push_front(*j++);
+    integer::REP out = longer._value;
+    for(integer::REP_SIZE_T i = 0; i < shorter._value.size(); i++){
+        out[i] |= shorter._value[i];
     }
 
     integer OUT(out, integer::POSITIVE);
@@ -284,22 +462,13 @@ integer integer::operator^(const integer & rhs) const {
     const integer             left     = (    _sign == integer::POSITIVE)?*this:twos_complement(max_bits);
     const integer             right    = (rhs._sign == integer::POSITIVE)?rhs:rhs.twos_complement(max_bits);
 
-    integer::REP out;
-    integer::REP::const_reverse_iterator i = left._value.rbegin(), j = right._value.rbegin();
-
-    // XOR matching digits
-    for(; (i != left._value.rend()) && (j != right._value.rend()); i++, j++){
-        out.push_front(*i ^ *j);
-    }
+    // XOR matching limbs, the rest comes from the longer value
+    const integer & longer  = (left._value.size() >= right._value.size())?left:right;
+    const integer & shorter = (left._value.size() >= right._value.size())?right:left;
 
-    // push *this into value
-    while (i != left._value.rend()){
-        out.push_front(*i++);
-    }
-
-    // push rhs into value
-    while (j != right._value.rend()){
-        out.push_front(*j++);
+    integer::REP out = longer._value;
+    for(integer::REP_SIZE_T i = 0; i < shorter._value.size(); i++){
+        out[i] ^= shorter._value[i];
     }
 
     integer OUT(out, integer::POSITIVE);
@@ -322,21 +491,15 @@ integer integer::operator~() const {
 
     integer::REP out = _value;
 
-    // invert whole digits
-    for(integer::REP_SIZE_T i = 1; i < out.size(); i++){
+    // invert whole limbs
+    for(integer::REP_SIZE_T i = 0; i + 1 < out.size(); i++){
         out[i] ^= integer::NEG1;
     }
 
-    INTEGER_DIGIT_T mask = HIGH_BIT;
-    while (!(out[0] & mask)){
-        mask >>= 1;
-    }
-
-    // invert bits of partial digit
-    while (mask){
-        out[0] ^= mask;
-        mask >>= 1;
-    }
+    // invert bits of partial (top) limb
+    const unsigned int used = static_cast <unsigned int> (integer::BITS) - clz(out.back());
+    const limb mask = (used == integer::BITS)?integer::NEG1:((static_cast <limb> (1) << used) - 1);
+    out.back() ^= mask;
 
     return integer(out, _sign);
 }
@@ -353,34 +516,22 @@ integer integer::operator<<(const integer & shift) const {
         throw std::runtime_error("Error: Negative shift amount");
     }
 
-    const std::pair <integer, integer> qr = dm(shift, integer::BITS);
-    const integer & whole      = qr.first;             // number of zeros to add to the back
-    const INTEGER_DIGIT_T push = qr.second;            // push left by this many bits
-    const INTEGER_DIGIT_T pull = integer::BITS - push; // pull "push" bits from the right
-
-    integer::REP out = _value;
+    const uint64_t            amount = static_cast <uint64_t> (shift);
+    const integer::REP_SIZE_T whole  = static_cast <integer::REP_SIZE_T> (amount / integer::BITS); // number of zero limbs to add to the bottom
+    const unsigned int        push   = static_cast <unsigned int> (amount % integer::BITS);        // push left by this many bits
 
-    out.push_front(0);                                 // extra digit for shifting into
-    out.push_back(0);                                  // extra digit for shifting from
+    integer::REP out(_value.size() + whole + 1, 0);
 
-    // do this part first to avoid shifting zeros
-    for(integer::REP_SIZE_T i = 0; i < (out.size() - 1); i++){
-        INTEGER_DOUBLE_DIGIT_T d = out[i];
-        d = (d << push) | (out[i + 1] >> pull);
-        out[i] = d & NEG1;
-        // out[i] = (out[i] << push) | (out[i + 1] >> pull);
-    }
-
-    if (!out[0]){                                      // if the top digit is still 0
-        out.pop_front();                               // remove it
-    }
-
-    if (!whole){                                       // if there was no need for the 0 at the end
-        out.pop_back();                                // remove it
+    if (push){
+        limb carry = 0;
+        for(integer::REP_SIZE_T i = 0; i < _value.size(); i++){
+            out[i + whole] = (_value[i] << push) | carry;
+            carry = _value[i] >> (integer::BITS - push);
+        }
+        out[_value.size() + whole] = carry;
     }
     else{
-        // push back zeros, excluding the one already there
-        out.insert(out.end(), whole - 1, 0);
+        std::copy(_value.begin(), _value.end(), out.begin() + whole);
     }
 
     return integer(out, _sign);
@@ -400,24 +551,19 @@ integer integer::operator>>(const integer & shift) const {
         return 0;
     }
 
-    const std::pair <integer, integer> qr = dm(shift, integer::BITS);
-    const integer & whole      = qr.first;             // number of digits to pop off
-    const INTEGER_DIGIT_T push = qr.second;            // push right by this many bits
-    const INTEGER_DIGIT_T pull = integer::BITS - push; // pull "push" bits from the left
+    const uint64_t            amount = static_cast <uint64_t> (shift);
+    const integer::REP_SIZE_T whole  = static_cast <integer::REP_SIZE_T> (amount / integer::BITS); // number of limbs to drop
+    const unsigned int        push   = static_cast <unsigned int> (amount % integer::BITS);        // push right by this many bits
 
-    integer::REP out = _value;
-
-    // pop off whole digits
-    for(integer i = 0; i < whole; i++){
-        out.pop_back();
-    }
+    integer::REP out(_value.begin() + whole, _value.end());
 
     if (push){
-        out.push_front(0);                             // extra 0 for shifting from
-        for(integer::REP_SIZE_T i = 1; i < out.size(); i++){
-            out[out.size() - i] = (out[out.size() - i - 1] << pull) | (out[out.size() - i] >> push);
+        for(integer::REP_SIZE_T i = 0; i < out.size(); i++){
+            out[i] >>= push;
+            if (i + 1 < out.size()){
+                out[i] |= out[i + 1] << (integer::BITS - push);
+            }
         }
-        out.pop_front();
     }
 
     return integer(out, _sign);
@@ -443,21 +589,7 @@ bool integer::operator!=(const integer & rhs) const {
 
 // operator> not considering signs
 bool integer::gt(const integer & lhs, const integer & rhs) const {
-    if (lhs._value.size() > rhs._value.size()){
-        return true;
-    }
-    if (lhs._value.size() < rhs._value.size()){
-        return false;
-    }
-    if (lhs._value == rhs._value){
-        return false;
-    }
-    for(integer::REP_SIZE_T i = 0; i < lhs._value.size(); i++){
-        if (lhs._value[i] != rhs._value[i]){
-            return lhs._value[i] > rhs._value[i];
-        }
-    }
-    return false;
+    return cmp_mag(lhs._value, rhs._value) > 0;
 }
 
 bool integer::operator>(const integer & rhs) const {
@@ -484,21 +616,7 @@ bool integer::operator>=(const integer & rhs) const {
 
 // operator< not considering signs
 bool integer::lt(const integer & lhs, const integer & rhs) const {
-    if (lhs._value.size() < rhs._value.size()){
-        return true;
-    }
-    if (lhs._value.size() > rhs._value.size()){
-        return false;
-    }
-    if (lhs._value == rhs._value){
-        return false;
-    }
-    for(integer::REP_SIZE_T i = 0; i < lhs._value.size(); i++){
-        if (lhs._value[i] != rhs._value[i]){
-            return lhs._value[i] < rhs._value[i];
-        }
-    }
-    return false;
+    return cmp_mag(lhs._value, rhs._value) < 0;
 }
 
 bool integer::operator<(const integer & rhs) const {
@@ -524,36 +642,19 @@ bool integer::operator<=(const integer & rhs) const {
 }
 
 // Arithmetic Operators
+
+// addition not considering signs
 integer integer::add(const integer & lhs, const integer & rhs) const {
-    integer::REP out;
-    integer::REP::const_reverse_iterator i = lhs._value.rbegin(), j = rhs._value.rbegin();
-    bool carry = false;
-    INTEGER_DOUBLE_DIGIT_T sum;
+    const integer & longer  = (lhs._value.size() >= rhs._value.size())?lhs:rhs;
+    const integer & shorter = (lhs._value.size() >= rhs._value.size())?rhs:lhs;
 
-    // add up matching digits
-    for(; ((i != lhs._value.rend()) && (j != rhs._value.rend())); i++, j++){
-        sum = static_cast <INTEGER_DOUBLE_DIGIT_T> (*i) + static_cast <INTEGER_DOUBLE_DIGIT_T> (*j) + carry;
-        out.push_front(sum);
-        carry = (sum > integer::NEG1);
-    }
+    integer::REP out(longer._value.size() + 1, 0);
 
-    // copy in lhs extra digits
-    for(; i != lhs._value.rend(); i++){
-        sum = static_cast <INTEGER_DOUBLE_DIGIT_T> (*i) + carry;
-        out.push_front(sum);
-        carry = (sum > integer::NEG1);
-    }
+    limb carry = add_n(out.data(), longer._value.data(), shorter._value.data(), shorter._value.size());
+    std::copy(longer._value.begin() + shorter._value.size(), longer._value.end(), out.begin() + shorter._value.size());
+    carry = add_1(out.data() + shorter._value.size(), longer._value.size() - shorter._value.size(), carry);
+    out.back() = carry;
 
-    // copy in rhs extra digits
-    for(; j != rhs._value.rend(); j++){
-        sum = static_cast <INTEGER_DOUBLE_DIGIT_T> (*j) + carry;
-        out.push_front(sum);
-        carry = (sum > integer::NEG1);
-    }
-
-    if (carry){
-        out.push_front(1);
-    }
     return integer(out);
 }
 
@@ -566,33 +667,21 @@ integer integer::operator+(const integer & rhs) const {
         return rhs;
     }
 
-    integer out = *this;
-    if (gt(out, rhs)){              // lhs > rhs
-        if (_sign == rhs._sign){    // same sign: lhs + rhs
-            out = add(out, rhs);
-        }
-        else{                       // different signs: lhs - rhs
-            out = sub(out, rhs);
-        }
+    integer out;
+    if (_sign == rhs._sign){        // same sign: lhs + rhs
+        out = add(*this, rhs);
+        out._sign = _sign;
+    }
+    else if (gt(*this, rhs)){       // lhs > rhs, different signs: lhs - rhs
+        out = sub(*this, rhs);
         out._sign = _sign;          // lhs sign dominates
     }
-    else if (lt(out, rhs)){         // lhs < rhs
-        if (_sign == rhs._sign){    // same sign: rhs + lhs
-            out = add(rhs, out);
-        }
-        else{                       // different sign: rhs - lhs
-            out = sub(rhs, out);
-        }
+    else if (lt(*this, rhs)){       // lhs < rhs, different signs: rhs - lhs
+        out = sub(rhs, *this);
         out._sign = rhs._sign;      // rhs sign dominates
     }
-    else{                           // lhs == rhs
-        if (_sign == rhs._sign){    // same sign: double value
-            out <<= 1;
-            out._sign = _sign;
-        }
-        else{                       // different signs: 0
-            return 0;
-        }
+    else{                           // different signs, same magnitude: 0
+        return 0;
     }
     out.trim();
     return out;
@@ -605,369 +694,138 @@ integer & integer::operator+=(const integer & rhs){
 // Subtraction as done by hand
 integer integer::long_sub(const integer & lhs, const integer & rhs) const {
     // rhs always smaller than lhs
-    integer out = lhs;
-    integer::REP_SIZE_T lsize = out._value.size() - 1;
-    integer::REP_SIZE_T rsize = rhs._value.size() - 1;
-
-    for(integer::REP_SIZE_T x = 0; x <= rsize; x++){
-        // if top is bigger than or equal to the bottom, just substract
-        if (out._value[lsize - x] >= rhs._value[rsize - x]){
-            out._value[lsize - x] -= rhs._value[rsize - x];
-        }
-        else{// find a higher digit to carry from
-            integer::REP_SIZE_T y = lsize - x - 1;
-            // if this goes out of bounds, something is wrong
-            while (!out._value[y]){
-                y--;
-            }
-
-            out._value[y]--;
-            y++;
+    integer::REP out(lhs._value.size(), 0);
 
-            for(; y < lsize - x; y++){
-                out._value[y] = integer::NEG1;
-            }
+    limb borrow = sub_n(out.data(), lhs._value.data(), rhs._value.data(), rhs._value.size());
+    std::copy(lhs._value.begin() + rhs._value.size(), lhs._value.end(), out.begin() + rhs._value.size());
+    sub_1(out.data() + rhs._value.size(), lhs._value.size() - rhs._value.size(), borrow);
 
-            out._value[y] = static_cast <INTEGER_DOUBLE_DIGIT_T> (out._value[y]) + (static_cast <uint64_t> (1) << integer::BITS) - rhs._value[rsize - x];
-        }
-    }
-    return out;
+    return integer(out);
 }
 
-//// Two's Complement Subtraction
-//integer integer::two_comp_sub(const integer & lhs, const integer & rhs){
-//    rhs = rhs.twos_complement(lhs.bits());
-//    return add(lhs, rhs) & (~(integer(1) << lhs.bits()));   // Flip bits to get max of 1 << x
-//}
-
 // subtraction not considering signs
 // lhs must be larger than rhs
 integer integer::sub(const integer & lhs, const integer & rhs) const {
     if (!rhs){
-        return lhs;
-    }
-    if (!lhs){
-        return -rhs;
+        return abs(lhs);
     }
-    if (lhs == rhs){
+    if (cmp_mag(lhs._value, rhs._value) == 0){
         return 0;
     }
     return long_sub(lhs, rhs);
-    // return two_comp_sub(lhs, rhs);
 }
 
 integer integer::operator-(const integer & rhs) const {
-    integer out = *this;
-    if (gt(out, rhs)){                                  // if lhs > rhs
-        if (out._sign == rhs._sign){                    // same signs
-            out = sub(out, rhs);
+    return *this + (-rhs);
+}
+
+integer & integer::operator-=(const integer & rhs){
+    return *this = *this - rhs;
+}
+
+void integer::schoolbook_mult(const INTEGER_DIGIT_T * a, integer::REP_SIZE_T an,
+                              const INTEGER_DIGIT_T * b, integer::REP_SIZE_T bn,
+                              INTEGER_DIGIT_T * out){
+    std::fill(out, out + an + bn, 0);
+
+    for(integer::REP_SIZE_T i = 0; i < an; i++){
+        limb carry = 0;
+        const limb ai = a[i];
+        if (!ai){
+            continue;
         }
-        else if (out._sign != rhs._sign){               // different signs
-            out = add(out, rhs);
+        for(integer::REP_SIZE_T j = 0; j < bn; j++){
+            limb hi;
+            limb lo = mul_hilo(ai, b[j], hi);
+            lo += carry;
+            hi += (lo < carry);
+            out[i + j] += lo;
+            hi += (out[i + j] < lo);
+            carry = hi;
         }
-        out._sign = _sign;                              // lhs sign dominates
+        out[i + bn] = carry;
     }
-    else if (lt(out, rhs)){                             // if lhs < rhs
-        if      (    (_sign == integer::NEGATIVE) &&    // - - -
-                 (rhs._sign == integer::NEGATIVE)){
-            out = sub(rhs, out);
-            out._sign = integer::POSITIVE;
-        }
-        else if (    (_sign == integer::NEGATIVE) &&    // - - +
-                 (rhs._sign == integer::POSITIVE)){
-            out = add(rhs, out);
-            out._sign = integer::NEGATIVE;
-        }
-        else if (    (_sign == integer::POSITIVE) &&    // + - -
-                 (rhs._sign == integer::NEGATIVE)){
-            out = add(out, rhs);
-            out._sign = integer::POSITIVE;
-        }
-        else if (    (_sign == integer::POSITIVE) &&    // + - +
-                 (rhs._sign == integer::POSITIVE)){
-            out = sub(rhs, out);
-            out._sign = integer::NEGATIVE;
-        }
+}
+
+void integer::karatsuba_mult(const INTEGER_DIGIT_T * a, const INTEGER_DIGIT_T * b, integer::REP_SIZE_T n,
+                             INTEGER_DIGIT_T * out){
+    // the middle product has (n - n / 2 + 1) limbs, which only shrinks for n >= 4
+    if ((n < INTEGER_KARATSUBA_THRESHOLD) || (n < 4)){
+        schoolbook_mult(a, n, b, n, out);
+        return;
     }
-    else{                                               // if lhs == rhs
-        if (_sign == rhs._sign){                        // same signs: 0
-            return 0;
-        }
-        else{                                           // different signs: double value
-            out <<= 1;
-            out._sign = _sign;
-        }
+
+    // a = a1 * B^h + a0, b = b1 * B^h + b0
+    const integer::REP_SIZE_T h  = n / 2;      // size of the low halves
+    const integer::REP_SIZE_T hi = n - h;      // size of the high halves (hi >= h)
+
+    // z0 = a0 * b0 goes to out[0 .. 2h), z2 = a1 * b1 goes to out[2h .. 2n)
+    karatsuba_mult(a,     b,     h,  out);
+    karatsuba_mult(a + h, b + h, hi, out + 2 * h);
+
+    // (a0 + a1) and (b0 + b1), hi + 1 limbs each
+    integer::REP sa(hi + 1, 0), sb(hi + 1, 0);
+    std::copy(a + h, a + n, sa.begin());
+    std::copy(b + h, b + n, sb.begin());
+    sa[hi] = add_1(sa.data() + h, hi - h, add_n(sa.data(), sa.data(), a, h));
+    sb[hi] = add_1(sb.data() + h, hi - h, add_n(sb.data(), sb.data(), b, h));
+
+    // z1 = (a0 + a1) * (b0 + b1) - z0 - z2
+    integer::REP z1(2 * (hi + 1), 0);
+    karatsuba_mult(sa.data(), sb.data(), hi + 1, z1.data());
+
+    limb borrow = sub_n(z1.data(), z1.data(), out, 2 * h);
+    sub_1(z1.data() + 2 * h, z1.size() - 2 * h, borrow);
+
+    borrow = sub_n(z1.data(), z1.data(), out + 2 * h, 2 * hi);
+    sub_1(z1.data() + 2 * hi, z1.size() - 2 * hi, borrow);
+
+    // out += z1 * B^h, z1 fits into 2 * hi + 1 limbs
+    integer::REP_SIZE_T z1n = z1.size();
+    while (z1n && !z1[z1n - 1]){
+        z1n--;
     }
-    out.trim();
-    return out;
-}
+    z1n = std::min(z1n, 2 * n - h);
 
-integer & integer::operator-=(const integer & rhs){
-    return *this = *this - rhs;
+    const limb carry = add_n(out + h, out + h, z1.data(), z1n);
+    add_1(out + h + z1n, 2 * n - h - z1n, carry);
 }
 
-// // Peasant Multiplication
-// integer integer::peasant(const integer & lhs, const integer & rhs) const {
-   // integer rhs_copy = rhs;
-   // integer sum = 0;
-   // for(integer::REP_SIZE_T x = 0; x < lhs.bits(); x++){
-      // if (lhs[x]){
-          // sum += add(sum, rhs_copy);
-       // }
-      // rhs_copy <<= 1;
-   // }
-   // return sum;
-// }
-
-// // Recurseive Peasant Algorithm
-// integer integer::recursive_peasant(const integer & lhs, const integer & rhs) const {
-   // if (!rhs){
-       // return 0;
-   // }
-   // if (rhs & 1){
-       // return lhs + recursive_peasant(lhs << 1, rhs >> 1);
-   // }
-   // return recursive_peasant(lhs << 1, rhs >> 1);
-// }
-
-// // Recursive Multiplication
-// integer integer::recursive_mult(const integer & lhs, const integer & rhs) const {
-   // if (!rhs){
-      // return 0;
-   // }
-   // integer z = recursive_mult(lhs, rhs >> 1);
-   // if (!(rhs & 1)){
-      // return z << 1;
-   // }
-   // return add(lhs, z << 1);
-// }
-
-// // Karatsuba Algorithm
-// integer integer::karatsuba(const integer & lhs, const integer & rhs, integer bm) const {
-  // // b is integer::REP = 256
-  // // m is chars = 4
-  // // bm is max _value = b ^ m
-
-  // if ((lhs <= bm) | (rhs <= bm))
-      // return peasant(lhs, rhs);
-
-  // std::pair <integer, integer> x = dm(lhs, bm);
-  // std::pair <integer, integer> y = dm(rhs, bm);
-  // integer x0 = x.second;
-  // integer x1 = x.first;
-  // integer y0 = y.second;
-  // integer y1 = y.first;
-
-  // integer z0 = karatsuba(x0, y0);
-  // integer z2 = karatsuba(x1, y1);
-  // integer z1 = sub(sub(karatsuba(add(x1, x0), add(y1, y0)), z2), z0);
-  // return add(karatsuba(add(karatsuba(z2, bm), z1), bm), z0);
-// }
-
-// // Toom-Cook multiplication
-// // as described at http://en.wikipedia.org/wiki/Toom%E2%80%93Cook_multiplications
-// // This implementation is a bit weird. In the pointwise Multiplcation step, using
-// // operator* and long_mult works, but everything else fails.
-// // It's also kind of slow.
-// integer integer::toom_cook_3(integer m, integer n, integer bm){
-  // if ((m <= bm) | (n <= bm)){
-      // return peasant(m, n);
-   // }
-
-  // // Splitting
-  // integer i = integer(std::max(m.log(3), n.log(3))) / 3 + 1;
-  // integer bi = pow(integer(3), i);
-  // integer B = 1;
-  // integer integer::REP = 10;
-  // while (B < bi){
-      // B *= integer::REP;
-   // }
-
-  // integer M[3], N[3];
-  // for(uint8_t i = 0; i < 3; i++){
-      // std::pair <integer, integer> tm = dm(m, B);
-      // std::pair <integer, integer> tn = dm(n, B);
-      // m = tm.first;
-      // n = tn.first;
-      // M[i] = tm.second;
-      // N[i] = tn.second;
-  // }
-
-  // // Evaluation
-  // //             {0,             1,                 -1,                         -2,                             inf}
-  // integer p[5] = {M[0], M[0] + M[1] + M[2], M[0] - M[1] + M[2], M[0] - M[1] - M[1] + M[2] + M[2] + M[2] + M[2], M[2]};
-  // integer q[5] = {N[0], N[0] + N[1] + N[2], N[0] - N[1] + N[2], N[0] - N[1] - N[1] + N[2] + N[2] + N[2] + N[2], N[2]};
-
-  // // Pointwise Multiplication
-  // integer r[5];
-  // for(uint8_t i = 0; i < 5; i++)
-      // r[i] = p[i] * q[i];                 // don't understand why only integer::operator* and long_mult can be used here
-
-  // // Interpolation
-  // integer r0 = r[0];
-  // integer r4 = r[4];
-  // integer r3 = (r[3] - r[1]) / 3;
-  // integer r1 = (r[1] - r[2]) / 2;
-  // integer r2 = r[2] - r[0];
-  // r3 = (r2 - r3) / 2 + r4 + r4;
-  // r2 = r2 + r1 - r4;
-  // r1 = r1 - r3;
-
-  // // Recomposition
-  // return peasant(peasant(peasant(peasant(r4, B) + r3, B) + r2, B) + r1, B) + r0;
-// }
-
-// // Long multiplication
-// integer integer::long_mult(const integer & lhs, const integer & rhs) const {
-   // unsigned int zeros = 0;
-   // integer row, out = 0;
-   // for(integer::REP::const_reverse_iterator i = lhs._value.rbegin(); i != lhs._value.rend(); i++){
-       // row._value = integer::REP(zeros++, 0); // zeros on the right hand side
-       // INTEGER_DIGIT_T carry = 0;
-       // for(integer::REP::const_reverse_iterator j = rhs._value.rbegin(); j != rhs._value.rend(); j++){
-           // INTEGER_DOUBLE_DIGIT_T prod = (INTEGER_DOUBLE_DIGIT_T) *i * (INTEGER_DOUBLE_DIGIT_T) *j + carry;// multiply through
-           // row._value.push_front(prod & integer::NEG1);
-           // carry = prod >> integer::BITS;
-       // }
-       // if (carry){
-           // row._value.push_front(carry);
-       // }
-       // out = add(out, row);
-   // }
-   // return out;
-// }
-
-//Private FFT helper function
-int integer::fft(std::deque<double>& data, bool dir) const
-{
-     //Verify size is a power of two
-     std::size_t n = data.size()/2;
-     if ((n == 0) || (n & (n-1))) return 1;
-
-     //rearrange data for signal flow chart
-     std::size_t bitr_j = 1;
-     for (std::size_t i = 3; i < 2*n-1; i += 2)
-     {
-          std::size_t msz = n;
-          while (bitr_j >= msz)
-          {
-               bitr_j -= msz;
-               msz >>= 1;
-          }
-          bitr_j += msz;
-
-          if (bitr_j > i)
-          {
-               double swap = data[bitr_j-1];
-               data[bitr_j-1] = data[i-1];
-               data[i-1] = swap;
-               swap = data[bitr_j];
-               data[bitr_j] = data[i];
-               data[i] = swap;
-          }
-     }
-
-     //Perform "butterfly" calculations
-     std::size_t lmax = 2;
-     while (lmax <= n)
-     {
-          double wr = 1;
-          double wi = 0;
-
-          double theta = (2*M_PI)/double(lmax*(dir?1.0:-1.0));
-          double wpr = cos(theta);
-          double wpi = sin(theta);
-
-          int pstep = 2*lmax;
-          for (std::size_t l = 1; l < lmax; l += 2)
-          {
-               for (std::size_t p = l; p < 2*n; p += pstep)
-               {
-                    std::size_t q = p + lmax;
-                    double tempr = wr*data[q-1] - wi*data[q];
-                    double tempi = wr*data[q] + wi*data[q-1];
-                    data[q-1] = data[p-1] - tempr;
-                    data[q] = data[p] - tempi;
-                    data[p-1] = data[p-1] + tempr;
-                    data[p] = data[p] + tempi;
-               }
-
-               //Find the next power of W
-               double wtemp = wr;
-               wr = wr*wpr - wi*wpi;
-               wi = wi*wpr + wtemp*wpi;
-          }
-
-          lmax = pstep;
-     }
-
-     //All is good
-     return 0;
-}
-
-// FFT-based multiplication
-//Based on the convolution theorem which states that the Fourier
-//transform of a convolution is the pointwise product of their
-//Fourier transforms.
-integer integer::fft_mult(const integer& lhs, const integer& rhs) const {
-     //Convert each integer to input wanted by fft()
-     size_t size = 1;
-     while (size < lhs._value.size()*2){
-          size <<= 1;
-     }
-     while (size < rhs._value.size()*2){
-          size <<= 1;
-     }
-
-     std::deque<double> lhs_fft;
-     lhs_fft.resize(size*2, 0);
-     for (size_t i = 0; i < lhs._value.size(); i++){
-          lhs_fft[i*2] = double(lhs._value[lhs._value.size()-1-i]);
-     }
-
-     std::deque<double> rhs_fft;
-     rhs_fft.resize(size*2, 0);
-     for (size_t i = 0; i < rhs._value.size(); i++){
-          rhs_fft[i*2] = double(rhs._value[rhs._value.size()-1-i]);
-     }
-
-     //Compute the FFT of each
-     fft(lhs_fft);
-     fft(rhs_fft);
-
-     //Perform pointwise multiplication (numbers are complex)
-     std::deque<double> out_fft(2*size);
-     for (size_t i = 0; i < 2*size; i+=2){
-          out_fft[i] = lhs_fft[i]*rhs_fft[i] - lhs_fft[i+1]*rhs_fft[i+1];
-          out_fft[i+1] = lhs_fft[i]*rhs_fft[i+1] + lhs_fft[i+1]*rhs_fft[i];
-     }
-
-     //Compute the inverse FFT of this number
-     //remember to properly scale afterwards!
-     fft(out_fft, false);
-     for (size_t i = 0; i < 2*size; i++){
-          out_fft[i] /= size;
-     }
-
-     //Convert back to integer, carrying along the way
-     double carry = 0;
-     integer out;
-     for (size_t i = 0; i < 2*size; i+=2){
-          double current = out_fft[i]+carry;
-          if (current > double(integer::NEG1)){
-               carry = current / (double(integer::NEG1)+1);
-               carry = double(floor(carry+0.0001));
-               current = current - (carry*(integer::NEG1+1));
-
-          }
-          else {
-               carry = 0;
-          }
-          out._value.push_front(INTEGER_DIGIT_T(current+0.0001));
-     }
-
-     //Finish up
-     return out;
+void integer::mult(const INTEGER_DIGIT_T * a, integer::REP_SIZE_T an,
+                   const INTEGER_DIGIT_T * b, integer::REP_SIZE_T bn,
+                   INTEGER_DIGIT_T * out){
+    if (an < bn){
+        std::swap(a, b);
+        std::swap(an, bn);
+    }
+
+    if (bn < INTEGER_KARATSUBA_THRESHOLD){
+        schoolbook_mult(a, an, b, bn, out);
+        return;
+    }
+
+    if (an == bn){
+        karatsuba_mult(a, b, an, out);
+        return;
+    }
+
+    // unbalanced: multiply b by bn-sized slices of a and accumulate
+    std::fill(out, out + an + bn, 0);
+
+    integer::REP partial(2 * bn, 0);
+    for(integer::REP_SIZE_T offset = 0; offset < an; offset += bn){
+        const integer::REP_SIZE_T len = std::min(bn, an - offset);
+
+        if (len == bn){
+            karatsuba_mult(a + offset, b, bn, partial.data());
+        }
+        else{
+            mult(a + offset, len, b, bn, partial.data());
+        }
+
+        const limb carry = add_n(out + offset, out + offset, partial.data(), len + bn);
+        add_1(out + offset + len + bn, an + bn - offset - len - bn, carry);
+    }
 }
 
 integer integer::operator*(const integer & rhs) const {
@@ -975,20 +833,11 @@ integer integer::operator*(const integer & rhs) const {
     if (!*this || !rhs){    // if multiplying by 0
         return 0;
     }
-    if (*this == 1){        // if multiplying by 1
-        return rhs;
-    }
-    if (rhs == 1){          // if multiplying by 1
-        return *this;
-    }
 
-    // integer out = peasant(*this, rhs);
-    // integer out = recursive_peasant(*this, rhs);
-    // integer out = recursive_mult(*this, rhs);
-    // integer out = karatsuba(*this, rhs);
-    // integer out = toom_cook_3(*this, rhs);
-    // integer out = long_mult(*this, rhs);
-    integer out = fft_mult(*this, rhs);
+    integer out;
+    out._value.assign(_value.size() + rhs._value.size(), 0);
+    mult(_value.data(), _value.size(), rhs._value.data(), rhs._value.size(), out._value.data());
+
     out._sign = _sign ^ rhs._sign;
     out.trim();
     return out;
@@ -998,77 +847,100 @@ integer & integer::operator*=(const integer & rhs){
     return *this = *this * rhs;
 }
 
-// // Naive Division: keep subtracting until lhs == 0
-// std::pair <integer, integer> integer::naive_divmod(const integer & lhs, const integer & rhs) const {
-    // std::pair <integer, integer> qr (0, lhs);
-    // while (qr.second >= rhs){
-        // qr.second -= rhs;
-        // qr.first++;
-    // }
-    // return qr;
-// }
-
-// // Long Division returning both quotient and remainder
-// std::pair <integer, integer> integer::long_divmod(const integer & lhs, const integer & rhs) const {
-   // std::pair <integer, integer> qr(0, lhs);
-   // integer copyd = rhs;
-   // integer adder = 1;
-   // integer shift = qr.second.bits() - copyd.bits();
-    // copyd <<= shift;
-    // adder <<= shift;
-   // // while (qr.second > copyd){
-       // // copyd <<= 1;
-       // // adder <<= 1;
-   // // }
-   // while (qr.second >= rhs){
-       // if (qr.second >= copyd){
-           // qr.second -= copyd;
-           // qr.first |= adder;
-       // }
-       // copyd >>= 1;
-       // adder >>= 1;
-   // }
-   // return qr;
-// }
-
-// // Recursive Division that returns both the quotient and remainder
-// // Recursion took up way too much memory
-// std::pair <integer, integer> integer::recursive_divmod(const integer & lhs, const integer & rhs) const {
-   // std::pair <integer, integer> qr;
-   // if (!lhs){
-       // qr.first = 0;
-       // qr.second = 0;
-       // return qr;
-   // }
-   // qr = recursive_divmod(lhs >> 1, rhs);
-   // qr.first <<= 1;
-   // qr.second <<= 1;
-   // if (lhs & 1)
-       // qr.second++;
-   // if (qr.second >= rhs){
-       // qr.second -= rhs;
-       // qr.first++;
-   // }
-   // return qr;
-// }
-
-// Non-Recursive version of above algorithm
-std::pair <integer, integer> integer::non_recursive_divmod(const integer & lhs, const integer & rhs) const {
-    std::pair <integer, integer> qr (0, 0);
-    for(integer::REP_SIZE_T x = lhs.bits(); x > 0; x--){
-        qr.first  <<= 1;
-        qr.second <<= 1;
-
-        if (lhs[x - 1]){
-            qr.second++;
+INTEGER_DIGIT_T integer::divmod_limb(integer::REP & value, INTEGER_DIGIT_T d){
+    limb r = 0;
+    for(integer::REP_SIZE_T i = value.size(); i > 0; i--){
+        value[i - 1] = div_2by1(r, value[i - 1], d, r);
+    }
+    while (!value.empty() && !value.back()){
+        value.pop_back();
+    }
+    return r;
+}
+
+std::pair <integer, integer> integer::long_divmod(const integer & lhs, const integer & rhs) const {
+    const integer::REP_SIZE_T n = rhs._value.size();
+    const integer::REP_SIZE_T m = lhs._value.size() - n;
+
+    // normalize so that the top bit of the divisor is set
+    const unsigned int s = clz(rhs._value.back());
+
+    integer::REP vn(n), un(lhs._value.size() + 1);
+    for(integer::REP_SIZE_T i = n; i > 0; i--){
+        vn[i - 1] = (rhs._value[i - 1] << s) | ((s && (i > 1))?(rhs._value[i - 2] >> (integer::BITS - s)):0);
+    }
+    un[lhs._value.size()] = s?(lhs._value.back() >> (integer::BITS - s)):0;
+    for(integer::REP_SIZE_T i = lhs._value.size(); i > 0; i--){
+        un[i - 1] = (lhs._value[i - 1] << s) | ((s && (i > 1))?(lhs._value[i - 2] >> (integer::BITS - s)):0);
+    }
+
+    integer::REP q(m + 1, 0);
+
+    for(integer::REP_SIZE_T j = m + 1; j > 0; j--){
+        const integer::REP_SIZE_T k = j - 1;
+
+        // estimate the quotient limb from the top two limbs
+        limb qhat, rhat;
+        bool rhat_overflow = false;
+        if (un[k + n] >= vn[n - 1]){
+            qhat = integer::NEG1;
+            rhat = un[k + n - 1] + vn[n - 1];
+            rhat_overflow = (rhat < vn[n - 1]);
+        }
+        else{
+            qhat = div_2by1(un[k + n], un[k + n - 1], vn[n - 1], rhat);
+        }
+
+        // refine with the third limb, at most two corrections
+        while (!rhat_overflow){
+            limb phi;
+            const limb plo = mul_hilo(qhat, vn[n - 2], phi);
+            if ((phi > rhat) || ((phi == rhat) && (plo > un[k + n - 2]))){
+                qhat--;
+                rhat += vn[n - 1];
+                rhat_overflow = (rhat < vn[n - 1]);
+            }
+            else{
+                break;
+            }
         }
 
-        if (qr.second >= rhs){
-            qr.second -= rhs;
-            qr.first++;
+        // multiply and subtract
+        limb borrow = 0, carry = 0;
+        for(integer::REP_SIZE_T i = 0; i < n; i++){
+            limb phi;
+            limb plo = mul_hilo(qhat, vn[i], phi);
+            plo += carry;
+            phi += (plo < carry);
+            carry = phi;
+
+            const limb t = un[i + k] - plo;
+            const limb b1 = (un[i + k] < plo);
+            un[i + k] = t - borrow;
+            borrow = b1 + (t < borrow);
         }
+        const limb t = un[k + n] - carry;
+        const limb b1 = (un[k + n] < carry);
+        un[k + n] = t - borrow;
+        borrow = b1 + (t < borrow);
+
+        // the estimate was one too large, add the divisor back
+        if (borrow){
+            qhat--;
+            const limb c = add_n(un.data() + k, un.data() + k, vn.data(), n);
+            un[k + n] += c;
+        }
+
+        q[k] = qhat;
+    }
+
+    // unnormalize the remainder
+    integer::REP r(n);
+    for(integer::REP_SIZE_T i = 0; i < n; i++){
+        r[i] = (un[i] >> s) | (s?(un[i + 1] << (integer::BITS - s)):0);
     }
-    return qr;
+
+    return {integer(q), integer(r)};
 }
 
 // division and modulus ignoring signs
@@ -1077,51 +949,33 @@ std::pair <integer, integer> integer::dm(const integer & lhs, const integer & rh
         throw std::domain_error("Error: division or modulus by 0");
     }
 
-    if (rhs == 1){          // divide by 1 check
-        return {lhs, 0};
+    const int c = cmp_mag(lhs._value, rhs._value);
+    if (c < 0){             // lhs < rhs check
+        return {0, abs(lhs)};
     }
-    if (lhs == rhs){        // divide by same value check
+    if (c == 0){            // divide by same value check
         return {1, 0};
     }
-    if (!lhs){              // 0 / rhs check
-        return {0, 0};
-    }
-    if (lt(lhs, rhs)){      // lhs < rhs check
-        return {0, lhs};
+
+    if (rhs._value.size() == 1){
+        integer q(lhs._value);
+        const limb r = divmod_limb(q._value, rhs._value[0]);
+        return {q, integer(r)};
     }
 
-    // return naive_divmod(lhs, rhs);
-    // return long_divmod(lhs, rhs);
-    // return recursive_divmod(lhs, rhs);
-    return non_recursive_divmod(lhs, rhs);
+    return long_divmod(lhs, rhs);
 }
 
 // division and modulus with signs
 std::pair <integer, integer> integer::divmod(const integer & lhs, const integer & rhs) const {
     std::pair <integer, integer> out = dm(abs(lhs), abs(rhs));
     out.first._sign = lhs._sign ^ rhs._sign;
+    out.first.trim();
 
     if (lhs._sign == integer::NEGATIVE){
         out.second = -out.second;
     }
 
-    // if      ((lhs._sign == integer::POSITIVE) &&    // + % +
-             // (rhs._sign == integer::POSITIVE)){
-        // // out.second = out.second;
-    // }
-    // else if ((lhs._sign == integer::POSITIVE) &&    // + % -
-             // (rhs._sign == integer::NEGATIVE)){
-        // // out.second = out.second;
-    // }
-    // else if ((lhs._sign == integer::NEGATIVE) &&    // - % +
-             // (rhs._sign == integer::POSITIVE)){
-        // out.second = -out.second;
-    // }
-    // else if ((lhs._sign == integer::NEGATIVE) &&    // - % -
-             // (rhs._sign == integer::NEGATIVE)){
-        // out.second = -out.second;
-    // }
-
     return out;
 }
 
@@ -1182,29 +1036,24 @@ integer::Sign integer::sign() const {
 
 // get minimum number of bits needed to hold this value
 integer integer::bits() const {
-    integer         out = integer(_value.empty()?0:(_value.size() - 1)) * integer::BITS;
-    INTEGER_DIGIT_T msb = _value.empty()?0:_value[0];
-    while (msb){
-        msb >>= 1;
-        out++;
+    if (_value.empty()){
+        return 0;
     }
 
-    return out;
+    return static_cast <uint64_t> (_value.size() * integer::BITS - clz(_value.back()));
 }
 
 // get minimum number of bytes needed to hold this value
 integer::REP_SIZE_T integer::bytes() const {
-    integer::REP_SIZE_T out = (_value.empty()?0:(_value.size() - 1)) * integer::OCTETS;
-    INTEGER_DIGIT_T     msb = (_value.empty()?0:_value[0]);
-    while (msb){
-        msb >>= 8;
-        out++;
+    if (_value.empty()){
+        return 0;
     }
 
-    return out;
+    const integer::REP_SIZE_T used_bits = _value.size() * integer::BITS - clz(_value.back());
+    return (used_bits + 7) / 8;
 }
 
-// get number of digits
+// get number of limbs
 integer::REP_SIZE_T integer::digits() const {
     return _value.size();
 }
@@ -1231,17 +1080,17 @@ integer integer::twos_complement(const integer::REP_SIZE_T & b) const {
 integer & integer::fill(const integer::REP_SIZE_T & b){
     _value = integer::REP(b / integer::BITS, integer::NEG1);
     if (b % integer::BITS){
-        _value.push_front((1 << (b % integer::BITS)) - 1);
+        _value.push_back((static_cast <limb> (1) << (b % integer::BITS)) - 1);
     }
     return *this;
 }
 
 // get bit, where 0 is the lsb and bits() - 1 is the msb
 bool integer::operator[](const integer::REP_SIZE_T & b) const {
-    if (b >= bits()){ // if given index is larger than bits in this _value, return 0
+    if ((b / integer::BITS) >= _value.size()){ // if given index is larger than bits in this _value, return 0
         return 0;
     }
-    return (_value[_value.size() - (b / integer::BITS) - 1] >> (b % integer::BITS)) & 1;
+    return (_value[b / integer::BITS] >> (b % integer::BITS)) & 1;
 }
 
 // Output value as a string from base 2 to 16, or base 256
@@ -1249,17 +1098,31 @@ std::string integer::str(const integer & base, const std::string::size_type & le
     std::string out = "";
     if ((2 <= base) && (base <= 16)){
         static const std::string digits = "0123456789abcdef";
-        integer rhs = abs(*this);       // use absolute value to make sure index stays small
-        if (*this == 0){
+        if (_value.empty()){
             out = "0";
         }
         else{
-            std::pair <integer, integer> qr;
-            do{
-                qr = dm(rhs, base);
-                out = digits[qr.second] + out;
-                rhs = qr.first;
-            } while (rhs);
+            const limb b = static_cast <uint64_t> (base);
+
+            // peel off as many digits as fit into a limb with a single limb division
+            limb chunk_power;
+            unsigned int chunk_digits;
+            chunk_base(b, chunk_power, chunk_digits);
+
+            integer::REP rhs = _value;  // absolute value
+            out.reserve(rhs.size() * integer::BITS);
+
+            while (!rhs.empty()){
+                limb chunk = divmod_limb(rhs, chunk_power);
+
+                // the most significant chunk is not padded with zeros
+                for(unsigned int i = 0; (i < chunk_digits) && (chunk || !rhs.empty()); i++){
+                    out += digits[chunk % b];
+                    chunk /= b;
+                }
+            }
+
+            std::reverse(out.begin(), out.end());
         }
 
         // pad with '0's
@@ -1272,24 +1135,9 @@ std::string integer::str(const integer & base, const std::string::size_type & le
             out = std::string(1, 0);
         }
         else{
-            // for each digit
-            for(INTEGER_DIGIT_T const & d : _value){
-                // write out each character
-                for(std::size_t i = integer::OCTETS << 3; i > 0; i -= 8){
-                    out += std::string(1, (d >> (i - 8)) & 0xff);
-                }
-            }
-
-            // remove leading '\x00's
-            // this is possible because _value is being read
-            // one character at a time, not one byte at a time
-            if (out.size() > length){
-                std::size_t i = 0;
-                while ((i < out.size()) && !out[i]){
-                    i++;
-                }
-
-                out = out.substr(i, out.size() - i);
+            // write out each byte, most significant first
+            for(integer::REP_SIZE_T i = bytes(); i > 0; i--){
+                out += static_cast <char> ((_value[(i - 1) / integer::OCTETS] >> (((i - 1) % integer::OCTETS) * 8)) & 0xff);
             }
         }
 
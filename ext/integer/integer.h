@@ -22,13 +22,12 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 
-#include <cmath> //For fft sin, cos, M_PI, and floor
 #include <cstdint>
-#include <deque>
 #include <iostream>
 #include <limits>
 #include <stdexcept>
 #include <type_traits>
+#include <vector>
 
 #include <sstream>
 
@@ -39,41 +38,35 @@ THE SOFTWARE.
 #include <algorithm>
 #endif
 
-#ifndef M_PI
-#define M_PI 3.14159265359
-#endif
-
 #ifndef __INTEGER__
 #define __INTEGER__
 
+// Numbers are stored as contiguous 64-bit limbs.
+// The limb helpers in integer.cpp (mul_hilo, div_2by1) are written for this width only.
 #ifndef INTEGER_DIGIT_T
-#define INTEGER_DIGIT_T        uint8_t
-#endif
-
-#ifndef INTEGER_DOUBLE_DIGIT_T
-#define INTEGER_DOUBLE_DIGIT_T uint64_t
+#define INTEGER_DIGIT_T        uint64_t
 #endif
 
-// INTEGET_DIGIT_T and INTEGER_DOUBLE_DIGIT_T
-// should be unsigned integers
 static_assert(std::is_unsigned <INTEGER_DIGIT_T>::value &&
-              std::is_unsigned <INTEGER_DOUBLE_DIGIT_T>::value
-              , "Internal types must be unsigned integers");
+              (sizeof(INTEGER_DIGIT_T) == 8)
+              , "INTEGER_DIGIT_T must be a 64-bit unsigned integer");
 
-// INTEGER_DOUBLE_DIGIT_T should be at least 2 times the size of INTEGER_DIGIT_T
-static_assert((2 * sizeof(INTEGER_DIGIT_T)) <= sizeof(INTEGER_DOUBLE_DIGIT_T)
-              , "INTEGER_DOUBLE_DIGIT_T should be at least twice the size of INTEGER_DIGIT_T");
+// Operands with at least this many limbs (on both sides) are multiplied with Karatsuba,
+// smaller ones with schoolbook multiplication.
+#ifndef INTEGER_KARATSUBA_THRESHOLD
+#define INTEGER_KARATSUBA_THRESHOLD 24
+#endif
 
 class integer{
     public:
-        typedef std::deque <INTEGER_DIGIT_T> REP;                                                 // internal representation of values
-        typedef REP::size_type               REP_SIZE_T;                                          // size type of internal representation
+        typedef std::vector <INTEGER_DIGIT_T> REP;                                                // internal representation of values (least significant limb first)
+        typedef REP::size_type                REP_SIZE_T;                                         // size type of internal representation
 
     private:
         static constexpr INTEGER_DIGIT_T NEG1     = std::numeric_limits <INTEGER_DIGIT_T>::max(); // value with all bits ON - will only work for unsigned integer types
         static constexpr std::size_t     OCTETS   = sizeof(INTEGER_DIGIT_T);                      // number of octets per INTEGER_DIGIT_T
-        static constexpr std::size_t     BITS     = OCTETS << 3;                                  // number of bits per INTEGER_DIGIT_T; hardcode this if INTEGER_DIGIT_T is not standard int type
-        static constexpr INTEGER_DIGIT_T HIGH_BIT = 1 << (BITS - 1);                              // highest bit of INTEGER_DIGIT_T (uint8_t -> 128)
+        static constexpr std::size_t     BITS     = OCTETS << 3;                                  // number of bits per INTEGER_DIGIT_T
+        static constexpr INTEGER_DIGIT_T HIGH_BIT = static_cast <INTEGER_DIGIT_T> (1) << (BITS - 1); // highest bit of INTEGER_DIGIT_T
 
     public:
         typedef bool Sign;
@@ -82,7 +75,7 @@ class integer{
 
     private:
         bool _sign;     // sign of value
-        REP _value;     // absolute value of *this
+        REP _value;     // absolute value of *this, least significant limb first
 
         template <typename Z>
         integer & setFromZ(Z val){
@@ -90,25 +83,28 @@ class integer{
                           !std::is_const     <Z>::value &&
                           !std::is_reference <Z>::value
                           , "Input to integer::setFromZ should be passed by value");
+            typedef typename std::conditional <std::is_same <Z, bool>::value,
+                                               std::common_type <uint8_t>,
+                                               std::make_unsigned <Z> >::type::type UZ;
+
             _value.clear();
             _sign = POSITIVE;
 
-            // make positive
+            // make positive (done in the unsigned type so that the minimum value does not overflow)
+            UZ mag = static_cast <UZ> (val);
             if (std::is_signed <Z>::value && (val < 0)){
                 _sign = NEGATIVE;
-                val = -val; // treat as positive even if top bit is still set
+                mag = static_cast <UZ> (0) - mag;
             }
 
-            // keep this here just in case value is sign extended
-            for(std::size_t d = std::max(sizeof(Z) / OCTETS, (std::size_t) 1); d > 0; d--){
-                _value.push_front(val & NEG1);
-                val >>= BITS;
+            if (mag){
+                _value.push_back(static_cast <INTEGER_DIGIT_T> (mag));
             }
 
             return trim();
         }
 
-        // remove 0 digits from top of deque to save memory
+        // remove 0 limbs from the top of the representation
         integer & trim();
 
     public:
@@ -372,41 +368,21 @@ class integer{
         }
 
     private:
-        // // Peasant Multiplication
-        // integer peasant(const integer & lhs, const integer & rhs) const;
-
-        // // Recurseive Peasant Algorithm
-        // integer recursive_peasant(const integer & lhs, const integer & rhs) const;
-
-        // // Recursive Multiplication
-        // integer recursive_mult(const integer & lhs, const integer & rhs) const;
-
-        // // Karatsuba Algorithm O(n-log2(3) = n - 1.585)
-        // // The Peasant Multiplication function is needed if Karatsuba is used.
-        // // Thanks to kjo @ stackoverflow for fixing up my original Karatsuba Algorithm implementation
-        // // which I then converted to C++ and made a few changes.
-        // // http://stackoverflow.com/questions/7058838/karatsuba-algorithm-too-much-recursion
-        // integer karatsuba(const integer & lhs, const integer & rhs, integer bm = 0x1000000U) const;
-
-        // // // Toom-Cook multiplication
-        // // // as described at http://en.wikipedia.org/wiki/Toom%E2%80%93Cook_multiplications
-        // // // The peasant function is needed if karatsuba is used.
-        // // // This implementation is a bit weird. In the pointwise Multiplcation step, using
-        // // // operator* and long_mult works, but everything else fails.
-        // // // It's also kind of slow.
-        // // integer toom_cook_3(integer m, integer n, integer bm = 0x1000000U);
-
-        // // Long multiplication
-        // integer long_mult(const integer & lhs, const integer & rhs) const;
-
-        //Private FFT helper function
-        int fft(std::deque<double>& data, bool dir = true) const;
-
-        // FFT-based multiplication
-        //Based on the convolution theorem which states that the Fourier
-        //transform of a convolution is the pointwise product of their
-        //Fourier transforms.
-        integer fft_mult(const integer& lhs, const integer& rhs) const;
+        // Schoolbook multiplication of raw limb arrays
+        // out must have room for an + bn limbs and must not overlap the inputs
+        static void schoolbook_mult(const INTEGER_DIGIT_T * a, REP_SIZE_T an,
+                                    const INTEGER_DIGIT_T * b, REP_SIZE_T bn,
+                                    INTEGER_DIGIT_T * out);
+
+        // Karatsuba multiplication of two n-limb arrays, O(n^log2(3))
+        // out must have room for 2 * n limbs and must not overlap the inputs
+        static void karatsuba_mult(const INTEGER_DIGIT_T * a, const INTEGER_DIGIT_T * b, REP_SIZE_T n,
+                                   INTEGER_DIGIT_T * out);
+
+        // Multiplication of raw limb arrays, picks schoolbook or Karatsuba
+        static void mult(const INTEGER_DIGIT_T * a, REP_SIZE_T an,
+                         const INTEGER_DIGIT_T * b, REP_SIZE_T bn,
+                         INTEGER_DIGIT_T * out);
 
     public:
         integer operator*(const integer & rhs) const;
@@ -426,18 +402,11 @@ class integer{
         }
 
     private:
-        // // Naive Division: keep subtracting until lhs == 0
-        // std::pair <integer, integer> naive_divmod(const integer & lhs, const integer & rhs) const;
-
-        // // Long Division returning both quotient and remainder
-        // std::pair <integer, integer> long_divmod(const integer & lhs, const integer & rhs) const;
-
-        // // Recursive Division that returns both the quotient and remainder
-        // // Recursion took up way too much memory
-        // std::pair <integer, integer> recursive_divmod(const integer & lhs, const integer & rhs) const;
+        // Division of the magnitude by a single limb, returns the remainder
+        static INTEGER_DIGIT_T divmod_limb(REP & value, INTEGER_DIGIT_T d);
 
-        // Non-Recursive version of above algorithm
-        std::pair <integer, integer> non_recursive_divmod(const integer & lhs, const integer & rhs) const;
+        // Knuth's Algorithm D (TAOCP vol. 2, 4.3.1) on the magnitudes, rhs must have at least 2 limbs
+        std::pair <integer, integer> long_divmod(const integer & lhs, const integer & rhs) const;
 
         // division and modulus ignoring signs
         std::pair <integer, integer> dm(const integer & lhs, const integer & rhs) const;
@@ -501,10 +470,10 @@ class integer{
         // get minimum number of bytes needed to hold this value
         REP_SIZE_T bytes() const;
 
-        // get number of digits of internal representation
+        // get number of limbs of internal representation
         REP_SIZE_T digits() const;
 
-        // get internal data
+        // get internal data (least significant limb first)
         REP data() const;
 
         // Miscellaneous Functions
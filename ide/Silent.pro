@@ -42,6 +42,37 @@ HEADERS += \
     ../ext/integer/integer.h \
     ../src/Controller/controller.h \
     ../src/Model/AudioService/audioservice.h \
+    ../src/Model/AudioService/Backend/alsaaudiobackend.h \
+    ../src/Model/AudioService/Backend/audiobackend.h \
+    ../src/Model/AudioService/Backend/nullaudiobackend.h \
+    ../src/Model/AudioService/Backend/resamplingaudiostream.h \
+    ../src/Model/AudioService/Backend/switchableaudiostream.h \
+    ../src/Model/AudioService/Backend/wavfileaudiobackend.h \
+    ../src/Model/AudioService/Backend/winmmaudiobackend.h \
+    ../src/Model/AudioService/DSP/audiogain.h \
+    ../src/Model/AudioService/DSP/audiomix.h \
+    ../src/Model/AudioService/DSP/automaticgaincontrol.h \
+    ../src/Model/AudioService/DSP/cpufeatures.h \
+    ../src/Model/AudioService/DSP/driftcompensator.h \
+    ../src/Model/AudioService/DSP/fft.h \
+    ../src/Model/AudioService/DSP/levelmeter.h \
+    ../src/Model/AudioService/DSP/noisesuppressor.h \
+    ../src/Model/AudioService/DSP/resampler.h \
+    ../src/Model/AudioService/DSP/voiceactivitydetector.h \
+    ../src/Model/AudioService/FramePool/audioframepool.h \
+    ../src/Model/AudioService/Latency/voicelatency.h \
+    ../src/Model/AudioService/Mixer/audiomixer.h \
+    ../src/Model/AudioService/Mixer/framering.h \
+    ../src/Model/AudioService/Recorder/sessionrecorder.h \
+    ../src/Model/AudioService/Sender/voicesender.h \
+    ../src/Model/AudioService/Sounds/notificationsounds.h \
+    ../src/Model/Crypto/dhgroup.h \
+    ../src/Model/Crypto/keyschedule.h \
+    ../src/Model/Crypto/sha256.h \
+    ../src/Model/InputSource/inputsource.h \
+    ../src/Model/InputSource/scriptedinputsource.h \
+    ../src/Model/InputSource/windowshookinputsource.h \
+    ../src/Model/NetworkService/handshakemessages.h \
     ../src/Model/NetworkService/networkservice.h \
     ../src/Model/OutputTextType.h \
     ../src/Model/SettingsManager/SettingsFile.h \
@@ -70,6 +101,34 @@ SOURCES += \
     ../ext/integer/integer.cpp \
     ../src/Controller/controller.cpp \
     ../src/Model/AudioService/audioservice.cpp \
+    ../src/Model/AudioService/Backend/audiobackend.cpp \
+    ../src/Model/AudioService/Backend/nullaudiobackend.cpp \
+    ../src/Model/AudioService/Backend/resamplingaudiostream.cpp \
+    ../src/Model/AudioService/Backend/switchableaudiostream.cpp \
+    ../src/Model/AudioService/Backend/wavfileaudiobackend.cpp \
+    ../src/Model/AudioService/DSP/audiogain.cpp \
+    ../src/Model/AudioService/DSP/audiomix.cpp \
+    ../src/Model/AudioService/DSP/automaticgaincontrol.cpp \
+    ../src/Model/AudioService/DSP/cpufeatures.cpp \
+    ../src/Model/AudioService/DSP/driftcompensator.cpp \
+    ../src/Model/AudioService/DSP/fft.cpp \
+    ../src/Model/AudioService/DSP/levelmeter.cpp \
+    ../src/Model/AudioService/DSP/noisesuppressor.cpp \
+    ../src/Model/AudioService/DSP/resampler.cpp \
+    ../src/Model/AudioService/DSP/voiceactivitydetector.cpp \
+    ../src/Model/AudioService/FramePool/audioframepool.cpp \
+    ../src/Model/AudioService/Latency/voicelatency.cpp \
+    ../src/Model/AudioService/Mixer/audiomixer.cpp \
+    ../src/Model/AudioService/Mixer/framering.cpp \
+    ../src/Model/AudioService/Recorder/sessionrecorder.cpp \
+    ../src/Model/AudioService/Sender/voicesender.cpp \
+    ../src/Model/AudioService/Sounds/notificationsounds.cpp \
+    ../src/Model/Crypto/dhgroup.cpp \
+    ../src/Model/Crypto/keyschedule.cpp \
+    ../src/Model/Crypto/sha256.cpp \
+    ../src/Model/InputSource/inputsource.cpp \
+    ../src/Model/InputSource/scriptedinputsource.cpp \
+    ../src/Model/NetworkService/handshakemessages.cpp \
     ../src/Model/NetworkService/networkservice.cpp \
     ../src/Model/SettingsManager/settingsmanager.cpp \
     ../src/View/AboutQtWindow/aboutqtwindow.cpp \
@@ -89,6 +148,16 @@ SOURCES += \
     ../src/main.cpp \
     ../src/View/SettingsWindow/settingswindow.cpp \
 
+win32: SOURCES += ../src/Model/AudioService/Backend/winmmaudiobackend.cpp \
+                  ../src/Model/InputSource/windowshookinputsource.cpp
+
+# Linux sound devices (libasound).
+unix:!macx {
+    SOURCES += ../src/Model/AudioService/Backend/alsaaudiobackend.cpp
+    DEFINES += SILENT_USE_ALSA
+    LIBS    += -lasound
+}
+
 RC_ICONS = ../res/icons/appMainIcon.ico
 
 RESOURCES += ../res/qt_rec_file.qrc
@@ -0,0 +1,93 @@
+#-------------------------------------------------
+#
+# Console microbenchmarks for the parts of the Silent
+# that run on hot paths (bignum, crypto, audio DSP, input).
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = SilentBench
+TEMPLATE = app
+
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+HEADERS += \
+    ../bench/bench.h \
+    ../ext/AES/AES.h \
+    ../ext/integer/integer.h \
+    ../src/Model/AudioService/Backend/audiobackend.h \
+    ../src/Model/AudioService/Backend/nullaudiobackend.h \
+    ../src/Model/AudioService/Backend/resamplingaudiostream.h \
+    ../src/Model/AudioService/Backend/switchableaudiostream.h \
+    ../src/Model/AudioService/Backend/wavfileaudiobackend.h \
+    ../src/Model/AudioService/DSP/audiogain.h \
+    ../src/Model/AudioService/DSP/audiomix.h \
+    ../src/Model/AudioService/DSP/automaticgaincontrol.h \
+    ../src/Model/AudioService/DSP/cpufeatures.h \
+    ../src/Model/AudioService/DSP/driftcompensator.h \
+    ../src/Model/AudioService/DSP/fft.h \
+    ../src/Model/AudioService/DSP/levelmeter.h \
+    ../src/Model/AudioService/DSP/noisesuppressor.h \
+    ../src/Model/AudioService/DSP/resampler.h \
+    ../src/Model/AudioService/DSP/voiceactivitydetector.h \
+    ../src/Model/AudioService/FramePool/audioframepool.h \
+    ../src/Model/AudioService/Latency/voicelatency.h \
+    ../src/Model/AudioService/Mixer/audiomixer.h \
+    ../src/Model/AudioService/Mixer/framering.h \
+    ../src/Model/AudioService/Recorder/sessionrecorder.h \
+    ../src/Model/AudioService/Sounds/notificationsounds.h \
+    ../src/Model/Crypto/dhgroup.h \
+    ../src/Model/Crypto/sha256.h \
+    ../src/Model/InputSource/inputsource.h \
+    ../src/Model/InputSource/scriptedinputsource.h \
+    ../src/Model/InputSource/windowshookinputsource.h \
+    ../src/Model/NetworkService/handshakemessages.h \
+    ../src/Model/net_params.h
+
+SOURCES += \
+    ../bench/bench.cpp \
+    ../bench/bench_aes.cpp \
+    ../bench/bench_alloc.cpp \
+    ../bench/bench_audio.cpp \
+    ../bench/bench_connect.cpp \
+    ../bench/bench_dsp.cpp \
+    ../bench/bench_handshake.cpp \
+    ../bench/bench_input.cpp \
+    ../bench/bench_integer.cpp \
+    ../bench/bench_latency.cpp \
+    ../bench/main.cpp \
+    ../ext/AES/AES.cpp \
+    ../ext/integer/integer.cpp \
+    ../src/Model/AudioService/Backend/audiobackend.cpp \
+    ../src/Model/AudioService/Backend/nullaudiobackend.cpp \
+    ../src/Model/AudioService/Backend/resamplingaudiostream.cpp \
+    ../src/Model/AudioService/Backend/switchableaudiostream.cpp \
+    ../src/Model/AudioService/Backend/wavfileaudiobackend.cpp \
+    ../src/Model/AudioService/DSP/audiogain.cpp \
+    ../src/Model/AudioService/DSP/audiomix.cpp \
+    ../src/Model/AudioService/DSP/automaticgaincontrol.cpp \
+    ../src/Model/AudioService/DSP/cpufeatures.cpp \
+    ../src/Model/AudioService/DSP/driftcompensator.cpp \
+    ../src/Model/AudioService/DSP/fft.cpp \
+    ../src/Model/AudioService/DSP/levelmeter.cpp \
+    ../src/Model/AudioService/DSP/noisesuppressor.cpp \
+    ../src/Model/AudioService/DSP/resampler.cpp \
+    ../src/Model/AudioService/DSP/voiceactivitydetector.cpp \
+    ../src/Model/AudioService/FramePool/audioframepool.cpp \
+    ../src/Model/AudioService/Latency/voicelatency.cpp \
+    ../src/Model/AudioService/Mixer/audiomixer.cpp \
+    ../src/Model/AudioService/Mixer/framering.cpp \
+    ../src/Model/AudioService/Recorder/sessionrecorder.cpp \
+    ../src/Model/AudioService/Sounds/notificationsounds.cpp \
+    ../src/Model/Crypto/dhgroup.cpp \
+    ../src/Model/Crypto/sha256.cpp \
+    ../src/Model/InputSource/inputsource.cpp \
+    ../src/Model/InputSource/scriptedinputsource.cpp \
+    ../src/Model/NetworkService/handshakemessages.cpp
+
+win32: SOURCES += ../src/Model/InputSource/windowshookinputsource.cpp
+
+INCLUDEPATH += "../src"
+INCLUDEPATH += "../ext"
@@ -175,6 +175,14 @@ void Controller::applyNewMasterVolumeFromSettings()
     }
 }
 
+void Controller::applyInputDeviceFromSettings()
+{
+    if (pAudioService)
+    {
+        pAudioService->setInputDevice( pSettingsManager->getCurrentSettings()->sInputDeviceName );
+    }
+}
+
 void Controller::applyAudioInputVolume(int iVolume)
 {
     if (pAudioService)
@@ -52,6 +52,7 @@ public:
     // Settings
 
         void           applyNewMasterVolumeFromSettings       ();
+        void           applyInputDeviceFromSettings           ();
         void           applyAudioInputVolume      (int iVolume);
         void           applyVoiceStartValue       (int iValue);
         void           applyShouldHearTestVoice   (bool bHear);
@@ -0,0 +1,368 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "alsaaudiobackend.h"
+
+
+#ifdef SILENT_USE_ALSA
+
+
+// STL
+#include <cstring>
+
+// External
+#include <alsa/asoundlib.h>
+
+
+namespace
+{
+    std::string getAlsaErrorText(const std::string& sFunctionName, int iResult)
+    {
+        return sFunctionName + "() error (" + std::to_string(iResult) + "): " + std::string(snd_strerror(iResult)) + ".";
+    }
+
+    // ALSA names are ASCII.
+
+    std::string toNarrow(const std::wstring& sText)
+    {
+        std::string sNarrow;
+
+        for (size_t i = 0; i < sText.size(); i++)
+        {
+            sNarrow += static_cast<char>(sText[i]);
+        }
+
+        return sNarrow;
+    }
+
+    // Device buffer of iBufferCount packets.
+
+    int openPcm(snd_pcm_t** ppPcm, const std::string& sDeviceName, snd_pcm_stream_t stream, const AudioFormat& format,
+                int iBufferCount, std::string& sErrorText)
+    {
+        int iResult = snd_pcm_open(ppPcm, sDeviceName.c_str(), stream, 0);
+
+        if (iResult < 0)
+        {
+            sErrorText = getAlsaErrorText("snd_pcm_open", iResult);
+            return iResult;
+        }
+
+        const unsigned int iLatencyInUs = static_cast<unsigned int>(1000000.0 * format.iSamplesPerPacket * iBufferCount / format.iSampleRate);
+
+        iResult = snd_pcm_set_params(*ppPcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, 1, format.iSampleRate,
+                                     1, iLatencyInUs);
+
+        if (iResult < 0)
+        {
+            sErrorText = getAlsaErrorText("snd_pcm_set_params", iResult);
+
+            snd_pcm_close(*ppPcm);
+            *ppPcm = nullptr;
+        }
+
+        return iResult;
+    }
+
+
+    // ---------------------------------------
+
+
+    class AlsaCaptureStream : public AudioCaptureStream
+    {
+    public:
+
+        AlsaCaptureStream(snd_pcm_t* pPcm, const AudioFormat& format)
+        {
+            this->pPcm        = pPcm;
+            iSamplesPerPacket = format.iSamplesPerPacket;
+            iSampleRate       = format.iSampleRate;
+            iBufferCount      = format.iCaptureBufferCount;
+        }
+
+        bool start() override
+        {
+            int iResult = snd_pcm_prepare(pPcm);
+
+            if (iResult >= 0)
+            {
+                iResult = snd_pcm_start(pPcm);
+            }
+
+            if (iResult < 0)
+            {
+                sLastError = getAlsaErrorText("snd_pcm_start", iResult);
+                return true;
+            }
+
+            return false;
+        }
+
+        bool read(short* pSamples) override
+        {
+            // snd_pcm_readi() sleeps until the driver has a period for us (no polling).
+
+            snd_pcm_uframes_t iReadFrames = 0;
+
+            while (iReadFrames < static_cast<snd_pcm_uframes_t>(iSamplesPerPacket))
+            {
+                snd_pcm_sframes_t iResult = snd_pcm_readi(pPcm, pSamples + iReadFrames, static_cast<snd_pcm_uframes_t>(iSamplesPerPacket) - iReadFrames);
+
+                stats.iWakeupCount++;
+
+                if (iResult < 0)
+                {
+                    // Overrun: we were too slow, continue from the current position.
+
+                    iResult = snd_pcm_recover(pPcm, static_cast<int>(iResult), 1);
+
+                    if (iResult < 0)
+                    {
+                        sLastError = getAlsaErrorText("snd_pcm_readi", static_cast<int>(iResult));
+                        return true;
+                    }
+
+                    continue;
+                }
+
+                iReadFrames += static_cast<snd_pcm_uframes_t>(iResult);
+            }
+
+
+            // Everything recorded after our packet was waiting for us.
+
+            snd_pcm_sframes_t iAvailableFrames = snd_pcm_avail_update(pPcm);
+
+            stats.addPacket( iAvailableFrames > 0 ? 1000.0 * iAvailableFrames / iSampleRate : 0.0 );
+
+            return false;
+        }
+
+        void stop() override
+        {
+            snd_pcm_drop(pPcm);
+        }
+
+        int getBufferCount() const override
+        {
+            return iBufferCount;
+        }
+
+        AudioCaptureStats getStats() const override
+        {
+            return stats;
+        }
+
+        std::string getLastError() const override
+        {
+            return sLastError;
+        }
+
+        ~AlsaCaptureStream() override
+        {
+            snd_pcm_close(pPcm);
+        }
+
+    private:
+
+        snd_pcm_t*        pPcm;
+
+        AudioCaptureStats stats;
+
+        std::string       sLastError;
+
+        unsigned int      iSampleRate;
+        int               iSamplesPerPacket;
+        int               iBufferCount;
+    };
+
+
+    // ALSA has no per-stream volume (only the mixer of the card), so we scale the samples.
+
+    class AlsaPlaybackStream : public AudioPlaybackStream
+    {
+    public:
+
+        AlsaPlaybackStream(snd_pcm_t* pPcm, const AudioFormat& format)
+        {
+            this->pPcm        = pPcm;
+            iSamplesPerPacket = format.iSamplesPerPacket;
+            fVolume           = 1.0f;
+
+            vScaledPacket.resize( static_cast<size_t>(iSamplesPerPacket) );
+        }
+
+        bool write(const short* pSamples) override
+        {
+            for (int i = 0; i < iSamplesPerPacket; i++)
+            {
+                vScaledPacket[i] = static_cast<short>(pSamples[i] * fVolume);
+            }
+
+
+            snd_pcm_uframes_t iWrittenFrames = 0;
+
+            while (iWrittenFrames < static_cast<snd_pcm_uframes_t>(iSamplesPerPacket))
+            {
+                snd_pcm_sframes_t iResult = snd_pcm_writei(pPcm, vScaledPacket.data() + iWrittenFrames,
+                                                           static_cast<snd_pcm_uframes_t>(iSamplesPerPacket) - iWrittenFrames);
+
+                if (iResult < 0)
+                {
+                    // Underrun: the previous packet came too late.
+
+                    iResult = snd_pcm_recover(pPcm, static_cast<int>(iResult), 1);
+
+                    if (iResult < 0)
+                    {
+                        sLastError = getAlsaErrorText("snd_pcm_writei", static_cast<int>(iResult));
+                        return true;
+                    }
+
+                    continue;
+                }
+
+                iWrittenFrames += static_cast<snd_pcm_uframes_t>(iResult);
+            }
+
+            return false;
+        }
+
+        size_t getQueuedPacketCount() override
+        {
+            snd_pcm_sframes_t iDelayFrames = 0;
+
+            if ( (snd_pcm_delay(pPcm, &iDelayFrames) < 0) || (iDelayFrames <= 0) )
+            {
+                return 0;
+            }
+
+            return static_cast<size_t>( (iDelayFrames + iSamplesPerPacket - 1) / iSamplesPerPacket );
+        }
+
+        void drain() override
+        {
+            snd_pcm_drain(pPcm);
+            snd_pcm_prepare(pPcm);
+        }
+
+        void reset() override
+        {
+            snd_pcm_drop(pPcm);
+            snd_pcm_prepare(pPcm);
+        }
+
+        void setVolume(unsigned short iVolume) override
+        {
+            fVolume = static_cast<float>(iVolume) / 0xFFFF;
+        }
+
+        std::string getLastError() const override
+        {
+            return sLastError;
+        }
+
+        ~AlsaPlaybackStream() override
+        {
+            snd_pcm_close(pPcm);
+        }
+
+    private:
+
+        snd_pcm_t*         pPcm;
+
+        std::vector<short> vScaledPacket;
+
+        std::string        sLastError;
+
+        float              fVolume;
+        int                iSamplesPerPacket;
+    };
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+std::string AlsaAudioBackend::getName() const
+{
+    return "ALSA";
+}
+
+std::vector<std::wstring> AlsaAudioBackend::getInputDevices()
+{
+    std::vector<std::wstring> vSupportedDevices;
+
+    void** pHints = nullptr;
+
+    if (snd_device_name_hint(-1, "pcm", &pHints) < 0)
+    {
+        return vSupportedDevices;
+    }
+
+    for (void** pHint = pHints; *pHint != nullptr; pHint++)
+    {
+        char* pName      = snd_device_name_get_hint(*pHint, "NAME");
+        char* pDirection = snd_device_name_get_hint(*pHint, "IOID");
+
+        // No IOID means both directions.
+
+        if ( pName && ((pDirection == nullptr) || (std::strcmp(pDirection, "Input") == 0)) )
+        {
+            std::string sName(pName);
+            vSupportedDevices.push_back( std::wstring(sName.begin(), sName.end()) );
+        }
+
+        free(pName);
+        free(pDirection);
+    }
+
+    snd_device_name_free_hint(pHints);
+
+    return vSupportedDevices;
+}
+
+AudioCaptureStream* AlsaAudioBackend::openCapture(const std::wstring& sDeviceName, const AudioFormat& format, std::string& sErrorText)
+{
+    std::string sPcmName = "default";
+
+    std::vector<std::wstring> vDevices = getInputDevices();
+
+    for (size_t i = 0; i < vDevices.size(); i++)
+    {
+        if (vDevices[i] == sDeviceName)
+        {
+            sPcmName = toNarrow(sDeviceName);
+            break;
+        }
+    }
+
+
+    snd_pcm_t* pPcm = nullptr;
+
+    if ( openPcm(&pPcm, sPcmName, SND_PCM_STREAM_CAPTURE, format, format.iCaptureBufferCount, sErrorText) < 0 )
+    {
+        return nullptr;
+    }
+
+    return new AlsaCaptureStream(pPcm, format);
+}
+
+AudioPlaybackStream* AlsaAudioBackend::openPlayback(const AudioFormat& format, std::string& sErrorText)
+{
+    snd_pcm_t* pPcm = nullptr;
+
+    if ( openPcm(&pPcm, "default", SND_PCM_STREAM_PLAYBACK, format, AUDIO_PLAYBACK_BUFFER_COUNT, sErrorText) < 0 )
+    {
+        return nullptr;
+    }
+
+    return new AlsaPlaybackStream(pPcm, format);
+}
+
+
+#endif // SILENT_USE_ALSA
@@ -0,0 +1,39 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+#ifdef SILENT_USE_ALSA
+
+
+// Custom
+#include "Model/AudioService/Backend/audiobackend.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Linux ALSA (libasound), device names are ALSA PCM names ("default", "hw:0,0", ...).
+
+class AlsaAudioBackend : public AudioBackend
+{
+
+public:
+
+    std::string  getName                 () const override;
+
+    std::vector<std::wstring> getInputDevices () override;
+
+
+    AudioCaptureStream*  openCapture     (const std::wstring& sDeviceName, const AudioFormat& format, std::string& sErrorText) override;
+
+    AudioPlaybackStream* openPlayback    (const AudioFormat& format, std::string& sErrorText) override;
+};
+
+
+#endif // SILENT_USE_ALSA
@@ -0,0 +1,109 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "audiobackend.h"
+
+
+// Custom
+#include "Model/AudioService/Backend/nullaudiobackend.h"
+#include "Model/AudioService/Backend/winmmaudiobackend.h"
+#include "Model/AudioService/Backend/alsaaudiobackend.h"
+#include "Model/AudioService/Backend/resamplingaudiostream.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+AudioBackend* AudioBackend::create(AUDIO_BACKEND_TYPE backendType)
+{
+    switch (backendType)
+    {
+    case(ABT_DEFAULT):
+    {
+#if defined(_WIN32)
+        return new WinMMAudioBackend();
+#elif defined(SILENT_USE_ALSA)
+        return new AlsaAudioBackend();
+#else
+        return new NullAudioBackend();
+#endif
+    }
+    case(ABT_WINMM):
+    {
+#ifdef _WIN32
+        return new WinMMAudioBackend();
+#else
+        return nullptr;
+#endif
+    }
+    case(ABT_ALSA):
+    {
+#ifdef SILENT_USE_ALSA
+        return new AlsaAudioBackend();
+#else
+        return nullptr;
+#endif
+    }
+    case(ABT_NULL):
+    {
+        return new NullAudioBackend();
+    }
+    }
+
+    return nullptr;
+}
+
+AudioCaptureStream* AudioBackend::openResampledCapture(const std::wstring& sDeviceName, const AudioFormat& format, std::string& sErrorText)
+{
+    if ( (format.iDeviceSampleRate == 0) || (format.iDeviceSampleRate == format.iSampleRate) )
+    {
+        return openCapture(sDeviceName, format, sErrorText);
+    }
+
+    const AudioFormat deviceFormat = getDeviceFormat(format);
+
+    AudioCaptureStream* pDeviceStream = openCapture(sDeviceName, deviceFormat, sErrorText);
+
+    if (pDeviceStream == nullptr)
+    {
+        return nullptr;
+    }
+
+    return new ResamplingCaptureStream(pDeviceStream, deviceFormat, format);
+}
+
+AudioPlaybackStream* AudioBackend::openResampledPlayback(const AudioFormat& format, std::string& sErrorText)
+{
+    if ( (format.iDeviceSampleRate == 0) || (format.iDeviceSampleRate == format.iSampleRate) )
+    {
+        return openPlayback(format, sErrorText);
+    }
+
+    const AudioFormat deviceFormat = getDeviceFormat(format);
+
+    AudioPlaybackStream* pDeviceStream = openPlayback(deviceFormat, sErrorText);
+
+    if (pDeviceStream == nullptr)
+    {
+        return nullptr;
+    }
+
+    return new ResamplingPlaybackStream(pDeviceStream, deviceFormat, format);
+}
+
+AudioFormat AudioBackend::getDeviceFormat(const AudioFormat& format) const
+{
+    // Rounded up: when capturing, one device packet always gives at least one wire packet.
+
+    AudioFormat deviceFormat = format;
+
+    deviceFormat.iSampleRate       = format.iDeviceSampleRate;
+    deviceFormat.iSamplesPerPacket = static_cast<int>( (static_cast<unsigned long long>(format.iSamplesPerPacket) * format.iDeviceSampleRate
+                                                        + format.iSampleRate - 1) / format.iSampleRate );
+
+    return deviceFormat;
+}
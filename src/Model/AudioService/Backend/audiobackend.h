@@ -0,0 +1,200 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <string>
+#include <vector>
+
+
+// How often we check if a device buffer is finished (when we can't wait for the device to tell us).
+#define  BUFFER_UPDATE_CHECK_MS      2
+
+// Capture: buffers queued to the device (1 recording + the rest waiting).
+// Fewer buffers - lower latency, more buffers - no dropouts on a busy machine.
+#define  AUDIO_CAPTURE_BUFFER_COUNT      4
+#define  AUDIO_CAPTURE_BUFFER_COUNT_MIN  2
+#define  AUDIO_CAPTURE_BUFFER_COUNT_MAX  8
+
+// Playback: buffers queued to the device (1 playing + 1 waiting).
+#define  AUDIO_PLAYBACK_BUFFER_COUNT 2
+
+// Rate the devices are opened at by default (we convert to/from the wire rate ourselves, see openResampledCapture()).
+#define  AUDIO_DEVICE_SAMPLE_RATE    48000
+
+
+enum AUDIO_BACKEND_TYPE
+{
+    ABT_DEFAULT             = 0,  // WinMM on Windows, ALSA on Linux (if built with SILENT_USE_ALSA), null otherwise
+    ABT_WINMM               = 1,
+    ABT_ALSA                = 2,
+    ABT_NULL                = 3
+};
+
+
+// Mono PCM16.
+struct AudioFormat
+{
+    unsigned int   iSampleRate         = 0;
+    int            iSamplesPerPacket   = 0;
+    int            iCaptureBufferCount = AUDIO_CAPTURE_BUFFER_COUNT;
+
+    // Used by openResampledCapture()/openResampledPlayback() only,
+    // 0 - open the device at iSampleRate (the OS converts if the device can't do it).
+    unsigned int   iDeviceSampleRate   = 0;
+};
+
+
+struct AudioCaptureStats
+{
+    unsigned long long iPacketCount    = 0;
+    unsigned long long iWakeupCount    = 0;    // how many times read() woke up to check for a packet
+    double             dTotalLatencyMs = 0.0;  // from the moment the device finished a packet until read() returned it
+    double             dMaxLatencyMs   = 0.0;
+
+
+    void   addPacket            (double dLatencyMs)
+    {
+        iPacketCount++;
+        dTotalLatencyMs += dLatencyMs;
+
+        if (dLatencyMs > dMaxLatencyMs)
+        {
+            dMaxLatencyMs = dLatencyMs;
+        }
+    }
+
+    double getAverageLatencyMs  () const
+    {
+        return iPacketCount ? dTotalLatencyMs / static_cast<double>(iPacketCount) : 0.0;
+    }
+
+    double getWakeupsPerPacket  () const
+    {
+        return iPacketCount ? static_cast<double>(iWakeupCount) / static_cast<double>(iPacketCount) : 0.0;
+    }
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Recording from an input device, one packet (AudioFormat::iSamplesPerPacket samples) at a time.
+// Functions that return bool return true if failed, see getLastError().
+
+class AudioCaptureStream
+{
+
+public:
+
+    virtual ~AudioCaptureStream() = default;
+
+
+    // Queues all buffers to the device and starts recording.
+
+    virtual bool        start           () = 0;
+
+    // Waits until the oldest buffer is recorded, copies it to pSamples and queues the buffer again.
+
+    virtual bool        read            (short* pSamples) = 0;
+
+    // Stops recording and drops everything that was not read.
+
+    virtual void        stop            () = 0;
+
+
+    // Number of packets that are already queued to the device when read() returns.
+
+    virtual int         getBufferCount  () const = 0;
+
+    // Collected since the stream was opened (from the thread that calls read()).
+
+    virtual AudioCaptureStats getStats  () const = 0;
+
+    virtual std::string getLastError    () const = 0;
+};
+
+
+// Playing to an output device, one packet at a time.
+// Functions that return bool return true if failed, see getLastError().
+
+class AudioPlaybackStream
+{
+
+public:
+
+    virtual ~AudioPlaybackStream() = default;
+
+
+    // Copies the packet and queues it, waits if all device buffers are busy.
+
+    virtual bool        write                (const short* pSamples) = 0;
+
+    // Written packets that are not played yet.
+
+    virtual size_t      getQueuedPacketCount () = 0;
+
+    // Waits until everything is played.
+
+    virtual void        drain                () = 0;
+
+    // Drops everything that is not played yet.
+
+    virtual void        reset                () = 0;
+
+
+    // 0 - 0xFFFF (same as SettingsFile::iMasterVolume).
+
+    virtual void        setVolume            (unsigned short iVolume) = 0;
+
+    virtual std::string getLastError         () const = 0;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+class AudioBackend
+{
+
+public:
+
+    // Returns nullptr if this backend is not available in this build.
+
+    static AudioBackend* create                  (AUDIO_BACKEND_TYPE backendType = ABT_DEFAULT);
+
+
+    virtual ~AudioBackend() = default;
+
+
+    virtual std::string  getName                 () const = 0;
+
+    virtual std::vector<std::wstring> getInputDevices () = 0;
+
+
+    // Uses the default device if sDeviceName is empty or not found.
+    // Return nullptr if failed (the reason is in sErrorText).
+
+    virtual AudioCaptureStream*  openCapture     (const std::wstring& sDeviceName, const AudioFormat& format, std::string& sErrorText) = 0;
+
+    virtual AudioPlaybackStream* openPlayback    (const AudioFormat& format, std::string& sErrorText) = 0;
+
+
+    // Same as openCapture()/openPlayback() but the device is opened at format.iDeviceSampleRate
+    // and the packets are converted to/from format.iSampleRate by us (Resampler).
+    // The device packets have the same duration (rounded up).
+
+    AudioCaptureStream*  openResampledCapture    (const std::wstring& sDeviceName, const AudioFormat& format, std::string& sErrorText);
+
+    AudioPlaybackStream* openResampledPlayback   (const AudioFormat& format, std::string& sErrorText);
+
+private:
+
+    AudioFormat          getDeviceFormat         (const AudioFormat& format) const;
+};
@@ -0,0 +1,210 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "nullaudiobackend.h"
+
+
+// STL
+#include <thread>
+#include <cstring>
+
+
+namespace
+{
+    class NullCaptureStream : public AudioCaptureStream
+    {
+    public:
+
+        NullCaptureStream(const AudioFormat& format, bool bRealTime) : packetClock(format, bRealTime)
+        {
+            iSamplesPerPacket = format.iSamplesPerPacket;
+            iBufferCount      = format.iCaptureBufferCount;
+        }
+
+        bool start() override
+        {
+            packetClock.start();
+
+            return false;
+        }
+
+        bool read(short* pSamples) override
+        {
+            packetClock.waitForNextPacket(stats);
+
+            std::memset(pSamples, 0, static_cast<size_t>(iSamplesPerPacket) * sizeof(short));
+
+            return false;
+        }
+
+        void stop() override
+        {
+        }
+
+        int getBufferCount() const override
+        {
+            return iBufferCount;
+        }
+
+        AudioCaptureStats getStats() const override
+        {
+            return stats;
+        }
+
+        std::string getLastError() const override
+        {
+            return "";
+        }
+
+    private:
+
+        AudioPacketClock  packetClock;
+
+        AudioCaptureStats stats;
+
+        int               iSamplesPerPacket;
+        int               iBufferCount;
+    };
+
+
+    class NullPlaybackStream : public AudioPlaybackStream
+    {
+    public:
+
+        NullPlaybackStream(const AudioFormat& format, bool bRealTime)
+        {
+            this->bRealTime = bRealTime;
+
+            packetDuration = std::chrono::nanoseconds( static_cast<long long>(1000000000.0 * format.iSamplesPerPacket / format.iSampleRate) );
+            playEndTime    = std::chrono::steady_clock::now();
+        }
+
+        bool write(const short*) override
+        {
+            if (bRealTime == false)
+            {
+                return false;
+            }
+
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+            if (playEndTime < now)
+            {
+                // Ran out of packets (the device plays silence).
+                playEndTime = now;
+            }
+
+            // Wait for a free buffer.
+            std::this_thread::sleep_until(playEndTime - packetDuration * (AUDIO_PLAYBACK_BUFFER_COUNT - 1));
+
+            playEndTime += packetDuration;
+
+            return false;
+        }
+
+        size_t getQueuedPacketCount() override
+        {
+            const std::chrono::nanoseconds queuedTime = playEndTime - std::chrono::steady_clock::now();
+
+            if (queuedTime.count() <= 0)
+            {
+                return 0;
+            }
+
+            return static_cast<size_t>( (queuedTime.count() + packetDuration.count() - 1) / packetDuration.count() );
+        }
+
+        void drain() override
+        {
+            if (bRealTime)
+            {
+                std::this_thread::sleep_until(playEndTime);
+            }
+        }
+
+        void reset() override
+        {
+            playEndTime = std::chrono::steady_clock::now();
+        }
+
+        void        setVolume            (unsigned short) override {}
+        std::string getLastError         () const override       { return ""; }
+
+    private:
+
+        std::chrono::steady_clock::time_point playEndTime;  // of everything that was written
+        std::chrono::nanoseconds              packetDuration;
+
+        bool                                  bRealTime;
+    };
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+NullAudioBackend::NullAudioBackend(bool bRealTime)
+{
+    this->bRealTime = bRealTime;
+}
+
+std::string NullAudioBackend::getName() const
+{
+    return "Null";
+}
+
+std::vector<std::wstring> NullAudioBackend::getInputDevices()
+{
+    return { L"Null" };
+}
+
+AudioCaptureStream* NullAudioBackend::openCapture(const std::wstring& sDeviceName, const AudioFormat& format, std::string& sErrorText)
+{
+    (void)sDeviceName;
+    (void)sErrorText;
+
+    return new NullCaptureStream(format, bRealTime);
+}
+
+AudioPlaybackStream* NullAudioBackend::openPlayback(const AudioFormat& format, std::string& sErrorText)
+{
+    (void)sErrorText;
+
+    return new NullPlaybackStream(format, bRealTime);
+}
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+AudioPacketClock::AudioPacketClock(const AudioFormat& format, bool bRealTime)
+{
+    this->bRealTime = bRealTime;
+
+    packetDuration = std::chrono::nanoseconds( static_cast<long long>(1000000000.0 * format.iSamplesPerPacket / format.iSampleRate) );
+}
+
+void AudioPacketClock::start()
+{
+    nextPacketTime = std::chrono::steady_clock::now() + packetDuration;
+}
+
+void AudioPacketClock::waitForNextPacket(AudioCaptureStats& stats)
+{
+    if (bRealTime == false)
+    {
+        stats.addPacket(0.0);
+        return;
+    }
+
+    std::this_thread::sleep_until(nextPacketTime);
+
+    stats.iWakeupCount++;
+    stats.addPacket( std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - nextPacketTime).count() );
+
+    nextPacketTime += packetDuration;
+}
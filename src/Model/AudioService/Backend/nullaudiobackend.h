@@ -0,0 +1,75 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <chrono>
+
+// Custom
+#include "Model/AudioService/Backend/audiobackend.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Records silence and throws away everything that is played.
+
+class NullAudioBackend : public AudioBackend
+{
+
+public:
+
+    // bRealTime: read() returns packets and write() takes them at the speed of a real device
+    // (AUDIO_PLAYBACK_BUFFER_COUNT buffers), otherwise as fast as they are asked for (for benchmarks).
+
+    NullAudioBackend(bool bRealTime = true);
+
+
+    std::string  getName                 () const override;
+
+    std::vector<std::wstring> getInputDevices () override;
+
+
+    AudioCaptureStream*  openCapture     (const std::wstring& sDeviceName, const AudioFormat& format, std::string& sErrorText) override;
+
+    AudioPlaybackStream* openPlayback    (const AudioFormat& format, std::string& sErrorText) override;
+
+private:
+
+    bool         bRealTime;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+// Waits in read() until the packet would be recorded by a real device.
+// Used by the null and the WAV file backends.
+// Latency is how late we woke up after the packet was "recorded".
+
+class AudioPacketClock
+{
+
+public:
+
+    AudioPacketClock(const AudioFormat& format, bool bRealTime);
+
+
+    void         start                   ();
+
+    void         waitForNextPacket       (AudioCaptureStats& stats);
+
+private:
+
+    std::chrono::steady_clock::time_point nextPacketTime;
+    std::chrono::nanoseconds              packetDuration;
+
+
+    bool         bRealTime;
+};
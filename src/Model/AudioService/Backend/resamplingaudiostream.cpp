@@ -0,0 +1,154 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "resamplingaudiostream.h"
+
+
+// STL
+#include <algorithm>
+
+
+ResamplingCaptureStream::ResamplingCaptureStream(AudioCaptureStream* pDeviceStream, const AudioFormat& deviceFormat, const AudioFormat& format)
+    : resampler(deviceFormat.iSampleRate, format.iSampleRate)
+{
+    this->pDeviceStream = pDeviceStream;
+
+    iSamplesPerPacket = format.iSamplesPerPacket;
+
+    vDevicePacket.resize( static_cast<size_t>(deviceFormat.iSamplesPerPacket) );
+    vConverted   .resize( resampler.getMaxOutputCount(vDevicePacket.size()) );
+    vReady       .reserve( static_cast<size_t>(iSamplesPerPacket) + vConverted.size() );
+}
+
+ResamplingCaptureStream::~ResamplingCaptureStream()
+{
+    delete pDeviceStream;
+}
+
+bool ResamplingCaptureStream::start()
+{
+    resampler.reset();
+    vReady.clear();
+
+    return pDeviceStream->start();
+}
+
+bool ResamplingCaptureStream::read(short* pSamples)
+{
+    while (vReady.size() < static_cast<size_t>(iSamplesPerPacket))
+    {
+        if ( pDeviceStream->read(vDevicePacket.data()) )
+        {
+            return true;
+        }
+
+        const size_t iConverted = resampler.process(vDevicePacket.data(), vDevicePacket.size(), vConverted.data());
+
+        vReady.insert(vReady.end(), vConverted.begin(), vConverted.begin() + static_cast<std::ptrdiff_t>(iConverted));
+    }
+
+    std::copy(vReady.begin(), vReady.begin() + iSamplesPerPacket, pSamples);
+
+    vReady.erase(vReady.begin(), vReady.begin() + iSamplesPerPacket);
+
+    return false;
+}
+
+void ResamplingCaptureStream::stop()
+{
+    pDeviceStream->stop();
+}
+
+int ResamplingCaptureStream::getBufferCount() const
+{
+    return pDeviceStream->getBufferCount();
+}
+
+AudioCaptureStats ResamplingCaptureStream::getStats() const
+{
+    return pDeviceStream->getStats();
+}
+
+std::string ResamplingCaptureStream::getLastError() const
+{
+    return pDeviceStream->getLastError();
+}
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+ResamplingPlaybackStream::ResamplingPlaybackStream(AudioPlaybackStream* pDeviceStream, const AudioFormat& deviceFormat, const AudioFormat& format)
+    : resampler(format.iSampleRate, deviceFormat.iSampleRate)
+{
+    this->pDeviceStream = pDeviceStream;
+
+    iSamplesPerPacket       = format.iSamplesPerPacket;
+    iDeviceSamplesPerPacket = deviceFormat.iSamplesPerPacket;
+
+    vConverted.resize( resampler.getMaxOutputCount(static_cast<size_t>(iSamplesPerPacket)) );
+    vReady    .reserve( static_cast<size_t>(iDeviceSamplesPerPacket) + vConverted.size() );
+}
+
+ResamplingPlaybackStream::~ResamplingPlaybackStream()
+{
+    delete pDeviceStream;
+}
+
+bool ResamplingPlaybackStream::write(const short* pSamples)
+{
+    const size_t iConverted = resampler.process(pSamples, static_cast<size_t>(iSamplesPerPacket), vConverted.data());
+
+    vReady.insert(vReady.end(), vConverted.begin(), vConverted.begin() + static_cast<std::ptrdiff_t>(iConverted));
+
+    while (vReady.size() >= static_cast<size_t>(iDeviceSamplesPerPacket))
+    {
+        if ( pDeviceStream->write(vReady.data()) )
+        {
+            return true;
+        }
+
+        vReady.erase(vReady.begin(), vReady.begin() + iDeviceSamplesPerPacket);
+    }
+
+    return false;
+}
+
+size_t ResamplingPlaybackStream::getQueuedPacketCount()
+{
+    return pDeviceStream->getQueuedPacketCount();
+}
+
+void ResamplingPlaybackStream::drain()
+{
+    if (vReady.empty() == false)
+    {
+        vReady.resize(static_cast<size_t>(iDeviceSamplesPerPacket), 0);
+
+        pDeviceStream->write(vReady.data());
+
+        vReady.clear();
+    }
+
+    pDeviceStream->drain();
+}
+
+void ResamplingPlaybackStream::reset()
+{
+    vReady.clear();
+    resampler.reset();
+
+    pDeviceStream->reset();
+}
+
+void ResamplingPlaybackStream::setVolume(unsigned short iVolume)
+{
+    pDeviceStream->setVolume(iVolume);
+}
+
+std::string ResamplingPlaybackStream::getLastError() const
+{
+    return pDeviceStream->getLastError();
+}
@@ -0,0 +1,106 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <vector>
+
+// Custom
+#include "Model/AudioService/Backend/audiobackend.h"
+#include "Model/AudioService/DSP/resampler.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// A device stream opened at the device rate, we see packets at the wire rate (AudioFormat::iSampleRate).
+// Made by AudioBackend::openResampledCapture().
+
+class ResamplingCaptureStream : public AudioCaptureStream
+{
+
+public:
+
+    // Takes ownership of pDeviceStream.
+
+    ResamplingCaptureStream(AudioCaptureStream* pDeviceStream, const AudioFormat& deviceFormat, const AudioFormat& format);
+
+    ~ResamplingCaptureStream() override;
+
+
+    bool        start           () override;
+
+    // Reads from the device only if the already converted samples are not enough for a packet.
+
+    bool        read            (short* pSamples) override;
+
+    void        stop            () override;
+
+
+    int         getBufferCount  () const override;
+
+    AudioCaptureStats getStats  () const override;
+
+    std::string getLastError    () const override;
+
+private:
+
+    AudioCaptureStream* pDeviceStream;
+
+    Resampler          resampler;
+
+    std::vector<short> vDevicePacket;
+    std::vector<short> vConverted;
+    std::vector<short> vReady;
+
+    int                iSamplesPerPacket;
+};
+
+
+// Takes packets at the wire rate, plays them at the device rate.
+// Made by AudioBackend::openResampledPlayback().
+
+class ResamplingPlaybackStream : public AudioPlaybackStream
+{
+
+public:
+
+    // Takes ownership of pDeviceStream.
+
+    ResamplingPlaybackStream(AudioPlaybackStream* pDeviceStream, const AudioFormat& deviceFormat, const AudioFormat& format);
+
+    ~ResamplingPlaybackStream() override;
+
+
+    bool        write                (const short* pSamples) override;
+
+    size_t      getQueuedPacketCount () override;
+
+    // Plays the converted samples that don't fill a device packet yet (padded with silence).
+
+    void        drain                () override;
+
+    void        reset                () override;
+
+    void        setVolume            (unsigned short iVolume) override;
+
+    std::string getLastError         () const override;
+
+private:
+
+    AudioPlaybackStream* pDeviceStream;
+
+    Resampler          resampler;
+
+    std::vector<short> vConverted;
+    std::vector<short> vReady;
+
+    int                iSamplesPerPacket;
+    int                iDeviceSamplesPerPacket;
+};
@@ -0,0 +1,442 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "switchableaudiostream.h"
+
+
+// STL
+#include <thread>
+#include <cmath>
+
+
+namespace
+{
+    void addCaptureStats(AudioCaptureStats& total, const AudioCaptureStats& stats)
+    {
+        total.iPacketCount    += stats.iPacketCount;
+        total.iWakeupCount    += stats.iWakeupCount;
+        total.dTotalLatencyMs += stats.dTotalLatencyMs;
+
+        if (stats.dMaxLatencyMs > total.dMaxLatencyMs)
+        {
+            total.dMaxLatencyMs = stats.dMaxLatencyMs;
+        }
+    }
+
+    double getMsSince(std::chrono::steady_clock::time_point time)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time).count();
+    }
+}
+
+
+SwitchableCaptureStream::SwitchableCaptureStream(AudioCaptureStream* pDeviceStream, const std::wstring& sDeviceName, const AudioFormat& format,
+                                                 OpenFunction openDevice, SwitchCallback onSwitched)
+{
+    this->pDeviceStream = pDeviceStream;
+    this->sDeviceName   = sDeviceName;
+    this->openDevice    = openDevice;
+    this->onSwitched    = onSwitched;
+
+    packetDuration = std::chrono::nanoseconds( static_cast<long long>(1000000000.0 * format.iSamplesPerPacket / format.iSampleRate) );
+
+    bSwitchRequested = false;
+    bStarted         = false;
+    bHavePacket      = false;
+}
+
+SwitchableCaptureStream::~SwitchableCaptureStream()
+{
+    delete pDeviceStream;
+}
+
+void SwitchableCaptureStream::switchDevice(const std::wstring& sDeviceName)
+{
+    std::lock_guard<std::mutex> switchLock(mtxSwitch);
+
+    sRequestedDeviceName = sDeviceName;
+    bSwitchRequested     = true;
+}
+
+bool SwitchableCaptureStream::start()
+{
+    if (bSwitchRequested)
+    {
+        // Nothing is recorded now, so nothing is lost.
+
+        const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+        AudioDeviceSwitch deviceSwitch;
+
+        mtxSwitch.lock();
+        deviceSwitch.sDeviceName = sRequestedDeviceName;
+        bSwitchRequested = false;
+        mtxSwitch.unlock();
+
+        deviceSwitch.bFailed = replaceDevice(deviceSwitch.sDeviceName, deviceSwitch.sErrorText);
+
+        reportSwitch(deviceSwitch, startTime);
+    }
+
+    bStarted    = true;
+    bHavePacket = false;
+
+    return pDeviceStream->start();
+}
+
+bool SwitchableCaptureStream::read(short* pSamples)
+{
+    std::chrono::steady_clock::time_point startTime;
+
+    AudioDeviceSwitch deviceSwitch;
+
+    bool bSwitched = false;
+
+    if (bSwitchRequested)
+    {
+        startTime = std::chrono::steady_clock::now();
+
+        mtxSwitch.lock();
+        deviceSwitch.sDeviceName = sRequestedDeviceName;
+        bSwitchRequested = false;
+        mtxSwitch.unlock();
+
+        if ( replaceDevice(deviceSwitch.sDeviceName, deviceSwitch.sErrorText) )
+        {
+            // Still on the old device.
+
+            deviceSwitch.bFailed = true;
+
+            reportSwitch(deviceSwitch, startTime);
+        }
+        else
+        {
+            bSwitched = true;
+        }
+    }
+
+
+    if ( pDeviceStream->read(pSamples) )
+    {
+        // The device is lost (unplugged?), open it again.
+
+        startTime = std::chrono::steady_clock::now();
+
+        deviceSwitch               = AudioDeviceSwitch();
+        deviceSwitch.sDeviceName   = sDeviceName;
+        deviceSwitch.bAfterFailure = true;
+
+        const std::string sReadError = pDeviceStream->getLastError();
+
+        bool bRecovered = false;
+
+        for (int i = 0;   (i < AUDIO_DEVICE_REOPEN_ATTEMPTS) && (bRecovered == false);   i++)
+        {
+            if (i > 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(AUDIO_DEVICE_REOPEN_PAUSE_MS));
+            }
+
+            if ( replaceDevice(sDeviceName, deviceSwitch.sErrorText) == false )
+            {
+                if ( pDeviceStream->read(pSamples) )
+                {
+                    deviceSwitch.sErrorText = pDeviceStream->getLastError();
+                }
+                else
+                {
+                    bRecovered = true;
+                }
+            }
+        }
+
+        if (bRecovered == false)
+        {
+            sLastError = sReadError + " (could not open the device again: " + deviceSwitch.sErrorText + ")";
+
+            return true;
+        }
+
+        deviceSwitch.sErrorText = sReadError;
+        sLastError.clear();
+
+        bSwitched = true;
+    }
+
+
+    if (bSwitched)
+    {
+        reportSwitch(deviceSwitch, startTime);
+    }
+
+    lastPacketTime = std::chrono::steady_clock::now();
+    bHavePacket    = true;
+
+    return false;
+}
+
+void SwitchableCaptureStream::stop()
+{
+    bStarted    = false;
+    bHavePacket = false;
+
+    pDeviceStream->stop();
+}
+
+int SwitchableCaptureStream::getBufferCount() const
+{
+    return pDeviceStream->getBufferCount();
+}
+
+AudioCaptureStats SwitchableCaptureStream::getStats() const
+{
+    AudioCaptureStats stats = closedDevicesStats;
+
+    addCaptureStats(stats, pDeviceStream->getStats());
+
+    return stats;
+}
+
+std::string SwitchableCaptureStream::getLastError() const
+{
+    if (sLastError.empty())
+    {
+        return pDeviceStream->getLastError();
+    }
+
+    return sLastError;
+}
+
+bool SwitchableCaptureStream::replaceDevice(const std::wstring& sNewDeviceName, std::string& sErrorText)
+{
+    AudioCaptureStream* pNewDeviceStream = openDevice(sNewDeviceName, sErrorText);
+
+    if (pNewDeviceStream == nullptr)
+    {
+        return true;
+    }
+
+    if (bStarted)
+    {
+        pDeviceStream->stop();
+    }
+
+    addCaptureStats(closedDevicesStats, pDeviceStream->getStats());
+
+    delete pDeviceStream;
+
+    pDeviceStream = pNewDeviceStream;
+    sDeviceName   = sNewDeviceName;
+
+    if ( bStarted && pDeviceStream->start() )
+    {
+        sErrorText = pDeviceStream->getLastError();
+
+        return true;
+    }
+
+    return false;
+}
+
+void SwitchableCaptureStream::reportSwitch(AudioDeviceSwitch& deviceSwitch, std::chrono::steady_clock::time_point startTime)
+{
+    deviceSwitch.dSwitchMs = getMsSince(startTime);
+
+    if (bHavePacket && (deviceSwitch.bFailed == false))
+    {
+        // We expected the next packet one packet after the last one, everything in between is lost.
+
+        const double dGapPackets = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastPacketTime).count()
+                                   / std::chrono::duration<double>(packetDuration).count();
+
+        if (dGapPackets > 1.5)
+        {
+            deviceSwitch.iLostPackets = static_cast<unsigned long long>( std::lround(dGapPackets - 1.0) );
+        }
+    }
+
+    if (onSwitched)
+    {
+        onSwitched(deviceSwitch);
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+SwitchablePlaybackStream::SwitchablePlaybackStream(AudioPlaybackStream* pDeviceStream, OpenFunction openDevice, SwitchCallback onSwitched)
+{
+    this->pDeviceStream = pDeviceStream;
+    this->openDevice    = openDevice;
+    this->onSwitched    = onSwitched;
+
+    bSwitchRequested = false;
+    iVolume          = 0;
+    bVolumeSet       = false;
+}
+
+SwitchablePlaybackStream::~SwitchablePlaybackStream()
+{
+    delete pDeviceStream;
+}
+
+void SwitchablePlaybackStream::switchDevice()
+{
+    bSwitchRequested = true;
+}
+
+bool SwitchablePlaybackStream::write(const short* pSamples)
+{
+    std::chrono::steady_clock::time_point startTime;
+
+    AudioDeviceSwitch deviceSwitch;
+
+    bool bSwitched = false;
+
+    if ( bSwitchRequested.exchange(false) )
+    {
+        startTime = std::chrono::steady_clock::now();
+
+        if ( replaceDevice(deviceSwitch.iLostPackets, deviceSwitch.sErrorText) )
+        {
+            deviceSwitch.bFailed   = true;
+            deviceSwitch.dSwitchMs = getMsSince(startTime);
+
+            if (onSwitched)
+            {
+                onSwitched(deviceSwitch);
+            }
+        }
+        else
+        {
+            bSwitched = true;
+        }
+    }
+
+
+    if ( pDeviceStream->write(pSamples) )
+    {
+        // The device is lost (unplugged?), open the default one.
+
+        startTime = std::chrono::steady_clock::now();
+
+        deviceSwitch               = AudioDeviceSwitch();
+        deviceSwitch.bAfterFailure = true;
+
+        const std::string sWriteError = pDeviceStream->getLastError();
+
+        bool bRecovered = false;
+
+        for (int i = 0;   (i < AUDIO_DEVICE_REOPEN_ATTEMPTS) && (bRecovered == false);   i++)
+        {
+            if (i > 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(AUDIO_DEVICE_REOPEN_PAUSE_MS));
+            }
+
+            if ( replaceDevice(deviceSwitch.iLostPackets, deviceSwitch.sErrorText) == false )
+            {
+                if ( pDeviceStream->write(pSamples) )
+                {
+                    deviceSwitch.sErrorText = pDeviceStream->getLastError();
+                }
+                else
+                {
+                    bRecovered = true;
+                }
+            }
+        }
+
+        if (bRecovered == false)
+        {
+            sLastError = sWriteError + " (could not open the device again: " + deviceSwitch.sErrorText + ")";
+
+            return true;
+        }
+
+        deviceSwitch.sErrorText = sWriteError;
+        sLastError.clear();
+
+        bSwitched = true;
+    }
+
+
+    if (bSwitched)
+    {
+        deviceSwitch.dSwitchMs = getMsSince(startTime);
+
+        if (onSwitched)
+        {
+            onSwitched(deviceSwitch);
+        }
+    }
+
+    return false;
+}
+
+size_t SwitchablePlaybackStream::getQueuedPacketCount()
+{
+    return pDeviceStream->getQueuedPacketCount();
+}
+
+void SwitchablePlaybackStream::drain()
+{
+    pDeviceStream->drain();
+}
+
+void SwitchablePlaybackStream::reset()
+{
+    pDeviceStream->reset();
+}
+
+void SwitchablePlaybackStream::setVolume(unsigned short iVolume)
+{
+    std::lock_guard<std::mutex> deviceLock(mtxDevice);
+
+    this->iVolume = iVolume;
+    bVolumeSet    = true;
+
+    pDeviceStream->setVolume(iVolume);
+}
+
+std::string SwitchablePlaybackStream::getLastError() const
+{
+    if (sLastError.empty())
+    {
+        return pDeviceStream->getLastError();
+    }
+
+    return sLastError;
+}
+
+bool SwitchablePlaybackStream::replaceDevice(unsigned long long& iLostPackets, std::string& sErrorText)
+{
+    AudioPlaybackStream* pNewDeviceStream = openDevice(sErrorText);
+
+    if (pNewDeviceStream == nullptr)
+    {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> deviceLock(mtxDevice);
+
+    // Not played yet - lost.
+
+    iLostPackets += pDeviceStream->getQueuedPacketCount();
+
+    pDeviceStream->reset();
+
+    delete pDeviceStream;
+
+    pDeviceStream = pNewDeviceStream;
+
+    if (bVolumeSet)
+    {
+        pDeviceStream->setVolume(iVolume);
+    }
+
+    return false;
+}
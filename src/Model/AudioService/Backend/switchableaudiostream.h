@@ -0,0 +1,169 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <string>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+// Custom
+#include "Model/AudioService/Backend/audiobackend.h"
+
+
+// When the device fails (unplugged) we try to open it again (the backend falls back to the default device).
+#define  AUDIO_DEVICE_REOPEN_ATTEMPTS   5
+#define  AUDIO_DEVICE_REOPEN_PAUSE_MS   200
+
+
+struct AudioDeviceSwitch
+{
+    std::wstring       sDeviceName;             // empty - the default device
+    double             dSwitchMs       = 0.0;   // from the request (or the failure) until the new device gave/took the first packet
+    unsigned long long iLostPackets    = 0;     // not recorded / not played because of the switch
+    bool               bAfterFailure   = false; // the old device stopped working, not switched by the user
+    bool               bFailed         = false; // the new device could not be opened (see sErrorText)
+    std::string        sErrorText;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// A capture stream that can be moved to another device while it's used,
+// the one who reads from it does not notice (except for the packets that are lost during the switch).
+// The device is also opened again if read() fails.
+
+class SwitchableCaptureStream : public AudioCaptureStream
+{
+
+public:
+
+    using OpenFunction   = std::function<AudioCaptureStream*(const std::wstring& sDeviceName, std::string& sErrorText)>;
+    using SwitchCallback = std::function<void(const AudioDeviceSwitch& deviceSwitch)>;
+
+
+    // Takes ownership of pDeviceStream (opened on sDeviceName).
+    // onSwitched is called from the thread that calls start()/read().
+
+    SwitchableCaptureStream(AudioCaptureStream* pDeviceStream, const std::wstring& sDeviceName, const AudioFormat& format,
+                            OpenFunction openDevice, SwitchCallback onSwitched);
+
+    ~SwitchableCaptureStream() override;
+
+
+    // Can be called from any thread, the device is switched in the next start()/read().
+
+    void        switchDevice    (const std::wstring& sDeviceName);
+
+
+    bool        start           () override;
+
+    bool        read            (short* pSamples) override;
+
+    void        stop            () override;
+
+
+    int         getBufferCount  () const override;
+
+    // Of all devices that were used.
+
+    AudioCaptureStats getStats  () const override;
+
+    std::string getLastError    () const override;
+
+private:
+
+    // Opens the new device first, so the old one is not touched if it fails.
+
+    bool        replaceDevice   (const std::wstring& sNewDeviceName, std::string& sErrorText);
+
+    void        reportSwitch    (AudioDeviceSwitch& deviceSwitch, std::chrono::steady_clock::time_point startTime);
+
+
+    std::mutex           mtxSwitch;
+    std::wstring         sRequestedDeviceName;
+    std::atomic<bool>    bSwitchRequested;
+
+
+    AudioCaptureStream*  pDeviceStream;
+    std::wstring         sDeviceName;
+
+    OpenFunction         openDevice;
+    SwitchCallback       onSwitched;
+
+    AudioCaptureStats    closedDevicesStats;
+
+    std::chrono::steady_clock::time_point lastPacketTime;
+    std::chrono::nanoseconds              packetDuration;
+
+    std::string          sLastError;
+
+    bool                 bStarted;
+    bool                 bHavePacket;     // lastPacketTime is set (since start())
+};
+
+
+// Same for an output device, opened again (the default device) if write() fails.
+
+class SwitchablePlaybackStream : public AudioPlaybackStream
+{
+
+public:
+
+    using OpenFunction   = std::function<AudioPlaybackStream*(std::string& sErrorText)>;
+    using SwitchCallback = std::function<void(const AudioDeviceSwitch& deviceSwitch)>;
+
+
+    // Takes ownership of pDeviceStream.
+    // onSwitched is called from the thread that calls write().
+
+    SwitchablePlaybackStream(AudioPlaybackStream* pDeviceStream, OpenFunction openDevice, SwitchCallback onSwitched);
+
+    ~SwitchablePlaybackStream() override;
+
+
+    // Can be called from any thread, the device is opened again in the next write()
+    // (for example, if the default device was changed).
+
+    void        switchDevice         ();
+
+
+    bool        write                (const short* pSamples) override;
+
+    size_t      getQueuedPacketCount () override;
+
+    void        drain                () override;
+
+    void        reset                () override;
+
+    void        setVolume            (unsigned short iVolume) override;
+
+    std::string getLastError         () const override;
+
+private:
+
+    bool        replaceDevice        (unsigned long long& iLostPackets, std::string& sErrorText);
+
+
+    std::mutex           mtxDevice;       // replacing the device vs. setVolume() from other threads
+    std::atomic<bool>    bSwitchRequested;
+
+    AudioPlaybackStream* pDeviceStream;
+
+    OpenFunction         openDevice;
+    SwitchCallback       onSwitched;
+
+    std::string          sLastError;
+
+    unsigned short       iVolume;
+    bool                 bVolumeSet;
+};
@@ -0,0 +1,495 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "wavfileaudiobackend.h"
+
+
+// STL
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+
+// Custom
+#include "Model/AudioService/Backend/nullaudiobackend.h"
+
+
+#define WAV_HEADER_SIZE 44
+
+
+namespace
+{
+    // WAV is little-endian (as all platforms we build for).
+
+    void appendUInt32(std::vector<char>& vBuffer, uint32_t iValue)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            vBuffer.push_back( static_cast<char>((iValue >> (8 * i)) & 0xFF) );
+        }
+    }
+
+    void appendUInt16(std::vector<char>& vBuffer, uint16_t iValue)
+    {
+        vBuffer.push_back( static_cast<char>(iValue & 0xFF) );
+        vBuffer.push_back( static_cast<char>(iValue >> 8) );
+    }
+
+    uint32_t readUInt32(const char* pData)
+    {
+        const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(pData);
+
+        return pBytes[0] | (pBytes[1] << 8) | (pBytes[2] << 16) | (static_cast<uint32_t>(pBytes[3]) << 24);
+    }
+
+    uint16_t readUInt16(const char* pData)
+    {
+        const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(pData);
+
+        return static_cast<uint16_t>( pBytes[0] | (pBytes[1] << 8) );
+    }
+
+    std::vector<char> makeWavHeader(uint32_t iDataSizeInBytes, unsigned int iSampleRate)
+    {
+        std::vector<char> vHeader;
+        vHeader.reserve(WAV_HEADER_SIZE);
+
+        vHeader.insert(vHeader.end(), {'R', 'I', 'F', 'F'});
+        appendUInt32(vHeader, WAV_HEADER_SIZE - 8 + iDataSizeInBytes);
+        vHeader.insert(vHeader.end(), {'W', 'A', 'V', 'E'});
+
+        vHeader.insert(vHeader.end(), {'f', 'm', 't', ' '});
+        appendUInt32(vHeader, 16);
+        appendUInt16(vHeader, 1);                // PCM
+        appendUInt16(vHeader, 1);                // mono
+        appendUInt32(vHeader, iSampleRate);
+        appendUInt32(vHeader, iSampleRate * 2);  // bytes per second
+        appendUInt16(vHeader, 2);                // block align
+        appendUInt16(vHeader, 16);               // bits per sample
+
+        vHeader.insert(vHeader.end(), {'d', 'a', 't', 'a'});
+        appendUInt32(vHeader, iDataSizeInBytes);
+
+        return vHeader;
+    }
+
+
+    // ---------------------------------------
+
+
+    class WavFileCaptureStream : public AudioCaptureStream
+    {
+    public:
+
+        WavFileCaptureStream(std::vector<short>&& vSamples, const AudioFormat& format, bool bRealTime)
+            : vSamples(std::move(vSamples)), packetClock(format, bRealTime)
+        {
+            iSamplesPerPacket = format.iSamplesPerPacket;
+            iBufferCount      = format.iCaptureBufferCount;
+            iReadPos          = 0;
+        }
+
+        bool start() override
+        {
+            packetClock.start();
+
+            return false;
+        }
+
+        bool read(short* pSamples) override
+        {
+            packetClock.waitForNextPacket(stats);
+
+            if (vSamples.empty())
+            {
+                std::memset(pSamples, 0, static_cast<size_t>(iSamplesPerPacket) * sizeof(short));
+                return false;
+            }
+
+
+            // Loop the file.
+
+            for (int i = 0; i < iSamplesPerPacket; i++)
+            {
+                pSamples[i] = vSamples[iReadPos];
+
+                iReadPos++;
+
+                if (iReadPos == vSamples.size())
+                {
+                    iReadPos = 0;
+                }
+            }
+
+            return false;
+        }
+
+        void stop() override
+        {
+        }
+
+        int getBufferCount() const override
+        {
+            return iBufferCount;
+        }
+
+        AudioCaptureStats getStats() const override
+        {
+            return stats;
+        }
+
+        std::string getLastError() const override
+        {
+            return "";
+        }
+
+    private:
+
+        std::vector<short> vSamples;
+
+        AudioPacketClock   packetClock;
+
+        AudioCaptureStats  stats;
+
+        size_t             iReadPos;
+        int                iSamplesPerPacket;
+        int                iBufferCount;
+    };
+
+
+    // Packets are written as they come (the volume is not applied, it's the device's job).
+
+    class WavFilePlaybackStream : public AudioPlaybackStream
+    {
+    public:
+
+        WavFilePlaybackStream(const std::string& sPath, const AudioFormat& format)
+        {
+            iSamplesPerPacket = format.iSamplesPerPacket;
+            bDiscard          = sPath.empty();
+
+            if (bDiscard == false)
+            {
+                writer.open(sPath, format.iSampleRate);
+            }
+        }
+
+        bool isOpen() const
+        {
+            return writer.isOpen();
+        }
+
+        bool write(const short* pSamples) override
+        {
+            if (bDiscard)
+            {
+                return false;
+            }
+
+            if ( writer.write(pSamples, static_cast<size_t>(iSamplesPerPacket)) )
+            {
+                sLastError = "failed to write to the output file";
+                return true;
+            }
+
+            return false;
+        }
+
+        size_t      getQueuedPacketCount () override       { return 0; }
+        void        drain                () override       { writer.updateHeader(); }
+        void        reset                () override       {}
+        void        setVolume            (unsigned short) override {}
+        std::string getLastError         () const override { return sLastError; }
+
+    private:
+
+        WavFileWriter writer;
+
+        std::string   sLastError;
+
+        int           iSamplesPerPacket;
+
+        bool          bDiscard;
+    };
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+WavFileAudioBackend::WavFileAudioBackend(const std::string& sInputPath, const std::string& sOutputPrefix, bool bRealTime)
+{
+    this->sInputPath    = sInputPath;
+    this->sOutputPrefix = sOutputPrefix;
+    this->bRealTime     = bRealTime;
+
+    iOpenedPlaybackStreams = 0;
+}
+
+std::string WavFileAudioBackend::getName() const
+{
+    return "WAV file";
+}
+
+std::vector<std::wstring> WavFileAudioBackend::getInputDevices()
+{
+    return { std::wstring(sInputPath.begin(), sInputPath.end()) };
+}
+
+AudioCaptureStream* WavFileAudioBackend::openCapture(const std::wstring& sDeviceName, const AudioFormat& format, std::string& sErrorText)
+{
+    (void)sDeviceName;
+
+    std::vector<short> vSamples;
+
+    if (sInputPath.empty() == false)
+    {
+        unsigned int iFileSampleRate = 0;
+
+        if ( readWavFile(sInputPath, vSamples, iFileSampleRate, sErrorText) )
+        {
+            return nullptr;
+        }
+
+        if (iFileSampleRate != format.iSampleRate)
+        {
+            sErrorText = "the sample rate of " + sInputPath + " is " + std::to_string(iFileSampleRate)
+                         + " Hz, expected " + std::to_string(format.iSampleRate) + " Hz";
+
+            return nullptr;
+        }
+    }
+
+    return new WavFileCaptureStream(std::move(vSamples), format, bRealTime);
+}
+
+AudioPlaybackStream* WavFileAudioBackend::openPlayback(const AudioFormat& format, std::string& sErrorText)
+{
+    std::string sPath;
+
+    if (sOutputPrefix.empty() == false)
+    {
+        sPath = sOutputPrefix + std::to_string(iOpenedPlaybackStreams++) + ".wav";
+    }
+
+    WavFilePlaybackStream* pStream = new WavFilePlaybackStream(sPath, format);
+
+    if ( (sPath.empty() == false) && (pStream->isOpen() == false) )
+    {
+        sErrorText = "can't create " + sPath;
+
+        delete pStream;
+
+        return nullptr;
+    }
+
+    return pStream;
+}
+
+bool WavFileAudioBackend::readWavFile(const std::string& sPath, std::vector<short>& vSamples, unsigned int& iSampleRate, std::string& sErrorText)
+{
+    std::ifstream file(sPath, std::ios::binary);
+
+    if (file.is_open() == false)
+    {
+        sErrorText = "can't open " + sPath;
+        return true;
+    }
+
+    std::vector<char> vFile( (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>() );
+
+    if ( (vFile.size() < 12) || (std::memcmp(vFile.data(), "RIFF", 4) != 0) || (std::memcmp(vFile.data() + 8, "WAVE", 4) != 0) )
+    {
+        sErrorText = sPath + " is not a WAV file";
+        return true;
+    }
+
+
+    // Walk the chunks, we need "fmt " and "data".
+
+    bool     bFormatFound = false;
+    uint16_t iChannels    = 1;
+    size_t   iPos         = 12;
+
+    while (iPos + 8 <= vFile.size())
+    {
+        const char*    pChunkId   = vFile.data() + iPos;
+        const uint32_t iChunkSize = readUInt32(vFile.data() + iPos + 4);
+
+        iPos += 8;
+
+        if (iChunkSize > vFile.size() - iPos)
+        {
+            break;
+        }
+
+        if (std::memcmp(pChunkId, "fmt ", 4) == 0)
+        {
+            if (iChunkSize < 16)
+            {
+                break;
+            }
+
+            const uint16_t iFormatTag     = readUInt16(vFile.data() + iPos);
+            const uint16_t iBitsPerSample = readUInt16(vFile.data() + iPos + 14);
+
+            iChannels = readUInt16(vFile.data() + iPos + 2);
+
+            if ( (iFormatTag != 1) || ( (iChannels != 1) && (iChannels != 2) ) || (iBitsPerSample != 16) )
+            {
+                sErrorText = sPath + " must be mono or stereo 16 bit PCM";
+                return true;
+            }
+
+            iSampleRate  = readUInt32(vFile.data() + iPos + 4);
+            bFormatFound = true;
+        }
+        else if ( (std::memcmp(pChunkId, "data", 4) == 0) && bFormatFound )
+        {
+            vSamples.resize(iChunkSize / sizeof(short));
+            std::memcpy(vSamples.data(), vFile.data() + iPos, vSamples.size() * sizeof(short));
+
+            if (iChannels == 2)
+            {
+                // Down to mono (in place, the left and right samples are averaged).
+
+                for (size_t i = 0; i < vSamples.size() / 2; i++)
+                {
+                    vSamples[i] = static_cast<short>( (vSamples[2 * i] + vSamples[2 * i + 1]) / 2 );
+                }
+
+                vSamples.resize(vSamples.size() / 2);
+            }
+
+            return false;
+        }
+
+        // Chunks are padded to an even size.
+        iPos += iChunkSize + (iChunkSize & 1);
+    }
+
+    sErrorText = sPath + " is damaged (no \"fmt \" or \"data\" chunk)";
+
+    return true;
+}
+
+bool WavFileAudioBackend::writeWavFile(const std::string& sPath, const std::vector<short>& vSamples, unsigned int iSampleRate)
+{
+    std::ofstream file(sPath, std::ios::binary | std::ios::trunc);
+
+    if (file.is_open() == false)
+    {
+        return true;
+    }
+
+    const uint32_t iDataSizeInBytes = static_cast<uint32_t>(vSamples.size() * sizeof(short));
+
+    std::vector<char> vHeader = makeWavHeader(iDataSizeInBytes, iSampleRate);
+
+    file.write(vHeader.data(), static_cast<std::streamsize>(vHeader.size()));
+    file.write(reinterpret_cast<const char*>(vSamples.data()), iDataSizeInBytes);
+
+    return file.good() == false;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+WavFileWriter::WavFileWriter()
+{
+    iDataSizeInBytes = 0;
+    iSampleRate      = 0;
+}
+
+WavFileWriter::~WavFileWriter()
+{
+    close();
+}
+
+bool WavFileWriter::open(const std::filesystem::path& path, unsigned int iSampleRate)
+{
+    close();
+
+    this->iSampleRate = iSampleRate;
+    iDataSizeInBytes  = 0;
+
+    file.open(path, std::ios::binary | std::ios::trunc);
+
+    if (file.is_open() == false)
+    {
+        return true;
+    }
+
+    return updateHeader();
+}
+
+bool WavFileWriter::write(const short* pSamples, size_t iCount)
+{
+    const unsigned long long iSizeInBytes = static_cast<unsigned long long>(iCount) * sizeof(short);
+
+    if ( (file.is_open() == false) || (iDataSizeInBytes + iSizeInBytes > UINT32_MAX - WAV_HEADER_SIZE) )
+    {
+        return true;
+    }
+
+    file.write(reinterpret_cast<const char*>(pSamples), static_cast<std::streamsize>(iSizeInBytes));
+
+    if (file.good() == false)
+    {
+        return true;
+    }
+
+    iDataSizeInBytes += static_cast<uint32_t>(iSizeInBytes);
+
+    return false;
+}
+
+bool WavFileWriter::updateHeader()
+{
+    if (file.is_open() == false)
+    {
+        return true;
+    }
+
+    std::vector<char> vHeader = makeWavHeader(iDataSizeInBytes, iSampleRate);
+
+    const std::streampos endPos = file.tellp();
+
+    file.seekp(0);
+    file.write(vHeader.data(), static_cast<std::streamsize>(vHeader.size()));
+
+    if (endPos > 0)
+    {
+        file.seekp(endPos);
+    }
+
+    file.flush();
+
+    return file.good() == false;
+}
+
+void WavFileWriter::close()
+{
+    if (file.is_open())
+    {
+        // Now we know the sizes.
+
+        updateHeader();
+
+        file.close();
+    }
+}
+
+bool WavFileWriter::isOpen() const
+{
+    return file.is_open() && file.good();
+}
+
+unsigned long long WavFileWriter::getSampleCount() const
+{
+    return iDataSizeInBytes / sizeof(short);
+}
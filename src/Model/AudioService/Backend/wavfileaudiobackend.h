@@ -0,0 +1,112 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <atomic>
+#include <fstream>
+#include <filesystem>
+#include <cstdint>
+
+// Custom
+#include "Model/AudioService/Backend/audiobackend.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Uses a WAV file (mono PCM16) as the microphone and writes each playback stream to its own WAV file,
+// so that the audio code can run without sound devices (benchmarks, build hosts).
+
+class WavFileAudioBackend : public AudioBackend
+{
+
+public:
+
+    // sInputPath:    played in a loop as the microphone, silence if empty.
+    // sOutputPrefix: playback stream N is written to "<sOutputPrefix>N.wav", thrown away if empty.
+    // bRealTime:     read() returns packets at the speed of a real device, otherwise as fast as they are asked for.
+
+    WavFileAudioBackend(const std::string& sInputPath, const std::string& sOutputPrefix, bool bRealTime);
+
+
+    std::string  getName                 () const override;
+
+    std::vector<std::wstring> getInputDevices () override;
+
+
+    AudioCaptureStream*  openCapture     (const std::wstring& sDeviceName, const AudioFormat& format, std::string& sErrorText) override;
+
+    AudioPlaybackStream* openPlayback    (const AudioFormat& format, std::string& sErrorText) override;
+
+
+    // Return true if failed.
+    // Stereo files are read as mono (the channels are averaged).
+
+    static bool  readWavFile             (const std::string& sPath, std::vector<short>& vSamples, unsigned int& iSampleRate, std::string& sErrorText);
+
+    static bool  writeWavFile            (const std::string& sPath, const std::vector<short>& vSamples, unsigned int iSampleRate);
+
+private:
+
+    std::string  sInputPath;
+    std::string  sOutputPrefix;
+
+
+    std::atomic<int> iOpenedPlaybackStreams;
+
+
+    bool         bRealTime;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+// Writes mono PCM16 to a WAV file as it comes (the sizes in the header are written by updateHeader() and close()).
+// Functions that return bool return true if failed.
+
+class WavFileWriter
+{
+
+public:
+
+    WavFileWriter();
+
+    // Calls close().
+
+    ~WavFileWriter();
+
+
+    // Creates (or truncates) the file.
+
+    bool         open                    (const std::filesystem::path& path, unsigned int iSampleRate);
+
+    // Fails if the file is not open, can't be written or would be over 4 GB (the limit of WAV).
+
+    bool         write                   (const short* pSamples, size_t iCount);
+
+    // Writes the current sizes, so the file can be played even if close() is never called (crash, power loss).
+
+    bool         updateHeader            ();
+
+    void         close                   ();
+
+
+    bool         isOpen                  () const;
+
+    unsigned long long getSampleCount    () const;
+
+private:
+
+    std::ofstream file;
+
+    uint32_t     iDataSizeInBytes;
+    unsigned int iSampleRate;
+};
@@ -0,0 +1,616 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "winmmaudiobackend.h"
+
+
+#ifdef _WIN32
+
+
+// STL
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+// Other
+#define _WINSOCKAPI_    // stops windows.h from including winsock.h
+#include <Windows.h>
+#include "Mmsystem.h"
+
+
+// for mmsystem
+#pragma comment(lib,"Winmm.lib")
+
+
+// In case the device stops sending buffers (unplugged).
+#define CAPTURE_EVENT_TIMEOUT_MS 500
+
+// No buffer for this long - read() fails (so the device can be opened again, see SwitchableCaptureStream).
+#define CAPTURE_DEVICE_LOST_MS   3000
+
+
+namespace
+{
+    std::string getWaveInErrorText(const std::string& sFunctionName, MMRESULT result)
+    {
+        char fault [256];
+        memset (fault, 0, 256);
+
+        waveInGetErrorTextA (result, fault, 256);
+
+        return sFunctionName + "() error (" + std::to_string(result) + "): " + std::string(fault) + ".";
+    }
+
+    std::string getWaveOutErrorText(const std::string& sFunctionName, MMRESULT result)
+    {
+        char fault [256];
+        memset (fault, 0, 256);
+
+        waveOutGetErrorTextA (result, fault, 256);
+
+        return sFunctionName + "() error (" + std::to_string(result) + "): " + std::string(fault) + ".";
+    }
+
+    WAVEFORMATEX makeWaveFormat(const AudioFormat& format)
+    {
+        WAVEFORMATEX waveFormat;
+
+        waveFormat.wFormatTag      = WAVE_FORMAT_PCM;
+        waveFormat.nChannels       = 1;    //  '1' - mono, '2' - stereo
+        waveFormat.cbSize          = 0;
+        waveFormat.wBitsPerSample  = 16;
+        waveFormat.nSamplesPerSec  = format.iSampleRate;
+        waveFormat.nBlockAlign     = waveFormat.nChannels      * waveFormat.wBitsPerSample / 8;
+        waveFormat.nAvgBytesPerSec = waveFormat.nSamplesPerSec * waveFormat.nChannels           * waveFormat.wBitsPerSample / 8;
+
+        return waveFormat;
+    }
+
+    void setupHeaders(std::vector<WAVEHDR>& vHeaders, std::vector<short>& vBuffers, int iSamplesPerPacket)
+    {
+        for (size_t i = 0; i < vHeaders.size(); i++)
+        {
+            vHeaders[i].lpData          = reinterpret_cast <LPSTR>         (vBuffers.data() + i * static_cast<size_t>(iSamplesPerPacket));
+            vHeaders[i].dwBufferLength  = static_cast      <unsigned long> (iSamplesPerPacket * 2);
+            vHeaders[i].dwBytesRecorded = 0;
+            vHeaders[i].dwUser          = 0L;
+            vHeaders[i].dwFlags         = 0L;
+            vHeaders[i].dwLoops         = 0L;
+        }
+    }
+
+
+    // ---------------------------------------
+
+
+    // Buffers are recorded in a circle: 1 (recording) - 2 - ... - N, read() waits for 1 and adds it back: 2 (recording) - ... - N - 1.
+    // The driver tells us (onBufferDone()) the moment a buffer is recorded, so read() either sleeps on an event
+    // until then (event driven) or checks the buffer every BUFFER_UPDATE_CHECK_MS (polling).
+
+    class WinMMCaptureStream : public AudioCaptureStream
+    {
+    public:
+
+        WinMMCaptureStream(const AudioFormat& format, bool bEventDriven) : vDoneTimeNs(static_cast<size_t>(format.iCaptureBufferCount))
+        {
+            this->bEventDriven = bEventDriven;
+            iSamplesPerPacket  = format.iSamplesPerPacket;
+            iNextHeader        = 0;
+            bStarted           = false;
+            hWaveIn            = nullptr;
+            hBufferDoneEvent   = nullptr;
+            iQueuedBufferCount = 0;
+
+            vHeaders.resize(static_cast<size_t>(format.iCaptureBufferCount));
+            vBuffers.resize(static_cast<size_t>(format.iCaptureBufferCount) * static_cast<size_t>(iSamplesPerPacket));
+
+            setupHeaders(vHeaders, vBuffers, iSamplesPerPacket);
+
+            for (size_t i = 0; i < vHeaders.size(); i++)
+            {
+                vHeaders[i].dwUser = i;
+            }
+        }
+
+        bool open(UINT iDeviceID, const AudioFormat& format, std::string& sErrorText)
+        {
+            // Auto-reset: every buffer that's done wakes up read() once.
+
+            hBufferDoneEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+
+            if (hBufferDoneEvent == nullptr)
+            {
+                sErrorText = "CreateEvent() error (" + std::to_string(GetLastError()) + ").";
+                return true;
+            }
+
+            WAVEFORMATEX waveFormat = makeWaveFormat(format);
+
+            MMRESULT result = waveInOpen (&hWaveIn,  iDeviceID,  &waveFormat,  reinterpret_cast<DWORD_PTR>(&onWaveInMessage),
+                                          reinterpret_cast<DWORD_PTR>(this),  CALLBACK_FUNCTION | WAVE_FORMAT_DIRECT);
+
+            if (result)
+            {
+                sErrorText = getWaveInErrorText("waveInOpen", result);
+
+                hWaveIn = nullptr;
+
+                return true;
+            }
+
+            return false;
+        }
+
+        bool start() override
+        {
+            for (size_t i = 0; i < vHeaders.size(); i++)
+            {
+                vDoneTimeNs[i] = 0;
+
+                if ( addBuffer(&vHeaders[i]) )
+                {
+                    resetDevice();
+                    return true;
+                }
+            }
+
+            MMRESULT result = waveInStart(hWaveIn);
+
+            if (result)
+            {
+                sLastError = getWaveInErrorText("waveInStart", result);
+
+                resetDevice();
+
+                return true;
+            }
+
+            iNextHeader = 0;
+            bStarted    = true;
+
+            return false;
+        }
+
+        bool read(short* pSamples) override
+        {
+            WAVEHDR* pHeader = &vHeaders[iNextHeader];
+
+
+            // Wait until buffer finished recording.
+
+            const long long iWaitStartNs = getTimeNs();
+
+            if (bEventDriven)
+            {
+                while (vDoneTimeNs[iNextHeader] == 0)
+                {
+                    WaitForSingleObject(hBufferDoneEvent, CAPTURE_EVENT_TIMEOUT_MS);
+
+                    stats.iWakeupCount++;
+
+                    if (getTimeNs() - iWaitStartNs > CAPTURE_DEVICE_LOST_MS * 1000000LL)
+                    {
+                        sLastError = "the device stopped recording (unplugged?)";
+                        return true;
+                    }
+                }
+
+                waveInUnprepareHeader(hWaveIn, pHeader, sizeof(WAVEHDR));
+            }
+            else
+            {
+                while (waveInUnprepareHeader(hWaveIn, pHeader, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+
+                    stats.iWakeupCount++;
+
+                    if (getTimeNs() - iWaitStartNs > CAPTURE_DEVICE_LOST_MS * 1000000LL)
+                    {
+                        sLastError = "the device stopped recording (unplugged?)";
+                        return true;
+                    }
+                }
+            }
+
+            std::memcpy(pSamples, pHeader->lpData, static_cast<size_t>(iSamplesPerPacket) * sizeof(short));
+
+
+            // The callback may come a bit after the "done" flag (polling).
+
+            long long iDoneTimeNs = vDoneTimeNs[iNextHeader].exchange(0);
+
+            stats.addPacket( iDoneTimeNs ? (getTimeNs() - iDoneTimeNs) / 1000000.0 : 0.0 );
+
+
+            // Add it to the end of the queue.
+
+            iNextHeader = (iNextHeader + 1) % vHeaders.size();
+
+            return addBuffer(pHeader);
+        }
+
+        void stop() override
+        {
+            if (bStarted)
+            {
+                resetDevice();
+
+                bStarted = false;
+            }
+        }
+
+        int getBufferCount() const override
+        {
+            return static_cast<int>(vHeaders.size());
+        }
+
+        AudioCaptureStats getStats() const override
+        {
+            return stats;
+        }
+
+        std::string getLastError() const override
+        {
+            return sLastError;
+        }
+
+        ~WinMMCaptureStream() override
+        {
+            if (hWaveIn)
+            {
+                stop();
+
+                waveInClose(hWaveIn);
+            }
+
+            if (hBufferDoneEvent)
+            {
+                CloseHandle(hBufferDoneEvent);
+            }
+        }
+
+    private:
+
+        static long long getTimeNs()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // Called by the driver. Only SetEvent() and such are allowed here,
+        // steady_clock (QueryPerformanceCounter()) doesn't take any locks so it's fine too.
+
+        static void CALLBACK onWaveInMessage(HWAVEIN hWaveIn, UINT uMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2)
+        {
+            (void)hWaveIn;
+            (void)dwParam2;
+
+            if (uMsg == WIM_DATA)
+            {
+                reinterpret_cast<WinMMCaptureStream*>(dwInstance)->onBufferDone( reinterpret_cast<WAVEHDR*>(dwParam1) );
+            }
+        }
+
+        void onBufferDone(WAVEHDR* pHeader)
+        {
+            vDoneTimeNs[pHeader->dwUser] = getTimeNs();
+
+            SetEvent(hBufferDoneEvent);
+
+            // Last, resetDevice() waits for it.
+            iQueuedBufferCount--;
+        }
+
+        bool addBuffer(WAVEHDR* pHeader)
+        {
+            MMRESULT result = waveInPrepareHeader(hWaveIn, pHeader, sizeof(WAVEHDR));
+
+            if (result)
+            {
+                sLastError = getWaveInErrorText("waveInPrepareHeader", result);
+                return true;
+            }
+
+
+            // Insert a wave input buffer to waveform-audio input device
+
+            iQueuedBufferCount++;
+
+            result = waveInAddBuffer(hWaveIn, pHeader, sizeof(WAVEHDR));
+
+            if (result)
+            {
+                iQueuedBufferCount--;
+
+                sLastError = getWaveInErrorText("waveInAddBuffer", result);
+
+                waveInUnprepareHeader(hWaveIn, pHeader, sizeof(WAVEHDR));
+
+                return true;
+            }
+
+            return false;
+        }
+
+        // waveInReset() returns every queued buffer, but the callback (WIM_DATA) may come after the "done" flag:
+        // wait for all of them, otherwise a late one marks a buffer of the next start() as recorded
+        // (or comes after we are deleted).
+
+        void resetDevice()
+        {
+            waveInReset(hWaveIn);
+
+            waitForAllBuffers();
+
+            const long long iWaitStartNs = getTimeNs();
+
+            while ( (iQueuedBufferCount > 0) && (getTimeNs() - iWaitStartNs < CAPTURE_DEVICE_LOST_MS * 1000000LL) )
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+            }
+
+            // The driver won't call back anymore (lost device).
+            iQueuedBufferCount = 0;
+        }
+
+        void waitForAllBuffers()
+        {
+            for (size_t i = 0; i < vHeaders.size(); i++)
+            {
+                while (waveInUnprepareHeader(hWaveIn, &vHeaders[i], sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+                }
+            }
+        }
+
+
+        std::vector<WAVEHDR> vHeaders;
+        std::vector<short>   vBuffers;
+
+        // When the driver finished the buffer (0 - still recording).
+        std::vector<std::atomic<long long>> vDoneTimeNs;
+
+        // Added to the driver, the WIM_DATA callback did not come yet.
+        std::atomic<int>     iQueuedBufferCount;
+
+        AudioCaptureStats    stats;
+
+        std::string          sLastError;
+
+        HWAVEIN              hWaveIn;
+        HANDLE               hBufferDoneEvent;
+
+        size_t               iNextHeader;
+        int                  iSamplesPerPacket;
+
+        bool                 bEventDriven;
+        bool                 bStarted;
+    };
+
+
+    // Two buffers: one is playing, the other one is waiting.
+
+    class WinMMPlaybackStream : public AudioPlaybackStream
+    {
+    public:
+
+        WinMMPlaybackStream(HWAVEOUT hWaveOut, const AudioFormat& format)
+        {
+            this->hWaveOut    = hWaveOut;
+            iSamplesPerPacket = format.iSamplesPerPacket;
+            iNextHeader       = 0;
+
+            vHeaders.resize(AUDIO_PLAYBACK_BUFFER_COUNT);
+            vBuffers.resize(AUDIO_PLAYBACK_BUFFER_COUNT * static_cast<size_t>(iSamplesPerPacket));
+            vQueued .resize(AUDIO_PLAYBACK_BUFFER_COUNT, false);
+
+            setupHeaders(vHeaders, vBuffers, iSamplesPerPacket);
+        }
+
+        bool write(const short* pSamples) override
+        {
+            WAVEHDR* pHeader = &vHeaders[iNextHeader];
+
+
+            // Wait until finished playing buffer
+
+            waitForBuffer(iNextHeader);
+
+            std::memcpy(pHeader->lpData, pSamples, static_cast<size_t>(iSamplesPerPacket) * sizeof(short));
+
+
+            MMRESULT result = waveOutPrepareHeader(hWaveOut, pHeader, sizeof(WAVEHDR));
+
+            if (result)
+            {
+                sLastError = getWaveOutErrorText("waveOutPrepareHeader", result);
+                return true;
+            }
+
+            result = waveOutWrite(hWaveOut, pHeader, sizeof(WAVEHDR));
+
+            if (result)
+            {
+                sLastError = getWaveOutErrorText("waveOutWrite", result);
+
+                waveOutUnprepareHeader(hWaveOut, pHeader, sizeof(WAVEHDR));
+
+                return true;
+            }
+
+            vQueued[iNextHeader] = true;
+
+            iNextHeader = (iNextHeader + 1) % vHeaders.size();
+
+            return false;
+        }
+
+        size_t getQueuedPacketCount() override
+        {
+            size_t iQueuedCount = 0;
+
+            for (size_t i = 0; i < vHeaders.size(); i++)
+            {
+                if ( vQueued[i] && (waveOutUnprepareHeader(hWaveOut, &vHeaders[i], sizeof(WAVEHDR)) == WAVERR_STILLPLAYING) )
+                {
+                    iQueuedCount++;
+                }
+                else
+                {
+                    vQueued[i] = false;
+                }
+            }
+
+            return iQueuedCount;
+        }
+
+        void drain() override
+        {
+            for (size_t i = 0; i < vHeaders.size(); i++)
+            {
+                waitForBuffer(i);
+            }
+        }
+
+        void reset() override
+        {
+            waveOutReset(hWaveOut);
+
+            drain();
+        }
+
+        void setVolume(unsigned short iVolume) override
+        {
+            waveOutSetVolume( hWaveOut, MAKELONG(iVolume, iVolume) );
+        }
+
+        std::string getLastError() const override
+        {
+            return sLastError;
+        }
+
+        ~WinMMPlaybackStream() override
+        {
+            reset();
+
+            waveOutClose(hWaveOut);
+        }
+
+    private:
+
+        void waitForBuffer(size_t iIndex)
+        {
+            if (vQueued[iIndex] == false)
+            {
+                return;
+            }
+
+            while (waveOutUnprepareHeader(hWaveOut, &vHeaders[iIndex], sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS / 2));
+            }
+
+            vQueued[iIndex] = false;
+        }
+
+
+        std::vector<WAVEHDR> vHeaders;
+        std::vector<short>   vBuffers;
+        std::vector<bool>    vQueued;
+
+        std::string          sLastError;
+
+        HWAVEOUT             hWaveOut;
+
+        size_t               iNextHeader;
+        int                  iSamplesPerPacket;
+    };
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+WinMMAudioBackend::WinMMAudioBackend(bool bEventDrivenCapture)
+{
+    this->bEventDrivenCapture = bEventDrivenCapture;
+}
+
+std::string WinMMAudioBackend::getName() const
+{
+    return "WinMM";
+}
+
+std::vector<std::wstring> WinMMAudioBackend::getInputDevices()
+{
+    UINT iInDeviceCount = waveInGetNumDevs();
+
+    std::vector<std::wstring> vSupportedDevices;
+
+    for (UINT i = 0; i < iInDeviceCount; i++)
+    {
+        WAVEINCAPS deviceInfo;
+
+        MMRESULT result = waveInGetDevCaps(i, &deviceInfo, sizeof(deviceInfo));
+        if (result == MMSYSERR_NOERROR)
+        {
+            vSupportedDevices.push_back(deviceInfo.szPname);
+        }
+    }
+
+    return vSupportedDevices;
+}
+
+AudioCaptureStream* WinMMAudioBackend::openCapture(const std::wstring& sDeviceName, const AudioFormat& format, std::string& sErrorText)
+{
+    UINT iDeviceID = WAVE_MAPPER;
+
+    std::vector<std::wstring> vDevices = getInputDevices();
+
+    for (size_t i = 0; i < vDevices.size(); i++)
+    {
+        if (vDevices[i] == sDeviceName)
+        {
+            iDeviceID = static_cast<UINT>(i);
+            break;
+        }
+    }
+
+
+    WinMMCaptureStream* pStream = new WinMMCaptureStream(format, bEventDrivenCapture);
+
+    if ( pStream->open(iDeviceID, format, sErrorText) )
+    {
+        delete pStream;
+
+        return nullptr;
+    }
+
+    return pStream;
+}
+
+AudioPlaybackStream* WinMMAudioBackend::openPlayback(const AudioFormat& format, std::string& sErrorText)
+{
+    WAVEFORMATEX waveFormat = makeWaveFormat(format);
+
+    HWAVEOUT hWaveOut;
+    MMRESULT result = waveOutOpen( &hWaveOut,  WAVE_MAPPER,  &waveFormat,  0L,  0L,  WAVE_FORMAT_DIRECT );
+
+    if (result)
+    {
+        sErrorText = getWaveOutErrorText("waveOutOpen", result);
+
+        return nullptr;
+    }
+
+    return new WinMMPlaybackStream(hWaveOut, format);
+}
+
+
+#endif // _WIN32
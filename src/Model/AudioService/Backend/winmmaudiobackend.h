@@ -0,0 +1,48 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+#ifdef _WIN32
+
+
+// Custom
+#include "Model/AudioService/Backend/audiobackend.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Windows waveIn/waveOut.
+// The capture thread sleeps until the driver signals a recorded buffer (bEventDrivenCapture)
+// or polls the buffers every BUFFER_UPDATE_CHECK_MS.
+
+class WinMMAudioBackend : public AudioBackend
+{
+
+public:
+
+    WinMMAudioBackend(bool bEventDrivenCapture = true);
+
+
+    std::string  getName                 () const override;
+
+    std::vector<std::wstring> getInputDevices () override;
+
+
+    AudioCaptureStream*  openCapture     (const std::wstring& sDeviceName, const AudioFormat& format, std::string& sErrorText) override;
+
+    AudioPlaybackStream* openPlayback    (const AudioFormat& format, std::string& sErrorText) override;
+
+private:
+
+    bool bEventDrivenCapture;
+};
+
+
+#endif // _WIN32
@@ -0,0 +1,254 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "audiogain.h"
+
+
+// STL
+#include <climits>
+
+// Custom
+#include "Model/AudioService/DSP/cpufeatures.h"
+
+
+namespace
+{
+    typedef void (*GainKernel)(short* pSamples, size_t iSampleCount, float fGain, float fSecondGain);
+
+
+    inline short gainSample(short iSample, float fGain)
+    {
+        int iNewValue = static_cast <int> (iSample * fGain);
+
+        if      (iNewValue > SHRT_MAX)
+        {
+            return SHRT_MAX;
+        }
+        else if (iNewValue < SHRT_MIN)
+        {
+            return SHRT_MIN;
+        }
+        else
+        {
+            return static_cast <short> (iNewValue);
+        }
+    }
+
+    void gainScalar(short* pSamples, size_t iSampleCount, float fGain, float fSecondGain)
+    {
+        if (fSecondGain == 1.0f)
+        {
+            for (size_t i = 0; i < iSampleCount; i++)
+            {
+                pSamples[i] = gainSample(pSamples[i], fGain);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < iSampleCount; i++)
+            {
+                pSamples[i] = gainSample( gainSample(pSamples[i], fGain), fSecondGain );
+            }
+        }
+    }
+
+
+    // ---------------------------------------
+
+
+    // Every kernel does the same as gainSample(): int16 -> float (exact), float multiply (same rounding as scalar),
+    // truncate to int32 (as static_cast<int>), saturate to int16 (signed pack).
+
+#ifdef SILENT_DSP_X86
+
+    // The unpack + shift sign-extends int16 to int32 (SSE2 has no cvtepi16_epi32),
+    // the pack puts the samples back in the same order.
+
+    template <bool bTwoGains>
+    void gainSSE2(short* pSamples, size_t iSampleCount, float fGain, float fSecondGain)
+    {
+        const __m128 gain       = _mm_set1_ps(fGain);
+        const __m128 secondGain = _mm_set1_ps(fSecondGain);
+
+        size_t i = 0;
+
+        for (; i + 8 <= iSampleCount; i += 8)
+        {
+            __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSamples + i));
+
+            __m128i low  = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+            __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+
+            low  = _mm_cvttps_epi32( _mm_mul_ps(_mm_cvtepi32_ps(low),  gain) );
+            high = _mm_cvttps_epi32( _mm_mul_ps(_mm_cvtepi32_ps(high), gain) );
+
+            samples = _mm_packs_epi32(low, high);
+
+            if (bTwoGains)
+            {
+                low  = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+                high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+
+                low  = _mm_cvttps_epi32( _mm_mul_ps(_mm_cvtepi32_ps(low),  secondGain) );
+                high = _mm_cvttps_epi32( _mm_mul_ps(_mm_cvtepi32_ps(high), secondGain) );
+
+                samples = _mm_packs_epi32(low, high);
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pSamples + i), samples);
+        }
+
+        gainScalar(pSamples + i, iSampleCount - i, fGain, fSecondGain);
+    }
+
+    // Same as SSE2 but unpack/pack work inside each 128 bit lane so the order is kept without permutes.
+
+    template <bool bTwoGains>
+    SILENT_TARGET_AVX2 void gainAVX2(short* pSamples, size_t iSampleCount, float fGain, float fSecondGain)
+    {
+        const __m256 gain       = _mm256_set1_ps(fGain);
+        const __m256 secondGain = _mm256_set1_ps(fSecondGain);
+
+        size_t i = 0;
+
+        for (; i + 16 <= iSampleCount; i += 16)
+        {
+            __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSamples + i));
+
+            __m256i low  = _mm256_srai_epi32(_mm256_unpacklo_epi16(samples, samples), 16);
+            __m256i high = _mm256_srai_epi32(_mm256_unpackhi_epi16(samples, samples), 16);
+
+            low  = _mm256_cvttps_epi32( _mm256_mul_ps(_mm256_cvtepi32_ps(low),  gain) );
+            high = _mm256_cvttps_epi32( _mm256_mul_ps(_mm256_cvtepi32_ps(high), gain) );
+
+            samples = _mm256_packs_epi32(low, high);
+
+            if (bTwoGains)
+            {
+                low  = _mm256_srai_epi32(_mm256_unpacklo_epi16(samples, samples), 16);
+                high = _mm256_srai_epi32(_mm256_unpackhi_epi16(samples, samples), 16);
+
+                low  = _mm256_cvttps_epi32( _mm256_mul_ps(_mm256_cvtepi32_ps(low),  secondGain) );
+                high = _mm256_cvttps_epi32( _mm256_mul_ps(_mm256_cvtepi32_ps(high), secondGain) );
+
+                samples = _mm256_packs_epi32(low, high);
+            }
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pSamples + i), samples);
+        }
+
+
+        // The rest of the program is SSE code, mixing it with dirty upper halves of the YMM registers is very slow
+        // (GCC does not add this on its own before the tail call).
+
+        _mm256_zeroupper();
+
+        gainScalar(pSamples + i, iSampleCount - i, fGain, fSecondGain);
+    }
+
+    void gainSSE2Dispatch(short* pSamples, size_t iSampleCount, float fGain, float fSecondGain)
+    {
+        if (fSecondGain == 1.0f) gainSSE2<false>(pSamples, iSampleCount, fGain, fSecondGain);
+        else                     gainSSE2<true> (pSamples, iSampleCount, fGain, fSecondGain);
+    }
+
+    void gainAVX2Dispatch(short* pSamples, size_t iSampleCount, float fGain, float fSecondGain)
+    {
+        if (fSecondGain == 1.0f) gainAVX2<false>(pSamples, iSampleCount, fGain, fSecondGain);
+        else                     gainAVX2<true> (pSamples, iSampleCount, fGain, fSecondGain);
+    }
+
+#endif // SILENT_DSP_X86
+
+
+#ifdef SILENT_DSP_NEON
+
+    // vcvtq_s32_f32 truncates (and saturates), vqmovn_s32 is the saturating narrow.
+
+    void gainNEON(short* pSamples, size_t iSampleCount, float fGain, float fSecondGain)
+    {
+        const bool bTwoGains = (fSecondGain != 1.0f);
+
+        size_t i = 0;
+
+        for (; i + 8 <= iSampleCount; i += 8)
+        {
+            int16x8_t samples = vld1q_s16(pSamples + i);
+
+            int32x4_t low  = vcvtq_s32_f32( vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))),  fGain) );
+            int32x4_t high = vcvtq_s32_f32( vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), fGain) );
+
+            samples = vcombine_s16(vqmovn_s32(low), vqmovn_s32(high));
+
+            if (bTwoGains)
+            {
+                low  = vcvtq_s32_f32( vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))),  fSecondGain) );
+                high = vcvtq_s32_f32( vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), fSecondGain) );
+
+                samples = vcombine_s16(vqmovn_s32(low), vqmovn_s32(high));
+            }
+
+            vst1q_s16(pSamples + i, samples);
+        }
+
+        gainScalar(pSamples + i, iSampleCount - i, fGain, fSecondGain);
+    }
+
+#endif // SILENT_DSP_NEON
+
+
+    // ---------------------------------------
+
+
+    struct GainKernelInfo
+    {
+        GainKernel  pKernel;
+        const char* pName;
+    };
+
+    const GainKernelInfo& getGainKernel()
+    {
+        // Checked once (thread-safe static init).
+
+        static const GainKernelInfo kernel = []()
+        {
+#if defined(SILENT_DSP_X86)
+            if ( CPUFeatures::hasAVX2() )
+            {
+                return GainKernelInfo{ &gainAVX2Dispatch, "AVX2" };
+            }
+
+            return GainKernelInfo{ &gainSSE2Dispatch, "SSE2" };
+#elif defined(SILENT_DSP_NEON)
+            return GainKernelInfo{ &gainNEON, "NEON" };
+#else
+            return GainKernelInfo{ &gainScalar, "scalar" };
+#endif
+        }();
+
+        return kernel;
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+void AudioGain::apply(short* pSamples, size_t iSampleCount, float fGain, float fSecondGain)
+{
+    getGainKernel().pKernel(pSamples, iSampleCount, fGain, fSecondGain);
+}
+
+void AudioGain::applyScalar(short* pSamples, size_t iSampleCount, float fGain, float fSecondGain)
+{
+    gainScalar(pSamples, iSampleCount, fGain, fSecondGain);
+}
+
+const char* AudioGain::getKernelName()
+{
+    return getGainKernel().pName;
+}
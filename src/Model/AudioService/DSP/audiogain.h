@@ -0,0 +1,38 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <cstddef>
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Volume for PCM16: sample = clamp( static_cast<int>(sample * fGain), SHRT_MIN, SHRT_MAX ).
+// apply() picks the widest kernel the CPU has (AVX2, SSE2, NEON or scalar),
+// all of them give exactly the same samples as applyScalar().
+
+class AudioGain
+{
+
+public:
+
+    // fSecondGain is applied to the saturated result of fGain (same as two apply() calls but in one pass).
+    // Gains must be in [0, 65536).
+
+    static void         apply         (short* pSamples, size_t iSampleCount, float fGain, float fSecondGain = 1.0f);
+
+    static void         applyScalar   (short* pSamples, size_t iSampleCount, float fGain, float fSecondGain = 1.0f);
+
+
+    // "AVX2", "SSE2", "NEON" or "scalar".
+
+    static const char*  getKernelName ();
+};
@@ -0,0 +1,248 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "audiomix.h"
+
+
+// Custom
+#include "Model/AudioService/DSP/cpufeatures.h"
+
+
+namespace
+{
+    typedef void (*AccumulateKernel)(float* pMix, const short* pSamples, size_t iSampleCount, float fGain);
+    typedef void (*ToPCM16Kernel)   (const float* pMix, short* pSamples, size_t iSampleCount);
+
+
+    void accumulateScalar(float* pMix, const short* pSamples, size_t iSampleCount, float fGain)
+    {
+        for (size_t i = 0; i < iSampleCount; i++)
+        {
+            pMix[i] += static_cast<float>(pSamples[i]) * fGain;
+        }
+    }
+
+    void toPCM16Scalar(const float* pMix, short* pSamples, size_t iSampleCount)
+    {
+        for (size_t i = 0; i < iSampleCount; i++)
+        {
+            float fSample = pMix[i];
+
+            // Clamped before the conversion, a sum of many speakers does not fit int32 only in theory.
+
+            if      (fSample > 32767.0f)
+            {
+                fSample = 32767.0f;
+            }
+            else if (fSample < -32768.0f)
+            {
+                fSample = -32768.0f;
+            }
+
+            pSamples[i] = static_cast<short>( static_cast<int>(fSample) );
+        }
+    }
+
+
+    // ---------------------------------------
+
+
+    // Every kernel: int16 -> float (exact), multiply, then add (no FMA, same rounding as scalar),
+    // clamp in float, truncate to int32 (as static_cast<int>), pack to int16 (already in range).
+
+#ifdef SILENT_DSP_X86
+
+    // The unpack + shift sign-extends int16 to int32 (SSE2 has no cvtepi16_epi32).
+
+    void accumulateSSE2(float* pMix, const short* pSamples, size_t iSampleCount, float fGain)
+    {
+        const __m128 gain = _mm_set1_ps(fGain);
+
+        size_t i = 0;
+
+        for (; i + 8 <= iSampleCount; i += 8)
+        {
+            const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSamples + i));
+
+            const __m128 low  = _mm_cvtepi32_ps( _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16) );
+            const __m128 high = _mm_cvtepi32_ps( _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16) );
+
+            _mm_storeu_ps( pMix + i,     _mm_add_ps(_mm_loadu_ps(pMix + i),     _mm_mul_ps(low,  gain)) );
+            _mm_storeu_ps( pMix + i + 4, _mm_add_ps(_mm_loadu_ps(pMix + i + 4), _mm_mul_ps(high, gain)) );
+        }
+
+        accumulateScalar(pMix + i, pSamples + i, iSampleCount - i, fGain);
+    }
+
+    void toPCM16SSE2(const float* pMix, short* pSamples, size_t iSampleCount)
+    {
+        const __m128 maxValue = _mm_set1_ps(32767.0f);
+        const __m128 minValue = _mm_set1_ps(-32768.0f);
+
+        size_t i = 0;
+
+        for (; i + 8 <= iSampleCount; i += 8)
+        {
+            const __m128i low  = _mm_cvttps_epi32( _mm_max_ps(_mm_min_ps(_mm_loadu_ps(pMix + i),     maxValue), minValue) );
+            const __m128i high = _mm_cvttps_epi32( _mm_max_ps(_mm_min_ps(_mm_loadu_ps(pMix + i + 4), maxValue), minValue) );
+
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pSamples + i), _mm_packs_epi32(low, high) );
+        }
+
+        toPCM16Scalar(pMix + i, pSamples + i, iSampleCount - i);
+    }
+
+    SILENT_TARGET_AVX2 void accumulateAVX2(float* pMix, const short* pSamples, size_t iSampleCount, float fGain)
+    {
+        const __m256 gain = _mm256_set1_ps(fGain);
+
+        size_t i = 0;
+
+        for (; i + 8 <= iSampleCount; i += 8)
+        {
+            const __m256 samples = _mm256_cvtepi32_ps( _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSamples + i))) );
+
+            _mm256_storeu_ps( pMix + i, _mm256_add_ps(_mm256_loadu_ps(pMix + i), _mm256_mul_ps(samples, gain)) );
+        }
+
+        _mm256_zeroupper();
+
+        accumulateScalar(pMix + i, pSamples + i, iSampleCount - i, fGain);
+    }
+
+    // packs works inside each 128 bit lane, the permute puts the samples back in order.
+
+    SILENT_TARGET_AVX2 void toPCM16AVX2(const float* pMix, short* pSamples, size_t iSampleCount)
+    {
+        const __m256 maxValue = _mm256_set1_ps(32767.0f);
+        const __m256 minValue = _mm256_set1_ps(-32768.0f);
+
+        size_t i = 0;
+
+        for (; i + 16 <= iSampleCount; i += 16)
+        {
+            const __m256i low  = _mm256_cvttps_epi32( _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(pMix + i),     maxValue), minValue) );
+            const __m256i high = _mm256_cvttps_epi32( _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(pMix + i + 8), maxValue), minValue) );
+
+            const __m256i samples = _mm256_permute4x64_epi64( _mm256_packs_epi32(low, high), 0xD8 );
+
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>(pSamples + i), samples );
+        }
+
+        _mm256_zeroupper();
+
+        toPCM16Scalar(pMix + i, pSamples + i, iSampleCount - i);
+    }
+
+#endif // SILENT_DSP_X86
+
+
+#ifdef SILENT_DSP_NEON
+
+    void accumulateNEON(float* pMix, const short* pSamples, size_t iSampleCount, float fGain)
+    {
+        size_t i = 0;
+
+        for (; i + 8 <= iSampleCount; i += 8)
+        {
+            const int16x8_t samples = vld1q_s16(pSamples + i);
+
+            // vmulq + vaddq, not vmlaq (that one may be fused on AArch64).
+
+            const float32x4_t low  = vmulq_n_f32( vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))),  fGain );
+            const float32x4_t high = vmulq_n_f32( vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), fGain );
+
+            vst1q_f32( pMix + i,     vaddq_f32(vld1q_f32(pMix + i),     low) );
+            vst1q_f32( pMix + i + 4, vaddq_f32(vld1q_f32(pMix + i + 4), high) );
+        }
+
+        accumulateScalar(pMix + i, pSamples + i, iSampleCount - i, fGain);
+    }
+
+    void toPCM16NEON(const float* pMix, short* pSamples, size_t iSampleCount)
+    {
+        const float32x4_t maxValue = vdupq_n_f32(32767.0f);
+        const float32x4_t minValue = vdupq_n_f32(-32768.0f);
+
+        size_t i = 0;
+
+        for (; i + 8 <= iSampleCount; i += 8)
+        {
+            const int32x4_t low  = vcvtq_s32_f32( vmaxq_f32(vminq_f32(vld1q_f32(pMix + i),     maxValue), minValue) );
+            const int32x4_t high = vcvtq_s32_f32( vmaxq_f32(vminq_f32(vld1q_f32(pMix + i + 4), maxValue), minValue) );
+
+            vst1q_s16( pSamples + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)) );
+        }
+
+        toPCM16Scalar(pMix + i, pSamples + i, iSampleCount - i);
+    }
+
+#endif // SILENT_DSP_NEON
+
+
+    // ---------------------------------------
+
+
+    struct MixKernelInfo
+    {
+        AccumulateKernel pAccumulate;
+        ToPCM16Kernel    pToPCM16;
+        const char*      pName;
+    };
+
+    const MixKernelInfo& getMixKernel()
+    {
+        // Checked once (thread-safe static init).
+
+        static const MixKernelInfo kernel = []()
+        {
+#if defined(SILENT_DSP_X86)
+            if ( CPUFeatures::hasAVX2() )
+            {
+                return MixKernelInfo{ &accumulateAVX2, &toPCM16AVX2, "AVX2" };
+            }
+
+            return MixKernelInfo{ &accumulateSSE2, &toPCM16SSE2, "SSE2" };
+#elif defined(SILENT_DSP_NEON)
+            return MixKernelInfo{ &accumulateNEON, &toPCM16NEON, "NEON" };
+#else
+            return MixKernelInfo{ &accumulateScalar, &toPCM16Scalar, "scalar" };
+#endif
+        }();
+
+        return kernel;
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+void AudioMix::accumulate(float* pMix, const short* pSamples, size_t iSampleCount, float fGain)
+{
+    getMixKernel().pAccumulate(pMix, pSamples, iSampleCount, fGain);
+}
+
+void AudioMix::accumulateScalar(float* pMix, const short* pSamples, size_t iSampleCount, float fGain)
+{
+    ::accumulateScalar(pMix, pSamples, iSampleCount, fGain);
+}
+
+void AudioMix::toPCM16(const float* pMix, short* pSamples, size_t iSampleCount)
+{
+    getMixKernel().pToPCM16(pMix, pSamples, iSampleCount);
+}
+
+void AudioMix::toPCM16Scalar(const float* pMix, short* pSamples, size_t iSampleCount)
+{
+    ::toPCM16Scalar(pMix, pSamples, iSampleCount);
+}
+
+const char* AudioMix::getKernelName()
+{
+    return getMixKernel().pName;
+}
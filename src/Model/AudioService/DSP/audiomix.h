@@ -0,0 +1,46 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <cstddef>
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Summing PCM16 packets of several speakers (AudioMixer).
+// The sum is kept in float so that the speakers can be louder than PCM16 together,
+// it's saturated once when converted back.
+// The functions pick the widest kernel the CPU has (AVX2, SSE2, NEON or scalar),
+// all of them give exactly the same samples as the scalar versions.
+
+class AudioMix
+{
+
+public:
+
+    // pMix[i] += pSamples[i] * fGain.
+
+    static void         accumulate        (float* pMix, const short* pSamples, size_t iSampleCount, float fGain);
+
+    static void         accumulateScalar  (float* pMix, const short* pSamples, size_t iSampleCount, float fGain);
+
+
+    // pSamples[i] = static_cast<int>( clamp(pMix[i], SHRT_MIN, SHRT_MAX) ).
+
+    static void         toPCM16           (const float* pMix, short* pSamples, size_t iSampleCount);
+
+    static void         toPCM16Scalar     (const float* pMix, short* pSamples, size_t iSampleCount);
+
+
+    // "AVX2", "SSE2", "NEON" or "scalar".
+
+    static const char*  getKernelName     ();
+};
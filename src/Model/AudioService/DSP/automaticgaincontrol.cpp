@@ -0,0 +1,115 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "automaticgaincontrol.h"
+
+
+// STL
+#include <cmath>
+#include <algorithm>
+
+// Custom
+#include "Model/AudioService/DSP/audiogain.h"
+#include "Model/AudioService/DSP/levelmeter.h"
+
+
+AutomaticGainControl::AutomaticGainControl(unsigned int iSampleRate, int iTargetDBFS)
+{
+    this->iSampleRate = iSampleRate;
+
+    setTargetDBFS(iTargetDBFS);
+
+    bEnabled = true;
+
+    reset();
+}
+
+void AutomaticGainControl::process(short* pSamples, size_t iSampleCount)
+{
+    if ( (bEnabled == false) || (iSampleCount == 0) )
+    {
+        return;
+    }
+
+
+    const AudioLevel level = LevelMeter::measure(pSamples, iSampleCount);
+
+    const double dRMSDBFS = level.getRMSDBFS();
+
+    if (dRMSDBFS >= AGC_GATE_DBFS)
+    {
+        const double dWantedGainDB = std::max(AGC_MIN_GAIN_DB, std::min(AGC_MAX_GAIN_DB, dTargetDBFS - dRMSDBFS));
+
+        const double dElapsedMs    = 1000.0 * iSampleCount / iSampleRate;
+        const double dTimeMs       = (dWantedGainDB < dGainDB) ? AGC_ATTACK_MS : AGC_RELEASE_MS;
+
+        dGainDB += (dWantedGainDB - dGainDB) * (1 - exp(-dElapsedMs / dTimeMs));
+    }
+
+
+    // The peak limit is only for this packet (the smoothed gain stays as it is).
+
+    float fGain      = static_cast<float>( pow(10.0, dGainDB / 20) );
+    float fStartGain = fLastAppliedGain;
+
+    if (level.iPeak > 0)
+    {
+        const float fPeakLimitGain = static_cast<float>( pow(10.0, (AGC_PEAK_LIMIT_DBFS - level.getPeakDBFS()) / 20) );
+
+        // The ramp must not start above it either (the gain of the last packet may be higher),
+        // the peak may be at the start of the packet.
+
+        fGain      = std::min(fGain,      fPeakLimitGain);
+        fStartGain = std::min(fStartGain, fPeakLimitGain);
+    }
+
+
+    // Ramp from the gain of the last packet.
+
+    size_t iDone = 0;
+
+    for (size_t iStep = 1; iStep <= AGC_RAMP_STEPS; iStep++)
+    {
+        const size_t iEnd      = iSampleCount * iStep / AGC_RAMP_STEPS;
+        const float  fStepGain = fStartGain + (fGain - fStartGain) * iStep / AGC_RAMP_STEPS;
+
+        AudioGain::apply(pSamples + iDone, iEnd - iDone, fStepGain);
+
+        iDone = iEnd;
+    }
+
+    fLastAppliedGain = fGain;
+}
+
+void AutomaticGainControl::setEnabled(bool bEnabled)
+{
+    if ( bEnabled && (this->bEnabled == false) )
+    {
+        reset();
+    }
+
+    this->bEnabled = bEnabled;
+}
+
+void AutomaticGainControl::setTargetDBFS(int iTargetDBFS)
+{
+    dTargetDBFS = std::max(AGC_MIN_TARGET_DBFS, std::min(AGC_MAX_TARGET_DBFS, iTargetDBFS));
+}
+
+void AutomaticGainControl::reset()
+{
+    dGainDB          = 0.0;
+    fLastAppliedGain = 1.0f;
+}
+
+bool AutomaticGainControl::isEnabled() const
+{
+    return bEnabled;
+}
+
+double AutomaticGainControl::getGainDB() const
+{
+    return dGainDB;
+}
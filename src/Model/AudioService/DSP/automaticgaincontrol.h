@@ -0,0 +1,83 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <cstddef>
+
+
+// Target voice loudness (RMS, dBFS relative to SHRT_MAX).
+#define  AGC_DEFAULT_TARGET_DBFS   -20
+#define  AGC_MIN_TARGET_DBFS       -30
+#define  AGC_MAX_TARGET_DBFS       -10
+
+// The gain never goes beyond these.
+#define  AGC_MIN_GAIN_DB           -20.0
+#define  AGC_MAX_GAIN_DB           20.0
+
+// Time constants: the gain goes down fast (a loud voice must not clip for long)
+// and comes back up slowly (no pumping between words).
+#define  AGC_ATTACK_MS             50.0
+#define  AGC_RELEASE_MS            1500.0
+
+// Quieter packets don't change the gain (pauses, background noise would be raised to the target).
+#define  AGC_GATE_DBFS             -50.0
+
+// The gain of a packet is lowered so that its peak stays under this.
+#define  AGC_PEAK_LIMIT_DBFS       -1.0
+
+// The gain changes in this many steps over a packet (instead of a jump between packets).
+#define  AGC_RAMP_STEPS            8
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Brings the voice to the target loudness before it is sent, so that all users sound about the same.
+// Not thread safe, call everything from the capture thread.
+
+class AutomaticGainControl
+{
+
+public:
+
+    AutomaticGainControl(unsigned int iSampleRate, int iTargetDBFS = AGC_DEFAULT_TARGET_DBFS);
+
+
+    // In place. Does nothing if disabled.
+
+    void         process          (short* pSamples, size_t iSampleCount);
+
+    // Turning it on again starts from 0 dB.
+
+    void         setEnabled       (bool bEnabled);
+
+    // Clamped to [AGC_MIN_TARGET_DBFS, AGC_MAX_TARGET_DBFS].
+
+    void         setTargetDBFS    (int iTargetDBFS);
+
+    void         reset            ();
+
+
+    bool         isEnabled        () const;
+
+    // Smoothed gain (without the peak limit).
+
+    double       getGainDB        () const;
+
+private:
+
+    unsigned int iSampleRate;
+
+    double       dTargetDBFS;
+    double       dGainDB;
+    float        fLastAppliedGain;
+
+    bool         bEnabled;
+};
@@ -0,0 +1,66 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "cpufeatures.h"
+
+
+// Other
+#if defined(SILENT_DSP_X86) && defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+
+namespace
+{
+    bool checkAVX2()
+    {
+#if defined(SILENT_DSP_X86) && defined(_MSC_VER)
+        int vInfo[4];
+
+        __cpuid(vInfo, 0);
+
+        if (vInfo[0] < 7)
+        {
+            return false;
+        }
+
+
+        // The OS must save the YMM registers (OSXSAVE + XCR0) and the CPU must have AVX and AVX2.
+
+        __cpuid(vInfo, 1);
+
+        const bool bOSXSave = (vInfo[2] & (1 << 27)) != 0;
+        const bool bAVX     = (vInfo[2] & (1 << 28)) != 0;
+
+        if ( (bOSXSave == false) || (bAVX == false) || ((_xgetbv(0) & 0x6) != 0x6) )
+        {
+            return false;
+        }
+
+        __cpuidex(vInfo, 7, 0);
+
+        return (vInfo[1] & (1 << 5)) != 0;
+#elif defined(SILENT_DSP_X86)
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+bool CPUFeatures::hasAVX2()
+{
+    // Checked once (thread-safe static init).
+
+    static const bool bHasAVX2 = checkAVX2();
+
+    return bHasAVX2;
+}
@@ -0,0 +1,42 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// Other
+#if defined(_M_X64) || defined(_M_IX86) || ( (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) )
+    #define SILENT_DSP_X86
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    #define SILENT_DSP_NEON
+    #include <arm_neon.h>
+#endif
+
+
+// MSVC compiles AVX2 intrinsics anywhere, GCC and Clang need the target attribute.
+#if defined(SILENT_DSP_X86) && !defined(_MSC_VER)
+    #define SILENT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define SILENT_TARGET_AVX2
+#endif
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// SSE2 (x86) and NEON (ARM) are always there when SILENT_DSP_X86/SILENT_DSP_NEON is defined,
+// AVX2 has to be checked at runtime.
+// AVX2 kernels must call _mm256_zeroupper() before calling non-AVX code (GCC does not always add it).
+
+class CPUFeatures
+{
+
+public:
+
+    static bool hasAVX2 ();
+};
@@ -0,0 +1,252 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "driftcompensator.h"
+
+
+// STL
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+
+PacketPeriodEstimator::PacketPeriodEstimator(double dNominalPeriodMs)
+{
+    this->dNominalPeriodMs = dNominalPeriodMs;
+
+    dForgetPerPacket = 1.0 - 1.0 / DRIFT_ESTIMATE_WINDOW_PACKETS;
+
+    reset();
+}
+
+void PacketPeriodEstimator::addPacket(double dTimeMs)
+{
+    if (bFirstPacket)
+    {
+        bFirstPacket = false;
+
+        dLastTimeMs = dTimeMs;
+        dSumW       = 1.0;
+
+        return;
+    }
+
+
+    // Several packets may come at once after a delay (0 periods) or be lost (2 or more).
+
+    const double dGapMs = dTimeMs - dLastTimeMs;
+    const double dGap   = std::max(0.0, std::round(dGapMs / dNominalPeriodMs));
+
+
+    // Move the old packets so that this one is at (0, 0).
+
+    dSumNT = dSumNT - dGapMs * dSumN - dGap * dSumT + dGap * dGapMs * dSumW;
+    dSumNN = dSumNN - 2.0 * dGap * dSumN + dGap * dGap * dSumW;
+    dSumN  = dSumN  - dGap * dSumW;
+    dSumT  = dSumT  - dGapMs * dSumW;
+
+    if (dGap > 0.0)
+    {
+        const double dForget = std::pow(dForgetPerPacket, dGap);
+
+        dSumW  *= dForget;
+        dSumN  *= dForget;
+        dSumT  *= dForget;
+        dSumNN *= dForget;
+        dSumNT *= dForget;
+    }
+
+    dSumW += 1.0;
+
+    dLastTimeMs = dTimeMs;
+}
+
+double PacketPeriodEstimator::getPeriodMs() const
+{
+    const double dDenominator = dSumW * dSumNN - dSumN * dSumN;
+
+    if ( (isReady() == false) || (dDenominator <= 0.0) )
+    {
+        return dNominalPeriodMs;
+    }
+
+    return (dSumW * dSumNT - dSumN * dSumT) / dDenominator;
+}
+
+bool PacketPeriodEstimator::isReady() const
+{
+    return dSumW >= DRIFT_ESTIMATE_MIN_PACKETS;
+}
+
+void PacketPeriodEstimator::reset()
+{
+    dSumW  = 0.0;
+    dSumN  = 0.0;
+    dSumT  = 0.0;
+    dSumNN = 0.0;
+    dSumNT = 0.0;
+
+    dLastTimeMs  = 0.0;
+    bFirstPacket = true;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+DriftCompensator::DriftCompensator(size_t iSamplesPerPacket, double dPacketPeriodMs, double dTargetLevelInPackets)
+    : arrivalPeriod(dPacketPeriodMs), playbackPeriod(dPacketPeriodMs)
+{
+    this->iSamplesPerPacket     = iSamplesPerPacket;
+    this->dTargetLevelInPackets = dTargetLevelInPackets;
+
+    // Up to 2 packets + the ones that the ratio may need.
+    vInput.reserve(iSamplesPerPacket * 3 + 4);
+    vInput.assign(1, 0);
+
+    dInputPos       = 1.0;
+    dRatio          = 1.0;
+    dDrift          = 0.0;
+    dLevelInPackets = 0.0;
+    bLevelKnown     = false;
+}
+
+void DriftCompensator::onPacketArrived(double dTimeMs)
+{
+    arrivalPeriod.addPacket(dTimeMs);
+}
+
+void DriftCompensator::addInput(const short* pSamples)
+{
+    // Keep one sample before the position.
+
+    const size_t iUsedCount = static_cast<size_t>(dInputPos) - 1;
+
+    if (iUsedCount > 0)
+    {
+        vInput.erase(vInput.begin(), vInput.begin() + static_cast<std::ptrdiff_t>(iUsedCount));
+        dInputPos -= static_cast<double>(iUsedCount);
+    }
+
+    vInput.insert(vInput.end(), pSamples, pSamples + iSamplesPerPacket);
+}
+
+bool DriftCompensator::canProduce() const
+{
+    return vInput.size() >= getNeededInputCount();
+}
+
+bool DriftCompensator::hasInput() const
+{
+    return vInput.size() > static_cast<size_t>(dInputPos);
+}
+
+void DriftCompensator::produce(short* pOutput, double dQueuedPackets, double dTimeMs)
+{
+    playbackPeriod.addPacket(dTimeMs);
+
+
+    // Queue level (with what is not played from vInput).
+
+    const double dBufferedPackets = getBufferedInputCount() / static_cast<double>(iSamplesPerPacket);
+    const double dLevelInPackets  = dQueuedPackets + dBufferedPackets;
+
+    if (bLevelKnown)
+    {
+        this->dLevelInPackets += (dLevelInPackets - this->dLevelInPackets) / DRIFT_LEVEL_SMOOTHING_PACKETS;
+    }
+    else
+    {
+        this->dLevelInPackets = dLevelInPackets;
+        bLevelKnown = true;
+    }
+
+
+    // Speed.
+
+    if ( arrivalPeriod.isReady() && playbackPeriod.isReady() )
+    {
+        dDrift = playbackPeriod.getPeriodMs() / arrivalPeriod.getPeriodMs() - 1.0;
+        dDrift = std::max(-DRIFT_MAX_RATIO_ADJUST, std::min(DRIFT_MAX_RATIO_ADJUST, dDrift));
+    }
+
+    const double dAdjust = dDrift + DRIFT_LEVEL_CORRECTION_PER_PACKET * (this->dLevelInPackets - dTargetLevelInPackets);
+
+    dRatio = 1.0 + std::max(-DRIFT_MAX_RATIO_ADJUST, std::min(DRIFT_MAX_RATIO_ADJUST, dAdjust));
+
+
+    // Resample (Catmull-Rom).
+
+    if (pOutput)
+    {
+        const size_t iInputCount = vInput.size();
+        double       dPos        = dInputPos;
+
+        for (size_t i = 0; i < iSamplesPerPacket; i++)
+        {
+            const size_t iIndex = static_cast<size_t>(dPos);
+            const double dFrac  = dPos - static_cast<double>(iIndex);
+
+            const double x0  = (iIndex     < iInputCount) ? vInput[iIndex]     : 0.0;
+            const double xm1 = (iIndex - 1 < iInputCount) ? vInput[iIndex - 1] : 0.0;
+            const double x1  = (iIndex + 1 < iInputCount) ? vInput[iIndex + 1] : 0.0;
+            const double x2  = (iIndex + 2 < iInputCount) ? vInput[iIndex + 2] : 0.0;
+
+            const double dSample = x0 + 0.5 * dFrac * (x1 - xm1 + dFrac * (2.0 * xm1 - 5.0 * x0 + 4.0 * x1 - x2
+                                                                          + dFrac * (3.0 * (x0 - x1) + x2 - xm1)));
+
+            pOutput[i] = static_cast<short>( std::max(static_cast<double>(SHRT_MIN), std::min(static_cast<double>(SHRT_MAX), std::round(dSample))) );
+
+            dPos += dRatio;
+        }
+    }
+
+    dInputPos += dRatio * static_cast<double>(iSamplesPerPacket);
+
+
+    // Ran out of input (the end of the phrase), the last sample is the history.
+
+    if (dInputPos > static_cast<double>(vInput.size()))
+    {
+        dInputPos = static_cast<double>(vInput.size());
+    }
+}
+
+void DriftCompensator::endPhrase()
+{
+    vInput.assign(1, 0);
+
+    dInputPos   = 1.0;
+    bLevelKnown = false;
+}
+
+double DriftCompensator::getRatio() const
+{
+    return dRatio;
+}
+
+double DriftCompensator::getDriftPPM() const
+{
+    return dDrift * 1000000.0;
+}
+
+double DriftCompensator::getLevelInPackets() const
+{
+    return dLevelInPackets;
+}
+
+double DriftCompensator::getBufferedInputCount() const
+{
+    return std::max(0.0, static_cast<double>(vInput.size()) - dInputPos);
+}
+
+size_t DriftCompensator::getNeededInputCount() const
+{
+    // The last output sample needs 2 samples after its position
+    // (at the max ratio, produce() may change it).
+    return static_cast<size_t>( dInputPos + (1.0 + DRIFT_MAX_RATIO_ADJUST) * static_cast<double>(iSamplesPerPacket - 1) ) + 3;
+}
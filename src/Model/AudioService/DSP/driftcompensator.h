@@ -0,0 +1,158 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <cstddef>
+#include <vector>
+
+
+// Max change of the playback speed (~9 cents, not audible in speech).
+// Sound cards differ by 0.01 - 0.03%, the rest is for bringing the queue back to the target.
+#define  DRIFT_MAX_RATIO_ADJUST             0.005
+
+// Periods are estimated over about this many packets (~1 min.), older ones are forgotten.
+#define  DRIFT_ESTIMATE_WINDOW_PACKETS      1700.0
+
+// ...and the drift is not used until both have about this many packets (~10 sec.).
+#define  DRIFT_ESTIMATE_MIN_PACKETS         300.0
+
+// Queue level correction: ratio change per packet above/below the target (a packet too many is played out in ~10 sec.).
+#define  DRIFT_LEVEL_CORRECTION_PER_PACKET  0.0035
+
+// The queue level is averaged over about this many packets (~1 sec.) so that the network jitter is not followed.
+#define  DRIFT_LEVEL_SMOOTHING_PACKETS      30.0
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Packet period from timestamps (exponentially weighted least squares of the time over the packet number,
+// so the jitter averages out). The packet number is counted from the gaps (rounded to the nominal period),
+// so lost packets and pauses between phrases don't look like a slower clock.
+
+class PacketPeriodEstimator
+{
+
+public:
+
+    PacketPeriodEstimator(double dNominalPeriodMs);
+
+
+    void         addPacket                (double dTimeMs);
+
+    // The nominal period if there is not enough packets yet.
+
+    double       getPeriodMs              () const;
+
+    bool         isReady                  () const;
+
+    void         reset                    ();
+
+private:
+
+    // Relative to the last packet (so they don't grow in an hour-long session).
+    double       dSumW;
+    double       dSumN;
+    double       dSumT;
+    double       dSumNN;
+    double       dSumNT;
+
+    double       dLastTimeMs;
+    double       dNominalPeriodMs;
+    double       dForgetPerPacket;
+
+    bool         bFirstPacket;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+// Keeps the queue of one remote speaker at the target level when the sender's sound card
+// is a bit faster or slower than ours (otherwise the queue grows for the whole phrase or runs out).
+//
+// The drift is the arrival period against the playback period (both from timestamps in our clock),
+// it's kept between phrases (it's the same sound card).
+// The playback speed is 1 + drift + a small correction towards the target queue level,
+// the packets are resampled by that ratio (cubic interpolation, exactly the input when the ratio is 1).
+// Not thread safe.
+
+class DriftCompensator
+{
+
+public:
+
+    DriftCompensator(size_t iSamplesPerPacket, double dPacketPeriodMs, double dTargetLevelInPackets);
+
+
+    // A packet arrived (it's queued somewhere until addInput()).
+
+    void         onPacketArrived          (double dTimeMs);
+
+    // The next packet of the speaker (iSamplesPerPacket samples).
+
+    void         addInput                 (const short* pSamples);
+
+    // There is enough input for produce().
+
+    bool         canProduce               () const;
+
+    // There is some input left (less than canProduce() needs, see produce()).
+
+    bool         hasInput                 () const;
+
+
+    // Writes one packet played at the current speed (pOutput may be nullptr - the packet is skipped),
+    // dQueuedPackets - packets waiting before addInput() (the buffered input is added to it).
+    // If there is not enough input the rest is silence.
+
+    void         produce                  (short* pOutput, double dQueuedPackets, double dTimeMs);
+
+    // The speaker finished the phrase, drops the buffered input but not the drift estimate.
+
+    void         endPhrase                ();
+
+
+    // Input samples per output sample.
+
+    double       getRatio                 () const;
+
+    // Positive - the sender is faster.
+
+    double       getDriftPPM              () const;
+
+    // Smoothed, with the buffered input.
+
+    double       getLevelInPackets        () const;
+
+    // Input samples that are not played yet (produce() plays getRatio() * iSamplesPerPacket of them).
+
+    double       getBufferedInputCount    () const;
+
+private:
+
+    size_t       getNeededInputCount      () const;
+
+
+    PacketPeriodEstimator arrivalPeriod;
+    PacketPeriodEstimator playbackPeriod;
+
+    std::vector<short> vInput;    // vInput[0] is the sample before the current position (cubic interpolation)
+
+    double       dInputPos;       // in vInput, of the next output sample (>= 1)
+    double       dRatio;
+    double       dDrift;
+
+    double       dLevelInPackets;
+    double       dTargetLevelInPackets;
+    bool         bLevelKnown;
+
+    size_t       iSamplesPerPacket;
+};
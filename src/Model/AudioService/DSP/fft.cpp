@@ -0,0 +1,117 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "fft.h"
+
+
+// STL
+#include <cmath>
+#include <utility>
+
+
+FFT::FFT(size_t iSize)
+{
+    this->iSize = iSize;
+
+    const double dPi = 3.14159265358979;
+
+    vTwiddles.resize(iSize / 2);
+
+    for (size_t k = 0; k < vTwiddles.size(); k++)
+    {
+        const double dAngle = -2 * dPi * k / iSize;
+
+        vTwiddles[k] = std::complex<float>( static_cast<float>(cos(dAngle)), static_cast<float>(sin(dAngle)) );
+    }
+
+
+    size_t iBits = 0;
+
+    while ( (static_cast<size_t>(1) << iBits) < iSize )
+    {
+        iBits++;
+    }
+
+    vBitReversed.resize(iSize);
+
+    for (size_t i = 0; i < iSize; i++)
+    {
+        size_t iReversed = 0;
+
+        for (size_t iBit = 0; iBit < iBits; iBit++)
+        {
+            if ( i & (static_cast<size_t>(1) << iBit) )
+            {
+                iReversed |= static_cast<size_t>(1) << (iBits - 1 - iBit);
+            }
+        }
+
+        vBitReversed[i] = iReversed;
+    }
+}
+
+void FFT::forward(std::complex<float>* pData) const
+{
+    transform(pData, false);
+}
+
+void FFT::inverse(std::complex<float>* pData) const
+{
+    transform(pData, true);
+
+    const float fScale = 1.0f / iSize;
+
+    for (size_t i = 0; i < iSize; i++)
+    {
+        pData[i] *= fScale;
+    }
+}
+
+size_t FFT::getSize() const
+{
+    return iSize;
+}
+
+void FFT::transform(std::complex<float>* pData, bool bInverse) const
+{
+    for (size_t i = 0; i < iSize; i++)
+    {
+        if (i < vBitReversed[i])
+        {
+            std::swap(pData[i], pData[vBitReversed[i]]);
+        }
+    }
+
+
+    // Butterflies, the twiddle step halves with every stage.
+
+    for (size_t iHalf = 1; iHalf < iSize; iHalf *= 2)
+    {
+        const size_t iTwiddleStep = iSize / (iHalf * 2);
+
+        for (size_t iStart = 0; iStart < iSize; iStart += iHalf * 2)
+        {
+            for (size_t k = 0; k < iHalf; k++)
+            {
+                std::complex<float> twiddle = vTwiddles[k * iTwiddleStep];
+
+                if (bInverse)
+                {
+                    twiddle = std::conj(twiddle);
+                }
+
+                // Not operator*, it checks for NaN and infinity (slow and not needed here).
+
+                const std::complex<float>& value = pData[iStart + k + iHalf];
+
+                const std::complex<float> odd( value.real() * twiddle.real() - value.imag() * twiddle.imag(),
+                                               value.real() * twiddle.imag() + value.imag() * twiddle.real() );
+
+                pData[iStart + k + iHalf] = pData[iStart + k] - odd;
+                pData[iStart + k]        += odd;
+            }
+        }
+    }
+}
@@ -0,0 +1,49 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <complex>
+#include <vector>
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// In-place radix-2 complex FFT, the tables are made once in the constructor.
+
+class FFT
+{
+
+public:
+
+    // iSize must be a power of 2.
+
+    FFT(size_t iSize);
+
+
+    void         forward  (std::complex<float>* pData) const;
+
+    // Also divides by the size (inverse(forward(x)) == x).
+
+    void         inverse  (std::complex<float>* pData) const;
+
+
+    size_t       getSize  () const;
+
+private:
+
+    void         transform(std::complex<float>* pData, bool bInverse) const;
+
+
+    std::vector<std::complex<float>> vTwiddles;  // exp(-2 pi i k / N), k < N / 2
+    std::vector<size_t>              vBitReversed;
+
+    size_t       iSize;
+};
@@ -0,0 +1,361 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "levelmeter.h"
+
+
+// STL
+#include <cmath>
+#include <climits>
+#include <cstdint>
+
+// Custom
+#include "Model/AudioService/DSP/cpufeatures.h"
+
+
+namespace
+{
+    typedef void (*LevelKernel)(const short* pSamples, size_t iSampleCount, int& iMax, int& iMin, uint64_t& iSumOfSquares);
+
+
+    void levelScalar(const short* pSamples, size_t iSampleCount, int& iMax, int& iMin, uint64_t& iSumOfSquares)
+    {
+        for (size_t i = 0; i < iSampleCount; i++)
+        {
+            const int iSample = pSamples[i];
+
+            if (iSample > iMax) iMax = iSample;
+            if (iSample < iMin) iMin = iSample;
+
+            iSumOfSquares += static_cast<uint64_t>(iSample * iSample);
+        }
+    }
+
+
+    // ---------------------------------------
+
+
+    // Squares are summed as pairs by madd (up to 2 * 32768^2 = 2^31, so it's unsigned)
+    // and then widened to 64 bits, integer sums are exact so every kernel gives the same RMS.
+
+#ifdef SILENT_DSP_X86
+
+    void levelSSE2(const short* pSamples, size_t iSampleCount, int& iMax, int& iMin, uint64_t& iSumOfSquares)
+    {
+        __m128i maxValues = _mm_set1_epi16(SHRT_MIN);
+        __m128i minValues = _mm_set1_epi16(SHRT_MAX);
+        __m128i sums      = _mm_setzero_si128();
+
+        const __m128i zero = _mm_setzero_si128();
+
+        size_t i = 0;
+
+        for (; i + 8 <= iSampleCount; i += 8)
+        {
+            const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSamples + i));
+
+            maxValues = _mm_max_epi16(maxValues, samples);
+            minValues = _mm_min_epi16(minValues, samples);
+
+            const __m128i squares = _mm_madd_epi16(samples, samples);
+
+            sums = _mm_add_epi64(sums, _mm_unpacklo_epi32(squares, zero));
+            sums = _mm_add_epi64(sums, _mm_unpackhi_epi32(squares, zero));
+        }
+
+        alignas(16) short    vMax[8];
+        alignas(16) short    vMin[8];
+        alignas(16) uint64_t vSums[2];
+
+        _mm_store_si128(reinterpret_cast<__m128i*>(vMax),  maxValues);
+        _mm_store_si128(reinterpret_cast<__m128i*>(vMin),  minValues);
+        _mm_store_si128(reinterpret_cast<__m128i*>(vSums), sums);
+
+        for (int k = 0; k < 8; k++)
+        {
+            if (vMax[k] > iMax) iMax = vMax[k];
+            if (vMin[k] < iMin) iMin = vMin[k];
+        }
+
+        iSumOfSquares += vSums[0] + vSums[1];
+
+        levelScalar(pSamples + i, iSampleCount - i, iMax, iMin, iSumOfSquares);
+    }
+
+    SILENT_TARGET_AVX2 void levelAVX2(const short* pSamples, size_t iSampleCount, int& iMax, int& iMin, uint64_t& iSumOfSquares)
+    {
+        __m256i maxValues = _mm256_set1_epi16(SHRT_MIN);
+        __m256i minValues = _mm256_set1_epi16(SHRT_MAX);
+        __m256i sums      = _mm256_setzero_si256();
+
+        const __m256i zero = _mm256_setzero_si256();
+
+        size_t i = 0;
+
+        for (; i + 16 <= iSampleCount; i += 16)
+        {
+            const __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSamples + i));
+
+            maxValues = _mm256_max_epi16(maxValues, samples);
+            minValues = _mm256_min_epi16(minValues, samples);
+
+            const __m256i squares = _mm256_madd_epi16(samples, samples);
+
+            sums = _mm256_add_epi64(sums, _mm256_unpacklo_epi32(squares, zero));
+            sums = _mm256_add_epi64(sums, _mm256_unpackhi_epi32(squares, zero));
+        }
+
+        alignas(32) short    vMax[16];
+        alignas(32) short    vMin[16];
+        alignas(32) uint64_t vSums[4];
+
+        _mm256_store_si256(reinterpret_cast<__m256i*>(vMax),  maxValues);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(vMin),  minValues);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(vSums), sums);
+
+        _mm256_zeroupper();
+
+        for (int k = 0; k < 16; k++)
+        {
+            if (vMax[k] > iMax) iMax = vMax[k];
+            if (vMin[k] < iMin) iMin = vMin[k];
+        }
+
+        iSumOfSquares += vSums[0] + vSums[1] + vSums[2] + vSums[3];
+
+        levelScalar(pSamples + i, iSampleCount - i, iMax, iMin, iSumOfSquares);
+    }
+
+#endif // SILENT_DSP_X86
+
+
+#ifdef SILENT_DSP_NEON
+
+    // Each square fits int32 (32768^2 = 2^30), vpadalq adds pairs of them to the 64 bit sums.
+
+    void levelNEON(const short* pSamples, size_t iSampleCount, int& iMax, int& iMin, uint64_t& iSumOfSquares)
+    {
+        int16x8_t maxValues = vdupq_n_s16(SHRT_MIN);
+        int16x8_t minValues = vdupq_n_s16(SHRT_MAX);
+        int64x2_t sums      = vdupq_n_s64(0);
+
+        size_t i = 0;
+
+        for (; i + 8 <= iSampleCount; i += 8)
+        {
+            const int16x8_t samples = vld1q_s16(pSamples + i);
+
+            maxValues = vmaxq_s16(maxValues, samples);
+            minValues = vminq_s16(minValues, samples);
+
+            sums = vpadalq_s32(sums, vmull_s16(vget_low_s16(samples),  vget_low_s16(samples)));
+            sums = vpadalq_s32(sums, vmull_s16(vget_high_s16(samples), vget_high_s16(samples)));
+        }
+
+        short   vMax[8];
+        short   vMin[8];
+        int64_t vSums[2];
+
+        vst1q_s16(vMax,  maxValues);
+        vst1q_s16(vMin,  minValues);
+        vst1q_s64(vSums, sums);
+
+        for (int k = 0; k < 8; k++)
+        {
+            if (vMax[k] > iMax) iMax = vMax[k];
+            if (vMin[k] < iMin) iMin = vMin[k];
+        }
+
+        iSumOfSquares += static_cast<uint64_t>(vSums[0] + vSums[1]);
+
+        levelScalar(pSamples + i, iSampleCount - i, iMax, iMin, iSumOfSquares);
+    }
+
+#endif // SILENT_DSP_NEON
+
+
+    // ---------------------------------------
+
+
+    struct LevelKernelInfo
+    {
+        LevelKernel pKernel;
+        const char* pName;
+    };
+
+    const LevelKernelInfo& getLevelKernel()
+    {
+        static const LevelKernelInfo kernel = []()
+        {
+#if defined(SILENT_DSP_X86)
+            if ( CPUFeatures::hasAVX2() )
+            {
+                return LevelKernelInfo{ &levelAVX2, "AVX2" };
+            }
+
+            return LevelKernelInfo{ &levelSSE2, "SSE2" };
+#elif defined(SILENT_DSP_NEON)
+            return LevelKernelInfo{ &levelNEON, "NEON" };
+#else
+            return LevelKernelInfo{ &levelScalar, "scalar" };
+#endif
+        }();
+
+        return kernel;
+    }
+
+    AudioLevel makeLevel(size_t iSampleCount, int iMax, int iMin, uint64_t iSumOfSquares)
+    {
+        AudioLevel level;
+
+        if (iSampleCount == 0)
+        {
+            return level;
+        }
+
+        level.iPeak = (iMax > -iMin) ? iMax : -iMin;
+        level.dRMS  = std::sqrt( static_cast<double>(iSumOfSquares) / static_cast<double>(iSampleCount) );
+
+        return level;
+    }
+
+    double toDBFS(double dValue)
+    {
+        if (dValue <= 0.0)
+        {
+            return LEVEL_METER_SILENCE_DBFS;
+        }
+
+        return 20 * log10(dValue / SHRT_MAX);
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+double AudioLevel::getPeakDBFS() const
+{
+    return toDBFS(iPeak);
+}
+
+double AudioLevel::getRMSDBFS() const
+{
+    return toDBFS(dRMS);
+}
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+LevelMeter::LevelMeter(double dPeakHoldMs, double dDecayDBPerSecond)
+{
+    this->dPeakHoldMs = dPeakHoldMs;
+    dDecayDBPerMs     = dDecayDBPerSecond / 1000.0;
+
+    reset();
+}
+
+AudioLevel LevelMeter::measure(const short* pSamples, size_t iSampleCount)
+{
+    int      iMax          = SHRT_MIN;
+    int      iMin          = SHRT_MAX;
+    uint64_t iSumOfSquares = 0;
+
+    getLevelKernel().pKernel(pSamples, iSampleCount, iMax, iMin, iSumOfSquares);
+
+    return makeLevel(iSampleCount, iMax, iMin, iSumOfSquares);
+}
+
+AudioLevel LevelMeter::measureScalar(const short* pSamples, size_t iSampleCount)
+{
+    int      iMax          = SHRT_MIN;
+    int      iMin          = SHRT_MAX;
+    uint64_t iSumOfSquares = 0;
+
+    levelScalar(pSamples, iSampleCount, iMax, iMin, iSumOfSquares);
+
+    return makeLevel(iSampleCount, iMax, iMin, iSumOfSquares);
+}
+
+const char* LevelMeter::getKernelName()
+{
+    return getLevelKernel().pName;
+}
+
+int LevelMeter::getPeakThreshold(int iDBFS)
+{
+    // Same formula as getPeakDBFS() (dB grow with the peak so a binary search is enough).
+
+    int iLow  = 0;
+    int iHigh = -SHRT_MIN + 1;  // "never"
+
+    while (iLow < iHigh)
+    {
+        const int iMiddle = (iLow + iHigh) / 2;
+
+        if (static_cast<int>(toDBFS(iMiddle)) >= iDBFS)
+        {
+            iHigh = iMiddle;
+        }
+        else
+        {
+            iLow = iMiddle + 1;
+        }
+    }
+
+    return iLow;
+}
+
+void LevelMeter::update(double dLevelDBFS, double dElapsedMs)
+{
+    // Rises at once, falls at dDecayDBPerMs.
+
+    const double dDecayedLevelDBFS = this->dLevelDBFS - dDecayDBPerMs * dElapsedMs;
+
+    this->dLevelDBFS = (dLevelDBFS > dDecayedLevelDBFS) ? dLevelDBFS : dDecayedLevelDBFS;
+
+
+    // The peak stays for dPeakHoldMs and then falls the same way (but not below the level).
+
+    if (dLevelDBFS >= dPeakHoldDBFS)
+    {
+        dPeakHoldDBFS   = dLevelDBFS;
+        dPeakHoldLeftMs = dPeakHoldMs;
+    }
+    else if (dPeakHoldLeftMs > dElapsedMs)
+    {
+        dPeakHoldLeftMs -= dElapsedMs;
+    }
+    else
+    {
+        dPeakHoldDBFS  -= dDecayDBPerMs * (dElapsedMs - dPeakHoldLeftMs);
+        dPeakHoldLeftMs = 0.0;
+
+        if (dPeakHoldDBFS < this->dLevelDBFS)
+        {
+            dPeakHoldDBFS = this->dLevelDBFS;
+        }
+    }
+}
+
+void LevelMeter::reset()
+{
+    dLevelDBFS      = LEVEL_METER_SILENCE_DBFS;
+    dPeakHoldDBFS   = LEVEL_METER_SILENCE_DBFS;
+    dPeakHoldLeftMs = 0.0;
+}
+
+double LevelMeter::getLevelDBFS() const
+{
+    return dLevelDBFS;
+}
+
+double LevelMeter::getPeakHoldDBFS() const
+{
+    return dPeakHoldDBFS;
+}
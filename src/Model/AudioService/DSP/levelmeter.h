@@ -0,0 +1,82 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <cstddef>
+
+
+// What we show (and compare against) when there is no sound at all.
+#define  LEVEL_METER_SILENCE_DBFS       -1000.0
+
+// Meter ballistics.
+#define  LEVEL_METER_PEAK_HOLD_MS       1000.0
+#define  LEVEL_METER_DECAY_DB_PER_SEC   20.0
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// PCM16 frame level. dBFS are relative to SHRT_MAX (as the voice start value in the settings).
+
+struct AudioLevel
+{
+    int    iPeak = 0;      // max |sample| (0 - 32768)
+    double dRMS  = 0.0;
+
+
+    double getPeakDBFS  () const;
+    double getRMSDBFS   () const;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+// measure() finds peak and RMS in one pass (AVX2, SSE2, NEON or scalar, the results are the same),
+// dB are only calculated when asked for.
+// An object of this class also keeps the meter ballistics: the level falls slowly
+// and the peak is held for a while, update() it with every measured frame.
+
+class LevelMeter
+{
+
+public:
+
+    LevelMeter(double dPeakHoldMs = LEVEL_METER_PEAK_HOLD_MS, double dDecayDBPerSecond = LEVEL_METER_DECAY_DB_PER_SEC);
+
+
+    static AudioLevel   measure          (const short* pSamples, size_t iSampleCount);
+
+    static AudioLevel   measureScalar    (const short* pSamples, size_t iSampleCount);
+
+    static const char*  getKernelName    ();
+
+
+    // The smallest peak for which static_cast<int>(getPeakDBFS()) >= iDBFS,
+    // so that frames can be compared against a setting without a log10() per frame.
+
+    static int          getPeakThreshold (int iDBFS);
+
+
+    void                update           (double dLevelDBFS, double dElapsedMs);
+    void                reset            ();
+
+    double              getLevelDBFS     () const;
+    double              getPeakHoldDBFS  () const;
+
+private:
+
+    double dPeakHoldMs;
+    double dDecayDBPerMs;
+
+    double dLevelDBFS;
+    double dPeakHoldDBFS;
+    double dPeakHoldLeftMs;
+};
@@ -0,0 +1,256 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "noisesuppressor.h"
+
+
+// STL
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+
+// Keeps the noise estimate (and divisions by it) away from zero and denormals.
+#define  NOISE_SUPPRESSOR_MIN_POWER  1e-10f
+
+
+NoiseSuppressor::NoiseSuppressor(unsigned int iSampleRate, int iSamplesPerPacket) : fft(NOISE_SUPPRESSOR_FFT_SIZE)
+{
+    const double dPi = 3.14159265358979;
+
+
+    // Periodic Hann, square root of it for analysis and synthesis
+    // (the squares sum to 1 at 50% overlap, so with all gains at 1 the output is the input).
+
+    vWindow.resize(NOISE_SUPPRESSOR_FFT_SIZE);
+
+    for (size_t i = 0; i < vWindow.size(); i++)
+    {
+        vWindow[i] = static_cast<float>( sqrt(0.5 * (1 - cos(2 * dPi * i / NOISE_SUPPRESSOR_FFT_SIZE))) );
+    }
+
+    vInput   .resize(NOISE_SUPPRESSOR_FFT_SIZE);
+    vOverlap .resize(NOISE_SUPPRESSOR_FFT_SIZE);
+    vSpectrum.resize(NOISE_SUPPRESSOR_FFT_SIZE);
+
+    vSmoothedPower.resize(NOISE_SUPPRESSOR_FFT_SIZE / 2 + 1);
+    vNoisePower   .resize(NOISE_SUPPRESSOR_FFT_SIZE / 2 + 1);
+    vCleanPower   .resize(NOISE_SUPPRESSOR_FFT_SIZE / 2 + 1);
+
+    // So that process() never allocates.
+    vOutput.reserve( static_cast<size_t>(iSamplesPerPacket) + NOISE_SUPPRESSOR_FFT_SIZE * 2 );
+
+
+    const double dHopSec = static_cast<double>(NOISE_SUPPRESSOR_HOP_SIZE) / iSampleRate;
+
+    fNoiseRisePerFrame = static_cast<float>( pow(10.0, NOISE_SUPPRESSOR_NOISE_RISE_DB_PER_SEC * dHopSec / 10) );
+
+    dCPUBudgetUs = 1000000.0 * iSamplesPerPacket / iSampleRate * NOISE_SUPPRESSOR_CPU_BUDGET_PART;
+
+
+    bEnabled          = true;
+    bBypassed         = false;
+    bNoiseInitialized = false;
+
+    reset();
+}
+
+bool NoiseSuppressor::process(short* pSamples, size_t iSampleCount)
+{
+    if (bEnabled == false)
+    {
+        return false;
+    }
+
+    const std::chrono::time_point<std::chrono::steady_clock> startTime = std::chrono::steady_clock::now();
+
+
+    for (size_t i = 0; i < iSampleCount; i++)
+    {
+        vInput[iInputFill] = pSamples[i];
+        iInputFill++;
+
+        if (iInputFill == NOISE_SUPPRESSOR_FFT_SIZE)
+        {
+            processFrame();
+
+            std::copy(vInput.begin() + NOISE_SUPPRESSOR_HOP_SIZE, vInput.end(), vInput.begin());
+            iInputFill = NOISE_SUPPRESSOR_FFT_SIZE - NOISE_SUPPRESSOR_HOP_SIZE;
+        }
+    }
+
+
+    // reset() puts a hop of silence in vOutput, so there is always enough.
+
+    for (size_t i = 0; i < iSampleCount; i++)
+    {
+        const float fSample = std::round(vOutput[i]);
+
+        pSamples[i] = static_cast<short>( std::max(-32768.0f, std::min(32767.0f, fSample)) );
+    }
+
+    vOutput.erase(vOutput.begin(), vOutput.begin() + static_cast<std::ptrdiff_t>(iSampleCount));
+
+
+    // CPU budget.
+
+    const double dTimeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+
+    stats.iPacketCount++;
+    stats.dTotalTimeUs += dTimeUs;
+    stats.dMaxTimeUs    = std::max(stats.dMaxTimeUs, dTimeUs);
+
+    if (dTimeUs > dCPUBudgetUs)
+    {
+        stats.iOverBudgetCount++;
+        iOverBudgetInARow++;
+
+        if ( (iOverBudgetInARow == NOISE_SUPPRESSOR_OVER_BUDGET_PACKETS) && (bBypassed == false) )
+        {
+            bBypassed = true;
+
+            return true;
+        }
+    }
+    else
+    {
+        iOverBudgetInARow = 0;
+    }
+
+    return false;
+}
+
+void NoiseSuppressor::setEnabled(bool bEnabled)
+{
+    if ( bEnabled && (this->bEnabled == false) )
+    {
+        // The buffers have old audio.
+        reset();
+
+        bBypassed = false;
+    }
+
+    this->bEnabled = bEnabled;
+}
+
+void NoiseSuppressor::reset()
+{
+    std::fill(vInput.begin(),   vInput.end(),   0.0f);
+    std::fill(vOverlap.begin(), vOverlap.end(), 0.0f);
+    std::fill(vCleanPower.begin(), vCleanPower.end(), 0.0f);
+
+    iInputFill = NOISE_SUPPRESSOR_FFT_SIZE - NOISE_SUPPRESSOR_HOP_SIZE;
+
+    vOutput.assign(NOISE_SUPPRESSOR_HOP_SIZE, 0.0f);
+
+    iOverBudgetInARow = 0;
+}
+
+bool NoiseSuppressor::isEnabled() const
+{
+    return bEnabled;
+}
+
+bool NoiseSuppressor::isBypassed() const
+{
+    return bBypassed;
+}
+
+double NoiseSuppressor::getCPUBudgetUs() const
+{
+    return dCPUBudgetUs;
+}
+
+int NoiseSuppressor::getLatencyInSamples() const
+{
+    return NOISE_SUPPRESSOR_FFT_SIZE;
+}
+
+NoiseSuppressorStats NoiseSuppressor::getStats() const
+{
+    return stats;
+}
+
+void NoiseSuppressor::processFrame()
+{
+    if (bBypassed)
+    {
+        // What the overlap-add would give with all gains at 1.
+
+        vOutput.insert(vOutput.end(), vInput.begin(), vInput.begin() + NOISE_SUPPRESSOR_HOP_SIZE);
+
+        return;
+    }
+
+
+    for (size_t i = 0; i < NOISE_SUPPRESSOR_FFT_SIZE; i++)
+    {
+        vSpectrum[i] = std::complex<float>(vInput[i] * vWindow[i], 0.0f);
+    }
+
+    fft.forward(vSpectrum.data());
+
+
+    // Wiener gain per bin (the upper half of the spectrum mirrors the lower one for real input).
+
+    for (size_t k = 0; k <= NOISE_SUPPRESSOR_FFT_SIZE / 2; k++)
+    {
+        const float fPower = std::norm(vSpectrum[k]);
+
+        if (bNoiseInitialized == false)
+        {
+            vSmoothedPower[k] = fPower;
+            vNoisePower[k]    = std::max(fPower, NOISE_SUPPRESSOR_MIN_POWER);
+        }
+        else
+        {
+            vSmoothedPower[k] = NOISE_SUPPRESSOR_POWER_SMOOTHING * vSmoothedPower[k] + (1 - NOISE_SUPPRESSOR_POWER_SMOOTHING) * fPower;
+
+            if (vSmoothedPower[k] < vNoisePower[k])
+            {
+                vNoisePower[k] = std::max(vSmoothedPower[k], NOISE_SUPPRESSOR_MIN_POWER);
+            }
+            else
+            {
+                vNoisePower[k] *= fNoiseRisePerFrame;
+            }
+        }
+
+        const float fNoisePower    = vNoisePower[k] * NOISE_SUPPRESSOR_NOISE_BIAS;
+
+        const float fPosterioriSNR = fPower / fNoisePower;
+        const float fPrioriSNR     = NOISE_SUPPRESSOR_SNR_SMOOTHING * vCleanPower[k] / fNoisePower
+                                     + (1 - NOISE_SUPPRESSOR_SNR_SMOOTHING) * std::max(fPosterioriSNR - 1, 0.0f);
+
+        const float fGain = std::max(fPrioriSNR / (1 + fPrioriSNR), NOISE_SUPPRESSOR_MIN_GAIN);
+
+        vCleanPower[k] = fGain * fGain * fPower;
+
+        vSpectrum[k] *= fGain;
+
+        if ( (k != 0) && (k != NOISE_SUPPRESSOR_FFT_SIZE / 2) )
+        {
+            vSpectrum[NOISE_SUPPRESSOR_FFT_SIZE - k] *= fGain;
+        }
+    }
+
+    bNoiseInitialized = true;
+
+
+    fft.inverse(vSpectrum.data());
+
+    for (size_t i = 0; i < NOISE_SUPPRESSOR_FFT_SIZE; i++)
+    {
+        vOverlap[i] += vSpectrum[i].real() * vWindow[i];
+    }
+
+
+    // The first hop is finished.
+
+    vOutput.insert(vOutput.end(), vOverlap.begin(), vOverlap.begin() + NOISE_SUPPRESSOR_HOP_SIZE);
+
+    std::copy(vOverlap.begin() + NOISE_SUPPRESSOR_HOP_SIZE, vOverlap.end(), vOverlap.begin());
+    std::fill(vOverlap.begin() + NOISE_SUPPRESSOR_HOP_SIZE, vOverlap.end(), 0.0f);
+}
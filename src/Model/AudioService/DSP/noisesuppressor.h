@@ -0,0 +1,126 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <complex>
+#include <vector>
+
+// Custom
+#include "Model/AudioService/DSP/fft.h"
+
+
+// Analysis frame (~13 ms at 19400 Hz) with 50% overlap, adds this much latency.
+#define  NOISE_SUPPRESSOR_FFT_SIZE          256
+#define  NOISE_SUPPRESSOR_HOP_SIZE          (NOISE_SUPPRESSOR_FFT_SIZE / 2)
+
+// Max attenuation of a bin (-20 dB), lower gives "musical noise".
+#define  NOISE_SUPPRESSOR_MIN_GAIN          0.1f
+
+// What stationary noise is lowered by (checked by SilentBench): less than the gain floor
+// because the noise goes above its estimate in some bins and frames, those get through at a higher gain.
+#define  NOISE_SUPPRESSOR_NOISE_REDUCTION_DB 15.0
+
+// Decision-directed a priori SNR (closer to 1 - smoother, but slower to follow speech).
+#define  NOISE_SUPPRESSOR_SNR_SMOOTHING     0.98f
+
+// Noise estimate per bin: follows the smoothed power down at once and rises this fast
+// (speech has pauses, so the minimum is the noise).
+#define  NOISE_SUPPRESSOR_POWER_SMOOTHING   0.7f
+#define  NOISE_SUPPRESSOR_NOISE_RISE_DB_PER_SEC 3.0
+// The minimum is below the average noise power, this brings it back.
+#define  NOISE_SUPPRESSOR_NOISE_BIAS        2.0f
+
+// Part of the packet duration process() may take. If it takes longer for this many packets in a row,
+// the suppressor bypasses itself (the audio is only delayed) so the capture does not fall behind.
+#define  NOISE_SUPPRESSOR_CPU_BUDGET_PART   0.25
+#define  NOISE_SUPPRESSOR_OVER_BUDGET_PACKETS 20
+
+
+struct NoiseSuppressorStats
+{
+    unsigned long long iPacketCount     = 0;
+    unsigned long long iOverBudgetCount = 0;
+    double             dTotalTimeUs     = 0.0;
+    double             dMaxTimeUs       = 0.0;
+
+
+    double getAverageTimeUs () const
+    {
+        return iPacketCount ? dTotalTimeUs / static_cast<double>(iPacketCount) : 0.0;
+    }
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Wiener filter over a short-time FFT (sqrt-Hann windows, overlap-add) with noise tracking,
+// takes packets of any size (the frames don't have to match the packets).
+// Not thread safe, call everything from the capture thread.
+
+class NoiseSuppressor
+{
+
+public:
+
+    NoiseSuppressor(unsigned int iSampleRate, int iSamplesPerPacket);
+
+
+    // In place. Does nothing if disabled.
+    // Returns true if the suppressor went over the CPU budget and bypassed itself (only once, on that packet).
+
+    bool         process                 (short* pSamples, size_t iSampleCount);
+
+    // Turning it on again also ends the bypass.
+
+    void         setEnabled              (bool bEnabled);
+
+    // Drops the buffered audio (call when the capture starts again), the noise estimate is kept.
+
+    void         reset                   ();
+
+
+    bool         isEnabled               () const;
+    bool         isBypassed              () const;
+
+    double       getCPUBudgetUs          () const;
+    int          getLatencyInSamples     () const;
+
+    NoiseSuppressorStats getStats        () const;
+
+private:
+
+    void         processFrame            ();
+
+
+    FFT                              fft;
+
+    std::vector<float>               vWindow;
+    std::vector<float>               vInput;        // last NOISE_SUPPRESSOR_FFT_SIZE samples
+    std::vector<float>               vOverlap;      // overlap-add accumulator
+    std::vector<float>               vOutput;       // ready samples
+    std::vector<std::complex<float>> vSpectrum;
+
+    std::vector<float>               vSmoothedPower;
+    std::vector<float>               vNoisePower;
+    std::vector<float>               vCleanPower;   // of the previous frame (for the a priori SNR)
+
+    NoiseSuppressorStats             stats;
+
+    double       dCPUBudgetUs;
+    float        fNoiseRisePerFrame;
+
+    size_t       iInputFill;
+    int          iOverBudgetInARow;
+
+    bool         bEnabled;
+    bool         bBypassed;
+    bool         bNoiseInitialized;
+};
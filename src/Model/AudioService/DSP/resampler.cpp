@@ -0,0 +1,294 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "resampler.h"
+
+
+// STL
+#include <cmath>
+#include <algorithm>
+
+// Custom
+#include "Model/AudioService/DSP/cpufeatures.h"
+
+
+namespace
+{
+    typedef float (*DotKernel)(const float* pA, const float* pB, size_t iCount);
+
+
+    // iCount is always a multiple of 8.
+
+    float dotScalar(const float* pA, const float* pB, size_t iCount)
+    {
+        float fSum = 0.0f;
+
+        for (size_t i = 0; i < iCount; i++)
+        {
+            fSum += pA[i] * pB[i];
+        }
+
+        return fSum;
+    }
+
+
+#ifdef SILENT_DSP_X86
+
+    float dotSSE2(const float* pA, const float* pB, size_t iCount)
+    {
+        __m128 sum1 = _mm_setzero_ps();
+        __m128 sum2 = _mm_setzero_ps();
+
+        for (size_t i = 0; i < iCount; i += 8)
+        {
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(pA + i),     _mm_loadu_ps(pB + i)));
+            sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(pA + i + 4), _mm_loadu_ps(pB + i + 4)));
+        }
+
+        __m128 sum = _mm_add_ps(sum1, sum2);
+
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+        return _mm_cvtss_f32(sum);
+    }
+
+    SILENT_TARGET_AVX2 float dotAVX2(const float* pA, const float* pB, size_t iCount)
+    {
+        __m256 sum = _mm256_setzero_ps();
+
+        for (size_t i = 0; i < iCount; i += 8)
+        {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(pA + i), _mm256_loadu_ps(pB + i)));
+        }
+
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+
+        // See CPUFeatures.
+        _mm256_zeroupper();
+
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+
+        return _mm_cvtss_f32(half);
+    }
+
+#endif // SILENT_DSP_X86
+
+
+#ifdef SILENT_DSP_NEON
+
+    float dotNEON(const float* pA, const float* pB, size_t iCount)
+    {
+        float32x4_t sum1 = vdupq_n_f32(0.0f);
+        float32x4_t sum2 = vdupq_n_f32(0.0f);
+
+        for (size_t i = 0; i < iCount; i += 8)
+        {
+            sum1 = vmlaq_f32(sum1, vld1q_f32(pA + i),     vld1q_f32(pB + i));
+            sum2 = vmlaq_f32(sum2, vld1q_f32(pA + i + 4), vld1q_f32(pB + i + 4));
+        }
+
+        const float32x4_t sum  = vaddq_f32(sum1, sum2);
+        const float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+
+        return vget_lane_f32(vpadd_f32(half, half), 0);
+    }
+
+#endif // SILENT_DSP_NEON
+
+
+    // ---------------------------------------
+
+
+    struct DotKernelInfo
+    {
+        DotKernel   pKernel;
+        const char* pName;
+    };
+
+    const DotKernelInfo& getDotKernel()
+    {
+        // Checked once (thread-safe static init).
+
+        static const DotKernelInfo kernel = []()
+        {
+#if defined(SILENT_DSP_X86)
+            if ( CPUFeatures::hasAVX2() )
+            {
+                return DotKernelInfo{ &dotAVX2, "AVX2" };
+            }
+
+            return DotKernelInfo{ &dotSSE2, "SSE2" };
+#elif defined(SILENT_DSP_NEON)
+            return DotKernelInfo{ &dotNEON, "NEON" };
+#else
+            return DotKernelInfo{ &dotScalar, "scalar" };
+#endif
+        }();
+
+        return kernel;
+    }
+
+
+    // ---------------------------------------
+
+
+    size_t greatestCommonDivisor(size_t iA, size_t iB)
+    {
+        while (iB != 0)
+        {
+            const size_t iRest = iA % iB;
+
+            iA = iB;
+            iB = iRest;
+        }
+
+        return iA;
+    }
+
+    // Zeroth order modified Bessel function of the first kind (for the Kaiser window).
+
+    double besselI0(double dX)
+    {
+        double dSum  = 1.0;
+        double dTerm = 1.0;
+
+        for (int k = 1; k < 50; k++)
+        {
+            dTerm *= (dX / (2 * k)) * (dX / (2 * k));
+            dSum  += dTerm;
+
+            if (dTerm < dSum * 1e-12)
+            {
+                break;
+            }
+        }
+
+        return dSum;
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+Resampler::Resampler(unsigned int iInputRate, unsigned int iOutputRate, bool bScalar)
+{
+    const size_t iGCD = greatestCommonDivisor(iInputRate, iOutputRate);
+
+    iUpFactor   = iOutputRate / iGCD;
+    iDownFactor = iInputRate  / iGCD;
+
+    pDotKernel  = bScalar ? &dotScalar : getDotKernel().pKernel;
+
+
+    // Taps are at the input rate, when downsampling the filter has to be longer
+    // to have the same transition band at the output rate.
+
+    iTapsPerPhase = RESAMPLER_TAPS_PER_PHASE;
+
+    if (iInputRate > iOutputRate)
+    {
+        iTapsPerPhase = static_cast<size_t>( std::ceil(RESAMPLER_TAPS_PER_PHASE * static_cast<double>(iInputRate) / iOutputRate) );
+        iTapsPerPhase = (iTapsPerPhase + 7) / 8 * 8;
+    }
+
+
+    // Windowed sinc at the upsampled rate (input rate * L), the cutoff is at the lower Nyquist.
+    // Tap i of phase p is prototype tap (p + i * L), times L (the upsampling inserts L - 1 zeros).
+
+    const double dPi          = 3.14159265358979;
+    const size_t iLength      = iUpFactor * iTapsPerPhase;
+    const double dCenter      = (iLength - 1) / 2.0;
+    const double dCutoff      = RESAMPLER_CUTOFF_PART * 0.5 * std::min(iInputRate, iOutputRate) / (static_cast<double>(iInputRate) * iUpFactor);
+    const double dWindowNorm  = besselI0(RESAMPLER_KAISER_BETA);
+
+    vFilters.resize(iLength);
+
+    for (size_t p = 0; p < iUpFactor; p++)
+    {
+        for (size_t i = 0; i < iTapsPerPhase; i++)
+        {
+            const size_t iTap = p + i * iUpFactor;
+            const double dX   = iTap - dCenter;
+
+            const double dSinc   = (dX == 0.0) ? 2 * dCutoff : sin(2 * dPi * dCutoff * dX) / (dPi * dX);
+            const double dRatio  = dX / (dCenter + 1);
+            const double dWindow = besselI0( RESAMPLER_KAISER_BETA * sqrt(std::max(0.0, 1 - dRatio * dRatio)) ) / dWindowNorm;
+
+            // Reversed: the last tap of the filter meets the newest input sample.
+
+            vFilters[p * iTapsPerPhase + (iTapsPerPhase - 1 - i)] = static_cast<float>(dSinc * dWindow * iUpFactor);
+        }
+    }
+
+    reset();
+}
+
+size_t Resampler::process(const short* pInput, size_t iInputCount, short* pOutput)
+{
+    for (size_t i = 0; i < iInputCount; i++)
+    {
+        vBuffer.push_back(pInput[i]);
+    }
+
+
+    // Output sample n is at input position n * M / L: input sample iNextInputIndex, phase iNextPhase.
+
+    size_t iOutputCount = 0;
+
+    while (iNextInputIndex < vBuffer.size())
+    {
+        const float fSample = pDotKernel( &vFilters[iNextPhase * iTapsPerPhase],
+                                          &vBuffer[iNextInputIndex + 1 - iTapsPerPhase],
+                                          iTapsPerPhase );
+
+        pOutput[iOutputCount] = static_cast<short>( std::max(-32768.0f, std::min(32767.0f, std::round(fSample))) );
+        iOutputCount++;
+
+        iNextPhase      += iDownFactor;
+        iNextInputIndex += iNextPhase / iUpFactor;
+        iNextPhase      %= iUpFactor;
+    }
+
+
+    // Keep what the next outputs need.
+
+    const size_t iFirstNeeded = std::min(iNextInputIndex + 1 - iTapsPerPhase, vBuffer.size());
+
+    vBuffer.erase(vBuffer.begin(), vBuffer.begin() + static_cast<std::ptrdiff_t>(iFirstNeeded));
+
+    iNextInputIndex -= iFirstNeeded;
+
+    return iOutputCount;
+}
+
+size_t Resampler::getMaxOutputCount(size_t iInputCount) const
+{
+    return (iInputCount * iUpFactor) / iDownFactor + 1;
+}
+
+size_t Resampler::getDelayInInputSamples() const
+{
+    return iTapsPerPhase / 2;
+}
+
+void Resampler::reset()
+{
+    // History of silence, the first output is at the first input sample.
+
+    vBuffer.assign(iTapsPerPhase - 1, 0.0f);
+
+    iNextInputIndex = iTapsPerPhase - 1;
+    iNextPhase      = 0;
+}
+
+const char* Resampler::getKernelName()
+{
+    return getDotKernel().pName;
+}
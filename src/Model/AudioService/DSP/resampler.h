@@ -0,0 +1,83 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <cstddef>
+#include <vector>
+
+
+// Filter taps per phase when upsampling, more when downsampling (times the ratio, so the filter is as sharp
+// at the lower rate). Multiple of 8 (AVX2 width).
+#define  RESAMPLER_TAPS_PER_PHASE       64
+
+// Cutoff as a part of the lower Nyquist frequency (the transition band ends at Nyquist).
+#define  RESAMPLER_CUTOFF_PART          0.92
+
+// Kaiser window, ~70 dB stopband.
+#define  RESAMPLER_KAISER_BETA          7.0
+
+// What the filter gives (checked by SilentBench): flat within the ripple up to this part of the lower Nyquist frequency,
+// everything above the lower Nyquist frequency (aliases when downsampling, images when upsampling) is this much down.
+#define  RESAMPLER_PASSBAND_PART        0.85
+#define  RESAMPLER_PASSBAND_RIPPLE_DB   0.1
+#define  RESAMPLER_STOPBAND_DB          70.0
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Rational polyphase resampler for PCM16 streams (any rates, the ratio is reduced by the GCD),
+// e.g. 48000 Hz device <-> 19400 Hz wire is 240 / 97.
+// The dot products use AVX2, SSE2, NEON or scalar code (the results may differ by 1 LSB because of the summation order).
+// Not thread safe.
+
+class Resampler
+{
+
+public:
+
+    // bScalar - don't use SIMD (to compare the results in SilentBench).
+
+    Resampler(unsigned int iInputRate, unsigned int iOutputRate, bool bScalar = false);
+
+
+    // Returns the number of written samples, pOutput must have space for getMaxOutputCount(iInputCount).
+    // The output is delayed by getDelayInInputSamples() (the filter history starts as silence).
+
+    size_t       process                 (const short* pInput, size_t iInputCount, short* pOutput);
+
+    size_t       getMaxOutputCount       (size_t iInputCount) const;
+
+    size_t       getDelayInInputSamples  () const;
+
+    // Clears the history.
+
+    void         reset                   ();
+
+
+    static const char* getKernelName     ();
+
+private:
+
+    typedef float (*DotKernel)(const float* pA, const float* pB, size_t iCount);
+
+
+    std::vector<float>  vFilters;   // iPhaseCount filters of iTapsPerPhase taps (reversed, so they are dot products with the input)
+    std::vector<float>  vBuffer;    // history + new input
+
+    DotKernel    pDotKernel;
+
+    size_t       iUpFactor;         // L (= the number of phases)
+    size_t       iDownFactor;       // M
+    size_t       iTapsPerPhase;
+
+    size_t       iNextInputIndex;   // in vBuffer, of the next output sample
+    size_t       iNextPhase;
+};
@@ -0,0 +1,283 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "voiceactivitydetector.h"
+
+
+// STL
+#include <cmath>
+#include <climits>
+
+
+namespace
+{
+    double toEnergyDBFS(double dSumOfSquares, size_t iSampleCount)
+    {
+        const double dMeanSquare = dSumOfSquares / iSampleCount / (static_cast<double>(SHRT_MAX) * SHRT_MAX);
+
+        if (dMeanSquare <= 0.0)
+        {
+            return VAD_MIN_ENERGY_DBFS;
+        }
+
+        const double dEnergyDBFS = 10 * log10(dMeanSquare);
+
+        return (dEnergyDBFS < VAD_MIN_ENERGY_DBFS) ? VAD_MIN_ENERGY_DBFS : dEnergyDBFS;
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+VoiceActivityDetector::VoiceActivityDetector(unsigned int iSampleRate, int iHangoverMs)
+{
+    this->iSampleRate = iSampleRate;
+
+    setHangoverMs(iHangoverMs);
+
+
+    // Butterworth (Q = 1/sqrt(2)) high pass + low pass = speech band.
+
+    const double dPi = 3.14159265358979;
+    const double dQ  = 0.70710678118655;
+
+    double dW     = 2 * dPi * VAD_BAND_LOW_HZ / iSampleRate;
+    double dAlpha = sin(dW) / (2 * dQ);
+
+    highPass.setup( (1 + cos(dW)) / 2, -(1 + cos(dW)), (1 + cos(dW)) / 2,
+                    1 + dAlpha,        -2 * cos(dW),   1 - dAlpha );
+
+    dW     = 2 * dPi * VAD_BAND_HIGH_HZ / iSampleRate;
+    dAlpha = sin(dW) / (2 * dQ);
+
+    lowPass.setup( (1 - cos(dW)) / 2, 1 - cos(dW),  (1 - cos(dW)) / 2,
+                   1 + dAlpha,        -2 * cos(dW), 1 - dAlpha );
+
+    reset();
+}
+
+bool VoiceActivityDetector::process(const short* pSamples, size_t iSampleCount, bool bLoudEnough)
+{
+    if (iSampleCount == 0)
+    {
+        bOnset = false;
+
+        return dHangoverLeftMs > 0.0;
+    }
+
+
+    // Band energy (of the frame and of each sub-block) and zero crossings.
+
+    double vSubblockSumOfSquares[VAD_SUBBLOCK_COUNT] = {};
+
+    double dSumOfSquares     = 0.0;
+    size_t iZeroCrossings    = 0;
+    bool   bPreviousNegative = false;
+
+    for (size_t i = 0; i < iSampleCount; i++)
+    {
+        const float fBandSample = lowPass.process( highPass.process(pSamples[i]) );
+
+        const double dSquare = static_cast<double>(fBandSample) * fBandSample;
+
+        dSumOfSquares += dSquare;
+        vSubblockSumOfSquares[i * VAD_SUBBLOCK_COUNT / iSampleCount] += dSquare;
+
+        const bool bNegative = fBandSample < 0.0f;
+
+        if ( (i > 0) && (bNegative != bPreviousNegative) )
+        {
+            iZeroCrossings++;
+        }
+
+        bPreviousNegative = bNegative;
+    }
+
+    dBandEnergyDBFS   = toEnergyDBFS(dSumOfSquares, iSampleCount);
+    dZeroCrossingRate = static_cast<double>(iZeroCrossings) / iSampleCount;
+
+
+    // Assume that nobody talks in the very first frame.
+
+    if (bFirstFrame)
+    {
+        dNoiseFloorDBFS        = dBandEnergyDBFS;
+        dNoiseZeroCrossingRate = dZeroCrossingRate;
+        bFirstFrame            = false;
+    }
+
+
+    // Decide.
+
+    iActiveSubblockCount = 0;
+
+    for (size_t i = 0; i < VAD_SUBBLOCK_COUNT; i++)
+    {
+        // Sub-block i has samples [i * N / COUNT, (i + 1) * N / COUNT).
+
+        const size_t iSubblockSize = ((i + 1) * iSampleCount / VAD_SUBBLOCK_COUNT) - (i * iSampleCount / VAD_SUBBLOCK_COUNT);
+
+        if ( (iSubblockSize > 0)
+             &&
+             (toEnergyDBFS(vSubblockSumOfSquares[i], iSubblockSize) - dNoiseFloorDBFS >= VAD_VOICED_MARGIN_DB) )
+        {
+            iActiveSubblockCount++;
+        }
+    }
+
+    const double dAboveFloorDB = dBandEnergyDBFS - dNoiseFloorDBFS;
+    const bool   bVoiced       = dZeroCrossingRate <= dNoiseZeroCrossingRate * VAD_VOICED_ZERO_CROSSING_RATIO;
+
+    bSpeech = bLoudEnough
+              &&
+              (iActiveSubblockCount >= VAD_MIN_ACTIVE_SUBBLOCKS)
+              &&
+              ( (dAboveFloorDB >= VAD_SPEECH_MARGIN_DB) || ((dAboveFloorDB >= VAD_VOICED_MARGIN_DB) && bVoiced) );
+
+
+    // Follow the noise (not in the hangover: it's the quiet part of the speech, soft speech would become the floor).
+
+    const double dFrameMs = 1000.0 * iSampleCount / iSampleRate;
+
+    if ( (bSpeech == false) && (dHangoverLeftMs <= 0.0) )
+    {
+        if (dBandEnergyDBFS < dNoiseFloorDBFS)
+        {
+            dNoiseFloorDBFS = dBandEnergyDBFS;
+        }
+        else
+        {
+            dNoiseFloorDBFS += (dBandEnergyDBFS - dNoiseFloorDBFS) * VAD_NOISE_FLOOR_RISE_PART;
+        }
+
+        dNoiseZeroCrossingRate += (dZeroCrossingRate - dNoiseZeroCrossingRate) * VAD_NOISE_FLOOR_RISE_PART;
+    }
+    else
+    {
+        dNoiseFloorDBFS += VAD_NOISE_FLOOR_CREEP_DB_PER_SEC * dFrameMs / 1000.0;
+    }
+
+
+    // Hangover.
+
+    bool bSend = false;
+
+    if (bSpeech)
+    {
+        dHangoverLeftMs = iHangoverMs;
+
+        bSend = true;
+    }
+    else if (dHangoverLeftMs > 0.0)
+    {
+        dHangoverLeftMs -= dFrameMs;
+
+        bSend = true;
+    }
+
+    bOnset   = bSend && (bSending == false);
+    bSending = bSend;
+
+    return bSend;
+}
+
+void VoiceActivityDetector::setHangoverMs(int iHangoverMs)
+{
+    if      (iHangoverMs < 0)
+    {
+        iHangoverMs = 0;
+    }
+    else if (iHangoverMs > VAD_MAX_HANGOVER_MS)
+    {
+        iHangoverMs = VAD_MAX_HANGOVER_MS;
+    }
+
+    this->iHangoverMs = iHangoverMs;
+}
+
+void VoiceActivityDetector::reset()
+{
+    highPass.fX1 = highPass.fX2 = highPass.fY1 = highPass.fY2 = 0.0f;
+    lowPass .fX1 = lowPass .fX2 = lowPass .fY1 = lowPass .fY2 = 0.0f;
+
+    dHangoverLeftMs        = 0.0;
+    dNoiseFloorDBFS        = VAD_MIN_ENERGY_DBFS;
+    dNoiseZeroCrossingRate = 0.0;
+    dBandEnergyDBFS        = VAD_MIN_ENERGY_DBFS;
+    dZeroCrossingRate      = 0.0;
+
+    iActiveSubblockCount   = 0;
+
+    bFirstFrame            = true;
+    bSpeech                = false;
+    bSending               = false;
+    bOnset                 = false;
+}
+
+bool VoiceActivityDetector::isOnset() const
+{
+    return bOnset;
+}
+
+bool VoiceActivityDetector::isSpeech() const
+{
+    return bSpeech;
+}
+
+double VoiceActivityDetector::getBandEnergyDBFS() const
+{
+    return dBandEnergyDBFS;
+}
+
+double VoiceActivityDetector::getZeroCrossingRate() const
+{
+    return dZeroCrossingRate;
+}
+
+double VoiceActivityDetector::getNoiseFloorDBFS() const
+{
+    return dNoiseFloorDBFS;
+}
+
+int VoiceActivityDetector::getActiveSubblockCount() const
+{
+    return iActiveSubblockCount;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+void VoiceActivityDetector::Biquad::setup(double dB0, double dB1, double dB2, double dA0, double dA1, double dA2)
+{
+    fB0 = static_cast<float>(dB0 / dA0);
+    fB1 = static_cast<float>(dB1 / dA0);
+    fB2 = static_cast<float>(dB2 / dA0);
+    fA1 = static_cast<float>(dA1 / dA0);
+    fA2 = static_cast<float>(dA2 / dA0);
+}
+
+float VoiceActivityDetector::Biquad::process(float fInput)
+{
+    float fOutput = fB0 * fInput + fB1 * fX1 + fB2 * fX2 - fA1 * fY1 - fA2 * fY2;
+
+
+    // After silence the state would decay into denormals (very slow on x86).
+
+    if (std::fabs(fOutput) < 1e-15f)
+    {
+        fOutput = 0.0f;
+    }
+
+    fX2 = fX1;
+    fX1 = fInput;
+    fY2 = fY1;
+    fY1 = fOutput;
+
+    return fOutput;
+}
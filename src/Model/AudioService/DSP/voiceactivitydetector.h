@@ -0,0 +1,112 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <cstddef>
+
+
+// Speech band (band energy and zero crossings are measured in it).
+#define  VAD_BAND_LOW_HZ                300.0
+#define  VAD_BAND_HIGH_HZ               3400.0
+
+// A frame is speech if its band energy is this much above the noise floor...
+#define  VAD_SPEECH_MARGIN_DB           12.0
+// ...or a bit less if it sounds voiced (fewer zero crossings than the noise has, hiss has as many or more).
+#define  VAD_VOICED_MARGIN_DB           6.0
+#define  VAD_VOICED_ZERO_CROSSING_RATIO 0.8
+
+// The frame is split into sub-blocks, at least this many of them must be above the floor (by VAD_VOICED_MARGIN_DB),
+// a click is loud but short.
+#define  VAD_SUBBLOCK_COUNT             8
+#define  VAD_MIN_ACTIVE_SUBBLOCKS       4
+
+// Noise floor: follows the quiet frames (falls at once, rises by this part of the difference per frame),
+// during speech it can only creep up (so that a new fan noise doesn't keep us "talking" forever).
+#define  VAD_NOISE_FLOOR_RISE_PART      0.1
+#define  VAD_NOISE_FLOOR_CREEP_DB_PER_SEC 1.0
+#define  VAD_MIN_ENERGY_DBFS            -100.0
+
+// Keep sending after the last speech frame (word endings, short pauses).
+#define  VAD_DEFAULT_HANGOVER_MS        250
+#define  VAD_MAX_HANGOVER_MS            2000
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Voice activity detector for the "Talk to Record" mode.
+// Energy is RMS (not peak) and must last for a good part of the frame so a click doesn't open it.
+// The user's start level stays as the absolute minimum (bLoudEnough in process()).
+
+class VoiceActivityDetector
+{
+
+public:
+
+    VoiceActivityDetector(unsigned int iSampleRate, int iHangoverMs = VAD_DEFAULT_HANGOVER_MS);
+
+
+    // Returns true if the frame should be sent (speech or hangover after it).
+
+    bool         process                 (const short* pSamples, size_t iSampleCount, bool bLoudEnough);
+
+    void         setHangoverMs           (int iHangoverMs);
+
+    void         reset                   ();
+
+
+    // process() returned true for the last frame and false for the one before it (the speech started).
+    // Speech that starts late in a frame is too short for VAD_MIN_ACTIVE_SUBBLOCKS so that frame was not sent,
+    // send it before this one (a one-frame pre-roll).
+
+    bool         isOnset                 () const;
+
+
+    // Of the last process()ed frame.
+
+    bool         isSpeech                () const;
+    double       getBandEnergyDBFS       () const;
+    double       getZeroCrossingRate     () const;
+    double       getNoiseFloorDBFS       () const;
+    int          getActiveSubblockCount  () const;
+
+private:
+
+    // Direct form I biquad (RBJ cookbook).
+
+    struct Biquad
+    {
+        void  setup   (double dB0, double dB1, double dB2, double dA0, double dA1, double dA2);
+        float process (float fInput);
+
+        float fB0 = 1.0f, fB1 = 0.0f, fB2 = 0.0f, fA1 = 0.0f, fA2 = 0.0f;
+        float fX1 = 0.0f, fX2 = 0.0f, fY1 = 0.0f, fY2 = 0.0f;
+    };
+
+
+    Biquad       highPass;
+    Biquad       lowPass;
+
+    unsigned int iSampleRate;
+    int          iHangoverMs;
+    double       dHangoverLeftMs;
+
+    double       dNoiseFloorDBFS;
+    double       dNoiseZeroCrossingRate;
+    double       dBandEnergyDBFS;
+    double       dZeroCrossingRate;
+
+    int          iActiveSubblockCount;
+
+    bool         bFirstFrame;
+    bool         bSpeech;
+    bool         bSending;     // the last result of process()
+    bool         bOnset;
+};
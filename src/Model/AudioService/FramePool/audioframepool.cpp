@@ -0,0 +1,192 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "audioframepool.h"
+
+
+AudioFrame::AudioFrame()
+{
+    pPool    = nullptr;
+    pSamples = nullptr;
+}
+
+AudioFrame::AudioFrame(AudioFramePool* pPool, short* pSamples)
+{
+    this->pPool    = pPool;
+    this->pSamples = pSamples;
+}
+
+AudioFrame::AudioFrame(AudioFrame&& other) noexcept
+{
+    pPool      = other.pPool;
+    pSamples   = other.pSamples;
+    timestamps = other.timestamps;
+
+    other.pPool    = nullptr;
+    other.pSamples = nullptr;
+}
+
+AudioFrame& AudioFrame::operator=(AudioFrame&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+
+        pPool      = other.pPool;
+        pSamples   = other.pSamples;
+        timestamps = other.timestamps;
+
+        other.pPool    = nullptr;
+        other.pSamples = nullptr;
+    }
+
+    return *this;
+}
+
+AudioFrame::~AudioFrame()
+{
+    release();
+}
+
+void AudioFrame::release()
+{
+    if (pSamples)
+    {
+        pPool->release(pSamples);
+
+        pPool    = nullptr;
+        pSamples = nullptr;
+    }
+}
+
+short* AudioFrame::getSamples()
+{
+    return pSamples;
+}
+
+const short* AudioFrame::getSamples() const
+{
+    return pSamples;
+}
+
+bool AudioFrame::isEmpty() const
+{
+    return pSamples == nullptr;
+}
+
+VoiceTimestamps& AudioFrame::getTimestamps()
+{
+    return timestamps;
+}
+
+const VoiceTimestamps& AudioFrame::getTimestamps() const
+{
+    return timestamps;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+AudioFramePool::AudioFramePool(size_t iSamplesPerFrame, size_t iFrameCount)
+{
+    this->iSamplesPerFrame = iSamplesPerFrame;
+
+    vAllFrames .reserve(iFrameCount);
+    vFreeFrames.reserve(iFrameCount);
+
+    for (size_t i = 0; i < iFrameCount; i++)
+    {
+        short* pSamples = new short[iSamplesPerFrame];
+
+        vAllFrames .push_back(pSamples);
+        vFreeFrames.push_back(pSamples);
+    }
+
+    stats.iFrameCount = iFrameCount;
+}
+
+AudioFramePool::~AudioFramePool()
+{
+    for (short* pSamples : vAllFrames)
+    {
+        delete[] pSamples;
+    }
+}
+
+AudioFrame AudioFramePool::acquire()
+{
+    std::unique_lock<std::mutex> lock(mtxPool);
+
+    stats.iAcquireCount++;
+    stats.iInUse++;
+
+    if (stats.iInUse > stats.iMaxInUse)
+    {
+        stats.iMaxInUse = stats.iInUse;
+    }
+
+    if (vFreeFrames.empty() == false)
+    {
+        short* pSamples = vFreeFrames.back();
+        vFreeFrames.pop_back();
+
+        return AudioFrame(this, pSamples);
+    }
+
+
+    // Miss, the new frame stays in the pool.
+
+    stats.iMissCount++;
+    stats.iFrameCount++;
+
+    lock.unlock();
+
+    short* pSamples = new short[iSamplesPerFrame];
+
+    lock.lock();
+
+    vAllFrames.push_back(pSamples);
+
+    // So that release() never allocates.
+    vFreeFrames.reserve(vAllFrames.size());
+
+    return AudioFrame(this, pSamples);
+}
+
+size_t AudioFramePool::getSamplesPerFrame() const
+{
+    return iSamplesPerFrame;
+}
+
+AudioFramePoolStats AudioFramePool::getStats()
+{
+    std::lock_guard<std::mutex> lock(mtxPool);
+
+    return stats;
+}
+
+void AudioFramePool::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mtxPool);
+
+    AudioFramePoolStats newStats;
+    newStats.iFrameCount = stats.iFrameCount;
+    newStats.iInUse      = stats.iInUse;
+    newStats.iMaxInUse   = stats.iInUse;
+
+    stats = newStats;
+}
+
+void AudioFramePool::release(short* pSamples)
+{
+    std::lock_guard<std::mutex> lock(mtxPool);
+
+    vFreeFrames.push_back(pSamples);
+
+    stats.iInUse--;
+}
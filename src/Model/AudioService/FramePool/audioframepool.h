@@ -0,0 +1,140 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <vector>
+#include <mutex>
+#include <cstddef>
+
+// Custom
+#include "Model/AudioService/Latency/voicelatency.h"
+
+
+// Frames allocated when the pool is created:
+// pre-roll (PUSH_TO_TALK_MAX_PRE_ROLL_MS) + packets being sent + a few seconds of the test voice in the settings window.
+#define  AUDIO_FRAME_POOL_DEFAULT_FRAMES   64
+
+
+struct AudioFramePoolStats
+{
+    size_t             iFrameCount     = 0;  // allocated (grows on a miss)
+    size_t             iInUse          = 0;
+    size_t             iMaxInUse       = 0;  // high-water mark
+    unsigned long long iAcquireCount   = 0;
+    unsigned long long iMissCount      = 0;  // the pool was empty and a frame was allocated from the heap
+};
+
+
+class AudioFramePool;
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// One frame (packet) of the pool, given back when destroyed.
+// Can be moved (to another thread) but not copied, so a frame always has one owner.
+
+class AudioFrame
+{
+
+public:
+
+    // Empty (no frame).
+
+    AudioFrame();
+
+    AudioFrame(AudioFrame&& other) noexcept;
+    AudioFrame& operator=(AudioFrame&& other) noexcept;
+
+    AudioFrame(const AudioFrame&) = delete;
+    AudioFrame& operator=(const AudioFrame&) = delete;
+
+    ~AudioFrame();
+
+
+    // Gives the frame back to the pool now.
+
+    void         release            ();
+
+
+    short*       getSamples         ();
+
+    const short* getSamples         () const;
+
+    bool         isEmpty            () const;
+
+
+    // Cleared when the frame is acquired, go with the frame when it's moved.
+
+    VoiceTimestamps&       getTimestamps ();
+
+    const VoiceTimestamps& getTimestamps () const;
+
+private:
+
+    friend class AudioFramePool;
+
+    AudioFrame(AudioFramePool* pPool, short* pSamples);
+
+
+    AudioFramePool* pPool;
+    short*          pSamples;
+
+    VoiceTimestamps timestamps;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+// Fixed-size PCM16 frames for the capture, network and playout stages,
+// so that the voice does not allocate in the steady state.
+// Thread-safe. When the pool is empty a new frame is allocated (a miss) and it stays in the pool after that.
+// All frames must be given back before the pool is deleted.
+
+class AudioFramePool
+{
+
+public:
+
+    AudioFramePool(size_t iSamplesPerFrame, size_t iFrameCount = AUDIO_FRAME_POOL_DEFAULT_FRAMES);
+
+    ~AudioFramePool();
+
+
+    // The samples are not cleared.
+
+    AudioFrame          acquire            ();
+
+
+    size_t              getSamplesPerFrame () const;
+
+    AudioFramePoolStats getStats           ();
+
+    // Everything except iFrameCount and iInUse.
+
+    void                resetStats         ();
+
+private:
+
+    friend class AudioFrame;
+
+    void                release            (short* pSamples);
+
+
+    std::mutex          mtxPool;
+
+    std::vector<short*> vAllFrames;
+    std::vector<short*> vFreeFrames;
+
+    AudioFramePoolStats stats;
+
+    size_t              iSamplesPerFrame;
+};
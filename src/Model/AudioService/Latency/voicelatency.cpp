@@ -0,0 +1,264 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "voicelatency.h"
+
+
+// STL
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+
+VoiceTimestamps::VoiceTimestamps()
+{
+    for (size_t i = 0; i < VLP_COUNT; i++)
+    {
+        vTimesMs[i] = 0.0;
+    }
+}
+
+void VoiceTimestamps::mark(VOICE_LATENCY_POINT point)
+{
+    vTimesMs[point] = now();
+}
+
+bool VoiceTimestamps::has(VOICE_LATENCY_POINT point) const
+{
+    return vTimesMs[point] != 0.0;
+}
+
+double VoiceTimestamps::now()
+{
+    // Never 0 (that's "not set") unless the clock was just started.
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::add(double dLatencyMs)
+{
+    if (dLatencyMs < 0.0)
+    {
+        // Clocks of different threads are the same, so only the rounding.
+        dLatencyMs = 0.0;
+    }
+
+    size_t iBucket = 0;
+
+    if (dLatencyMs > VOICE_LATENCY_MIN_MS)
+    {
+        iBucket = static_cast<size_t>( std::log2(dLatencyMs / VOICE_LATENCY_MIN_MS) * VOICE_LATENCY_BUCKETS_PER_DOUBLING );
+
+        if (iBucket >= VOICE_LATENCY_BUCKET_COUNT)
+        {
+            iBucket = VOICE_LATENCY_BUCKET_COUNT - 1;
+        }
+    }
+
+    vBuckets[iBucket]++;
+
+    iCount++;
+    dTotalMs += dLatencyMs;
+
+    if (dLatencyMs > dMaxMs)
+    {
+        dMaxMs = dLatencyMs;
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (size_t i = 0; i < VOICE_LATENCY_BUCKET_COUNT; i++)
+    {
+        vBuckets[i] = 0;
+    }
+
+    iCount   = 0;
+    dTotalMs = 0.0;
+    dMaxMs   = 0.0;
+}
+
+unsigned long long LatencyHistogram::getCount() const
+{
+    return iCount;
+}
+
+double LatencyHistogram::getAverageMs() const
+{
+    return iCount ? dTotalMs / static_cast<double>(iCount) : 0.0;
+}
+
+double LatencyHistogram::getMaxMs() const
+{
+    return dMaxMs;
+}
+
+double LatencyHistogram::getPercentileMs(double dPart) const
+{
+    if (iCount == 0)
+    {
+        return 0.0;
+    }
+
+    const double dRank = dPart * static_cast<double>(iCount);
+
+    unsigned long long iSeen = 0;
+
+    for (size_t i = 0; i < VOICE_LATENCY_BUCKET_COUNT; i++)
+    {
+        iSeen += vBuckets[i];
+
+        if (static_cast<double>(iSeen) >= dRank)
+        {
+            const double dUpperEdgeMs = VOICE_LATENCY_MIN_MS * std::exp2( static_cast<double>(i + 1) / VOICE_LATENCY_BUCKETS_PER_DOUBLING );
+
+            // The last bucket (and the edge of the max's bucket) may be above everything that was added.
+            return (dUpperEdgeMs < dMaxMs) ? dUpperEdgeMs : dMaxMs;
+        }
+    }
+
+    return dMaxMs;
+}
+
+std::string LatencyHistogram::toString() const
+{
+    char vText[128];
+    std::snprintf(vText, sizeof(vText), "p50 %.2f / p95 %.2f / p99 %.2f / max %.2f ms",
+                  getPercentileMs(0.5), getPercentileMs(0.95), getPercentileMs(0.99), dMaxMs);
+
+    return vText;
+}
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+VoiceLatencyStats::VoiceLatencyStats()
+{
+    totalFrom = VLP_CAPTURED;
+    totalTo   = VLP_CAPTURED;
+}
+
+void VoiceLatencyStats::addPacket(const VoiceTimestamps& timestamps)
+{
+    int iFirst = -1;
+    int iLast  = -1;
+
+    for (int i = 0; i < VLP_COUNT; i++)
+    {
+        if (timestamps.has(static_cast<VOICE_LATENCY_POINT>(i)) == false)
+        {
+            continue;
+        }
+
+        if (iFirst == -1)
+        {
+            iFirst = i;
+        }
+        else if (iLast == i - 1)
+        {
+            vStages[i].add(timestamps.vTimesMs[i] - timestamps.vTimesMs[i - 1]);
+        }
+
+        iLast = i;
+    }
+
+    if (iFirst == iLast)
+    {
+        return;
+    }
+
+    // The points differ only when we start to see a packet at another point (the loopback sets all).
+    if ( (total.getCount() > 0) && ( (iFirst != totalFrom) || (iLast != totalTo) ) )
+    {
+        total.reset();
+    }
+
+    totalFrom = static_cast<VOICE_LATENCY_POINT>(iFirst);
+    totalTo   = static_cast<VOICE_LATENCY_POINT>(iLast);
+
+    total.add(timestamps.vTimesMs[iLast] - timestamps.vTimesMs[iFirst]);
+}
+
+void VoiceLatencyStats::reset()
+{
+    for (size_t i = 0; i < VLP_COUNT; i++)
+    {
+        vStages[i].reset();
+    }
+
+    total.reset();
+
+    totalFrom = VLP_CAPTURED;
+    totalTo   = VLP_CAPTURED;
+}
+
+const LatencyHistogram& VoiceLatencyStats::getStage(VOICE_LATENCY_POINT point) const
+{
+    return vStages[point];
+}
+
+const LatencyHistogram& VoiceLatencyStats::getTotal() const
+{
+    return total;
+}
+
+VOICE_LATENCY_POINT VoiceLatencyStats::getTotalFrom() const
+{
+    return totalFrom;
+}
+
+VOICE_LATENCY_POINT VoiceLatencyStats::getTotalTo() const
+{
+    return totalTo;
+}
+
+std::string VoiceLatencyStats::toString(const std::string& sIndent) const
+{
+    std::string sText;
+
+    for (int i = 1; i < VLP_COUNT; i++)
+    {
+        if (vStages[i].getCount() == 0)
+        {
+            continue;
+        }
+
+        sText += sIndent + getPointName(static_cast<VOICE_LATENCY_POINT>(i - 1)) + " -> " + getPointName(static_cast<VOICE_LATENCY_POINT>(i))
+                 + ": " + vStages[i].toString() + "\n";
+    }
+
+    if (total.getCount() > 0)
+    {
+        sText += sIndent + "total (" + getPointName(totalFrom) + " -> " + getPointName(totalTo) + ", "
+                 + std::to_string(total.getCount()) + " packets): " + total.toString() + "\n";
+    }
+
+    return sText;
+}
+
+const char* VoiceLatencyStats::getPointName(VOICE_LATENCY_POINT point)
+{
+    switch (point)
+    {
+    case(VLP_CAPTURED):  return "captured";
+    case(VLP_SENT):      return "sent";
+    case(VLP_RECEIVED):  return "received";
+    case(VLP_DECRYPTED): return "decrypted";
+    case(VLP_QUEUED):    return "queued";
+    case(VLP_OUTPUT):    return "output";
+    default:             return "?";
+    }
+}
@@ -0,0 +1,147 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <string>
+
+
+// Histogram buckets grow by 2^(1/8) (~9%, so a percentile is off by less than that) from VOICE_LATENCY_MIN_MS,
+// 168 buckets cover up to ~20 sec.
+#define  VOICE_LATENCY_MIN_MS                0.01
+#define  VOICE_LATENCY_BUCKETS_PER_DOUBLING  8
+#define  VOICE_LATENCY_BUCKET_COUNT          168
+
+
+// Points in the life of one voice packet, in order.
+enum VOICE_LATENCY_POINT
+{
+    VLP_CAPTURED            = 0,  // the capture stream returned it (sender)
+    VLP_SENT                = 1,  // encrypted and given to sendto() (sender)
+    VLP_RECEIVED            = 2,  // recv() returned it
+    VLP_DECRYPTED           = 3,
+    VLP_QUEUED              = 4,  // in the speaker's jitter buffer (AudioMixer::pushPacket())
+    VLP_OUTPUT              = 5,  // its first sample was mixed and submitted to the output device
+
+    VLP_COUNT               = 6
+};
+
+
+// When a packet passed each point (a steady clock, so only points of the same machine can be compared).
+
+struct VoiceTimestamps
+{
+    VoiceTimestamps();
+
+
+    // Sets the point to now().
+
+    void          mark        (VOICE_LATENCY_POINT point);
+
+    bool          has         (VOICE_LATENCY_POINT point) const;
+
+
+    // Milliseconds, the same for all threads.
+
+    static double now         ();
+
+
+    double        vTimesMs[VLP_COUNT];  // 0 - the packet did not pass the point (here)
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Logarithmic histogram of latencies (fixed size, add() does not allocate).
+
+class LatencyHistogram
+{
+
+public:
+
+    LatencyHistogram();
+
+
+    void               add              (double dLatencyMs);
+
+    void               reset            ();
+
+
+    unsigned long long getCount         () const;
+
+    double             getAverageMs     () const;
+
+    double             getMaxMs         () const;
+
+    // dPart 0 - 1 (0.95 - p95), the upper edge of the bucket (0 if empty).
+
+    double             getPercentileMs  (double dPart) const;
+
+    // "p50 1.2 / p95 3.4 / p99 5.6 / max 7.8 ms".
+
+    std::string        toString         () const;
+
+private:
+
+    unsigned long long vBuckets[VOICE_LATENCY_BUCKET_COUNT];
+
+    unsigned long long iCount;
+    double             dTotalMs;
+    double             dMaxMs;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+
+
+// Latency of one speaker (or of our voice): each stage between two points that follow each other
+// and the total from the first to the last point that the packets passed.
+
+class VoiceLatencyStats
+{
+
+public:
+
+    VoiceLatencyStats();
+
+
+    // Adds every stage that has both points.
+
+    void                    addPacket     (const VoiceTimestamps& timestamps);
+
+    void                    reset         ();
+
+
+    // From the point before (empty for VLP_CAPTURED).
+
+    const LatencyHistogram& getStage      (VOICE_LATENCY_POINT point) const;
+
+    const LatencyHistogram& getTotal      () const;
+
+    VOICE_LATENCY_POINT     getTotalFrom  () const;
+
+    VOICE_LATENCY_POINT     getTotalTo    () const;
+
+
+    // A line per stage that has packets and the total, each starts with sIndent.
+
+    std::string             toString      (const std::string& sIndent) const;
+
+
+    static const char*      getPointName  (VOICE_LATENCY_POINT point);
+
+private:
+
+    LatencyHistogram        vStages[VLP_COUNT];
+    LatencyHistogram        total;
+
+    VOICE_LATENCY_POINT     totalFrom;
+    VOICE_LATENCY_POINT     totalTo;
+};
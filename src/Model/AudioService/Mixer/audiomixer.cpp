@@ -0,0 +1,735 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "audiomixer.h"
+
+
+// STL
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// Custom
+#include "Model/AudioService/DSP/audiomix.h"
+#include "Model/AudioService/DSP/levelmeter.h"
+#include "Model/AudioService/DSP/driftcompensator.h"
+#include "Model/AudioService/Mixer/framering.h"
+#include "Model/AudioService/Recorder/sessionrecorder.h"
+
+
+// A packet in the DriftCompensator that did not start to play yet.
+struct MixerBufferedPacket
+{
+    VoiceTimestamps    timestamps;
+    double             dSamplesBefore;    // buffered input samples that are played before it
+};
+
+
+struct MixerSpeaker
+{
+    MixerSpeaker(size_t iSamplesPerPacket, double dPacketMs)
+        : packets(AUDIO_MIXER_MAX_QUEUED_PACKETS, iSamplesPerPacket), drift(iSamplesPerPacket, dPacketMs, AUDIO_MIXER_PREBUFFER_PACKETS)
+    {
+        vBufferedPackets.reserve(AUDIO_MIXER_MAX_QUEUED_PACKETS);
+    }
+
+
+    // produce() played dPlayedCount input samples in the output packet that starts to play at dOutputTimeMs (and lasts dPacketMs),
+    // the packets that started in it are added to the latency stats (if they are heard, dropped otherwise).
+
+    void updateLatency(double dPlayedCount, double dOutputTimeMs, double dPacketMs, bool bHeard)
+    {
+        size_t iStartedCount = 0;
+
+        for (MixerBufferedPacket& packet : vBufferedPackets)
+        {
+            if (packet.dSamplesBefore < dPlayedCount)
+            {
+                if (bHeard)
+                {
+                    packet.timestamps.vTimesMs[VLP_OUTPUT] = dOutputTimeMs + dPacketMs * packet.dSamplesBefore / dPlayedCount;
+                    latency.addPacket(packet.timestamps);
+                }
+
+                iStartedCount++;
+            }
+            else
+            {
+                packet.dSamplesBefore -= dPlayedCount;
+            }
+        }
+
+        // They are in order.
+        vBufferedPackets.erase(vBufferedPackets.begin(), vBufferedPackets.begin() + static_cast<std::ptrdiff_t>(iStartedCount));
+    }
+
+
+    std::function<void(bool bTalking)> onTalkingChanged;
+
+    FrameRing          packets;
+    DriftCompensator   drift;             // takes the packets from the FrameRing as it needs them
+
+    std::vector<MixerBufferedPacket> vBufferedPackets;
+    VoiceLatencyStats  latency;
+
+    std::string        sName;
+    size_t             iRecorderStream  = 0;
+
+    double             dLoudness        = 0.0;    // smoothed RMS of the pushed packets
+    float              fGain            = 1.0f;
+    int                iMissedPackets   = 0;
+
+    bool               bHeard           = false;  // in vHeardSpeakers
+    bool               bMixed           = false;  // was one of the loudest last time (see AudioMixer::capSpeakers())
+    bool               bCapped          = false;  // heard but not mixed last time, its packets are skipped (see AudioMixer::skipCappedPacket())
+    unsigned long long iCappedPacketCount = 0;    // since it was capped, to pick the probe packets
+    bool               bTalkingReported = false;
+    bool               bLastPacketCame  = false;
+    bool               bRecorded        = false;  // has iRecorderStream
+};
+
+
+namespace
+{
+    struct MixInput
+    {
+        const short*   pPacket;
+        float          fGain;
+    };
+
+    struct TalkingChange
+    {
+        std::function<void(bool bTalking)> onTalkingChanged;
+        bool           bTalking;
+    };
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+AudioMixer::AudioMixer(AudioPlaybackStream* pOutput, const AudioFormat& format)
+{
+    this->pOutput     = pOutput;
+
+    iSamplesPerPacket = format.iSamplesPerPacket;
+    iMaxSpeakers      = AUDIO_MIXER_DEFAULT_MAX_SPEAKERS;
+    bStop             = false;
+
+    pRecorder          = nullptr;
+    iMixRecorderStream = 0;
+    bRecordSpeakers    = false;
+
+    startTime = std::chrono::steady_clock::now();
+    dPacketMs = 1000.0 * format.iSamplesPerPacket / format.iSampleRate;
+
+    dLoudnessSmoothing = std::exp(-dPacketMs / AUDIO_MIXER_LOUDNESS_WINDOW_MS);
+    dProbeLoudnessSmoothing = std::pow(dLoudnessSmoothing, AUDIO_MIXER_CAPPED_PROBE_PACKETS);
+    dSwitchHysteresis  = std::pow(10.0, AUDIO_MIXER_SWITCH_HYSTERESIS_DB / 20.0);
+
+    renderThread = std::thread(&AudioMixer::render, this);
+}
+
+AudioMixer::~AudioMixer()
+{
+    // A sound played right before this (the lost connection, the disconnect when the app is closed) should be heard.
+
+    std::unique_lock<std::mutex> lock(mtxMixer);
+
+    cvSoundsPlayed.wait_for(lock, std::chrono::milliseconds(AUDIO_MIXER_MAX_SOUND_WAIT_MS), [this]() { return vPlayingSounds.empty(); });
+
+    const bool bPlayedSounds = (stats.iSoundCount > 0);
+
+    bStop = true;
+
+    lock.unlock();
+
+    cvMixer.notify_all();
+
+    // The render thread writes the packet it has mixed before it stops.
+    renderThread.join();
+
+    if (bPlayedSounds)
+    {
+        // Until the device has played the written packets.
+        pOutput->drain();
+    }
+
+
+    for (MixerSpeaker* pSpeaker : vSpeakers)
+    {
+        delete pSpeaker;
+    }
+
+    delete pOutput;
+}
+
+MixerSpeaker* AudioMixer::addSpeaker(const std::function<void(bool bTalking)>& onTalkingChanged, const std::string& sName)
+{
+    MixerSpeaker* pSpeaker = new MixerSpeaker( static_cast<size_t>(iSamplesPerPacket), dPacketMs );
+    pSpeaker->onTalkingChanged = onTalkingChanged;
+    pSpeaker->sName            = sName;
+
+    std::lock_guard<std::mutex> lock(mtxMixer);
+
+    vSpeakers.push_back(pSpeaker);
+
+    addRecorderStream(pSpeaker);
+
+    return pSpeaker;
+}
+
+void AudioMixer::removeSpeaker(MixerSpeaker* pSpeaker)
+{
+    // Wait if the render thread is calling onTalkingChanged (may be ours).
+    std::lock_guard<std::mutex> callbacksLock(mtxCallbacks);
+    std::lock_guard<std::mutex> lock(mtxMixer);
+
+    vSpeakers.erase( std::remove(vSpeakers.begin(), vSpeakers.end(), pSpeaker), vSpeakers.end() );
+    vHeardSpeakers.erase( std::remove(vHeardSpeakers.begin(), vHeardSpeakers.end(), pSpeaker), vHeardSpeakers.end() );
+
+    delete pSpeaker;
+}
+
+void AudioMixer::setSpeakerGain(MixerSpeaker* pSpeaker, float fGain)
+{
+    std::lock_guard<std::mutex> lock(mtxMixer);
+
+    pSpeaker->fGain = fGain;
+}
+
+void AudioMixer::pushPacket(MixerSpeaker* pSpeaker, const short* pPacket, const VoiceTimestamps& timestamps)
+{
+    VoiceTimestamps queuedTimestamps = timestamps;
+    queuedTimestamps.mark(VLP_QUEUED);
+
+    const double dRMS = LevelMeter::measure(pPacket, static_cast<size_t>(iSamplesPerPacket)).dRMS;
+
+    const double dArrivalTimeMs = getTimeMs();
+
+    std::unique_lock<std::mutex> lock(mtxMixer);
+
+    pSpeaker->drift.onPacketArrived(dArrivalTimeMs);
+
+    if ( pSpeaker->bCapped && (pSpeaker->bRecorded == false) )
+    {
+        // A probe packet, only to know if it's louder than a mixed speaker now.
+
+        pSpeaker->dLoudness = pSpeaker->dLoudness * dProbeLoudnessSmoothing + dRMS * (1.0 - dProbeLoudnessSmoothing);
+
+        pSpeaker->bLastPacketCame = false;
+        pSpeaker->iMissedPackets  = 0;
+
+        return;
+    }
+
+    if ( (pSpeaker->bHeard == false) && pSpeaker->packets.isEmpty() )
+    {
+        // Starts talking, don't wait for the average to catch up.
+        pSpeaker->dLoudness = dRMS;
+    }
+    else
+    {
+        pSpeaker->dLoudness = pSpeaker->dLoudness * dLoudnessSmoothing + dRMS * (1.0 - dLoudnessSmoothing);
+    }
+
+    if ( pSpeaker->packets.push(pPacket, queuedTimestamps) )
+    {
+        // The oldest was overwritten.
+        stats.iDroppedPacketCount++;
+    }
+
+    pSpeaker->bLastPacketCame = false;
+
+    if ( (pSpeaker->bHeard == false) && (pSpeaker->packets.getSize() >= AUDIO_MIXER_PREBUFFER_PACKETS) )
+    {
+        pSpeaker->bHeard = true;
+        vHeardSpeakers.push_back(pSpeaker);
+
+        lock.unlock();
+
+        cvMixer.notify_one();
+    }
+}
+
+bool AudioMixer::skipCappedPacket(MixerSpeaker* pSpeaker)
+{
+    const double dArrivalTimeMs = getTimeMs();
+
+    std::lock_guard<std::mutex> lock(mtxMixer);
+
+    if ( (pSpeaker->bCapped == false) || pSpeaker->bRecorded )
+    {
+        return false;
+    }
+
+    pSpeaker->iCappedPacketCount++;
+
+    if (pSpeaker->iCappedPacketCount % AUDIO_MIXER_CAPPED_PROBE_PACKETS == 0)
+    {
+        return false;
+    }
+
+    // Still talking.
+
+    pSpeaker->drift.onPacketArrived(dArrivalTimeMs);
+
+    pSpeaker->bLastPacketCame = false;
+    pSpeaker->iMissedPackets  = 0;
+
+    stats.iSkippedPacketCount++;
+
+    return true;
+}
+
+void AudioMixer::pushLastPacket(MixerSpeaker* pSpeaker)
+{
+    std::unique_lock<std::mutex> lock(mtxMixer);
+
+    pSpeaker->bLastPacketCame = true;
+
+    if ( (pSpeaker->bHeard == false) && (pSpeaker->packets.isEmpty() == false) )
+    {
+        // Short phrase (less than AUDIO_MIXER_PREBUFFER_PACKETS).
+
+        pSpeaker->bHeard = true;
+        vHeardSpeakers.push_back(pSpeaker);
+
+        lock.unlock();
+
+        cvMixer.notify_one();
+    }
+}
+
+void AudioMixer::playSound(const MixerSound* pSound)
+{
+    if (pSound->vSamples.empty())
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mtxMixer);
+
+    for (const PlayingSound& sound : vPlayingSounds)
+    {
+        if (sound.pSound == pSound)
+        {
+            stats.iDroppedSoundCount++;
+            return;
+        }
+    }
+
+    vPlayingSounds.push_back( PlayingSound{pSound, 0} );
+
+    stats.iSoundCount++;
+
+    lock.unlock();
+
+    cvMixer.notify_one();
+}
+
+void AudioMixer::setRecorder(SessionRecorder* pRecorder, bool bRecordSpeakers)
+{
+    std::lock_guard<std::mutex> lock(mtxMixer);
+
+    this->pRecorder       = pRecorder;
+    this->bRecordSpeakers = bRecordSpeakers;
+
+    if (pRecorder)
+    {
+        iMixRecorderStream = pRecorder->addStream("mix");
+    }
+
+    for (MixerSpeaker* pSpeaker : vSpeakers)
+    {
+        pSpeaker->bRecorded = false;
+
+        addRecorderStream(pSpeaker);
+    }
+}
+
+void AudioMixer::setVolume(unsigned short iVolume)
+{
+    pOutput->setVolume(iVolume);
+}
+
+void AudioMixer::setMaxSpeakers(size_t iMaxSpeakers)
+{
+    std::lock_guard<std::mutex> lock(mtxMixer);
+
+    this->iMaxSpeakers = iMaxSpeakers;
+}
+
+AudioMixerStats AudioMixer::getStats()
+{
+    std::lock_guard<std::mutex> lock(mtxMixer);
+
+    return stats;
+}
+
+VoiceLatencyStats AudioMixer::getSpeakerLatency(MixerSpeaker* pSpeaker)
+{
+    std::lock_guard<std::mutex> lock(mtxMixer);
+
+    return pSpeaker->latency;
+}
+
+void AudioMixer::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mtxMixer);
+
+    stats = AudioMixerStats();
+}
+
+std::string AudioMixer::getLastError()
+{
+    std::lock_guard<std::mutex> lock(mtxMixer);
+
+    return sLastError;
+}
+
+void AudioMixer::render()
+{
+    std::vector<MixInput>      vInputs;
+    std::vector<TalkingChange> vTalkingChanges;
+
+    std::vector<MixerSpeaker*> vCandidates;
+    std::vector<MixerSpeaker*> vCapped;
+
+    // Packets of vInputs (played by the DriftCompensators and the sounds, grows to the max number of them in one mix).
+    std::vector<short>         vInputSamples;
+
+    // From a FrameRing to a DriftCompensator.
+    std::vector<short>         vPacket (static_cast<size_t>(iSamplesPerPacket));
+
+    std::vector<float>         vMix    (static_cast<size_t>(iSamplesPerPacket));
+    std::vector<short>         vOutput (static_cast<size_t>(iSamplesPerPacket));
+
+    // Played by the DriftCompensator of a capped speaker (only if it's recorded).
+    std::vector<short>         vCappedPacket (static_cast<size_t>(iSamplesPerPacket));
+
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mtxMixer);
+
+        // Sleep while nobody is heard.
+        cvMixer.wait(lock, [this]() { return bStop || (vHeardSpeakers.empty() == false) || (vPlayingSounds.empty() == false); });
+
+        if (bStop)
+        {
+            break;
+        }
+
+        lock.unlock();
+
+
+        // Take one packet of everyone who is heard.
+
+        mtxCallbacks.lock();
+        lock.lock();
+
+        for (size_t i = 0; i < vHeardSpeakers.size(); )
+        {
+            MixerSpeaker* pSpeaker = vHeardSpeakers[i];
+
+            if (pSpeaker->bTalkingReported == false)
+            {
+                pSpeaker->bTalkingReported = true;
+                vTalkingChanges.push_back( TalkingChange{pSpeaker->onTalkingChanged, true} );
+            }
+
+            while ( (pSpeaker->drift.canProduce() == false) && (pSpeaker->packets.isEmpty() == false) )
+            {
+                MixerBufferedPacket bufferedPacket;
+                bufferedPacket.dSamplesBefore = pSpeaker->drift.getBufferedInputCount();
+
+                pSpeaker->packets.pop(vPacket.data(), &bufferedPacket.timestamps);
+                pSpeaker->drift.addInput(vPacket.data());
+
+                pSpeaker->vBufferedPackets.push_back(bufferedPacket);
+            }
+
+            if ( pSpeaker->drift.canProduce() || (pSpeaker->bLastPacketCame && pSpeaker->drift.hasInput()) )
+            {
+                vCandidates.push_back(pSpeaker);
+
+                pSpeaker->iMissedPackets = 0;
+
+                i++;
+            }
+            else if ( pSpeaker->bLastPacketCame || (pSpeaker->iMissedPackets >= AUDIO_MIXER_MAX_MISSED_PACKETS) )
+            {
+                // Finished talking (or the network is too slow), wait for AUDIO_MIXER_PREBUFFER_PACKETS again.
+
+                pSpeaker->drift.endPhrase();
+                pSpeaker->vBufferedPackets.clear();
+
+                pSpeaker->bHeard           = false;
+                pSpeaker->bMixed           = false;
+                pSpeaker->bCapped          = false;
+                pSpeaker->bTalkingReported = false;
+                pSpeaker->bLastPacketCame  = false;
+                pSpeaker->iMissedPackets   = 0;
+
+                vTalkingChanges.push_back( TalkingChange{pSpeaker->onTalkingChanged, false} );
+
+                vHeardSpeakers.erase(vHeardSpeakers.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+            else if (pSpeaker->bCapped)
+            {
+                // Its packets are skipped (not late), it's still ranked by the loudness of the probe packets.
+                // skipCappedPacket() resets iMissedPackets while they come.
+
+                vCandidates.push_back(pSpeaker);
+
+                pSpeaker->iMissedPackets++;
+
+                i++;
+            }
+            else
+            {
+                pSpeaker->iMissedPackets++;
+                stats.iMissedPacketCount++;
+
+                i++;
+            }
+        }
+
+        capSpeakers(vCandidates, vCapped);
+
+        if (vInputSamples.size() < (vCandidates.size() + vPlayingSounds.size()) * vMix.size())
+        {
+            vInputSamples.resize( (vCandidates.size() + vPlayingSounds.size()) * vMix.size() );
+        }
+
+        const double dMixTimeMs = getTimeMs();
+
+        // The mix is submitted right after the lock (the summing takes microseconds)
+        // and starts to play after the packets that the device already has.
+        const double dOutputTimeMs = VoiceTimestamps::now() + static_cast<double>(pOutput->getQueuedPacketCount()) * dPacketMs;
+
+        // The mix and the speakers' packets have the same position in their files.
+        SessionRecorder*         pMixRecorder    = pRecorder;
+        const unsigned long long iRecordPosition = pRecorder ? pRecorder->nextPacketPosition() : 0;
+
+        for (size_t i = 0; i < vCandidates.size(); i++)
+        {
+            MixerSpeaker* pSpeaker = vCandidates[i];
+            short*        pPacket  = vInputSamples.data() + i * vMix.size();
+
+            const double dBufferedCount = pSpeaker->drift.getBufferedInputCount();
+
+            pSpeaker->drift.produce( pPacket, static_cast<double>(pSpeaker->packets.getSize()), dMixTimeMs );
+
+            pSpeaker->updateLatency(dBufferedCount - pSpeaker->drift.getBufferedInputCount(), dOutputTimeMs, dPacketMs, true);
+
+            if (pRecorder && pSpeaker->bRecorded)
+            {
+                // Dropped (and counted by the recorder) if the disk is too slow.
+                pRecorder->writePacket(pSpeaker->iRecorderStream, iRecordPosition, pPacket);
+            }
+
+            vInputs.push_back( MixInput{pPacket, pSpeaker->fGain} );
+
+            stats.dTotalQueuedPackets += pSpeaker->drift.getLevelInPackets();
+            stats.dMaxQueuedPackets    = std::max(stats.dMaxQueuedPackets, pSpeaker->drift.getLevelInPackets());
+            stats.dMaxDriftPPM         = std::max(stats.dMaxDriftPPM, std::abs(pSpeaker->drift.getDriftPPM()));
+        }
+
+        for (MixerSpeaker* pSpeaker : vCapped)
+        {
+            if (pSpeaker->drift.hasInput() == false)
+            {
+                // Its packets are skipped, nothing to play.
+                continue;
+            }
+
+            // Not heard but played at the same speed (so it can be heard from the next mix).
+
+            const double dBufferedCount = pSpeaker->drift.getBufferedInputCount();
+
+            short* pRecordedPacket = (pRecorder && pSpeaker->bRecorded) ? vCappedPacket.data() : nullptr;
+
+            pSpeaker->drift.produce( pRecordedPacket, static_cast<double>(pSpeaker->packets.getSize()), dMixTimeMs );
+
+            pSpeaker->updateLatency(dBufferedCount - pSpeaker->drift.getBufferedInputCount(), dOutputTimeMs, dPacketMs, false);
+
+            if (pRecordedPacket)
+            {
+                pRecorder->writePacket(pSpeaker->iRecorderStream, iRecordPosition, pRecordedPacket);
+            }
+        }
+
+        stats.iCappedPacketCount += vCapped.size();
+        stats.iMaxCappedSpeakers  = std::max(stats.iMaxCappedSpeakers, vCapped.size());
+
+        const size_t iSpeakerInputCount = vInputs.size();
+
+
+        // Sounds (the last packet is padded with silence).
+
+        for (size_t i = 0; i < vPlayingSounds.size(); )
+        {
+            PlayingSound& sound   = vPlayingSounds[i];
+            short*        pPacket = vInputSamples.data() + vInputs.size() * vMix.size();
+
+            const size_t iCount = std::min(vMix.size(), sound.pSound->vSamples.size() - sound.iPos);
+
+            std::memcpy(pPacket, sound.pSound->vSamples.data() + sound.iPos, iCount * sizeof(short));
+            std::fill(pPacket + iCount, pPacket + vMix.size(), static_cast<short>(0));
+
+            vInputs.push_back( MixInput{pPacket, sound.pSound->fGain} );
+
+            sound.iPos += iCount;
+
+            if (sound.iPos == sound.pSound->vSamples.size())
+            {
+                vPlayingSounds.erase(vPlayingSounds.begin() + static_cast<std::ptrdiff_t>(i));
+
+                if (vPlayingSounds.empty())
+                {
+                    cvSoundsPlayed.notify_all();
+                }
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        vCandidates.clear();
+        vCapped.clear();
+
+        const bool bSomeoneIsHeard = (vHeardSpeakers.empty() == false) || (vPlayingSounds.empty() == false);
+
+        lock.unlock();
+
+        for (const TalkingChange& change : vTalkingChanges)
+        {
+            change.onTalkingChanged(change.bTalking);
+        }
+
+        vTalkingChanges.clear();
+
+        mtxCallbacks.unlock();
+
+
+        if ( vInputs.empty() && (bSomeoneIsHeard == false) )
+        {
+            continue;
+        }
+
+
+        // Mix (silence if the packets are late, so that the device keeps the pace).
+
+        const std::chrono::time_point<std::chrono::steady_clock> mixStartTime = std::chrono::steady_clock::now();
+
+        std::fill(vMix.begin(), vMix.end(), 0.0f);
+
+        for (const MixInput& input : vInputs)
+        {
+            AudioMix::accumulate(vMix.data(), input.pPacket, vMix.size(), input.fGain);
+        }
+
+        AudioMix::toPCM16(vMix.data(), vOutput.data(), vOutput.size());
+
+        const double dMixTimeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - mixStartTime).count();
+
+
+        lock.lock();
+
+        stats.iMixCount++;
+        stats.iSpeakerPacketCount += iSpeakerInputCount;
+        stats.dTotalMixTimeUs     += dMixTimeUs;
+        stats.iMaxSpeakersInMix    = std::max(stats.iMaxSpeakersInMix, iSpeakerInputCount);
+        stats.dMaxMixTimeUs        = std::max(stats.dMaxMixTimeUs, dMixTimeUs);
+
+        if ( pRecorder && (pRecorder == pMixRecorder) )
+        {
+            pRecorder->writePacket(iMixRecorderStream, iRecordPosition, vOutput.data());
+        }
+
+        lock.unlock();
+
+        vInputs.clear();
+
+
+        // Waits if the device buffers are busy.
+
+        if ( pOutput->write(vOutput.data()) )
+        {
+            lock.lock();
+            stats.iWriteErrorCount++;
+            sLastError = pOutput->getLastError();
+            lock.unlock();
+        }
+    }
+}
+
+double AudioMixer::getTimeMs() const
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void AudioMixer::capSpeakers(std::vector<MixerSpeaker*>& vCandidates, std::vector<MixerSpeaker*>& vCapped) const
+{
+    if ( (iMaxSpeakers == 0) || (vCandidates.size() <= iMaxSpeakers) )
+    {
+        for (MixerSpeaker* pSpeaker : vCandidates)
+        {
+            pSpeaker->bMixed  = true;
+            pSpeaker->bCapped = false;
+        }
+
+        return;
+    }
+
+
+    // The ones that are mixed already are compared as if they were louder,
+    // so that two speakers of about the same loudness don't replace each other every packet.
+
+    const double dSwitchHysteresis = this->dSwitchHysteresis;
+
+    std::sort(vCandidates.begin(), vCandidates.end(), [dSwitchHysteresis](const MixerSpeaker* pA, const MixerSpeaker* pB)
+    {
+        const double dA = pA->bMixed ? pA->dLoudness * dSwitchHysteresis : pA->dLoudness;
+        const double dB = pB->bMixed ? pB->dLoudness * dSwitchHysteresis : pB->dLoudness;
+
+        return dA > dB;
+    });
+
+    for (size_t i = 0; i < vCandidates.size(); i++)
+    {
+        MixerSpeaker* pSpeaker = vCandidates[i];
+
+        pSpeaker->bMixed = (i < iMaxSpeakers);
+
+        if ( pSpeaker->bMixed )
+        {
+            // Its next packets are decrypted again (it's heard after the jitter buffer fills up).
+            pSpeaker->bCapped = false;
+        }
+        else if (pSpeaker->bCapped == false)
+        {
+            pSpeaker->bCapped            = true;
+            pSpeaker->iCappedPacketCount = 0;
+        }
+    }
+
+    vCapped.assign(vCandidates.begin() + static_cast<std::ptrdiff_t>(iMaxSpeakers), vCandidates.end());
+    vCandidates.resize(iMaxSpeakers);
+}
+
+void AudioMixer::addRecorderStream(MixerSpeaker* pSpeaker)
+{
+    if ( pRecorder && bRecordSpeakers && (pSpeaker->bRecorded == false) )
+    {
+        pSpeaker->iRecorderStream = pRecorder->addStream(pSpeaker->sName);
+        pSpeaker->bRecorded       = true;
+    }
+}
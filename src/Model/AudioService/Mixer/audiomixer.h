@@ -0,0 +1,262 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// Custom
+#include "Model/AudioService/Backend/audiobackend.h"
+#include "Model/AudioService/Latency/voicelatency.h"
+
+
+// A speaker starts to be heard when this many packets are queued (jitter buffer).
+#define  AUDIO_MIXER_PREBUFFER_PACKETS     2
+
+// Packets that can wait for one speaker (FrameRing capacity), when more come the oldest are dropped (~0.5 sec.).
+#define  AUDIO_MIXER_MAX_QUEUED_PACKETS    16
+
+// A speaker that has no packets for this many mixes (and did not send the last packet) is considered silent (~100 ms).
+#define  AUDIO_MIXER_MAX_MISSED_PACKETS    3
+
+// Only this many of the loudest speakers are mixed (default for SettingsFile::iMaxSpeakersInMix, 0 - everyone).
+#define  AUDIO_MIXER_DEFAULT_MAX_SPEAKERS  4
+
+// Speaker loudness (RMS) is averaged over about this time, so that a pause between words doesn't drop the speaker.
+#define  AUDIO_MIXER_LOUDNESS_WINDOW_MS    300.0
+
+// A speaker that is not mixed replaces the quietest mixed one only if it's this much louder.
+#define  AUDIO_MIXER_SWITCH_HYSTERESIS_DB  6.0
+
+// Of the packets of a speaker that is not mixed only every this-th is decrypted (to follow its loudness),
+// the rest are skipped before the decryption (see AudioMixer::skipCappedPacket()).
+#define  AUDIO_MIXER_CAPPED_PROBE_PACKETS  8
+
+// When the mixer is deleted the notification sounds that are playing are finished first (the longest sound is ~2.5 sec.).
+#define  AUDIO_MIXER_MAX_SOUND_WAIT_MS     3000
+
+
+struct AudioMixerStats
+{
+    unsigned long long iMixCount            = 0;    // packets written to the device
+    unsigned long long iSpeakerPacketCount  = 0;    // speaker packets summed into them
+    unsigned long long iMissedPacketCount   = 0;    // a speaker that is heard had no packet in time
+    unsigned long long iDroppedPacketCount  = 0;    // AUDIO_MIXER_MAX_QUEUED_PACKETS
+    unsigned long long iCappedPacketCount   = 0;    // speaker packets that were not mixed because of AudioMixer::setMaxSpeakers()
+    unsigned long long iSkippedPacketCount  = 0;    // of them, not even decrypted (see AudioMixer::skipCappedPacket())
+    unsigned long long iWriteErrorCount     = 0;    // see AudioMixer::getLastError()
+    unsigned long long iSoundCount          = 0;    // see AudioMixer::playSound()
+    unsigned long long iDroppedSoundCount   = 0;    // the same sound was still playing
+    size_t             iMaxSpeakersInMix    = 0;
+    size_t             iMaxCappedSpeakers   = 0;    // in one mix
+    double             dTotalQueuedPackets  = 0.0;  // per mixed speaker packet (the latency of the mixer, see DriftCompensator)
+    double             dMaxQueuedPackets    = 0.0;
+    double             dMaxDriftPPM         = 0.0;  // the biggest clock difference with a speaker (absolute)
+    double             dTotalMixTimeUs      = 0.0;  // summing + conversion, without waiting for the device
+    double             dMaxMixTimeUs        = 0.0;
+
+
+    double getAverageSpeakersPerMix () const
+    {
+        return iMixCount ? static_cast<double>(iSpeakerPacketCount) / static_cast<double>(iMixCount) : 0.0;
+    }
+
+    double getAverageCappedSpeakers () const
+    {
+        return iMixCount ? static_cast<double>(iCappedPacketCount) / static_cast<double>(iMixCount) : 0.0;
+    }
+
+    double getAverageQueuedPackets  () const
+    {
+        return iSpeakerPacketCount ? dTotalQueuedPackets / static_cast<double>(iSpeakerPacketCount) : 0.0;
+    }
+
+    double getAverageMixTimeUs      () const
+    {
+        return iMixCount ? dTotalMixTimeUs / static_cast<double>(iMixCount) : 0.0;
+    }
+};
+
+
+// Owned by AudioMixer (one per remote user).
+struct MixerSpeaker;
+
+class SessionRecorder;
+
+
+// Decoded once, played by AudioMixer::playSound() as many times as needed.
+struct MixerSound
+{
+    std::vector<short> vSamples;     // mono, at the mixer rate
+    float              fGain = 1.0f;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Sums the packets of everyone who is talking (each with its own gain) into one output stream.
+// One render thread writes a packet per mix, so it's paced by the device
+// and the cost depends on the number of speakers that are heard, not on the number of users.
+// When too many people talk only the loudest are mixed (see setMaxSpeakers()),
+// the packets of the others are dropped without being mixed (but they are still shown as talking).
+// Each speaker is played a bit faster or slower to follow the clock of their sound card (DriftCompensator).
+// The mix (and each speaker) can be recorded to disk, see setRecorder().
+
+class AudioMixer
+{
+
+public:
+
+    // Takes ownership of pOutput, starts the render thread.
+
+    AudioMixer(AudioPlaybackStream* pOutput, const AudioFormat& format);
+
+    // Waits for the notification sounds to be played (up to AUDIO_MIXER_MAX_SOUND_WAIT_MS),
+    // stops the render thread, deletes the speakers and the output.
+
+    ~AudioMixer();
+
+
+    // onTalkingChanged is called from the render thread when the speaker starts or stops being heard,
+    // it's never called after removeSpeaker() returns. sName is the name of the speaker's file when recorded.
+
+    MixerSpeaker*   addSpeaker          (const std::function<void(bool bTalking)>& onTalkingChanged, const std::string& sName = "");
+
+    void            removeSpeaker       (MixerSpeaker* pSpeaker);
+
+    // Gain is applied when mixed (so it's used for the packets that are already queued too).
+
+    void            setSpeakerGain      (MixerSpeaker* pSpeaker, float fGain);
+
+
+    // Copies pPacket (format.iSamplesPerPacket samples) to the speaker's FrameRing,
+    // the timestamps get VLP_QUEUED now and VLP_OUTPUT when the packet starts to play (see getSpeakerLatency()).
+
+    void            pushPacket          (MixerSpeaker* pSpeaker, const short* pPacket, const VoiceTimestamps& timestamps = VoiceTimestamps());
+
+    // Called before the speaker's packet is decrypted. Returns true if the packet is not needed:
+    // the speaker is not mixed now (see setMaxSpeakers()) and this is not a probe packet (AUDIO_MIXER_CAPPED_PROBE_PACKETS)
+    // and the speaker is not recorded. The packet is only counted as arrived (so the speaker is still talking).
+    // Otherwise decrypt it and call pushPacket() (for a probe packet only its loudness is taken).
+
+    bool            skipCappedPacket    (MixerSpeaker* pSpeaker);
+
+    // The speaker stopped talking: play what is queued and don't wait for more.
+
+    void            pushLastPacket      (MixerSpeaker* pSpeaker);
+
+
+    // Mixed over the speakers (not capped) from the next packet, pSound must live while the mixer does.
+    // Ignored if the same sound is still playing (a burst of joins plays it once).
+
+    void            playSound           (const MixerSound* pSound);
+
+
+    // From the next mix the mixed packets (before the volume) are given to pRecorder as the "mix" stream
+    // and, if bRecordSpeakers, the packets of each speaker (before the gain, the capped ones too) as a stream per speaker.
+    // nullptr - stop, pRecorder can be stopped and deleted when this returns.
+
+    void            setRecorder         (SessionRecorder* pRecorder, bool bRecordSpeakers);
+
+
+    // 0 - 0xFFFF (same as SettingsFile::iMasterVolume).
+
+    void            setVolume           (unsigned short iVolume);
+
+    // 0 - everyone who talks is mixed.
+
+    void            setMaxSpeakers      (size_t iMaxSpeakers);
+
+
+    AudioMixerStats getStats            ();
+
+    // Of the packets that were mixed (since addSpeaker()).
+
+    VoiceLatencyStats getSpeakerLatency (MixerSpeaker* pSpeaker);
+
+    void            resetStats          ();
+
+    // Last error of the output stream.
+
+    std::string     getLastError        ();
+
+private:
+
+    struct PlayingSound
+    {
+        const MixerSound* pSound;
+        size_t            iPos;      // of the next packet in pSound->vSamples
+    };
+
+
+    void            render              ();
+
+    // Since the mixer was created.
+
+    double          getTimeMs           () const;
+
+    // Leaves only the iMaxSpeakers loudest speakers in vCandidates (the rest are moved to vCapped).
+
+    void            capSpeakers         (std::vector<MixerSpeaker*>& vCandidates, std::vector<MixerSpeaker*>& vCapped) const;
+
+    // Under mtxMixer.
+
+    void            addRecorderStream   (MixerSpeaker* pSpeaker);
+
+
+    AudioPlaybackStream*       pOutput;
+
+    std::thread                renderThread;
+
+
+    // Speakers, packets and stats.
+    std::mutex                 mtxMixer;
+    std::condition_variable    cvMixer;
+    std::condition_variable    cvSoundsPlayed;  // vPlayingSounds became empty
+
+    // Held by the render thread while it calls onTalkingChanged.
+    std::mutex                 mtxCallbacks;
+
+
+    std::vector<MixerSpeaker*> vSpeakers;
+    std::vector<MixerSpeaker*> vHeardSpeakers;  // the render thread looks only at these
+
+    std::vector<PlayingSound>  vPlayingSounds;
+
+    AudioMixerStats            stats;
+
+    std::string                sLastError;
+
+
+    SessionRecorder*           pRecorder;
+    size_t                     iMixRecorderStream;
+    bool                       bRecordSpeakers;
+
+
+    std::chrono::time_point<std::chrono::steady_clock> startTime;
+
+    double                     dPacketMs;
+
+
+    size_t                     iMaxSpeakers;
+
+    double                     dLoudnessSmoothing;  // per packet, see AUDIO_MIXER_LOUDNESS_WINDOW_MS
+    double                     dProbeLoudnessSmoothing; // per probe packet (AUDIO_MIXER_CAPPED_PROBE_PACKETS), same time
+    double                     dSwitchHysteresis;   // RMS ratio, see AUDIO_MIXER_SWITCH_HYSTERESIS_DB
+
+    int                        iSamplesPerPacket;
+
+    bool                       bStop;
+};
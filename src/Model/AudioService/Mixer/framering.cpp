@@ -0,0 +1,94 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "framering.h"
+
+
+// STL
+#include <cstring>
+
+
+FrameRing::FrameRing(size_t iCapacity, size_t iSamplesPerFrame) : vSamples(iCapacity * iSamplesPerFrame), vTimestamps(iCapacity)
+{
+    this->iCapacity        = iCapacity;
+    this->iSamplesPerFrame = iSamplesPerFrame;
+
+    iReadFrame = 0;
+    iSize      = 0;
+}
+
+bool FrameRing::push(const short* pSamples, const VoiceTimestamps& timestamps)
+{
+    if (iCapacity == 0)
+    {
+        return true;
+    }
+
+    bool bDropped = false;
+
+    if (iSize == iCapacity)
+    {
+        // Drop the oldest.
+
+        iReadFrame = (iReadFrame + 1) % iCapacity;
+        iSize--;
+
+        bDropped = true;
+    }
+
+    const size_t iWriteFrame = (iReadFrame + iSize) % iCapacity;
+
+    std::memcpy(vSamples.data() + iWriteFrame * iSamplesPerFrame, pSamples, iSamplesPerFrame * sizeof(short));
+
+    vTimestamps[iWriteFrame] = timestamps;
+
+    iSize++;
+
+    return bDropped;
+}
+
+bool FrameRing::pop(short* pSamples, VoiceTimestamps* pTimestamps)
+{
+    if (iSize == 0)
+    {
+        return true;
+    }
+
+    if (pSamples)
+    {
+        std::memcpy(pSamples, vSamples.data() + iReadFrame * iSamplesPerFrame, iSamplesPerFrame * sizeof(short));
+    }
+
+    if (pTimestamps)
+    {
+        *pTimestamps = vTimestamps[iReadFrame];
+    }
+
+    iReadFrame = (iReadFrame + 1) % iCapacity;
+    iSize--;
+
+    return false;
+}
+
+void FrameRing::clear()
+{
+    iReadFrame = 0;
+    iSize      = 0;
+}
+
+size_t FrameRing::getSize() const
+{
+    return iSize;
+}
+
+size_t FrameRing::getCapacity() const
+{
+    return iCapacity;
+}
+
+bool FrameRing::isEmpty() const
+{
+    return iSize == 0;
+}
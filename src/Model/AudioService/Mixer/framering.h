@@ -0,0 +1,63 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <vector>
+#include <cstddef>
+
+// Custom
+#include "Model/AudioService/Latency/voicelatency.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Fixed number of PCM16 frames (packets) in one block of memory that is allocated once,
+// so the memory does not depend on how long someone talks.
+// When full, push() overwrites the oldest frame.
+// Not thread-safe: one thread pushes and one pops (AudioMixer does both under its mutex).
+
+class FrameRing
+{
+
+public:
+
+    FrameRing(size_t iCapacity, size_t iSamplesPerFrame);
+
+
+    // Copies the frame (and its timestamps). Returns true if the ring was full and the oldest frame was dropped.
+
+    bool        push           (const short* pSamples, const VoiceTimestamps& timestamps = VoiceTimestamps());
+
+    // Copies the oldest frame to pSamples and its timestamps to pTimestamps (if they are not nullptr) and removes it.
+    // Returns true if the ring is empty.
+
+    bool        pop            (short* pSamples, VoiceTimestamps* pTimestamps = nullptr);
+
+    void        clear          ();
+
+
+    size_t      getSize        () const;
+
+    size_t      getCapacity    () const;
+
+    bool        isEmpty        () const;
+
+private:
+
+    std::vector<short> vSamples;
+    std::vector<VoiceTimestamps> vTimestamps;
+
+    size_t      iCapacity;
+    size_t      iSamplesPerFrame;
+
+    size_t      iReadFrame;
+    size_t      iSize;
+};
@@ -0,0 +1,360 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "sessionrecorder.h"
+
+
+// STL
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+
+// nextPacketPosition() moves to the time only if it's this many packets behind (the mixer was idle),
+// not because of the jitter of the render thread or the clock of the device.
+#define  SESSION_RECORDER_RESYNC_PACKETS    4
+
+// Silence (the stream had no packets) is written in blocks of this many packets (~4.5 sec.), not a packet at a time.
+#define  SESSION_RECORDER_SILENCE_PACKETS   128
+
+
+SessionRecorder::SessionRecorder(const AudioFormat& format)
+{
+    iSampleRate       = format.iSampleRate;
+    iSamplesPerPacket = static_cast<size_t>(format.iSamplesPerPacket);
+    dPacketMs         = 1000.0 * format.iSamplesPerPacket / format.iSampleRate;
+
+    iQueueReadPos     = 0;
+    iQueueSize        = 0;
+    iNextPosition     = 0;
+
+    bStarted          = false;
+    bStop             = false;
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    stop();
+
+    for (RecorderStream* pStream : vStreams)
+    {
+        delete pStream;
+    }
+}
+
+bool SessionRecorder::start(const std::filesystem::path& parentDirectory, std::string& sErrorText)
+{
+    if (bStarted)
+    {
+        sErrorText = "already started";
+        return true;
+    }
+
+
+    // "<date> <time>" (a suffix if it's the second session in this second).
+
+    char vTime[64];
+
+    const std::time_t currentTime = std::time(nullptr);
+    std::strftime(vTime, sizeof(vTime), "%Y-%m-%d %H-%M-%S", std::localtime(&currentTime));
+
+    std::error_code error;
+
+    for (int i = 1; ; i++)
+    {
+        directory = parentDirectory / ( vTime + ( (i == 1) ? std::string() : " (" + std::to_string(i) + ")" ) );
+
+        if ( std::filesystem::create_directories(directory, error) )
+        {
+            break;
+        }
+
+        if ( error || (i == 100) )
+        {
+            sErrorText = "can't create the directory " + directory.u8string() + (error ? " (" + error.message() + ")" : "");
+            return true;
+        }
+    }
+
+
+    vQueueSamples.resize(SESSION_RECORDER_QUEUE_PACKETS * iSamplesPerPacket);
+    vQueue       .resize(SESSION_RECORDER_QUEUE_PACKETS);
+
+    startTime = std::chrono::steady_clock::now();
+
+    bStarted = true;
+    bStop    = false;
+
+    writerThread = std::thread(&SessionRecorder::writeQueue, this);
+
+    return false;
+}
+
+void SessionRecorder::stop()
+{
+    std::unique_lock<std::mutex> lock(mtxRecorder);
+
+    if ( (bStarted == false) || bStop )
+    {
+        return;
+    }
+
+    bStop = true;
+
+    lock.unlock();
+
+    cvRecorder.notify_one();
+
+    writerThread.join();
+}
+
+size_t SessionRecorder::addStream(const std::string& sName)
+{
+    // Characters that Windows doesn't allow in file names.
+
+    std::string sFileName = sName.empty() ? "unnamed" : sName;
+
+    for (char& character : sFileName)
+    {
+        if ( (static_cast<unsigned char>(character) < 32) || (std::strchr("\\/:*?\"<>|", character) != nullptr) )
+        {
+            character = '_';
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mtxRecorder);
+
+
+    // Someone left and came back (or two users with the same name in different sessions of the server).
+
+    std::string sUniqueName = sFileName;
+
+    for (int i = 2; ; i++)
+    {
+        const bool bTaken = std::any_of(vStreams.begin(), vStreams.end(), [&sUniqueName](const RecorderStream* pStream)
+        {
+            return pStream->sFileName == sUniqueName + ".wav";
+        });
+
+        if (bTaken == false)
+        {
+            break;
+        }
+
+        sUniqueName = sFileName + " (" + std::to_string(i) + ")";
+    }
+
+    RecorderStream* pStream = new RecorderStream();
+    pStream->sFileName = sUniqueName + ".wav";
+
+    vStreams.push_back(pStream);
+
+    return vStreams.size() - 1;
+}
+
+unsigned long long SessionRecorder::nextPacketPosition()
+{
+    const double dElapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    const unsigned long long iTimePosition = static_cast<unsigned long long>(dElapsedMs / dPacketMs);
+
+    unsigned long long iPosition = iNextPosition;
+
+    if (iTimePosition > iNextPosition + SESSION_RECORDER_RESYNC_PACKETS)
+    {
+        iPosition = iTimePosition;
+    }
+
+    iNextPosition = iPosition + 1;
+
+    return iPosition;
+}
+
+bool SessionRecorder::writePacket(size_t iStream, unsigned long long iPosition, const short* pSamples)
+{
+    std::unique_lock<std::mutex> lock(mtxRecorder);
+
+    stats.iPacketCount++;
+
+    if ( (bStarted == false) || bStop || (iStream >= vStreams.size()) || (iQueueSize == SESSION_RECORDER_QUEUE_PACKETS) )
+    {
+        stats.iDroppedPacketCount++;
+        return true;
+    }
+
+    const size_t iWritePos = (iQueueReadPos + iQueueSize) % SESSION_RECORDER_QUEUE_PACKETS;
+
+    std::memcpy(vQueueSamples.data() + iWritePos * iSamplesPerPacket, pSamples, iSamplesPerPacket * sizeof(short));
+
+    vQueue[iWritePos] = QueuedPacket{iStream, iPosition};
+
+    iQueueSize++;
+
+    stats.iMaxQueuedPackets = std::max(stats.iMaxQueuedPackets, iQueueSize);
+
+    lock.unlock();
+
+    cvRecorder.notify_one();
+
+    return false;
+}
+
+std::filesystem::path SessionRecorder::getDirectory() const
+{
+    return directory;
+}
+
+SessionRecorderStats SessionRecorder::getStats()
+{
+    std::lock_guard<std::mutex> lock(mtxRecorder);
+
+    SessionRecorderStats currentStats = stats;
+    currentStats.iStreamCount = vStreams.size();
+
+    return currentStats;
+}
+
+void SessionRecorder::writeQueue()
+{
+    std::vector<short> vSilence(SESSION_RECORDER_SILENCE_PACKETS * iSamplesPerPacket, 0);
+    std::vector<RecorderStream*> vOpenedStreams;
+    std::vector<RecorderStream*> vBatchStreams;
+
+    vBatchStreams.reserve(SESSION_RECORDER_QUEUE_PACKETS);
+
+    std::chrono::time_point<std::chrono::steady_clock> lastHeaderUpdateTime = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mtxRecorder);
+
+    while (true)
+    {
+        cvRecorder.wait_for(lock, std::chrono::milliseconds(SESSION_RECORDER_HEADER_UPDATE_MS), [this]()
+        {
+            return bStop || (iQueueSize > 0);
+        });
+
+        if ( bStop && (iQueueSize == 0) )
+        {
+            break;
+        }
+
+        if (iQueueSize > 0)
+        {
+            // All that is queued now, the packets stay in their slots (writePacket() doesn't touch them) until they are written.
+
+            const size_t iFirstPos = iQueueReadPos;
+            const size_t iCount    = iQueueSize;
+
+            vBatchStreams.clear();
+
+            for (size_t i = 0; i < iCount; i++)
+            {
+                vBatchStreams.push_back( vStreams[ vQueue[(iFirstPos + i) % SESSION_RECORDER_QUEUE_PACKETS].iStream ] );
+            }
+
+            lock.unlock();
+
+            unsigned long long iErrorCount = 0;
+
+            for (size_t i = 0; i < iCount; i++)
+            {
+                const size_t    iPos    = (iFirstPos + i) % SESSION_RECORDER_QUEUE_PACKETS;
+                RecorderStream* pStream = vBatchStreams[i];
+
+                const bool bNewFile = (pStream->pWriter == nullptr);
+
+                if ( writeToStream(*pStream, vQueue[iPos], vQueueSamples.data() + iPos * iSamplesPerPacket, vSilence) )
+                {
+                    iErrorCount++;
+                }
+
+                if ( bNewFile && pStream->pWriter )
+                {
+                    vOpenedStreams.push_back(pStream);
+                }
+            }
+
+            lock.lock();
+
+            stats.iWriteErrorCount += iErrorCount;
+
+            iQueueReadPos = (iFirstPos + iCount) % SESSION_RECORDER_QUEUE_PACKETS;
+            iQueueSize   -= iCount;
+        }
+
+        if (std::chrono::steady_clock::now() - lastHeaderUpdateTime >= std::chrono::milliseconds(SESSION_RECORDER_HEADER_UPDATE_MS))
+        {
+            lock.unlock();
+
+            for (RecorderStream* pStream : vOpenedStreams)
+            {
+                pStream->pWriter->updateHeader();
+            }
+
+            lastHeaderUpdateTime = std::chrono::steady_clock::now();
+
+            lock.lock();
+        }
+    }
+
+    lock.unlock();
+
+
+    // Everything is written.
+
+    for (RecorderStream* pStream : vOpenedStreams)
+    {
+        delete pStream->pWriter;
+        pStream->pWriter = nullptr;
+    }
+}
+
+bool SessionRecorder::writeToStream(RecorderStream& stream, const QueuedPacket& packet, const short* pSamples, const std::vector<short>& vSilence)
+{
+    if (stream.pWriter == nullptr)
+    {
+        stream.pWriter = new WavFileWriter();
+
+        // Not the narrow path: the names of the users may be in any language.
+
+        if ( stream.pWriter->open(directory / std::filesystem::u8path(stream.sFileName), iSampleRate) )
+        {
+            // Tried again with the next packet.
+
+            delete stream.pWriter;
+            stream.pWriter = nullptr;
+
+            return true;
+        }
+    }
+
+
+    // Silence since the last packet of this stream (or since start()).
+
+    const unsigned long long iSilenceBlockPackets = vSilence.size() / iSamplesPerPacket;
+
+    while (stream.iPacketCount < packet.iPosition)
+    {
+        const unsigned long long iSilencePackets = std::min(packet.iPosition - stream.iPacketCount, iSilenceBlockPackets);
+
+        if ( stream.pWriter->write(vSilence.data(), static_cast<size_t>(iSilencePackets) * iSamplesPerPacket) )
+        {
+            return true;
+        }
+
+        stream.iPacketCount += iSilencePackets;
+    }
+
+    if ( stream.pWriter->write(pSamples, iSamplesPerPacket) )
+    {
+        return true;
+    }
+
+    stream.iPacketCount++;
+
+    return false;
+}
@@ -0,0 +1,161 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <filesystem>
+
+// Custom
+#include "Model/AudioService/Backend/audiobackend.h"
+#include "Model/AudioService/Backend/wavfileaudiobackend.h"
+
+
+// Relative to the working directory (next to the executable, as NOTIFICATION_SOUNDS_DIRECTORY),
+// each session goes to its own "<date> <time>" folder.
+#define  SESSION_RECORDER_DIRECTORY         "recordings/"
+
+// Packets that can wait for the writer thread (of all files, ~9 sec. of the mix alone),
+// when the disk is slower than this the new packets are dropped (and counted).
+#define  SESSION_RECORDER_QUEUE_PACKETS     256
+
+// The sizes in the WAV headers are updated this often, so a crash loses only the last seconds.
+#define  SESSION_RECORDER_HEADER_UPDATE_MS  10000
+
+
+enum SESSION_RECORDING_MODE
+{
+    SRM_OFF                 = 0,
+    SRM_MIX                 = 1,   // what we hear
+    SRM_MIX_AND_SPEAKERS    = 2    // + a file per speaker
+};
+
+
+struct SessionRecorderStats
+{
+    unsigned long long iPacketCount         = 0;    // given to writePacket()
+    unsigned long long iDroppedPacketCount  = 0;    // the queue was full (the disk is too slow)
+    unsigned long long iWriteErrorCount     = 0;    // packets that could not be written (disk full, 4 GB file)
+    size_t             iMaxQueuedPackets    = 0;
+    size_t             iStreamCount         = 0;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Records a session to WAV files (one per stream) from a writer thread,
+// so the threads that give the packets (the mixer's render thread) never wait for the disk:
+// the packets are copied to a queue of fixed size and dropped when it's full.
+// All files start at start() (the time when a stream had no packets is written as silence),
+// so they can be opened as tracks of one project.
+
+class SessionRecorder
+{
+
+public:
+
+    SessionRecorder(const AudioFormat& format);
+
+    // Calls stop().
+
+    ~SessionRecorder();
+
+
+    // Creates "<parentDirectory>/<date> <time>/" and starts the writer thread.
+    // Returns true if failed (the reason is in sErrorText).
+
+    bool            start               (const std::filesystem::path& parentDirectory, std::string& sErrorText);
+
+    // Writes what is queued, closes the files and stops the writer thread (the recorder can't be started again).
+
+    void            stop                ();
+
+
+    // The file ("<sName>.wav" in the session directory, sName is UTF-8) is created by the writer thread with the first packet.
+    // Names are made unique and safe for the file system. Returns the stream index for writePacket().
+
+    size_t          addStream           (const std::string& sName);
+
+
+    // Called once per mixed packet (by one thread), returns the position of this packet in the files:
+    // the next one or (if nothing was written for a while) the one that matches the time since start().
+
+    unsigned long long nextPacketPosition ();
+
+    // Copies the packet (format.iSamplesPerPacket samples) to the queue.
+    // Returns true if it was dropped (the queue is full or the recorder is stopped).
+
+    bool            writePacket         (size_t iStream, unsigned long long iPosition, const short* pSamples);
+
+
+    std::filesystem::path getDirectory  () const;
+
+    SessionRecorderStats getStats       ();
+
+private:
+
+    struct RecorderStream
+    {
+        std::string        sFileName;             // UTF-8
+        WavFileWriter*     pWriter     = nullptr;  // only the writer thread touches it
+        unsigned long long iPacketCount = 0;      // in the file (with silence)
+    };
+
+    struct QueuedPacket
+    {
+        size_t             iStream;
+        unsigned long long iPosition;
+    };
+
+
+    void            writeQueue          ();
+
+    // Writer thread (pSamples stays in the queue until it returns). Returns true if failed.
+    // vSilence is a few packets of zeros, the time without packets is written in blocks of it.
+
+    bool            writeToStream       (RecorderStream& stream, const QueuedPacket& packet, const short* pSamples, const std::vector<short>& vSilence);
+
+
+    std::thread                writerThread;
+
+    // Streams, queue and stats.
+    std::mutex                 mtxRecorder;
+    std::condition_variable    cvRecorder;
+
+
+    std::vector<RecorderStream*> vStreams;        // pointers stay valid when a stream is added (the writer uses them without the mutex)
+
+    std::vector<short>         vQueueSamples;   // SESSION_RECORDER_QUEUE_PACKETS packets
+    std::vector<QueuedPacket>  vQueue;
+    size_t                     iQueueReadPos;
+    size_t                     iQueueSize;
+
+    SessionRecorderStats       stats;
+
+
+    std::filesystem::path      directory;
+
+    std::chrono::time_point<std::chrono::steady_clock> startTime;
+
+    unsigned long long         iNextPosition;
+
+    double                     dPacketMs;
+
+    unsigned int               iSampleRate;
+    size_t                     iSamplesPerPacket;
+
+    bool                       bStarted;
+    bool                       bStop;
+};
@@ -0,0 +1,141 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "voicesender.h"
+
+
+// STL
+#include <algorithm>
+
+
+VoiceSender::VoiceSender(SendFunction sendPacket, EndFunction sendEnd) : vQueue(VOICE_SENDER_QUEUE_PACKETS + 1)
+{
+    this->sendPacket = sendPacket;
+    this->sendEnd    = sendEnd;
+
+    iQueueReadPos    = 0;
+    iQueueSize       = 0;
+
+    bStop            = false;
+
+    sendThread = std::thread(&VoiceSender::sendQueue, this);
+}
+
+VoiceSender::~VoiceSender()
+{
+    mtxQueue.lock();
+    bStop = true;
+    mtxQueue.unlock();
+
+    cvQueue.notify_one();
+
+    sendThread.join();
+}
+
+bool VoiceSender::push(AudioFrame&& packet)
+{
+    std::unique_lock<std::mutex> lock(mtxQueue);
+
+    stats.iPacketCount++;
+
+    if (iQueueSize >= VOICE_SENDER_QUEUE_PACKETS)
+    {
+        stats.iDroppedPacketCount++;
+
+        lock.unlock();
+
+        // Back to the pool.
+        packet.release();
+
+        return true;
+    }
+
+    QueuedPacket& queued = vQueue[(iQueueReadPos + iQueueSize) % vQueue.size()];
+    queued.packet = std::move(packet);
+    queued.bEnd   = false;
+
+    iQueueSize++;
+
+    stats.iMaxQueuedPackets = std::max(stats.iMaxQueuedPackets, iQueueSize);
+
+    lock.unlock();
+
+    cvQueue.notify_one();
+
+    return false;
+}
+
+void VoiceSender::pushEnd()
+{
+    std::unique_lock<std::mutex> lock(mtxQueue);
+
+    // The extra slot is for it (a full queue of packets still gets its end).
+
+    if (iQueueSize == vQueue.size())
+    {
+        return;
+    }
+
+    QueuedPacket& queued = vQueue[(iQueueReadPos + iQueueSize) % vQueue.size()];
+    queued.bEnd = true;
+
+    iQueueSize++;
+
+    lock.unlock();
+
+    cvQueue.notify_one();
+}
+
+VoiceSenderStats VoiceSender::getStats()
+{
+    std::lock_guard<std::mutex> lock(mtxQueue);
+
+    return stats;
+}
+
+void VoiceSender::sendQueue()
+{
+    std::unique_lock<std::mutex> lock(mtxQueue);
+
+    while (true)
+    {
+        cvQueue.wait(lock, [this]()
+        {
+            return bStop || (iQueueSize > 0);
+        });
+
+        if ( bStop && (iQueueSize == 0) )
+        {
+            break;
+        }
+
+
+        // One at a time: push() doesn't wait while we send.
+
+        QueuedPacket& queued = vQueue[iQueueReadPos];
+
+        AudioFrame packet = std::move(queued.packet);
+        const bool bEnd   = queued.bEnd;
+
+        iQueueReadPos = (iQueueReadPos + 1) % vQueue.size();
+        iQueueSize--;
+
+        lock.unlock();
+
+        if (bEnd)
+        {
+            sendEnd();
+        }
+        else
+        {
+            sendPacket(packet);
+        }
+
+        // Back to the pool before the next one.
+        packet.release();
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,99 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Custom
+#include "Model/AudioService/FramePool/audioframepool.h"
+
+
+// Packets that can wait for the send thread: the longest push-to-talk pre-roll (PUSH_TO_TALK_MAX_PRE_ROLL_MS)
+// is pushed at once, plus a few packets. When the send thread is slower than this the new packets are dropped (and counted).
+#define  VOICE_SENDER_QUEUE_PACKETS   40
+
+
+struct VoiceSenderStats
+{
+    unsigned long long iPacketCount         = 0;    // given to push()
+    unsigned long long iDroppedPacketCount  = 0;    // the queue was full
+    size_t             iMaxQueuedPackets    = 0;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Sends our voice packets from one thread in the order they were recorded,
+// so the record thread never waits for the encryption and the socket.
+// The frames are moved to a queue of fixed size (no allocations).
+
+class VoiceSender
+{
+
+public:
+
+    using SendFunction = std::function<void(AudioFrame& packet)>;
+    using EndFunction  = std::function<void()>;
+
+
+    // Both are called from the send thread (started here):
+    // sendPacket for every packet, sendEnd for the end of the phrase.
+
+    VoiceSender(SendFunction sendPacket, EndFunction sendEnd);
+
+    // Sends what is queued and stops the send thread.
+
+    ~VoiceSender();
+
+
+    // Returns true if the packet was dropped (the queue is full).
+
+    bool             push        (AudioFrame&& packet);
+
+    // The end of the phrase, sent after the packets that were pushed before it.
+
+    void             pushEnd     ();
+
+
+    VoiceSenderStats getStats    ();
+
+private:
+
+    struct QueuedPacket
+    {
+        AudioFrame       packet;
+        bool             bEnd = false;
+    };
+
+
+    void             sendQueue   ();
+
+
+    std::thread                 sendThread;
+
+    std::mutex                  mtxQueue;
+    std::condition_variable     cvQueue;
+
+    std::vector<QueuedPacket>   vQueue;   // VOICE_SENDER_QUEUE_PACKETS + 1 (for the end of the phrase)
+    size_t                      iQueueReadPos;
+    size_t                      iQueueSize;
+
+    VoiceSenderStats            stats;
+
+    SendFunction                sendPacket;
+    EndFunction                 sendEnd;
+
+    bool                        bStop;
+};
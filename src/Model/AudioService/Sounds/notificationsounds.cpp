@@ -0,0 +1,122 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "notificationsounds.h"
+
+
+// STL
+#include <algorithm>
+
+// Custom
+#include "Model/AudioService/Backend/wavfileaudiobackend.h"
+#include "Model/AudioService/DSP/resampler.h"
+
+
+namespace
+{
+    struct NotificationSoundFile
+    {
+        const char*  pFileName;
+        float        fGain;
+    };
+
+    // Same order as NOTIFICATION_SOUND.
+    // The files are about equally loud, gain 1 plays them as PlaySound() did.
+    const NotificationSoundFile vSoundFiles[NS_COUNT] =
+    {
+        { "connect.wav",        1.0f },
+        { "disconnect.wav",     1.0f },
+        { "lostconnection.wav", 1.0f },
+        { "newmessage.wav",     1.0f },
+        { "press.wav",          1.0f },
+        { "unpress.wav",        1.0f },
+        { "servermessage.wav",  1.0f },
+        { "mutemic.wav",        1.0f },
+        { "unmutemic.wav",      1.0f }
+    };
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+NotificationSounds::NotificationSounds()
+{
+    for (size_t i = 0; i < NS_COUNT; i++)
+    {
+        vSounds[i].fGain = vSoundFiles[i].fGain;
+    }
+}
+
+bool NotificationSounds::load(unsigned int iSampleRate, std::string& sErrorText)
+{
+    bool bFailed = false;
+
+    for (size_t i = 0; i < NS_COUNT; i++)
+    {
+        std::string sSoundErrorText;
+
+        if ( readSound(std::string(NOTIFICATION_SOUNDS_DIRECTORY) + vSoundFiles[i].pFileName, iSampleRate, vSounds[i].vSamples, sSoundErrorText) )
+        {
+            if (bFailed == false)
+            {
+                sErrorText = sSoundErrorText;
+            }
+
+            bFailed = true;
+
+            vSounds[i].vSamples.clear();
+        }
+    }
+
+    return bFailed;
+}
+
+const MixerSound* NotificationSounds::getSound(NOTIFICATION_SOUND sound) const
+{
+    return &vSounds[sound];
+}
+
+bool NotificationSounds::readSound(const std::string& sPath, unsigned int iSampleRate, std::vector<short>& vSamples, std::string& sErrorText)
+{
+    unsigned int iFileSampleRate = 0;
+
+    if ( WavFileAudioBackend::readWavFile(sPath, vSamples, iFileSampleRate, sErrorText) )
+    {
+        return true;
+    }
+
+    if (iFileSampleRate == 0)
+    {
+        sErrorText = sPath + " has no sample rate";
+        return true;
+    }
+
+    if (iFileSampleRate == iSampleRate)
+    {
+        return false;
+    }
+
+
+    // Flush the filter with silence and cut its delay, so the sound is not shifted.
+
+    Resampler resampler(iFileSampleRate, iSampleRate);
+
+    const size_t iDelayInInputSamples = resampler.getDelayInInputSamples();
+
+    vSamples.resize(vSamples.size() + iDelayInInputSamples, 0);
+
+    std::vector<short> vResampled( resampler.getMaxOutputCount(vSamples.size()) );
+    vResampled.resize( resampler.process(vSamples.data(), vSamples.size(), vResampled.data()) );
+
+    const size_t iDelayInOutputSamples = std::min( vResampled.size(),
+                                                   static_cast<size_t>( static_cast<unsigned long long>(iDelayInInputSamples) * iSampleRate / iFileSampleRate ) );
+
+    vSamples.assign(vResampled.begin() + static_cast<std::ptrdiff_t>(iDelayInOutputSamples), vResampled.end());
+
+    return false;
+}
@@ -0,0 +1,72 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <string>
+
+// Custom
+#include "Model/AudioService/Mixer/audiomixer.h"
+
+
+// Relative to the working directory (the "sounds" folder is next to the executable).
+#define  NOTIFICATION_SOUNDS_DIRECTORY  "sounds/"
+
+
+enum NOTIFICATION_SOUND
+{
+    NS_CONNECT              = 0,
+    NS_DISCONNECT           = 1,
+    NS_LOST_CONNECTION      = 2,
+    NS_NEW_MESSAGE          = 3,
+    NS_PRESS                = 4,
+    NS_UNPRESS              = 5,
+    NS_SERVER_MESSAGE       = 6,
+    NS_MUTE_MIC             = 7,
+    NS_UNMUTE_MIC           = 8,
+
+    NS_COUNT                = 9
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// All notification sounds, read from the WAV files once and converted to the mixer format
+// (so that playing one is only AudioMixer::playSound(), no disk access).
+
+class NotificationSounds
+{
+
+public:
+
+    // Empty (silent) sounds until load().
+
+    NotificationSounds();
+
+
+    // Reads all files and resamples them to iSampleRate.
+    // Returns true if some failed (they stay silent, the reason of the first one is in sErrorText).
+    // The mixer runs at the voice rate (19.4 kHz) so the sounds lose everything above ~8 kHz (RESAMPLER_PASSBAND_PART),
+    // this is less than 0.2% of the energy of the files in "sounds/"
+    // and it's cheaper than a second mixer/output stream at 44.1 kHz.
+
+    bool              load           (unsigned int iSampleRate, std::string& sErrorText);
+
+
+    const MixerSound* getSound       (NOTIFICATION_SOUND sound) const;
+
+    // Reads one WAV file (mono or stereo PCM16) to vSamples at iSampleRate. Returns true if failed.
+
+    static bool       readSound      (const std::string& sPath, unsigned int iSampleRate, std::vector<short>& vSamples, std::string& sErrorText);
+
+private:
+
+    MixerSound        vSounds[NS_COUNT];
+};
@@ -8,6 +8,11 @@
 
 // STL
 #include <thread>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <locale>
+#include <codecvt>
 
 // Custom
 #include "View/MainWindow/mainwindow.h"
@@ -16,6 +21,9 @@
 #include "Model/SettingsManager/SettingsFile.h"
 #include "Model/User.h"
 #include "Model/net_params.h"
+#include "Model/AudioService/DSP/audiogain.h"
+#include "Model/AudioService/DSP/levelmeter.h"
+#include "Model/AudioService/Mixer/framering.h"
 
 
 // ------------------------------------------------------------------------------------------------
@@ -23,30 +31,70 @@
 // ------------------------------------------------------------------------------------------------
 
 
-AudioService::AudioService(MainWindow* pMainWindow, SettingsManager* pSettingsManager)
+AudioService::AudioService(MainWindow* pMainWindow, SettingsManager* pSettingsManager, AudioBackend* pAudioBackend, InputSource* pInputSource)
 {
     this->pMainWindow      = pMainWindow;
     this->pSettingsManager = pSettingsManager;
+    this->pAudioBackend    = pAudioBackend;
+    this->pInputSource     = pInputSource;
+
+    if (this->pAudioBackend == nullptr)
+    {
+        this->pAudioBackend = AudioBackend::create(ABT_DEFAULT);
+    }
+
+    if (this->pInputSource == nullptr)
+    {
+        this->pInputSource = InputSource::create(IST_DEFAULT);
+    }
+
+    iPushToTalkButton       = 0;
 
 
     // Do not record audio now
     bInputReady             = false;
     bTestInputReady         = false;
     bPauseTestInput         = true;
-    bRecordTalk             = false;
     bMuteMic                = false;
 
 
-    // "In" (record) buffers
-    pWaveIn1                = nullptr;
-    pWaveIn2                = nullptr;
-    pWaveIn3                = nullptr;
-    pWaveIn4                = nullptr;
+    // Devices are opened in start() and startTestWaveOut()
+    pCapture                = nullptr;
+    pTestCapture            = nullptr;
+    pTestPlayback           = nullptr;
+    pNoiseSuppressor        = nullptr;
+    pAutomaticGainControl   = nullptr;
+    pMixer                  = nullptr;
+    pSessionRecorder        = nullptr;
+    pVoiceSender            = nullptr;
+
+    pFramePool              = new AudioFramePool( static_cast<size_t>(sampleCount) );
+
+
+    // Format
+    prepareForStart();
+
+
+    // Notification sounds are converted to the mixer format once.
+
+    pNotificationSounds     = new NotificationSounds();
+
+    std::string sSoundsErrorText;
+
+    if ( pNotificationSounds->load(format.iSampleRate, sSoundsErrorText) )
+    {
+        pMainWindow->printOutput(std::string("AudioService::AudioService::NotificationSounds::load() error: " + sSoundsErrorText
+                                             + " (the sounds that failed are not played)."),
+                                  SilentMessage(false),
+                                  true);
+    }
 
-    pTestWaveIn1                = nullptr;
-    pTestWaveIn2                = nullptr;
-    pTestWaveIn3                = nullptr;
-    pTestWaveIn4                = nullptr;
+
+    pVoiceActivityDetector     = new VoiceActivityDetector(format.iSampleRate, pSettingsManager->getCurrentSettings()->iVoiceHangoverMs);
+    pTestVoiceActivityDetector = new VoiceActivityDetector(format.iSampleRate, pSettingsManager->getCurrentSettings()->iVoiceHangoverMs);
+
+    pTestNoiseSuppressor       = new NoiseSuppressor(format.iSampleRate, format.iSamplesPerPacket);
+    pTestAutomaticGainControl  = new AutomaticGainControl(format.iSampleRate);
 
 
     // All audio will be x1.45 volume
@@ -54,7 +102,7 @@ AudioService::AudioService(MainWindow* pMainWindow, SettingsManager* pSettingsMa
     fMasterVolumeMult       = 1.45f;
 
     iAudioInputVolume = pSettingsManager->getCurrentSettings()->iInputVolumeMultiplier;
-    iLowerVoiceStartRecValueInDBFS = pSettingsManager->getCurrentSettings()->iVoiceStartRecValueInDBFS;
+    iVoiceStartPeakThreshold = LevelMeter::getPeakThreshold( pSettingsManager->getCurrentSettings()->iVoiceStartRecValueInDBFS );
     bOutputTestVoice = !pSettingsManager->getCurrentSettings()->bPushToTalkVoiceMode;
 
     startTestWaveOut();
@@ -105,33 +153,7 @@ float AudioService::getUserCurrentVolume(const std::string &sUserName)
 
 std::vector<std::wstring> AudioService::getInputDevices()
 {
-    UINT iInDeviceCount = waveInGetNumDevs();
-
-    std::vector<std::wstring> vSupportedDevices;
-
-    for (UINT i = 0; i < iInDeviceCount; i++)
-    {
-        WAVEINCAPS deviceInfo;
-
-        MMRESULT result = waveInGetDevCaps(i, &deviceInfo, sizeof(deviceInfo));
-        if (result)
-        {
-            char fault [256];
-            memset (fault, 0, 256);
-
-            waveInGetErrorTextA (result, fault, 256);
-            pMainWindow->printOutput (std::string("AudioService::getInputDevices::waveInGetDevCaps() error: " + std::string(fault) + "."),
-                                      SilentMessage(false),
-                                      true);
-           continue;
-        }
-        else
-        {
-            vSupportedDevices.push_back(deviceInfo.szPname);
-        }
-    }
-
-    return vSupportedDevices;
+    return pAudioBackend->getInputDevices();
 }
 
 int AudioService::getAudioPacketSizeInSamples() const
@@ -144,17 +166,33 @@ void AudioService::setNewMasterVolume(unsigned short int iVolume)
     pNetworkService->getOtherUsersMutex()->lock();
 
 
-    for (size_t i = 0;  i < pNetworkService->getOtherUsersVectorSize();  i++)
+    if (pMixer)
     {
-        waveOutSetVolume( pNetworkService->getOtherUser(i)->hWaveOut, MAKELONG(iVolume, iVolume) );
+        pMixer->setVolume(iVolume);
     }
 
-    waveOutSetVolume( hTestWaveOut, MAKELONG(iVolume, iVolume) );
+    if (pTestPlayback)
+    {
+        pTestPlayback->setVolume(iVolume);
+    }
 
 
     pNetworkService->getOtherUsersMutex()->unlock();
 }
 
+void AudioService::setInputDevice(const std::wstring& sDeviceName)
+{
+    // Switched by the thread that records (see SwitchableCaptureStream), the session goes on.
+    // If we are not connected the device is opened in start().
+
+    std::lock_guard<std::mutex> switchLock(mtxCaptureSwitch);
+
+    if (pCapture)
+    {
+        pCapture->switchDevice(sDeviceName);
+    }
+}
+
 void AudioService::setNewUserVolume(std::string sUserName, float fVolume)
 {
     User* pUser = nullptr;
@@ -175,6 +213,11 @@ void AudioService::setNewUserVolume(std::string sUserName, float fVolume)
     if (pUser)
     {
        pUser->fUserDefinedVolume = fVolume;
+
+       if (pUser->pMixerSpeaker && pMixer)
+       {
+           pMixer->setSpeakerGain( pUser->pMixerSpeaker, getUserGain(fVolume) );
+       }
     }
 
 
@@ -184,190 +227,192 @@ void AudioService::setNewUserVolume(std::string sUserName, float fVolume)
 
 void AudioService::prepareForStart()
 {
-    pWaveIn1  = new short int [ static_cast<size_t>(sampleCount) ];
-    pWaveIn2  = new short int [ static_cast<size_t>(sampleCount) ];
-    pWaveIn3  = new short int [ static_cast<size_t>(sampleCount) ];
-    pWaveIn4  = new short int [ static_cast<size_t>(sampleCount) ];
-
-
     // Format
-    Format.wFormatTag      = WAVE_FORMAT_PCM;
-    Format.nChannels       = 1;    //  '1' - mono, '2' - stereo
-    Format.cbSize          = 0;
-    Format.wBitsPerSample  = 16;
-    Format.nSamplesPerSec  = sampleRate;
-    Format.nBlockAlign     = Format.nChannels      * Format.wBitsPerSample / 8;
-    Format.nAvgBytesPerSec = Format.nSamplesPerSec * Format.nChannels           * Format.wBitsPerSample / 8;
+    format.iSampleRate       = static_cast<unsigned int>(sampleRate);
+    format.iSamplesPerPacket = sampleCount;
 
 
-    // "In" buffers
+    // The settings file may be edited by hand.
 
-    // Audio buffer 1
-    WaveInHdr1.lpData          = reinterpret_cast <LPSTR>         (pWaveIn1);
-    WaveInHdr1.dwBufferLength  = static_cast      <unsigned long> (sampleCount * 2);
-    WaveInHdr1.dwBytesRecorded = 0;
-    WaveInHdr1.dwUser          = 0L;
-    WaveInHdr1.dwFlags         = 0L;
-    WaveInHdr1.dwLoops         = 0L;
+    format.iCaptureBufferCount = pSettingsManager->getCurrentSettings()->iCaptureBufferCount;
 
+    if (format.iCaptureBufferCount < AUDIO_CAPTURE_BUFFER_COUNT_MIN)
+    {
+        format.iCaptureBufferCount = AUDIO_CAPTURE_BUFFER_COUNT_MIN;
+    }
+    else if (format.iCaptureBufferCount > AUDIO_CAPTURE_BUFFER_COUNT_MAX)
+    {
+        format.iCaptureBufferCount = AUDIO_CAPTURE_BUFFER_COUNT_MAX;
+    }
 
-    // Audio buffer 2
-    WaveInHdr2 = WaveInHdr1;
-    WaveInHdr2.lpData = reinterpret_cast <LPSTR> (pWaveIn2);
 
+    // Devices are opened at their native rate, we resample to the wire rate (0 - the system does it).
 
-    // Audio buffer 3
-    WaveInHdr3 = WaveInHdr1;
-    WaveInHdr3.lpData = reinterpret_cast <LPSTR> (pWaveIn3);
+    format.iDeviceSampleRate = pSettingsManager->getCurrentSettings()->iDeviceSampleRate;
 
+    if ( (format.iDeviceSampleRate != 0) && ( (format.iDeviceSampleRate < 8000) || (format.iDeviceSampleRate > 192000) ) )
+    {
+        format.iDeviceSampleRate = AUDIO_DEVICE_SAMPLE_RATE;
+    }
 
-    // Audio buffer 4
-    WaveInHdr4 = WaveInHdr1;
-    WaveInHdr4.lpData = reinterpret_cast <LPSTR> (pWaveIn4);
-}
 
-bool AudioService::start()
-{
-    MMRESULT result;
+    // One output device for all users (opened again, the settings may be changed).
 
-    UINT iDeviceID = WAVE_MAPPER;
+    std::lock_guard<std::mutex> mixerLock(mtxMixer);
 
-    int iPreferredDeviceID = getInputDeviceID( pSettingsManager->getCurrentSettings()->sInputDeviceName );
-    if (iPreferredDeviceID != -1)
+    if (pMixer)
     {
-        iDeviceID = static_cast<UINT>(iPreferredDeviceID);
+        delete pMixer;
+        pMixer = nullptr;
     }
 
-    // Start input device
-    result = waveInOpen (&hWaveIn,  iDeviceID,  &Format,  0L,  0L,  WAVE_FORMAT_DIRECT);
+    std::string sErrorText;
 
-    if (result)
-    {
-        char fault [256];
-        memset (fault, 0, 256);
+    AudioPlaybackStream* pDevice = pAudioBackend->openResampledPlayback(format, sErrorText);
 
+    if (pDevice == nullptr)
+    {
+        pMainWindow->printOutput(std::string("AudioService::prepareForStart::openResampledPlayback() " + pAudioBackend->getName() + " error: " + sErrorText),
+                                  SilentMessage(false),
+                                  true);
+    }
+    else
+    {
+        // The default device is opened again if this one is lost (unplugged headphones).
 
-        waveInGetErrorTextA (result, fault, 256);
-        pMainWindow->printOutput (std::string("AudioService::start::waveInOpen() error: " + std::string(fault) + "."),
-                                   SilentMessage(false),
-                                   true);
+        const AudioFormat outputFormat = format;
 
+        AudioPlaybackStream* pOutput = new SwitchablePlaybackStream(pDevice,
+            [this, outputFormat](std::string& sOpenErrorText)
+            {
+                return pAudioBackend->openResampledPlayback(outputFormat, sOpenErrorText);
+            },
+            [this](const AudioDeviceSwitch& deviceSwitch)
+            {
+                printDeviceSwitch(deviceSwitch, "speakers");
+            });
 
-        delete[] pWaveIn1;
-        pWaveIn1 = nullptr;
+        pMixer = new AudioMixer(pOutput, format);
+        pMixer->setVolume( pSettingsManager->getCurrentSettings()->iMasterVolume );
+        pMixer->setMaxSpeakers( static_cast<size_t>(std::max(pSettingsManager->getCurrentSettings()->iMaxSpeakersInMix, 0)) );
+    }
+}
 
-        delete[] pWaveIn2;
-        pWaveIn2 = nullptr;
+bool AudioService::start()
+{
+    // Start input device
+    std::string sErrorText;
 
-        delete[] pWaveIn3;
-        pWaveIn3 = nullptr;
+    const std::wstring sInputDeviceName = pSettingsManager->getCurrentSettings()->sInputDeviceName;
 
-        delete[] pWaveIn4;
-        pWaveIn4 = nullptr;
+    AudioCaptureStream* pDevice = pAudioBackend->openResampledCapture(sInputDeviceName, format, sErrorText);
 
+    if (pDevice == nullptr)
+    {
+        pMainWindow->printOutput (std::string("AudioService::start::openResampledCapture() " + pAudioBackend->getName() + " error: " + sErrorText),
+                                   SilentMessage(false),
+                                   true);
 
         return false;
     }
     else
     {
-        bInputReady = true;
-    }
+        // Can be moved to another device without restarting the session (see setInputDevice()).
 
+        const AudioFormat captureFormat = format;
 
-    if (pSettingsManager->getCurrentSettings()->bPushToTalkVoiceMode)
-    {
-        std::thread recordThread (&AudioService::recordOnPush, this);
-        recordThread.detach ();
-    }
-    else
-    {
-        std::thread recordThread (&AudioService::recordOnTalk, this);
-        recordThread.detach ();
+        mtxCaptureSwitch.lock();
+
+        pCapture = new SwitchableCaptureStream(pDevice, sInputDeviceName, format,
+            [this, captureFormat](const std::wstring& sDeviceName, std::string& sOpenErrorText)
+            {
+                return pAudioBackend->openResampledCapture(sDeviceName, captureFormat, sOpenErrorText);
+            },
+            [this](const AudioDeviceSwitch& deviceSwitch)
+            {
+                printDeviceSwitch(deviceSwitch, "microphone");
+            });
+
+        mtxCaptureSwitch.unlock();
+
+        bInputReady = true;
     }
 
-    return true;
-}
+    pNoiseSuppressor      = new NoiseSuppressor(format.iSampleRate, format.iSamplesPerPacket);
+    pAutomaticGainControl = new AutomaticGainControl(format.iSampleRate);
 
-void AudioService::startTestWaveOut()
-{
-    pTestWaveIn1  = new short int [ static_cast<size_t>(sampleCount) ];
-    pTestWaveIn2  = new short int [ static_cast<size_t>(sampleCount) ];
-    pTestWaveIn3  = new short int [ static_cast<size_t>(sampleCount) ];
-    pTestWaveIn4  = new short int [ static_cast<size_t>(sampleCount) ];
+    pushToTalkStats = PushToTalkStats();
 
+    mtxOutgoingLatency.lock();
+    outgoingLatency.reset();
+    mtxOutgoingLatency.unlock();
 
-    // Format
-    Format.wFormatTag      = WAVE_FORMAT_PCM;
-    Format.nChannels       = 1;    //  '1' - mono, '2' - stereo
-    Format.cbSize          = 0;
-    Format.wBitsPerSample  = 16;
-    Format.nSamplesPerSec  = sampleRate;
-    Format.nBlockAlign     = Format.nChannels      * Format.wBitsPerSample / 8;
-    Format.nAvgBytesPerSec = Format.nSamplesPerSec * Format.nChannels           * Format.wBitsPerSample / 8;
+    if (pMixer)
+    {
+        pMixer->resetStats();
+    }
 
+    pFramePool->resetStats();
 
-    // "In" buffers
+    startSessionRecording();
 
-    // Audio buffer 1
-    TestWaveInHdr1.lpData          = reinterpret_cast <LPSTR>         (pTestWaveIn1);
-    TestWaveInHdr1.dwBufferLength  = static_cast      <unsigned long> (sampleCount * 2);
-    TestWaveInHdr1.dwBytesRecorded = 0;
-    TestWaveInHdr1.dwUser          = 0L;
-    TestWaveInHdr1.dwFlags         = 0L;
-    TestWaveInHdr1.dwLoops         = 0L;
 
+    // Our packets go out in the order they were recorded.
 
-    // Audio buffer 2
-    TestWaveInHdr2 = TestWaveInHdr1;
-    TestWaveInHdr2.lpData = reinterpret_cast <LPSTR> (pTestWaveIn2);
+    pVoiceSender = new VoiceSender(
+        [this](AudioFrame& packet)
+        {
+            sendVoicePacket(packet);
+        },
+        [this]()
+        {
+            pNetworkService->sendVoiceMessage(nullptr, 1, true);
+        });
 
 
-    // Audio buffer 3
-    TestWaveInHdr3 = TestWaveInHdr1;
-    TestWaveInHdr3.lpData = reinterpret_cast <LPSTR> (pTestWaveIn3);
+    if (pSettingsManager->getCurrentSettings()->bPushToTalkVoiceMode)
+    {
+        iPushToTalkButton = pSettingsManager->getCurrentSettings()->iPushToTalkButton;
 
+        if ( pInputSource->start({iPushToTalkButton}, sErrorText) )
+        {
+            pMainWindow->printOutput (std::string("AudioService::start::InputSource::start() " + pInputSource->getName() + " error: " + sErrorText),
+                                       SilentMessage(false),
+                                       true);
 
-    // Audio buffer 4
-    TestWaveInHdr4 = TestWaveInHdr1;
-    TestWaveInHdr4.lpData = reinterpret_cast <LPSTR> (pTestWaveIn4);
+            pMainWindow->showMessageBox(true, "The push-to-talk button won't work, choose another button "
+                                              "or the voice activation in the settings.");
 
-    MMRESULT result;
+            // Not the voice activation instead: we would send what the user didn't want to.
+            // Frees everything that was created above.
+            stop();
 
-    UINT iDeviceID = WAVE_MAPPER;
+            return false;
+        }
 
-    int iPreferredDeviceID = getInputDeviceID( pSettingsManager->getCurrentSettings()->sInputDeviceName );
-    if (iPreferredDeviceID != -1)
+        recordThread = std::thread(&AudioService::recordOnPush, this);
+    }
+    else
     {
-        iDeviceID = static_cast<UINT>(iPreferredDeviceID);
+        recordThread = std::thread(&AudioService::recordOnTalk, this);
     }
 
-    // Start input device
-    result = waveInOpen (&hTestWaveIn,  iDeviceID,  &Format,  0L,  0L,  WAVE_FORMAT_DIRECT);
+    return true;
+}
 
-    if (result)
-    {
-        char fault [256];
-        memset (fault, 0, 256);
+void AudioService::startTestWaveOut()
+{
+    // Start input device
+    std::string sErrorText;
 
+    pTestCapture = pAudioBackend->openResampledCapture(pSettingsManager->getCurrentSettings()->sInputDeviceName, format, sErrorText);
 
-        waveInGetErrorTextA (result, fault, 256);
-        pMainWindow->printOutput (std::string("AudioService::startTestWaveOut::waveInOpen() error: " + std::string(fault) + "."),
+    if (pTestCapture == nullptr)
+    {
+        pMainWindow->printOutput (std::string("AudioService::startTestWaveOut::openResampledCapture() " + pAudioBackend->getName() + " error: " + sErrorText),
                                    SilentMessage(false),
                                    true);
 
-
-        delete[] pTestWaveIn1;
-        pTestWaveIn1 = nullptr;
-
-        delete[] pTestWaveIn2;
-        pTestWaveIn2 = nullptr;
-
-        delete[] pTestWaveIn3;
-        pTestWaveIn3 = nullptr;
-
-        delete[] pTestWaveIn4;
-        pTestWaveIn4 = nullptr;
-
         return;
     }
     else
@@ -386,11 +431,11 @@ void AudioService::playConnectDisconnectSound(bool bConnectSound)
     {
         if (bConnectSound)
         {
-            PlaySoundW( AUDIO_CONNECT_PATH,    nullptr, SND_FILENAME | SND_ASYNC );
+            playNotificationSound( NS_CONNECT );
         }
         else
         {
-            PlaySoundW( AUDIO_DISCONNECT_PATH, nullptr, SND_FILENAME | SND_ASYNC );
+            playNotificationSound( NS_DISCONNECT );
         }
     }
 }
@@ -399,68 +444,170 @@ void AudioService::playMuteMicSound(bool bMuteSound)
 {
     if (bMuteSound)
     {
-        PlaySoundW( AUDIO_MUTE_MIC_PATH,   nullptr, SND_FILENAME | SND_ASYNC );
+        playNotificationSound( NS_MUTE_MIC );
     }
     else
     {
-        PlaySoundW( AUDIO_UNMUTE_MIC_PATH, nullptr, SND_FILENAME | SND_ASYNC );
+        playNotificationSound( NS_UNMUTE_MIC );
     }
 }
 
 void AudioService::playServerMessageSound()
 {
-    PlaySoundW( AUDIO_SERVER_MESSAGE_PATH, nullptr, SND_FILENAME | SND_ASYNC );
+    playNotificationSound( NS_SERVER_MESSAGE );
 }
 
 void AudioService::playNewMessageSound()
 {
     if (pSettingsManager->getCurrentSettings()->bPlayTextMessageSound)
     {
-       PlaySoundW( AUDIO_NEW_MESSAGE_PATH, nullptr, SND_FILENAME | SND_ASYNC );
+       playNotificationSound( NS_NEW_MESSAGE );
     }
 }
 
 void AudioService::playLostConnectionSound()
 {
-    PlaySoundW( AUDIO_LOST_CONNECTION_PATH, nullptr, SND_FILENAME );
+    playNotificationSound( NS_LOST_CONNECTION );
 }
 
-void AudioService::setupUserAudio(User *pUser)
+void AudioService::playNotificationSound(NOTIFICATION_SOUND sound)
 {
-    pUser->bPacketsArePlaying   = false;
-    pUser->bDeletePacketsAtLast = false;
-    pUser->bLastPacketCame      = false;
-    pUser->fUserDefinedVolume   = 1.0f;
+    std::lock_guard<std::mutex> lock(mtxMixer);
 
+    if (pMixer)
+    {
+        pMixer->playSound( pNotificationSounds->getSound(sound) );
+    }
+}
 
-    // Audio buffer1
-    pUser->WaveOutHdr1.dwBufferLength  = static_cast <unsigned long> (sampleCount * 2);
-    pUser->WaveOutHdr1.dwBytesRecorded = 0;
-    pUser->WaveOutHdr1.dwUser          = 0L;
-    pUser->WaveOutHdr1.dwFlags         = 0L;
-    pUser->WaveOutHdr1.dwLoops         = 0L;
+void AudioService::startSessionRecording()
+{
+    const int iMode = pSettingsManager->getCurrentSettings()->iSessionRecording;
 
-    // Audio buffer2
-    pUser->WaveOutHdr2 = pUser->WaveOutHdr1;
+    std::lock_guard<std::mutex> lock(mtxMixer);
 
+    if ( (iMode == SRM_OFF) || (pMixer == nullptr) || pSessionRecorder )
+    {
+        return;
+    }
 
+    std::string sErrorText;
 
-    // Start output device
-    MMRESULT result = waveOutOpen( &pUser->hWaveOut,  WAVE_MAPPER,  &Format,  0L,  0L,  WAVE_FORMAT_DIRECT );
+    pSessionRecorder = new SessionRecorder(format);
 
-    if (result)
+    if ( pSessionRecorder->start(SESSION_RECORDER_DIRECTORY, sErrorText) )
     {
-        char fault [256];
-        memset (fault, 0, 256);
+        pMainWindow->printOutput(std::string("AudioService::startSessionRecording::SessionRecorder::start() error: " + sErrorText),
+                                 SilentMessage(false),
+                                 true);
 
-        waveInGetErrorTextA (result, fault, 256);
-        pMainWindow->printOutput(std::string("AudioService::addNewUser::waveOutOpen() error: " + std::string(fault) + "."),
-                                  SilentMessage(false),
-                                  true);
+        delete pSessionRecorder;
+        pSessionRecorder = nullptr;
+
+        return;
+    }
+
+    pMixer->setRecorder(pSessionRecorder, iMode == SRM_MIX_AND_SPEAKERS);
+
+    pMainWindow->printOutputW(L"Recording the session to \"" + pSessionRecorder->getDirectory().wstring() + L"\".",
+                              SilentMessage(false),
+                              true);
+}
+
+void AudioService::stopSessionRecording()
+{
+    std::lock_guard<std::mutex> lock(mtxMixer);
+
+    if (pSessionRecorder == nullptr)
+    {
+        return;
+    }
+
+    if (pMixer)
+    {
+        pMixer->setRecorder(nullptr, false);
+    }
+
+    // Writes the rest of the queue.
+    pSessionRecorder->stop();
+
+    SessionRecorderStats stats = pSessionRecorder->getStats();
+
+    char vStatsText[256];
+    std::snprintf(vStatsText, sizeof(vStatsText),
+                  "Session recording: %zu tracks, %llu packets, %llu dropped (the disk was too slow), %llu not written (disk errors), "
+                  "%zu of %d queued max.\n",
+                  stats.iStreamCount, stats.iPacketCount, stats.iDroppedPacketCount, stats.iWriteErrorCount,
+                  stats.iMaxQueuedPackets, SESSION_RECORDER_QUEUE_PACKETS);
+
+    pMainWindow->printOutput(vStatsText, SilentMessage(false), true);
+
+    delete pSessionRecorder;
+    pSessionRecorder = nullptr;
+}
+
+void AudioService::printDeviceSwitch(const AudioDeviceSwitch& deviceSwitch, const std::string& sDeviceType)
+{
+    std::string sDeviceName = "the default device";
+
+    if (deviceSwitch.sDeviceName.empty() == false)
+    {
+        using convert_type = std::codecvt_utf8<wchar_t>;
+        std::wstring_convert<convert_type, wchar_t> converter;
+
+        sDeviceName = "\"" + converter.to_bytes(deviceSwitch.sDeviceName) + "\"";
+    }
+
+    if (deviceSwitch.bFailed)
+    {
+        pMainWindow->printOutput("Could not switch the " + sDeviceType + " to " + sDeviceName + ": " + deviceSwitch.sErrorText
+                                 + " (the old device is still used).",
+                                 SilentMessage(false),
+                                 true);
+
+        return;
+    }
+
+    char vSwitchText[256];
+
+    if (deviceSwitch.bAfterFailure)
+    {
+        std::snprintf(vSwitchText, sizeof(vSwitchText),
+                      "The %s stopped working (%s), opened %s again in %.0f ms, %llu packets lost.\n",
+                      sDeviceType.c_str(), deviceSwitch.sErrorText.c_str(), sDeviceName.c_str(),
+                      deviceSwitch.dSwitchMs, deviceSwitch.iLostPackets);
+    }
+    else
+    {
+        std::snprintf(vSwitchText, sizeof(vSwitchText),
+                      "Switched the %s to %s in %.0f ms, %llu packets lost.\n",
+                      sDeviceType.c_str(), sDeviceName.c_str(), deviceSwitch.dSwitchMs, deviceSwitch.iLostPackets);
+    }
+
+    pMainWindow->printOutput(vSwitchText, SilentMessage(false), true);
+}
+
+void AudioService::setupUserAudio(User *pUser)
+{
+    pUser->fUserDefinedVolume   = 1.0f;
+    pUser->pMixerSpeaker        = nullptr;
+
+    if (pMixer == nullptr)
+    {
+        // The error was shown in prepareForStart().
+        return;
     }
 
-    waveOutSetVolume( pUser->hWaveOut, MAKELONG(pSettingsManager->getCurrentSettings()->iMasterVolume,
-                                                 pSettingsManager->getCurrentSettings()->iMasterVolume) );
+
+    // Called from the mixer's thread.
+
+    pUser->pMixerSpeaker = pMixer->addSpeaker([this, pUser](bool bTalking)
+    {
+        pUser      ->bTalking = bTalking;
+        pMainWindow->setPingAndTalkingToUser(pUser->pListWidgetItem, pUser->iPing, pUser->bTalking);
+    }, pUser->sUserName);
+
+    pMixer->setSpeakerGain( pUser->pMixerSpeaker, getUserGain(pUser->fUserDefinedVolume) );
 }
 
 void AudioService::deleteUserAudio(User *pUser)
@@ -468,20 +615,32 @@ void AudioService::deleteUserAudio(User *pUser)
     pUser->mtxUser. lock();
 
 
-    for (size_t j = 0;  j < pUser->vAudioPackets.size();  j++)
+    if (pUser->pMixerSpeaker && pMixer)
     {
-        if (pUser->vAudioPackets[j])
+        VoiceLatencyStats latency = pMixer->getSpeakerLatency(pUser->pMixerSpeaker);
+
+        if (latency.getTotal().getCount() > 0)
         {
-            delete[] pUser->vAudioPackets[j];
+            pMainWindow->printOutput("Voice latency of " + pUser->sUserName + " (on our side):\n" + latency.toString("    "),
+                                     SilentMessage(false),
+                                     true);
         }
+
+        // Deletes the packets that were not played.
+        pMixer->removeSpeaker(pUser->pMixerSpeaker);
     }
 
-    waveOutClose (pUser->hWaveOut);
+    pUser->pMixerSpeaker = nullptr;
 
 
     pUser->mtxUser. unlock();
 }
 
+float AudioService::getUserGain(float fUserDefinedVolume) const
+{
+    return fMasterVolumeMult + (fUserDefinedVolume - 1.0f);
+}
+
 void AudioService::setTestRecordingPause(bool bPause)
 {
     bPauseTestInput = bPause;
@@ -489,327 +648,343 @@ void AudioService::setTestRecordingPause(bool bPause)
 
 void AudioService::recordOnPush()
 {
-    MMRESULT result;
+    const int iPreRollMs = pSettingsManager->getCurrentSettings()->iPushToTalkPreRollMs;
+
+    if (iPreRollMs > 0)
+    {
+        const double dPacketMs = 1000.0 * sampleCount / sampleRate;
+
+        const size_t iPreRollPackets = static_cast<size_t>( std::ceil(std::min(iPreRollMs, PUSH_TO_TALK_MAX_PRE_ROLL_MS) / dPacketMs) );
+
+        if ( recordOnPushWithPreRoll(iPreRollPackets) )
+        {
+            pMainWindow->showMessageBox(true, "The voice recording won't work.");
+        }
 
+        return;
+    }
+
+
+    // The microphone is started when the button is pressed.
 
-    bool bError               = false;
-    bool bButtonPressed       = false;
-    bool bWaitForFourthBuffer = false;
+    bool bError = false;
+
+    InputEvent event;
 
-    while(bInputReady)
+    while ( bInputReady && pInputSource->waitForEvent(event) )
     {
-        while ( (GetAsyncKeyState(pSettingsManager->getCurrentSettings()->iPushToTalkButton) & 0x8000)
-                && bInputReady
-                && bMuteMic == false)
+        // Skip the releases and the presses that are already released (we were recording).
+
+        if ( event.bDown && isPushToTalkButtonPressed() && (bMuteMic == false) )
         {
+            const std::chrono::time_point<std::chrono::steady_clock> pressTime = event.time;
+
             // Button pressed
-            if ( (bButtonPressed == false) && (pSettingsManager->getCurrentSettings()->bPlayPushToTalkSound) )
+            if (pSettingsManager->getCurrentSettings()->bPlayPushToTalkSound)
             {
-                PlaySoundW( AUDIO_PRESS_PATH, nullptr, SND_FILENAME | SND_ASYNC );
+                playNotificationSound( NS_PRESS );
             }
 
-            bButtonPressed = true;
-
-            if (bWaitForFourthBuffer == false)
+            if ( pCapture->start() )
             {
-                // Add 1st buffer
-                if ( addInBuffer(&WaveInHdr1) )
-                {
-                    bError = true;
-                    break;
-                }
+                pMainWindow->printOutput(std::string("AudioService::recordOnPush::start() error: " + pCapture->getLastError()),
+                                          SilentMessage(false),
+                                          true);
 
-                // Add 2nd buffer
-                if ( addInBuffer(&WaveInHdr2) )
-                {
-                    bError = true;
-                    break;
-                }
+                bError = true;
+                break;
+            }
 
-                // Add 3rd buffer
-                if ( addInBuffer(&WaveInHdr3) )
-                {
-                    bError = true;
-                    break;
-                }
+            pNoiseSuppressor->reset();
+
+
+            // Record while the button is pressed.
 
-                // Add 4th buffer
-                if ( addInBuffer(&WaveInHdr4) )
+            bool bFirstPacket = true;
+
+            while ( bInputReady && isPushToTalkButtonPressed() && (bMuteMic == false) )
+            {
+                AudioFrame packet;
+
+                if ( recordPacket(pCapture, pNoiseSuppressor, pAutomaticGainControl, packet, "recordOnPush") )
                 {
                     bError = true;
                     break;
                 }
 
-                // Start recording for ('sampleCount/sampleRate' * 4) seconds
-                // Current buffers queue: 1 (recording) - 2 - 3 - 4.
-                result = waveInStart(hWaveIn);
+                sendAudioData( std::move(packet) );
 
-                if (result)
+                if (bFirstPacket)
                 {
-                    char fault [256];
-                    memset (fault, 0, 256);
-
-                    waveInGetErrorTextA (result, fault, 256);
-                    pMainWindow->printOutput(std::string("AudioService::recordOnPress::waveInStart() error: " + std::string(fault) + "."),
-                                              SilentMessage(false),
-                                              true);
+                    pushToTalkStats.addPress( std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pressTime).count(), 0.0 );
 
-                    bError = true;
-                    break;
+                    bFirstPacket = false;
                 }
             }
-            else
+
+
+            // Button unpressed.
+            // The buffers that were queued to the device are still recorded, send them too
+            // (it's the end of the phrase).
+
+            for (int i = 0;  (i < pCapture->getBufferCount() - 1) && bInputReady && (bError == false);  i++)
             {
-                // Wait until 4th buffer finished recording.
-                // 4-1-2-3.
-                waitAndSendBuffer(&WaveInHdr4, pWaveIn4);
-
-                ///////////////////////////////
-                // Add 4th buffer
-                // 1-2-3-(4).
-                ///////////////////////////////
-                if ( addInBuffer(&WaveInHdr4) )
+                AudioFrame packet;
+
+                if ( recordPacket(pCapture, pNoiseSuppressor, pAutomaticGainControl, packet, "recordOnPush") )
                 {
                     bError = true;
                     break;
                 }
-            }
 
-
-            // Wait until 1st buffer finished recording.
-            // 1-2-3-4.
-            waitAndSendBuffer (&WaveInHdr1, pWaveIn1);
-
-
-            ///////////////////////////////
-            // Add 1st buffer
-            // 2-3-4-(1).
-            ///////////////////////////////
-            if ( addInBuffer(&WaveInHdr1) )
-            {
-                bError = true;
-                break;
+                sendAudioData( std::move(packet) );
             }
 
+            pCapture->stop();
 
-            // Wait until 2nd buffer finished recording.
-            // 2-3-4-1.
-            waitAndSendBuffer (&WaveInHdr2, pWaveIn2);
-
-
-            ///////////////////
-            // Add 2nd buffer.
-            // 3-4-1-(2).
-            ///////////////////
-
-            if ( addInBuffer(&WaveInHdr2) )
+            if (bError)
             {
-                bError = true;
                 break;
             }
 
 
-            // Wait until 3rd buffer finished recording.
-            // 3-4-1-2.
-            waitAndSendBuffer (&WaveInHdr3, pWaveIn3);
-
+            if (bInputReady)
+            {
+                // After the packets above.
 
-            ///////////////////
-            // Add 3rd buffer.
-            // 4-1-2-(3).
-            ///////////////////
+                pVoiceSender->pushEnd();
 
-            if ( (GetAsyncKeyState(pSettingsManager->getCurrentSettings()->iPushToTalkButton) & 0x8000)
-                 && bMuteMic == false)
-            {
-                if ( addInBuffer(&WaveInHdr3) )
+                if ( pSettingsManager->getCurrentSettings()->bPushToTalkVoiceMode
+                     && pSettingsManager->getCurrentSettings()->bPlayPushToTalkSound )
                 {
-                    bError = true;
-                    break;
+                    playNotificationSound( NS_UNPRESS );
                 }
-
-                bWaitForFourthBuffer = true;
             }
-            else break;
         }
+    }
 
+    if (bError)
+    {
+        pMainWindow->showMessageBox(true, "The voice recording won't work.");
+    }
+}
 
+bool AudioService::recordOnPushWithPreRoll(size_t iPreRollPackets)
+{
+    // The microphone is always on, the packets go to the pre-roll while the button is not pressed.
+    // The button is checked once per packet (the pre-roll covers that).
 
-        if (bButtonPressed && bInputReady)
-        {
-            // Button unpressed
-            bButtonPressed = false;
-            bWaitForFourthBuffer = false;
-
-            if (bError)
-            {
-                waitForAllInBuffers();
-
-                bError = false;
-            }
+    if ( pCapture->start() )
+    {
+        pMainWindow->printOutput(std::string("AudioService::recordOnPushWithPreRoll::start() error: " + pCapture->getLastError()),
+                                  SilentMessage(false),
+                                  true);
 
-            // Wait until 4th buffer finished recording.
-            // 4-1-2.
-            waitAndSendBuffer (&WaveInHdr4, pWaveIn4);
+        return true;
+    }
 
+    pNoiseSuppressor->reset();
 
-            // Wait until 1st buffer finished recording.
-            waitAndSendBuffer (&WaveInHdr1, pWaveIn1);
 
+    const double dPacketMs = 1000.0 * sampleCount / sampleRate;
 
-            // Wait until 2nd buffer finished recording.
-            waitAndSendBuffer (&WaveInHdr2, pWaveIn2);
+    // Copies of the last packets (allocated once), the pool frames are given back right away.
+    FrameRing preRoll(iPreRollPackets, static_cast<size_t>(sampleCount));
 
+    bool bError           = false;
+    bool bWasPressed      = false;
+    int  iTailPacketsLeft = 0;
 
-            waveInStop(hWaveIn);
+    std::chrono::time_point<std::chrono::steady_clock> lastPressTime = std::chrono::steady_clock::now();
 
+    while (bInputReady)
+    {
+        AudioFrame packet;
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if ( recordPacket(pCapture, pNoiseSuppressor, pAutomaticGainControl, packet, "recordOnPushWithPreRoll") )
+        {
+            bError = true;
+            break;
+        }
 
+        // We only need the time of the last press, the state is in isPushToTalkButtonPressed().
 
-            pNetworkService->sendVoiceMessage(nullptr, 1, true);
+        InputEvent event;
 
-            if ( pSettingsManager->getCurrentSettings()->bPushToTalkVoiceMode
-                 && pSettingsManager->getCurrentSettings()->bPlayPushToTalkSound )
+        while ( pInputSource->popEvent(event) )
+        {
+            if (event.bDown)
             {
-                PlaySoundW( AUDIO_UNPRESS_PATH, nullptr, SND_FILENAME | SND_ASYNC );
+                lastPressTime = event.time;
             }
         }
 
-        if (bInputReady) std::this_thread::sleep_for( std::chrono::milliseconds(INTERVAL_AUDIO_RECORD_MS) );
-    }
-}
+        const bool bPressed = isPushToTalkButtonPressed() && (bMuteMic == false);
 
-void AudioService::recordOnTalk()
-{
-    MMRESULT result;
+        if (bPressed)
+        {
+            if (bWasPressed == false)
+            {
+                // Button pressed, the speech started a bit before that - send the pre-roll first.
 
-    bool bError = false;
-    bool bWaitForFourthBuffer = false;
+                const std::chrono::time_point<std::chrono::steady_clock> pressTime = lastPressTime;
 
-    iPacketsNeedToRecordLeft = 4;
+                if (pSettingsManager->getCurrentSettings()->bPlayPushToTalkSound)
+                {
+                    playNotificationSound( NS_PRESS );
+                }
 
-    bRecordedSome = false;
+                const double dPreRollMs = preRoll.getSize() * dPacketMs;
 
-    while(bInputReady)
-    {
-        if (bWaitForFourthBuffer == false)
-        {
-            // Add 1st buffer
-            if ( addInBuffer(&WaveInHdr1) )
-            {
-                break;
-            }
+                // The whole pre-roll fits in the send queue (see VOICE_SENDER_QUEUE_PACKETS).
 
-            // Add 2nd buffer
-            if ( addInBuffer(&WaveInHdr2) )
+                while (preRoll.isEmpty() == false)
+                {
+                    AudioFrame preRollPacket = pFramePool->acquire();
+
+                    preRoll.pop( preRollPacket.getSamples(), &preRollPacket.getTimestamps() );
+
+                    sendAudioData( std::move(preRollPacket) );
+                }
+
+                sendAudioData( std::move(packet) );
+
+                pushToTalkStats.addPress( std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pressTime).count(), dPreRollMs );
+            }
+            else
             {
-                bError = true;
-                break;
+                sendAudioData( std::move(packet) );
             }
 
-            // Add 3rd buffer
-            if ( addInBuffer(&WaveInHdr3) )
+            iTailPacketsLeft = 0;
+        }
+        else
+        {
+            if (bWasPressed)
             {
-                bError = true;
-                break;
+                // Button unpressed.
+                // Send this packet and as many as without the pre-roll (the end of the phrase).
+
+                iTailPacketsLeft = pCapture->getBufferCount();
             }
 
-            // Add 4th buffer
-            if ( addInBuffer(&WaveInHdr4) )
+            if (iTailPacketsLeft > 0)
             {
-                bError = true;
-                break;
-            }
+                sendAudioData( std::move(packet) );
 
-            // Start recording for ('sampleCount/sampleRate' * 4) seconds
-            // Current buffers queue: 1 (recording) - 2 - 3 - 4.
-            result = waveInStart(hWaveIn);
+                iTailPacketsLeft--;
 
-            if (result)
-            {
-                char fault [256];
-                memset (fault, 0, 256);
+                if (iTailPacketsLeft == 0)
+                {
+                    pVoiceSender->pushEnd();
 
-                waveInGetErrorTextA (result, fault, 256);
-                pMainWindow->printOutput(std::string("AudioService::recordOnTalk::waveInStart() error: " + std::string(fault) + "."),
-                                          SilentMessage(false),
-                                          true);
+                    if (pSettingsManager->getCurrentSettings()->bPlayPushToTalkSound)
+                    {
+                        playNotificationSound( NS_UNPRESS );
+                    }
+                }
+            }
+            else if (bMuteMic == false)
+            {
+                // Overwrites the oldest one when full.
 
-                bError = true;
-                break;
+                preRoll.push( packet.getSamples(), packet.getTimestamps() );
             }
         }
-        else
+
+        if (bMuteMic)
         {
-            // Wait until 4th buffer finished recording.
-            // 4-1-2-3.
-            waitAndSendBuffer(&WaveInHdr4, pWaveIn4, true);
-
-            ///////////////////////////////
-            // Add 4th buffer
-            // 1-2-3-(4).
-            ///////////////////////////////
-            if ( addInBuffer(&WaveInHdr4) )
-            {
-                bError = true;
-                break;
-            }
+            // Nothing from before the mute should be sent after it.
+
+            preRoll.clear();
         }
 
+        bWasPressed = bPressed;
+    }
 
-        // Wait until 1st buffer finished recording.
-        // 1-2-3-4.
-        waitAndSendBuffer (&WaveInHdr1, pWaveIn1, true);
 
+    pCapture->stop();
 
-        ///////////////////////////////
-        // Add 1st buffer
-        // 2-3-4-(1).
-        ///////////////////////////////
-        if ( addInBuffer(&WaveInHdr1) )
-        {
-            bError = true;
-            break;
-        }
+    return bError;
+}
+
+void AudioService::recordOnTalk()
+{
+    bool bError = false;
+
+    pVoiceActivityDetector->reset();
 
+    bool bTalking = false;
 
-        // Wait until 2nd buffer finished recording.
-        // 2-3-4-1.
-        waitAndSendBuffer (&WaveInHdr2, pWaveIn2, true);
 
+    if ( pCapture->start() )
+    {
+        pMainWindow->printOutput(std::string("AudioService::recordOnTalk::start() error: " + pCapture->getLastError()),
+                                  SilentMessage(false),
+                                  true);
+
+        bError = true;
+    }
+
+    pNoiseSuppressor->reset();
 
-        ///////////////////
-        // Add 2nd buffer.
-        // 3-4-1-(2).
-        ///////////////////
+    // A copy of the last packet that was not sent (allocated once),
+    // it's sent first when the speech starts (see VoiceActivityDetector::isOnset()).
+    FrameRing previousPacket(1, static_cast<size_t>(sampleCount));
+
+    while (bInputReady && (bError == false))
+    {
+        AudioFrame packet;
 
-        if ( addInBuffer(&WaveInHdr2) )
+        if ( recordPacket(pCapture, pNoiseSuppressor, pAutomaticGainControl, packet, "recordOnTalk") )
         {
             bError = true;
             break;
         }
 
+        // Here and not in the send thread: the voice activation depends on the previous packets.
 
-        // Wait until 3rd buffer finished recording.
-        // 3-4-1-2.
-        waitAndSendBuffer (&WaveInHdr3, pWaveIn3, true);
+        if ( isVoiceOnTalk(packet.getSamples()) && (bMuteMic == false) )
+        {
+            if ( pVoiceActivityDetector->isOnset() && (previousPacket.isEmpty() == false) )
+            {
+                AudioFrame preRollPacket = pFramePool->acquire();
 
+                previousPacket.pop( preRollPacket.getSamples(), &preRollPacket.getTimestamps() );
 
-        ///////////////////
-        // Add 3rd buffer.
-        // 4-1-2-(3).
-        ///////////////////
+                pVoiceSender->push( std::move(preRollPacket) );
+            }
 
-        if ( addInBuffer(&WaveInHdr3) )
-        {
-            bError = true;
-            break;
+            pVoiceSender->push( std::move(packet) );
+
+            bTalking = true;
         }
+        else
+        {
+            if (bTalking)
+            {
+                pVoiceSender->pushEnd();
+
+                bTalking = false;
+            }
+
+            if (bMuteMic)
+            {
+                // Nothing from before the mute should be sent after it.
+
+                previousPacket.clear();
+            }
+            else
+            {
+                // Overwrites the one before.
 
-        bWaitForFourthBuffer = true;
+                previousPacket.push( packet.getSamples(), packet.getTimestamps() );
+            }
+        }
     }
 
+    pCapture->stop();
+
     if (bError)
     {
         pMainWindow->showMessageBox(true, "The voice recording won't work.");
@@ -818,13 +993,10 @@ void AudioService::recordOnTalk()
 
 void AudioService::testRecord()
 {
-    MMRESULT result;
-
     bool bError = false;
     bool bWasStarted = false;
-    bool bWaitForFourthBuffer = false;
 
-    iTestPacketsNeedToRecordLeft = 4;
+    pTestVoiceActivityDetector->reset();
 
     std::thread tOutputThread(&AudioService::testOutputAudio, this);
     tOutputThread.detach();
@@ -836,11 +1008,7 @@ void AudioService::testRecord()
         {
             if (bWasStarted)
             {
-                waitForAllTestInBuffers();
-
-                waveInStop(hTestWaveIn);
-
-                bWaitForFourthBuffer = false;
+                pTestCapture->stop();
 
                 bWasStarted = false;
             }
@@ -852,125 +1020,39 @@ void AudioService::testRecord()
 
         if (bTestInputReady == false) break;
 
-        bWasStarted = true;
 
-        if (bWaitForFourthBuffer == false)
+        if (bWasStarted == false)
         {
-            // Add 1st buffer
-            if ( addInBuffer(&TestWaveInHdr1, true) )
-            {
-                break;
-            }
-
-            // Add 2nd buffer
-            if ( addInBuffer(&TestWaveInHdr2, true) )
-            {
-                bError = true;
-                break;
-            }
-
-            // Add 3rd buffer
-            if ( addInBuffer(&TestWaveInHdr3, true) )
-            {
-                bError = true;
-                break;
-            }
-
-            // Add 4th buffer
-            if ( addInBuffer(&TestWaveInHdr4, true) )
-            {
-                bError = true;
-                break;
-            }
-
-            // Start recording for ('sampleCount/sampleRate' * 4) seconds
-            // Current buffers queue: 1 (recording) - 2 - 3 - 4.
-            result = waveInStart(hTestWaveIn);
-
-            if (result)
+            if ( pTestCapture->start() )
             {
-                char fault [256];
-                memset (fault, 0, 256);
-
-                waveInGetErrorTextA (result, fault, 256);
-                pMainWindow->printOutput(std::string("AudioService::testRecord::waveInStart() error: " + std::string(fault) + "."),
+                pMainWindow->printOutput(std::string("AudioService::testRecord::start() error: " + pTestCapture->getLastError()),
                                           SilentMessage(false),
                                           true);
 
                 bError = true;
                 break;
             }
-        }
-        else
-        {
-            // Wait until 4th buffer finished recording.
-            // 4-1-2-3.
-            waitAndShowBufferVolume(&TestWaveInHdr4, pTestWaveIn4);
-
-            ///////////////////////////////
-            // Add 4th buffer
-            // 1-2-3-(4).
-            ///////////////////////////////
-            if ( addInBuffer(&TestWaveInHdr4, true) )
-            {
-                bError = true;
-                break;
-            }
-        }
-
-
-        // Wait until 1st buffer finished recording.
-        // 1-2-3-4.
-        waitAndShowBufferVolume (&TestWaveInHdr1, pTestWaveIn1);
-
-
-        ///////////////////////////////
-        // Add 1st buffer
-        // 2-3-4-(1).
-        ///////////////////////////////
-        if ( addInBuffer(&TestWaveInHdr1, true) )
-        {
-            bError = true;
-            break;
-        }
-
-
-        // Wait until 2nd buffer finished recording.
-        // 2-3-4-1.
-        waitAndShowBufferVolume (&TestWaveInHdr2, pTestWaveIn2);
 
+            bWasStarted = true;
 
-        ///////////////////
-        // Add 2nd buffer.
-        // 3-4-1-(2).
-        ///////////////////
-
-        if ( addInBuffer(&TestWaveInHdr2, true) )
-        {
-            bError = true;
-            break;
+            pTestNoiseSuppressor->reset();
         }
 
 
-        // Wait until 3rd buffer finished recording.
-        // 3-4-1-2.
-        waitAndShowBufferVolume (&TestWaveInHdr3, pTestWaveIn3);
+        AudioFrame packet;
 
-
-        ///////////////////
-        // Add 3rd buffer.
-        // 4-1-2-(3).
-        ///////////////////
-
-        if ( addInBuffer(&TestWaveInHdr3, true) )
+        if ( recordPacket(pTestCapture, pTestNoiseSuppressor, pTestAutomaticGainControl, packet, "testRecord") )
         {
             bError = true;
             break;
         }
 
-        bWaitForFourthBuffer = true;
+        // Show volume (here: the voice activation depends on the previous packets).
+        sendAudioDataVolume( std::move(packet) );
     }
 
+    pTestCapture->stop();
+
     if (bError)
     {
         pMainWindow->showMessageBox(true, "The voice volume meter in the settings window will not work.");
@@ -979,1205 +1061,567 @@ void AudioService::testRecord()
     promiseFinishTestRecord.set_value(false);
 }
 
-bool AudioService::addInBuffer(LPWAVEHDR buffer, bool bTestDevice)
+bool AudioService::recordPacket(AudioCaptureStream* pStream, NoiseSuppressor* pNoiseSuppressor, AutomaticGainControl* pAutomaticGainControl,
+                                AudioFrame& packet, const std::string& sFunctionName)
 {
-    MMRESULT result;
-
+    packet = pFramePool->acquire();
 
-    if (bTestDevice)
-    {
-        result = waveInPrepareHeader(hTestWaveIn, buffer, sizeof(WAVEHDR));
-    }
-    else
-    {
-        result = waveInPrepareHeader(hWaveIn, buffer, sizeof(WAVEHDR));
-    }
+    short* pPacket = packet.getSamples();
 
-    if (result)
+    if ( pStream->read(pPacket) )
     {
-        char fault[256];
-        memset(fault, 0, 256);
-
-        waveInGetErrorTextA(result, fault, 256);
-        pMainWindow->printOutput(std::string("AudioService::addInBuffer::waveInPrepareHeader() error: " + std::string(fault) + "."),
+        pMainWindow->printOutput(std::string("AudioService::" + sFunctionName + "::read() error: " + pStream->getLastError()),
                                  SilentMessage(false), true);
 
+        packet.release();
+
         return true;
     }
 
+    packet.getTimestamps().mark(VLP_CAPTURED);
 
-    // Insert a wave input buffer to waveform-audio input device
-    if (bTestDevice)
-    {
-        result = waveInAddBuffer (hTestWaveIn, buffer, sizeof(WAVEHDR));
-    }
-    else
-    {
-        result = waveInAddBuffer (hWaveIn, buffer, sizeof(WAVEHDR));
-    }
 
-    if (result)
-    {
-        char fault[256];
-        memset(fault, 0, 256);
+    // Before the voice activation looks at the packet (the noise would keep it open).
 
-        waveInGetErrorTextA(result, fault, 256);
-        pMainWindow->printOutput(std::string("AudioService::addInBuffer::waveInAddBuffer() error: " + std::string(fault) + "."),
-                                 SilentMessage(false), true);
+    pNoiseSuppressor->setEnabled( pSettingsManager->getCurrentSettings()->bNoiseSuppression );
 
-        if (bTestDevice)
-        {
-            waveInUnprepareHeader(hTestWaveIn, buffer, sizeof(WAVEHDR));
-        }
-        else
-        {
-            waveInUnprepareHeader(hWaveIn, buffer, sizeof(WAVEHDR));
-        }
+    if ( pNoiseSuppressor->process(pPacket, static_cast<size_t>(sampleCount)) )
+    {
+        char vBudgetText[256];
+        std::snprintf(vBudgetText, sizeof(vBudgetText),
+                      "Noise suppression is too slow on this computer (%.0f us per packet, the budget is %.0f us), "
+                      "it's bypassed until turned on again.\n",
+                      pNoiseSuppressor->getStats().dMaxTimeUs, pNoiseSuppressor->getCPUBudgetUs());
 
-        return true;
+        pMainWindow->printOutput(vBudgetText, SilentMessage(false), true);
     }
 
 
+    // After the noise suppression (so that the noise is not counted as the voice level),
+    // the input volume multiplier is applied later (in sendAudioData...()) on top of it.
+
+    pAutomaticGainControl->setEnabled   ( pSettingsManager->getCurrentSettings()->bAutomaticGainControl );
+    pAutomaticGainControl->setTargetDBFS( pSettingsManager->getCurrentSettings()->iAGCTargetDBFS );
+
+    pAutomaticGainControl->process(pPacket, static_cast<size_t>(sampleCount));
+
     return false;
 }
 
-bool AudioService::addOutBuffer(HWAVEOUT hWaveOut, LPWAVEHDR buffer)
+bool AudioService::isPushToTalkButtonPressed()
 {
-    MMRESULT result;
+    return pInputSource->isKeyDown(iPushToTalkButton);
+}
 
-    result = waveOutPrepareHeader (hWaveOut, buffer, sizeof(WAVEHDR));
+void AudioService::sendAudioData(AudioFrame audio)
+{
+    short* pAudio = audio.getSamples();
 
-    if (result)
+    if (iAudioInputVolume != 100)
     {
-        char fault [256];
-        memset (fault, 0, 256);
-
-        waveInGetErrorTextA (result, fault, 256);
-        pMainWindow->printOutput(std::string("AudioService::addOutBuffer::waveOutPrepareHeader() error (" + std::to_string(result) + "): " + std::string(fault) + "."),
-                                  SilentMessage(false),
-                                  true);
-
-        return true;
+        AudioGain::apply( pAudio, static_cast<size_t>(sampleCount), iAudioInputVolume / 100.0f );
     }
 
+    // Sent by the send thread in the order they were pushed.
 
-    return false;
+    pVoiceSender->push( std::move(audio) );
 }
 
-void AudioService::waitAndSendBuffer(WAVEHDR *WaveInHdr, short *pWaveIn, bool bOnTalk)
+void AudioService::sendVoicePacket(AudioFrame& audio)
 {
-    // Wait until buffer finished recording.
+    pNetworkService->sendVoiceMessage( reinterpret_cast<char*>(audio.getSamples()), sampleCount * 2, false );
+
+    audio.getTimestamps().mark(VLP_SENT);
+
+    mtxOutgoingLatency.lock();
+    outgoingLatency.addPacket( audio.getTimestamps() );
+    mtxOutgoingLatency.unlock();
+}
 
-    while (waveInUnprepareHeader(hWaveIn, WaveInHdr, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
+bool AudioService::isVoiceOnTalk(short* pAudio)
+{
+    if (iAudioInputVolume != 100)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+        AudioGain::apply( pAudio, static_cast<size_t>(sampleCount), iAudioInputVolume / 100.0f );
     }
 
+    // Others hear us at the master volume.
 
-    // Make a copy
-    short* pAudioCopy = new short [ static_cast <unsigned long long> (sampleCount) ];
-    std::memcpy ( pAudioCopy, pWaveIn, static_cast <unsigned long long> (sampleCount * 2) );
+    const AudioLevel level = LevelMeter::measure( pAudio, static_cast<size_t>(sampleCount) );
 
+    int iPeakAtMasterVolume = static_cast <int> (level.iPeak * fMasterVolumeMult);
 
-    // Compress and send in other thread
-    if (bOnTalk)
-    {
-        std::thread compressThread (&AudioService::sendAudioDataOnTalk, this, pAudioCopy);
-        compressThread.detach();
-    }
-    else
+    if (iPeakAtMasterVolume > SHRT_MAX)
     {
-        std::thread compressThread (&AudioService::sendAudioData, this, pAudioCopy);
-        compressThread.detach();
+        iPeakAtMasterVolume = SHRT_MAX;
     }
+
+
+    // The hangover may be changed in the settings.
+
+    pVoiceActivityDetector->setHangoverMs( pSettingsManager->getCurrentSettings()->iVoiceHangoverMs );
+
+    return pVoiceActivityDetector->process( pAudio, static_cast<size_t>(sampleCount),
+                                            iPeakAtMasterVolume >= iVoiceStartPeakThreshold );
 }
 
-void AudioService::waitAndShowBufferVolume(WAVEHDR *WaveInHdr, short *pWaveIn)
+void AudioService::sendAudioDataVolume(AudioFrame audio)
 {
-    // Wait until buffer finished recording.
+    short* pAudio = audio.getSamples();
+
+    bool bInDBFS = true; //do not change this thing please
+
+    // Set volume.
+    float fInputMult = fMasterVolumeMult;
 
-    while (waveInUnprepareHeader(hWaveIn, WaveInHdr, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
+    if (bInDBFS == false)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+        fInputMult += 3.0f;
     }
 
+    // Master volume, then input volume.
 
-    // Make a copy
-    short* pAudioCopy = new short [ static_cast <unsigned long long> (sampleCount) ];
-    std::memcpy ( pAudioCopy, pWaveIn, static_cast <unsigned long long> (sampleCount * 2) );
+    AudioGain::apply( pAudio, static_cast<size_t>(sampleCount), fInputMult,
+                      (iAudioInputVolume != 100) ? iAudioInputVolume / 100.0f : 1.0f );
 
+    // Find max volume.
 
-    // Compress and send in other thread
-    std::thread compressThread (&AudioService::sendAudioDataVolume, this, pAudioCopy);
-    compressThread.detach();
-}
+    const AudioLevel level = LevelMeter::measure( pAudio, static_cast<size_t>(sampleCount) );
 
-void AudioService::waitForAllInBuffers()
-{
-    while (waveInUnprepareHeader(hWaveIn, &WaveInHdr1, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
-    }
-    while (waveInUnprepareHeader(hWaveIn, &WaveInHdr2, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
+    const short  maxVolume = static_cast<short>( (level.iPeak > SHRT_MAX) ? SHRT_MAX : level.iPeak );
+    const double maxDBFS   = level.getPeakDBFS();
+
+    if (bInDBFS)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+        pMainWindow->showVoiceVolumeValueInSettings(static_cast<int>(maxDBFS));
     }
-    while (waveInUnprepareHeader(hWaveIn, &WaveInHdr3, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
+    else
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+        pMainWindow->showVoiceVolumeValueInSettings(static_cast<int>(static_cast<float>(maxVolume) / SHRT_MAX * 100));
     }
-    while (waveInUnprepareHeader(hWaveIn, &WaveInHdr4, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
+
+
+    if (pSettingsManager->getCurrentSettings()->bHearVoiceInSettings && bOutputTestVoice)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+        pTestVoiceActivityDetector->setHangoverMs( pSettingsManager->getCurrentSettings()->iVoiceHangoverMs );
+
+        const bool bVoice = pTestVoiceActivityDetector->process( pAudio, static_cast<size_t>(sampleCount),
+                                                                 level.iPeak >= iVoiceStartPeakThreshold );
+
+        if (bVoice)
+        {
+            mtxAudioPacketsForTest.lock();
+
+            vAudioPacketsForTest.push_back( std::move(audio) );
+
+            mtxAudioPacketsForTest.unlock();
+        }
     }
 }
 
-void AudioService::waitForAllTestInBuffers()
+void AudioService::testOutputAudio()
 {
-    while (waveInUnprepareHeader(hTestWaveIn, &TestWaveInHdr1, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
-    }
-    while (waveInUnprepareHeader(hTestWaveIn, &TestWaveInHdr2, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
-    }
-    while (waveInUnprepareHeader(hTestWaveIn, &TestWaveInHdr3, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
+    // Start output device
+    std::string sErrorText;
+
+    pTestPlayback = pAudioBackend->openResampledPlayback(format, sErrorText);
+
+    if (pTestPlayback == nullptr)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+        pMainWindow->printOutput(std::string("AudioService::testOutputAudio::openResampledPlayback() " + pAudioBackend->getName() + " error: " + sErrorText),
+                                  SilentMessage(false),
+                                  true);
     }
-    while (waveInUnprepareHeader(hTestWaveIn, &TestWaveInHdr4, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
+    else
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+        pTestPlayback->setVolume( pSettingsManager->getCurrentSettings()->iMasterVolume );
     }
-}
 
-void AudioService::waitForAllTestOutBuffers()
-{
-    // Wait until finished playing 1
-    while ( waveOutUnprepareHeader(hTestWaveOut, &TestWaveOutHdr1, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING )
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
-    }
 
-    // Wait until finished playing 2
-    while ( waveOutUnprepareHeader(hTestWaveOut, &TestWaveOutHdr2, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING )
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
-    }
-}
-
-void AudioService::waitForPlayToEnd(User *pUser, WAVEHDR* pWaveOutHdr, size_t& iLastPlayingPacketIndex)
-{
-    // Wait until finished playing buffer
-    while (waveOutUnprepareHeader(pUser->hWaveOut, pWaveOutHdr, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
-    }
-
-    delete[] pUser->vAudioPackets[iLastPlayingPacketIndex];
-    pUser->vAudioPackets[iLastPlayingPacketIndex] = nullptr;
-
-    iLastPlayingPacketIndex++;
-}
-
-void AudioService::waitForPlayOnTestToEnd(WAVEHDR *pWaveOutHdr)
-{
-    // Wait until finished playing buffer
-    while (waveOutUnprepareHeader(hTestWaveOut, pWaveOutHdr, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
-    }
-}
-
-
-void AudioService::sendAudioData(short *pAudio)
-{
-    if (iAudioInputVolume != 100)
-    {
-        float fInputMult = iAudioInputVolume / 100.0f;
-
-        for (int t = 0;  t < sampleCount;  t++)
-        {
-            int iNewValue = static_cast <int> (pAudio[t] * fInputMult);
-
-            if      (iNewValue > SHRT_MAX)
-            {
-                pAudio[t] = SHRT_MAX;
-            }
-            else if (iNewValue < SHRT_MIN)
-            {
-                pAudio[t] = SHRT_MIN;
-            }
-            else
-            {
-                pAudio[t] = static_cast <short> (iNewValue);
-            }
-        }
-    }
-
-
-    char* pAudioSamples = new char     [ static_cast <size_t> (sampleCount * 2) ];
-    std::memcpy ( pAudioSamples, pAudio, static_cast <size_t> (sampleCount * 2) );
-
-
-    delete[] pAudio;
-
-
-    pNetworkService->sendVoiceMessage( pAudioSamples, sampleCount * 2, false );
-}
-
-void AudioService::sendAudioDataOnTalk(short *pAudio)
-{
-    if (iAudioInputVolume != 100)
-    {
-        float fInputMult = iAudioInputVolume / 100.0f;
-
-        for (int t = 0;  t < sampleCount;  t++)
-        {
-            int iNewValue = static_cast <int> (pAudio[t] * fInputMult);
-
-            if      (iNewValue > SHRT_MAX)
-            {
-                pAudio[t] = SHRT_MAX;
-            }
-            else if (iNewValue < SHRT_MIN)
-            {
-                pAudio[t] = SHRT_MIN;
-            }
-            else
-            {
-                pAudio[t] = static_cast <short> (iNewValue);
-            }
-        }
-    }
-
-    double maxDBFS = -1000.0;
-
-    for (int t = 0;  t < sampleCount;  t++)
-    {
-        int iNewValue = static_cast <int> (pAudio[t] * fMasterVolumeMult);
-
-        if      (iNewValue > SHRT_MAX)
-        {
-            pAudio[t] = SHRT_MAX;
-        }
-        else if (iNewValue < SHRT_MIN)
-        {
-            pAudio[t] = SHRT_MIN;
-        }
-        else
-        {
-            double sampleInRange = static_cast<double>(iNewValue) / SHRT_MAX;
-
-            double sampleInDBFS = 20 * log10(abs(sampleInRange));
-
-            if (sampleInDBFS > maxDBFS)
-            {
-                maxDBFS = sampleInDBFS;
-            }
-        }
-    }
-
-
-    if (iPacketsNeedToRecordLeft == 0)
-    {
-        iPacketsNeedToRecordLeft = 4;
-    }
-
-    if ( iPacketsNeedToRecordLeft != 4 )
-    {
-        bRecordTalk = true;
-        bRecordedSome = true;
-        iPacketsNeedToRecordLeft--;
-    }
-    else if ( (static_cast<int>(maxDBFS) >= iLowerVoiceStartRecValueInDBFS) && bMuteMic == false )
-    {
-        bRecordTalk = true;
-        bRecordedSome = true;
-        iPacketsNeedToRecordLeft--;
-    }
-    else
-    {
-        bRecordTalk = false;
-
-        if (bRecordedSome)
-        {
-            bRecordedSome = false;
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
-            pNetworkService->sendVoiceMessage(nullptr, 1, true);
-        }
-    }
-
-
-    if (bRecordTalk)
-    {
-        char* pAudioSamples = new char     [ static_cast <size_t> (sampleCount * 2) ];
-        std::memcpy ( pAudioSamples, pAudio, static_cast <size_t> (sampleCount * 2) );
-
-
-        delete[] pAudio;
-
-
-        pNetworkService->sendVoiceMessage( pAudioSamples, sampleCount * 2, false );
-    }
-    else
-    {
-        delete[] pAudio;
-    }
-}
-
-void AudioService::sendAudioDataVolume(short *pAudio)
-{
-    bool bInDBFS = true; //do not change this thing please
-
-    // Set volume.
-    float fInputMult = fMasterVolumeMult;
-
-    if (bInDBFS == false)
-    {
-        fInputMult += 3.0f;
-    }
-
-    for (int t = 0;  t < sampleCount;  t++)
-    {
-        int iNewValue = static_cast <int> (pAudio[t] * fInputMult);
-
-        if      (iNewValue > SHRT_MAX)
-        {
-            pAudio[t] = SHRT_MAX;
-        }
-        else if (iNewValue < SHRT_MIN)
-        {
-            pAudio[t] = SHRT_MIN;
-        }
-        else
-        {
-            pAudio[t] = static_cast <short> (iNewValue);
-        }
-    }
-
-    if (iAudioInputVolume != 100)
-    {
-        float fInputMult = iAudioInputVolume / 100.0f;
-
-        for (int t = 0;  t < sampleCount;  t++)
-        {
-            int iNewValue = static_cast <int> (pAudio[t] * fInputMult);
-
-            if      (iNewValue > SHRT_MAX)
-            {
-                pAudio[t] = SHRT_MAX;
-            }
-            else if (iNewValue < SHRT_MIN)
-            {
-                pAudio[t] = SHRT_MIN;
-            }
-            else
-            {
-                pAudio[t] = static_cast <short> (iNewValue);
-            }
-        }
-    }
-
-    // Find max volume.
-
-    short maxVolume = 0;
-    double maxDBFS = -1000.0;
-
-    for (int i = 0; i < sampleCount; i++)
-    {
-        if (bInDBFS)
-        {
-            double sampleInRange = static_cast<double>(pAudio[i]) / SHRT_MAX;
-
-            double sampleInDBFS = 20 * log10(abs(sampleInRange));
-
-            if (sampleInDBFS > maxDBFS)
-            {
-                maxDBFS = sampleInDBFS;
-            }
-        }
-        else
-        {
-            if (abs(pAudio[i]) > abs(maxVolume))
-            {
-                maxVolume = static_cast<short>(abs(pAudio[i]));
-            }
-        }
-    }
-
-    if (bInDBFS)
-    {
-        pMainWindow->showVoiceVolumeValueInSettings(static_cast<int>(maxDBFS));
-    }
-    else
-    {
-        pMainWindow->showVoiceVolumeValueInSettings(static_cast<int>(static_cast<float>(maxVolume) / SHRT_MAX * 100));
-    }
-
-
-    if (pSettingsManager->getCurrentSettings()->bHearVoiceInSettings && bOutputTestVoice)
-    {
-        if (iTestPacketsNeedToRecordLeft == 0)
-        {
-            iTestPacketsNeedToRecordLeft = 4;
-        }
-
-        if ( (static_cast<int>(maxDBFS) >= iLowerVoiceStartRecValueInDBFS)
-             ||
-             (iTestPacketsNeedToRecordLeft != 4) )
-        {
-            mtxAudioPacketsForTest.lock();
-
-            vAudioPacketsForTest.push_back(pAudio);
-
-            iTestPacketsNeedToRecordLeft--;
-
-            mtxAudioPacketsForTest.unlock();
-        }
-        else
-        {
-            delete[] pAudio;
-        }
-    }
-    else
-    {
-        delete[] pAudio;
-    }
-}
-
-void AudioService::testOutputAudio()
-{
-    // Audio buffer1
-    TestWaveOutHdr1.dwBufferLength  = static_cast <unsigned long> (sampleCount * 2);
-    TestWaveOutHdr1.dwBytesRecorded = 0;
-    TestWaveOutHdr1.dwUser          = 0L;
-    TestWaveOutHdr1.dwFlags         = 0L;
-    TestWaveOutHdr1.dwLoops         = 0L;
-
-    // Audio buffer2
-    TestWaveOutHdr2 = TestWaveOutHdr1;
-
-    // Start output device
-    MMRESULT result = waveOutOpen( &hTestWaveOut,  WAVE_MAPPER,  &Format,  0L,  0L,  WAVE_FORMAT_DIRECT );
-
-    if (result)
-    {
-        char fault [256];
-        memset (fault, 0, 256);
-
-        waveInGetErrorTextA (result, fault, 256);
-        pMainWindow->printOutput(std::string("AudioService::testOutputAudio::waveOutOpen() error: " + std::string(fault) + "."),
-                                  SilentMessage(false),
-                                  true);
-    }
-
-    waveOutSetVolume( hTestWaveOut, MAKELONG(pSettingsManager->getCurrentSettings()->iMasterVolume,
-                                             pSettingsManager->getCurrentSettings()->iMasterVolume) );
-
-
-
-    bool bWasStarted = false;
-    size_t iCurrentAudioPacketIndex = 0;
-
-    while (bTestInputReady)
-    {
-        while (bPauseTestInput || bOutputTestVoice == false)
-        {
-            if (bWasStarted)
-            {
-                waitForAllTestOutBuffers();
-
-                waveOutReset(hTestWaveOut);
-
-                mtxAudioPacketsForTest.lock();
-
-                for (size_t i = 0; i < vAudioPacketsForTest.size(); i++)
-                {
-                    delete[] vAudioPacketsForTest[i];
-                }
-
-                vAudioPacketsForTest.clear();
-
-                iCurrentAudioPacketIndex = 0;
-
-                mtxAudioPacketsForTest.unlock();
-
-                bWasStarted = false;
-
-                waveOutSetVolume( hTestWaveOut, MAKELONG(pSettingsManager->getCurrentSettings()->iMasterVolume,
-                                                         pSettingsManager->getCurrentSettings()->iMasterVolume) );
-            }
-
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-
-            if (bTestInputReady == false) break;
-        }
-
-        if (bTestInputReady == false) break;
-
-
-        while (iCurrentAudioPacketIndex + 3 >= vAudioPacketsForTest.size())
-        {
-            if (vAudioPacketsForTest.size() >= 4)
-            {
-                waitForAllTestOutBuffers();
-
-                waveOutReset(hTestWaveOut);
-
-                mtxAudioPacketsForTest.lock();
-
-                for (size_t i = 0; i < vAudioPacketsForTest.size(); i++)
-                {
-                    delete[] vAudioPacketsForTest[i];
-                }
-
-                vAudioPacketsForTest.clear();
-
-                iCurrentAudioPacketIndex = 0;
-
-                mtxAudioPacketsForTest.unlock();
-
-                waveOutSetVolume( hTestWaveOut, MAKELONG(pSettingsManager->getCurrentSettings()->iMasterVolume,
-                                                         pSettingsManager->getCurrentSettings()->iMasterVolume) );
-            }
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
-
-        bWasStarted = true;
-
-
-        // Add buffer1
-        TestWaveOutHdr1.lpData = reinterpret_cast<LPSTR>( vAudioPacketsForTest[iCurrentAudioPacketIndex] );
-        if ( addOutBuffer(hTestWaveOut, &TestWaveOutHdr1) ) {break;}
-        iCurrentAudioPacketIndex++;
-
-
-
-        // Add buffer2
-        TestWaveOutHdr2.lpData = reinterpret_cast<LPSTR>( vAudioPacketsForTest[iCurrentAudioPacketIndex] );
-        if ( addOutBuffer(hTestWaveOut, &TestWaveOutHdr2) ) {break;}
-        iCurrentAudioPacketIndex++;
-
-
-        // Play buffer1
-        result = waveOutWrite(hTestWaveOut, &TestWaveOutHdr1, sizeof(WAVEHDR));
-        if (result)
-        {
-            char fault[256];
-            memset(fault, 0, 256);
-
-            waveInGetErrorTextA(result, fault, 256);
-            pMainWindow->printOutput(std::string("AudioService::testOutputAudio::waveOutWrite() error (" + std::to_string(result) + "): " + std::string(fault) + "."),
-                                     SilentMessage(false),
-                                     true);
-
-            waveOutUnprepareHeader(hTestWaveOut, &TestWaveOutHdr1, sizeof(WAVEHDR));
-
-            break;
-        }
-
-
-        // Play buffer2
-        result = waveOutWrite(hTestWaveOut, &TestWaveOutHdr2, sizeof(WAVEHDR));
-        if (result)
-        {
-            char fault[256];
-            memset(fault, 0, 256);
-
-            waveInGetErrorTextA(result, fault, 256);
-            pMainWindow->printOutput(std::string("AudioService::testOutputAudio::waveOutWrite() error (" + std::to_string(result) + "): " + std::string(fault) + "."),
-                                     SilentMessage(false),
-                                     true);
-
-            waveOutUnprepareHeader(hTestWaveOut, &TestWaveOutHdr2, sizeof(WAVEHDR));
-
-            break;
-        }
-
-
-
-        // Wait until finished playing 1st buffer
-        waitForPlayOnTestToEnd(&TestWaveOutHdr1);
-
-
-        bool bWaitForSecondBuffer = true;
-        bool bError = false;
-
-        do
-        {
-            if (bWaitForSecondBuffer)
-            {
-                // Wait until finished playing 2st buffer
-                while ( (waveOutUnprepareHeader(hTestWaveOut, &TestWaveOutHdr2, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
-                        &&
-                        !(iCurrentAudioPacketIndex < vAudioPacketsForTest.size()) )
-                {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS / 2));
-                }
-            }
-            else
-            {
-                // Wait until finished playing 1st buffer
-                while ( (waveOutUnprepareHeader(hTestWaveOut, &TestWaveOutHdr1, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
-                        &&
-                        !(iCurrentAudioPacketIndex < vAudioPacketsForTest.size()) )
-                {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS / 2));
-                }
-            }
-
-
-            if ( iCurrentAudioPacketIndex < vAudioPacketsForTest.size() )
-            {
-                if (bWaitForSecondBuffer)
-                {
-                    // Add 1st buffer
-                    TestWaveOutHdr1.lpData = reinterpret_cast<LPSTR>( vAudioPacketsForTest[iCurrentAudioPacketIndex] );
-                    if ( addOutBuffer(hTestWaveOut, &TestWaveOutHdr1) ) {bError = true; break;}
-                    iCurrentAudioPacketIndex++;
-
-
-                    // Play 1.
-                    result = waveOutWrite(hTestWaveOut, &TestWaveOutHdr1, sizeof(WAVEHDR));
-                    if (result)
-                    {
-                        char fault[256];
-                        memset(fault, 0, 256);
-
-                        waveInGetErrorTextA(result, fault, 256);
-                        pMainWindow->printOutput(std::string("AudioService::testOutputAudio::waveOutWrite() error (" + std::to_string(result) + "): " + std::string(fault) + "."),
-                                                 SilentMessage(false),
-                                                 true);
-
-                        waveOutUnprepareHeader(hTestWaveOut, &TestWaveOutHdr1, sizeof(WAVEHDR));
-
-                        bError = true;
-
-                        break;
-                    }
-
-
-                    // Wait until finished playing 2st buffer
-                    waitForPlayOnTestToEnd(&TestWaveOutHdr2);
-                }
-                else
-                {
-                    // Add 2st buffer
-                    TestWaveOutHdr2.lpData = reinterpret_cast<LPSTR>( vAudioPacketsForTest[iCurrentAudioPacketIndex] );
-                    if ( addOutBuffer(hTestWaveOut, &TestWaveOutHdr2) ) {bError = true; break;}
-                    iCurrentAudioPacketIndex++;
-
-
-                    // Play 2.
-                    result = waveOutWrite(hTestWaveOut, &TestWaveOutHdr2, sizeof(WAVEHDR));
-                    if (result)
-                    {
-                        char fault[256];
-                        memset(fault, 0, 256);
-
-                        waveInGetErrorTextA(result, fault, 256);
-                        pMainWindow->printOutput(std::string("AudioService::testOutputAudio::waveOutWrite() error (" + std::to_string(result) + "): " + std::string(fault) + "."),
-                                                 SilentMessage(false),
-                                                 true);
-
-                        waveOutUnprepareHeader(hTestWaveOut, &TestWaveOutHdr2, sizeof(WAVEHDR));
-
-                        bError = true;
-
-                        break;
-                    }
-
-
-                    // Wait until finished playing 1st buffer
-                    waitForPlayOnTestToEnd(&TestWaveOutHdr1);
-                }
-
-                bWaitForSecondBuffer = !bWaitForSecondBuffer;
-            }
-
-        }while ( iCurrentAudioPacketIndex < vAudioPacketsForTest.size() );
-
-        if (bError)
-        {
-            break;
-        }
-    }
-
-    waitForAllTestOutBuffers();
-
-    mtxAudioPacketsForTest.lock();
-
-    for (size_t i = 0; i < vAudioPacketsForTest.size(); i++)
-    {
-        delete[] vAudioPacketsForTest[i];
-    }
-
-    vAudioPacketsForTest.clear();
-
-    mtxAudioPacketsForTest.unlock();
-
-
-    promiseFinishTestOutputAudio.set_value(false);
-}
-
-void AudioService::playAudioData(short int *pAudio, std::string sUserName, bool bLast)
-{
-    if (bInputReady == false)
-    {
-        delete[] pAudio;
-        return;
-    }
-
-    pNetworkService->getOtherUsersMutex()->lock();
 
-    User* pUser = nullptr;
+    bool bWasStarted = false;
+    size_t iCurrentAudioPacketIndex = 0;
 
-    for (size_t i = 0;   i < pNetworkService->getOtherUsersVectorSize();   i++)
+    while (bTestInputReady)
     {
-        if (pNetworkService->getOtherUser(i)->sUserName == sUserName)
+        while (bPauseTestInput || bOutputTestVoice == false || pTestPlayback == nullptr)
         {
-            pUser = pNetworkService->getOtherUser(i);
-        }
-    }
-
-    pNetworkService->getOtherUsersMutex()->unlock();
-
-    if (pUser == nullptr)
-    {
-        delete[] pAudio;
-
-        return;
-    }
+            if (bWasStarted)
+            {
+                pTestPlayback->reset();
 
+                clearTestAudioPackets();
 
+                iCurrentAudioPacketIndex = 0;
 
-    if (bLast)
-    {
-        if (pUser->bDeletePacketsAtLast)
-        {
-            // Something went wrong, delete all packets
+                bWasStarted = false;
 
-            for (size_t j = 0;  j < pUser->vAudioPackets.size();  j++)
+                pTestPlayback->setVolume( pSettingsManager->getCurrentSettings()->iMasterVolume );
+            }
+            else if (pTestPlayback == nullptr)
             {
-                if (pUser->vAudioPackets[j])
-                {
-                    delete[] pUser->vAudioPackets[j];
-                }
+                clearTestAudioPackets();
             }
 
-            pUser->vAudioPackets.clear();
-
-            pUser->bDeletePacketsAtLast = false;
-            pUser->bPacketsArePlaying   = false;
+            std::this_thread::sleep_for(std::chrono::seconds(1));
 
-            // Wait until finished playing
-            waitForAllBuffers (pUser, false, nullptr);
+            if (bTestInputReady == false) break;
         }
 
-        pUser->bLastPacketCame = true;
-    }
-    else
-    {
-        // Set volume multiplier
-        float fVolumeMult  = fMasterVolumeMult;
+        if (bTestInputReady == false) break;
 
-        if (pUser->fUserDefinedVolume != 1.0f)
-        {
-            fVolumeMult += ( pUser->fUserDefinedVolume - 1.0f );
-        }
 
+        // Wait for 4 new packets.
 
-        // Set volume
-        for (int t = 0;  t < sampleCount;  t++)
+        while (iCurrentAudioPacketIndex + 3 >= vAudioPacketsForTest.size())
         {
-            int iNewValue = static_cast <int> (pAudio[t] * fVolumeMult);
-
-            if      (iNewValue > SHRT_MAX)
-            {
-                pAudio[t] = SHRT_MAX;
-            }
-            else if (iNewValue < SHRT_MIN)
-            {
-                pAudio[t] = SHRT_MIN;
-            }
-            else
+            if (vAudioPacketsForTest.size() >= 4)
             {
-                pAudio[t] = static_cast <short> (iNewValue);
-            }
-        }
-
+                // Old (already played) packets.
 
+                pTestPlayback->drain();
 
+                clearTestAudioPackets();
 
-        pUser->vAudioPackets.push_back(pAudio);
-
+                iCurrentAudioPacketIndex = 0;
 
+                pTestPlayback->setVolume( pSettingsManager->getCurrentSettings()->iMasterVolume );
+            }
 
-        if ( (pUser->vAudioPackets.size() > 1)
-             &&
-             (pUser->bPacketsArePlaying == false) )
-        {
-            pUser->bPacketsArePlaying = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
-            std::thread playThread (&AudioService::play, this, pUser);
-            playThread.detach();
-        }
-        else if (pUser->vAudioPackets.size() == 1)
-        {
-            pUser->bLastPacketCame = false;
+            if (bTestInputReady == false) break;
         }
-    }
-}
-
-void AudioService::play(User* pUser)
-{
-    pUser->mtxUser.lock();
-
-
-    MMRESULT result;
 
-    size_t i = 0;
-    size_t iLastPlayingPacketIndex = 0;
+        if (bTestInputReady == false) break;
 
+        bWasStarted = true;
 
-    // Wait a little so when we finished playing the first buffer
-    // we will almost 100% have a new audio packet came.
-    std::this_thread::sleep_for(std::chrono::milliseconds(30));
 
+        // Play until there is nothing to play.
 
-    pUser      ->bTalking = true;
-    pMainWindow->setPingAndTalkingToUser(pUser->pListWidgetItem, pUser->iPing, pUser->bTalking);
+        bool bError = false;
 
+        do
+        {
+            mtxAudioPacketsForTest.lock();
 
+            const short* pPacket = nullptr;
 
-    // Add buffer1
-    pUser->WaveOutHdr1.lpData = reinterpret_cast<LPSTR>( pUser->vAudioPackets[i] );
-    if ( addOutBuffer(pUser->hWaveOut, &pUser->WaveOutHdr1) ) {pUser->bDeletePacketsAtLast = true;}
-    i++;
+            if ( iCurrentAudioPacketIndex < vAudioPacketsForTest.size() )
+            {
+                // Stays valid when the vector grows (the frame is moved, not the samples).
+                pPacket = vAudioPacketsForTest[iCurrentAudioPacketIndex].getSamples();
+            }
 
+            mtxAudioPacketsForTest.unlock();
 
 
-    // Add buffer2
-    pUser->WaveOutHdr2.lpData = reinterpret_cast<LPSTR>( pUser->vAudioPackets[i] );
-    if ( addOutBuffer(pUser->hWaveOut, &pUser->WaveOutHdr2) ) {pUser->bDeletePacketsAtLast = true;}
-    i++;
+            if (pPacket)
+            {
+                if ( pTestPlayback->write(pPacket) )
+                {
+                    pMainWindow->printOutput(std::string("AudioService::testOutputAudio::write() error: " + pTestPlayback->getLastError()),
+                                             SilentMessage(false),
+                                             true);
 
+                    bError = true;
 
-    // Play buffer1
-    result = waveOutWrite(pUser->hWaveOut, &pUser->WaveOutHdr1, sizeof(WAVEHDR));
-    if (result)
-    {
-        char fault[256];
-        memset(fault, 0, 256);
+                    break;
+                }
 
-        waveInGetErrorTextA(result, fault, 256);
-        pMainWindow->printOutput(std::string("AudioService::play::waveOutWrite() error (" + std::to_string(result) + "): " + std::string(fault) + "."),
-                                 SilentMessage(false),
-                                 true);
+                iCurrentAudioPacketIndex++;
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS / 2));
+            }
 
-        waveOutUnprepareHeader(pUser->hWaveOut, &pUser->WaveOutHdr1, sizeof(WAVEHDR));
+        }while ( (iCurrentAudioPacketIndex < vAudioPacketsForTest.size()) || (pTestPlayback->getQueuedPacketCount() > 0) );
 
-        pUser->bDeletePacketsAtLast = true;
+        if (bError)
+        {
+            break;
+        }
     }
 
-
-    // Play buffer2
-    result = waveOutWrite(pUser->hWaveOut, &pUser->WaveOutHdr2, sizeof(WAVEHDR));
-    if (result)
+    if (pTestPlayback)
     {
-        char fault[256];
-        memset(fault, 0, 256);
+        pTestPlayback->reset();
+    }
 
-        waveInGetErrorTextA(result, fault, 256);
-        pMainWindow->printOutput(std::string("AudioService::play::waveOutWrite() error (" + std::to_string(result) + "): " + std::string(fault) + "."),
-                                 SilentMessage(false),
-                                 true);
+    clearTestAudioPackets();
 
-        waveOutUnprepareHeader(pUser->hWaveOut, &pUser->WaveOutHdr2, sizeof(WAVEHDR));
 
-        pUser->bDeletePacketsAtLast = true;
-    }
+    promiseFinishTestOutputAudio.set_value(false);
+}
 
+void AudioService::clearTestAudioPackets()
+{
+    mtxAudioPacketsForTest.lock();
 
+    // Back to the pool.
+    vAudioPacketsForTest.clear();
 
-    // Wait until finished playing 1st buffer
-    waitForPlayToEnd(pUser, &pUser->WaveOutHdr1, iLastPlayingPacketIndex);
+    mtxAudioPacketsForTest.unlock();
+}
 
+void AudioService::playAudioData(const short int *pAudio, const std::string& sUserName, bool bLast, const VoiceTimestamps& timestamps)
+{
+    // Called from the UDP thread (the only producer for the speakers' FrameRings).
 
-    bool bWaitForSecondBuffer = true;
+    if ( (bInputReady == false) || (pMixer == nullptr) )
+    {
+        return;
+    }
 
+    pNetworkService->getOtherUsersMutex()->lock();
 
-    do
+    for (size_t i = 0;   i < pNetworkService->getOtherUsersVectorSize();   i++)
     {
-        if (bWaitForSecondBuffer)
+        User* pUser = pNetworkService->getOtherUser(i);
+
+        if ( (pUser->sUserName == sUserName) && pUser->pMixerSpeaker )
         {
-            // Wait until finished playing 2st buffer
-            while ( (waveOutUnprepareHeader(pUser->hWaveOut, &pUser->WaveOutHdr2, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
-                    &&
-                    !(i < pUser->vAudioPackets.size()) )
+            if (bLast)
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS / 2));
+                pMixer->pushLastPacket(pUser->pMixerSpeaker);
             }
-        }
-        else
-        {
-            // Wait until finished playing 1st buffer
-            while ( (waveOutUnprepareHeader(pUser->hWaveOut, &pUser->WaveOutHdr1, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING)
-                    &&
-                    !(i < pUser->vAudioPackets.size()) )
+            else
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS / 2));
+                pMixer->pushPacket(pUser->pMixerSpeaker, pAudio, timestamps);
             }
-        }
 
+            break;
+        }
+    }
 
-        if ( i < pUser->vAudioPackets.size() )
-        {
-            if (bWaitForSecondBuffer)
-            {
-                // Add 1st buffer
-                pUser->WaveOutHdr1.lpData = reinterpret_cast<LPSTR>( pUser->vAudioPackets[i] );
-                if ( addOutBuffer(pUser->hWaveOut, &pUser->WaveOutHdr1) ) {pUser->bDeletePacketsAtLast = true;}
-                i++;
+    pNetworkService->getOtherUsersMutex()->unlock();
+}
 
+bool AudioService::skipAudioData(const std::string& sUserName)
+{
+    // Called from the UDP thread.
 
-                // Play 1.
-                result = waveOutWrite(pUser->hWaveOut, &pUser->WaveOutHdr1, sizeof(WAVEHDR));
-                if (result)
-                {
-                    char fault[256];
-                    memset(fault, 0, 256);
+    if ( (bInputReady == false) || (pMixer == nullptr) )
+    {
+        return false;
+    }
 
-                    waveInGetErrorTextA(result, fault, 256);
-                    pMainWindow->printOutput(std::string("AudioService::uncompressAndPlay::waveOutWrite() error (" + std::to_string(result) + "): " + std::string(fault) + "."),
-                                             SilentMessage(false),
-                                             true);
+    bool bSkip = false;
 
-                    waveOutUnprepareHeader(pUser->hWaveOut, &pUser->WaveOutHdr1, sizeof(WAVEHDR));
+    pNetworkService->getOtherUsersMutex()->lock();
 
-                    pUser->bDeletePacketsAtLast = true;
+    for (size_t i = 0;   i < pNetworkService->getOtherUsersVectorSize();   i++)
+    {
+        User* pUser = pNetworkService->getOtherUser(i);
 
-                    break;
-                }
+        if ( (pUser->sUserName == sUserName) && pUser->pMixerSpeaker )
+        {
+            bSkip = pMixer->skipCappedPacket(pUser->pMixerSpeaker);
 
+            break;
+        }
+    }
 
-                // Wait until finished playing 2st buffer
-                waitForPlayToEnd(pUser, &pUser->WaveOutHdr2, iLastPlayingPacketIndex);
-            }
-            else
-            {
-                // Add 2st buffer
-                pUser->WaveOutHdr2.lpData = reinterpret_cast<LPSTR>( pUser->vAudioPackets[i] );
-                if ( addOutBuffer(pUser->hWaveOut, &pUser->WaveOutHdr2) ) {pUser->bDeletePacketsAtLast = true;}
-                i++;
+    pNetworkService->getOtherUsersMutex()->unlock();
 
+    return bSkip;
+}
 
-                // Play 2.
-                result = waveOutWrite(pUser->hWaveOut, &pUser->WaveOutHdr2, sizeof(WAVEHDR));
-                if (result)
-                {
-                    char fault[256];
-                    memset(fault, 0, 256);
+void AudioService::stop()
+{
+    bInputReady = false;
 
-                    waveInGetErrorTextA(result, fault, 256);
-                    pMainWindow->printOutput(std::string("AudioService::uncompressAndPlay::waveOutWrite() error (" + std::to_string(result) + "): " + std::string(fault) + "."),
-                                             SilentMessage(false),
-                                             true);
+    // Wakes up recordOnPush().
+    pInputSource->stop();
 
-                    waveOutUnprepareHeader(pUser->hWaveOut, &pUser->WaveOutHdr2, sizeof(WAVEHDR));
 
-                    pUser->bDeletePacketsAtLast = true;
+    // Wait for recordOnPush()/recordOnTalk() to finish (it may be in the middle of a read from pCapture).
 
-                    break;
-                }
+    if (recordThread.joinable())
+    {
+        recordThread.join();
+    }
 
+    if (pVoiceSender)
+    {
+        // Sends what is still queued.
 
-                // Wait until finished playing 1st buffer
-                waitForPlayToEnd(pUser, &pUser->WaveOutHdr1, iLastPlayingPacketIndex);
-            }
+        VoiceSenderStats senderStats = pVoiceSender->getStats();
 
+        delete pVoiceSender;
+        pVoiceSender = nullptr;
 
-            bWaitForSecondBuffer = !bWaitForSecondBuffer;
-        }
-        else
+        if (senderStats.iDroppedPacketCount > 0)
         {
-            delete[] pUser->vAudioPackets[iLastPlayingPacketIndex];
-            pUser->vAudioPackets[iLastPlayingPacketIndex] = nullptr;
+            char vStatsText[256];
+            std::snprintf(vStatsText, sizeof(vStatsText),
+                          "Voice sender: %llu of %llu packets dropped (the send thread was too slow), %zu max queued.\n",
+                          senderStats.iDroppedPacketCount, senderStats.iPacketCount, senderStats.iMaxQueuedPackets);
 
-            iLastPlayingPacketIndex++;
-
-            break;
+            pMainWindow->printOutput(vStatsText, SilentMessage(false), true);
         }
+    }
 
-    }while ( bInputReady );
-
-
-    if (bInputReady)
+    if (pCapture)
     {
-        // Wait until finished playing
-        waitForAllBuffers (pUser, true, &iLastPlayingPacketIndex);
-
-
-        pUser      ->bTalking = false;
-        pMainWindow->setPingAndTalkingToUser(pUser->pListWidgetItem, pUser->iPing, pUser->bTalking);
+        AudioCaptureStats stats = pCapture->getStats();
 
-
-        if (pUser->bDeletePacketsAtLast == false)
+        if (stats.iPacketCount > 0)
         {
-            // No errors, delete here.
-
-            for (size_t i = 0;  i < pUser->vAudioPackets.size();  i++)
-            {
-                if (pUser->vAudioPackets[i])
-                {
-                    delete[] pUser->vAudioPackets[i];
-                }
-            }
+            char vStatsText[256];
+            std::snprintf(vStatsText, sizeof(vStatsText),
+                          "Voice capture (%s): %llu packets, %.2f wakeups per packet, latency %.2f ms average / %.2f ms max.\n",
+                          pAudioBackend->getName().c_str(), stats.iPacketCount, stats.getWakeupsPerPacket(),
+                          stats.getAverageLatencyMs(), stats.dMaxLatencyMs);
 
-            pUser->vAudioPackets.clear ();
-            pUser->bPacketsArePlaying = false;
+            pMainWindow->printOutput(vStatsText, SilentMessage(false), true);
         }
-        else if (pUser->bLastPacketCame)
-        {
-            // An error occured but last packet already came-> delete here and not in playAudioData().
 
-            for (size_t i = 0;  i < pUser->vAudioPackets.size();  i++)
-            {
-                if (pUser->vAudioPackets[i])
-                {
-                    delete[] pUser->vAudioPackets[i];
-                }
-            }
+        mtxCaptureSwitch.lock();
 
-            pUser->vAudioPackets.clear ();
-            pUser->bPacketsArePlaying   = false;
-            pUser->bDeletePacketsAtLast = false;
-        }
+        delete pCapture;
+        pCapture = nullptr;
+
+        mtxCaptureSwitch.unlock();
     }
-    else
+
+    if (pNoiseSuppressor)
     {
-        for (size_t i = 0;  i < pUser->vAudioPackets.size();  i++)
+        NoiseSuppressorStats stats = pNoiseSuppressor->getStats();
+
+        if (stats.iPacketCount > 0)
         {
-            if (pUser->vAudioPackets[i])
-            {
-                delete[] pUser->vAudioPackets[i];
-            }
+            char vStatsText[256];
+            std::snprintf(vStatsText, sizeof(vStatsText),
+                          "Noise suppression: %llu packets, %.1f us average / %.1f us max per packet (budget %.0f us), %llu over budget.\n",
+                          stats.iPacketCount, stats.getAverageTimeUs(), stats.dMaxTimeUs,
+                          pNoiseSuppressor->getCPUBudgetUs(), stats.iOverBudgetCount);
+
+            pMainWindow->printOutput(vStatsText, SilentMessage(false), true);
         }
 
-        pUser->vAudioPackets.clear ();
-        pUser->bPacketsArePlaying   = false;
-        pUser->bDeletePacketsAtLast = false;
+        delete pNoiseSuppressor;
+        pNoiseSuppressor = nullptr;
     }
 
+    if (pAutomaticGainControl)
+    {
+        delete pAutomaticGainControl;
+        pAutomaticGainControl = nullptr;
+    }
 
+    if (pushToTalkStats.iPressCount > 0)
+    {
+        char vStatsText[256];
+        std::snprintf(vStatsText, sizeof(vStatsText),
+                      "Push-to-talk: %llu presses, %.1f ms average / %.1f ms max from the press to the first packet, %.0f ms of pre-roll sent on average.\n",
+                      pushToTalkStats.iPressCount, pushToTalkStats.getAveragePressToFirstPacketMs(),
+                      pushToTalkStats.dMaxPressToFirstPacketMs, pushToTalkStats.getAveragePreRollMs());
 
-    pUser->mtxUser.unlock();
-}
+        pMainWindow->printOutput(vStatsText, SilentMessage(false), true);
 
-void AudioService::waitForAllBuffers(User* pUser, bool bClearPackets, size_t* iLastPlayingPacketIndex)
-{
-    // Wait until finished playing 1
-    while ( waveOutUnprepareHeader(pUser->hWaveOut, &pUser->WaveOutHdr1, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING )
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+        pushToTalkStats = PushToTalkStats();
     }
 
-    // Wait until finished playing 2
-    while ( waveOutUnprepareHeader(pUser->hWaveOut, &pUser->WaveOutHdr2, sizeof(WAVEHDR)) == WAVERR_STILLPLAYING )
+
+    mtxOutgoingLatency.lock();
+
+    if (outgoingLatency.getTotal().getCount() > 0)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(BUFFER_UPDATE_CHECK_MS));
+        pMainWindow->printOutput("Voice latency of our voice (until it's sent):\n" + outgoingLatency.toString("    "),
+                                 SilentMessage(false),
+                                 true);
     }
 
-    if (bClearPackets)
+    mtxOutgoingLatency.unlock();
+
+
+    // A user may still be added or removed by the TCP thread.
+
+    pNetworkService->getOtherUsersMutex()->lock();
+
+    for (size_t i = 0;   i < pNetworkService->getOtherUsersVectorSize();   i++)
     {
-        for (size_t i = *iLastPlayingPacketIndex;   i < pUser->vAudioPackets.size();   i++)
-        {
-            delete[] pUser->vAudioPackets[i];
-            pUser->vAudioPackets[i] = nullptr;
-        }
+        deleteUserAudio( pNetworkService->getOtherUser(i) );
     }
-}
 
-int AudioService::getInputDeviceID(std::wstring sDeviceName)
-{
-    UINT iInDeviceCount = waveInGetNumDevs();
+    pNetworkService->getOtherUsersMutex()->unlock();
+
 
-    for (UINT i = 0; i < iInDeviceCount; i++)
+    if (pMixer)
     {
-        WAVEINCAPS deviceInfo;
+        AudioMixerStats stats = pMixer->getStats();
 
-        MMRESULT result = waveInGetDevCaps(i, &deviceInfo, sizeof(deviceInfo));
-        if (result)
+        if (stats.iMixCount > 0)
         {
-            char fault [256];
-            memset (fault, 0, 256);
-
-            waveInGetErrorTextA (result, fault, 256);
-            pMainWindow->printOutput (std::string("AudioService::getInputDevices::waveInGetDevCaps() error: " + std::string(fault) + "."),
-                                       SilentMessage(false),
-                                       true);
-           continue;
+            char vStatsText[256];
+            std::snprintf(vStatsText, sizeof(vStatsText),
+                          "Voice mixer: %llu packets, %.2f speakers per packet (%zu max), %.1f us average / %.1f us max per packet, "
+                          "%llu late, %llu dropped.\n",
+                          stats.iMixCount, stats.getAverageSpeakersPerMix(), stats.iMaxSpeakersInMix,
+                          stats.getAverageMixTimeUs(), stats.dMaxMixTimeUs, stats.iMissedPacketCount, stats.iDroppedPacketCount);
+
+            pMainWindow->printOutput(vStatsText, SilentMessage(false), true);
         }
-        else
+
+        if (stats.iSpeakerPacketCount > 0)
         {
-            if (sDeviceName == std::wstring(deviceInfo.szPname))
-            {
-                return static_cast<int>(i);
-            }
-        }
-    }
+            const double dPacketMs = 1000.0 * sampleCount / sampleRate;
 
-    return -1;
-}
+            char vStatsText[256];
+            std::snprintf(vStatsText, sizeof(vStatsText),
+                          "Voice queue: %.1f ms average / %.1f ms max per speaker, clock drift up to %.0f ppm (compensated).\n",
+                          stats.getAverageQueuedPackets() * dPacketMs, stats.dMaxQueuedPackets * dPacketMs, stats.dMaxDriftPPM);
 
-void AudioService::stop()
-{
-    if (bInputReady)
-    {
-        bInputReady = false;
+            pMainWindow->printOutput(vStatsText, SilentMessage(false), true);
+        }
 
-        // Wait for record to stop.
-        std::this_thread::sleep_for( std::chrono::milliseconds(INTERVAL_AUDIO_RECORD_MS * 2) );
+        if (stats.iCappedPacketCount > 0)
+        {
+            char vStatsText[256];
+            std::snprintf(vStatsText, sizeof(vStatsText),
+                          "Voice mixer: %llu packets of the quieter speakers were not mixed (%.2f speakers per packet, %zu max), "
+                          "%llu of them were not decrypted.\n",
+                          stats.iCappedPacketCount, stats.getAverageCappedSpeakers(), stats.iMaxCappedSpeakers, stats.iSkippedPacketCount);
 
-        waitForAllInBuffers();
+            pMainWindow->printOutput(vStatsText, SilentMessage(false), true);
+        }
 
-        waveInClose(hWaveIn);
-    }
+        if (stats.iDroppedSoundCount > 0)
+        {
+            char vStatsText[256];
+            std::snprintf(vStatsText, sizeof(vStatsText),
+                          "Voice mixer: %llu notification sounds played, %llu dropped (the same sound was still playing).\n",
+                          stats.iSoundCount, stats.iDroppedSoundCount);
 
+            pMainWindow->printOutput(vStatsText, SilentMessage(false), true);
+        }
 
-    if (pWaveIn1 != nullptr)
-    {
-        delete[] pWaveIn1;
-        pWaveIn1 = nullptr;
+        if (stats.iWriteErrorCount > 0)
+        {
+            pMainWindow->printOutput(std::string("AudioService::stop(): the voice mixer failed to play " + std::to_string(stats.iWriteErrorCount)
+                                                 + " packets, last error: " + pMixer->getLastError()),
+                                     SilentMessage(false),
+                                     true);
+        }
     }
 
-    if (pWaveIn2 != nullptr)
-    {
-        delete[] pWaveIn2;
-        pWaveIn2 = nullptr;
-    }
 
-    if (pWaveIn3 != nullptr)
-    {
-        delete[] pWaveIn3;
-        pWaveIn3 = nullptr;
-    }
+    stopSessionRecording();
 
-    if (pWaveIn4 != nullptr)
-    {
-        delete[] pWaveIn4;
-        pWaveIn4 = nullptr;
-    }
 
+    AudioFramePoolStats framePoolStats = pFramePool->getStats();
 
-    for (size_t i = 0;   i < pNetworkService->getOtherUsersVectorSize();   i++)
+    if (framePoolStats.iAcquireCount > 0)
     {
-        deleteUserAudio( pNetworkService->getOtherUser(i) );
+        char vStatsText[256];
+        std::snprintf(vStatsText, sizeof(vStatsText),
+                      "Voice frames: %llu taken from the pool of %zu, %zu max in use, %llu allocated (the pool was empty).\n",
+                      framePoolStats.iAcquireCount, framePoolStats.iFrameCount, framePoolStats.iMaxInUse, framePoolStats.iMissCount);
+
+        pMainWindow->printOutput(vStatsText, SilentMessage(false), true);
     }
 }
 
@@ -2188,7 +1632,7 @@ void AudioService::setInputAudioVolume(int iVolume)
 
 void AudioService::setVoiceStartValue(int iValue)
 {
-    iLowerVoiceStartRecValueInDBFS = iValue;
+    iVoiceStartPeakThreshold = LevelMeter::getPeakThreshold(iValue);
 }
 
 void AudioService::setShouldHearTestVoice(bool bHear)
@@ -2213,45 +1657,45 @@ AudioService::~AudioService()
 
         f1.get(); // wait for testRecord() to finish.
         f2.get(); // wait for testOutputAudio() to finish.
-
-
-        waitForAllTestInBuffers();
-
-        waveInStop(hTestWaveIn);
-
-        waveOutReset(hTestWaveOut);
     }
 
     bTestInputReady = false;
     bPauseTestInput = false;
 
-    if (pTestWaveIn1 != nullptr)
+    if (pTestCapture)
     {
-        delete[] pTestWaveIn1;
-        pTestWaveIn1 = nullptr;
+        delete pTestCapture;
+        pTestCapture = nullptr;
     }
 
-    if (pTestWaveIn2 != nullptr)
+    if (pTestPlayback)
     {
-        delete[] pTestWaveIn2;
-        pTestWaveIn2 = nullptr;
+        delete pTestPlayback;
+        pTestPlayback = nullptr;
     }
 
-    if (pTestWaveIn3 != nullptr)
-    {
-        delete[] pTestWaveIn3;
-        pTestWaveIn3 = nullptr;
-    }
+    delete pVoiceActivityDetector;
+    delete pTestVoiceActivityDetector;
 
-    if (pTestWaveIn4 != nullptr)
-    {
-        delete[] pTestWaveIn4;
-        pTestWaveIn4 = nullptr;
-    }
+    delete pNoiseSuppressor;
+    delete pTestNoiseSuppressor;
+
+    delete pAutomaticGainControl;
+    delete pTestAutomaticGainControl;
+
+    stopSessionRecording();
+
+    // Before the backend (and the sounds it plays).
+    delete pMixer;
+
+    delete pNotificationSounds;
+
+    delete pAudioBackend;
 
-    waitForAllTestInBuffers();
+    delete pInputSource;
 
-    waveInClose(hTestWaveIn);
+    // After all frames are back.
+    clearTestAudioPackets();
 
-    waveOutClose(hTestWaveOut);
+    delete pFramePool;
 }
@@ -11,17 +11,21 @@
 #include <vector>
 #include <mutex>
 #include <future>
+#include <thread>
+#include <chrono>
 
-// Other
-#define _WINSOCKAPI_    // stops windows.h from including winsock.h
-#include <Windows.h>
-#include "Mmsystem.h"
-
-
-// for mmsystem
-#pragma comment(lib,"Winmm.lib")
-// for GetAsyncKeyState
-#pragma comment(lib, "user32.lib")
+// Custom
+#include "Model/AudioService/Backend/audiobackend.h"
+#include "Model/AudioService/Backend/switchableaudiostream.h"
+#include "Model/AudioService/DSP/voiceactivitydetector.h"
+#include "Model/AudioService/DSP/noisesuppressor.h"
+#include "Model/AudioService/DSP/automaticgaincontrol.h"
+#include "Model/AudioService/Mixer/audiomixer.h"
+#include "Model/AudioService/FramePool/audioframepool.h"
+#include "Model/AudioService/Sounds/notificationsounds.h"
+#include "Model/AudioService/Recorder/sessionrecorder.h"
+#include "Model/AudioService/Sender/voicesender.h"
+#include "Model/InputSource/inputsource.h"
 
 
 
@@ -33,17 +37,40 @@ class User;
 
 
 
-#define  BUFFER_UPDATE_CHECK_MS      2
+// Push-to-talk pre-roll: the microphone is always on and this much audio from before the press is sent.
+#define  PUSH_TO_TALK_MAX_PRE_ROLL_MS 1000
+
 
-#define  AUDIO_CONNECT_PATH          L"sounds/connect.wav"
-#define  AUDIO_DISCONNECT_PATH       L"sounds/disconnect.wav"
-#define  AUDIO_LOST_CONNECTION_PATH  L"sounds/lostconnection.wav"
-#define  AUDIO_NEW_MESSAGE_PATH      L"sounds/newmessage.wav"
-#define  AUDIO_PRESS_PATH            L"sounds/press.wav"
-#define  AUDIO_UNPRESS_PATH          L"sounds/unpress.wav"
-#define  AUDIO_SERVER_MESSAGE_PATH   L"sounds/servermessage.wav"
-#define  AUDIO_MUTE_MIC_PATH         L"sounds/mutemic.wav"
-#define  AUDIO_UNMUTE_MIC_PATH       L"sounds/unmutemic.wav"
+struct PushToTalkStats
+{
+    unsigned long long iPressCount                = 0;
+    double             dTotalPressToFirstPacketMs = 0.0;  // from the moment we saw the button until the first packet went to the send thread
+    double             dMaxPressToFirstPacketMs   = 0.0;
+    double             dTotalPreRollMs            = 0.0;  // audio from before the press that was sent
+
+
+    void   addPress                       (double dPressToFirstPacketMs, double dPreRollMs)
+    {
+        iPressCount++;
+        dTotalPressToFirstPacketMs += dPressToFirstPacketMs;
+        dTotalPreRollMs            += dPreRollMs;
+
+        if (dPressToFirstPacketMs > dMaxPressToFirstPacketMs)
+        {
+            dMaxPressToFirstPacketMs = dPressToFirstPacketMs;
+        }
+    }
+
+    double getAveragePressToFirstPacketMs () const
+    {
+        return iPressCount ? dTotalPressToFirstPacketMs / static_cast<double>(iPressCount) : 0.0;
+    }
+
+    double getAveragePreRollMs            () const
+    {
+        return iPressCount ? dTotalPreRollMs / static_cast<double>(iPressCount) : 0.0;
+    }
+};
 
 
 
@@ -57,7 +84,10 @@ class AudioService
 
 public:
 
-    AudioService(MainWindow* pMainWindow, SettingsManager* pSettingsManager);
+    // Takes ownership of pAudioBackend, nullptr - AudioBackend::create(ABT_DEFAULT).
+    // Takes ownership of pInputSource, nullptr - InputSource::create(IST_DEFAULT).
+
+    AudioService(MainWindow* pMainWindow, SettingsManager* pSettingsManager, AudioBackend* pAudioBackend = nullptr, InputSource* pInputSource = nullptr);
 
 
 
@@ -87,8 +117,10 @@ public:
     // Audio data record/play
 
         void   setTestRecordingPause         (bool bPause);
-        void   playAudioData                 (short int* pAudio,  std::string sUserName,  bool bLast);
-        void   play                          (User* pUser);
+        void   playAudioData                 (const short int* pAudio,  const std::string& sUserName,  bool bLast,
+                                              const VoiceTimestamps& timestamps = VoiceTimestamps());
+        // Before the packet of the user is decrypted: true if it's not needed (see AudioMixer::skipCappedPacket()).
+        bool   skipAudioData                 (const std::string& sUserName);
 
 
     // Stop
@@ -103,6 +135,7 @@ public:
         void   setShouldHearTestVoice        (bool bHear);
         void   setNewUserVolume              (std::string sUserName,  float fVolume);
         void   setNewMasterVolume            (unsigned short int iVolume);
+        void   setInputDevice                (const std::wstring& sDeviceName);
         void   setNetworkService             (NetworkService* pNetworkService);
         void   setMuteMic                    (bool bMute);
         bool   getMuteMic                    ();
@@ -125,33 +158,27 @@ private:
     // Recording
 
         void   recordOnPush                  ();
+        bool   recordOnPushWithPreRoll       (size_t iPreRollPackets);
         void   recordOnTalk                  ();
         void   testRecord                    ();
 
 
     // Used in recordOnPress()/recordOnTalk()/testRecord()
 
-        bool  addInBuffer              (LPWAVEHDR buffer, bool bTestDevice = false);
-        bool  addOutBuffer             (HWAVEOUT  hWaveOut, LPWAVEHDR buffer);
-        void  waitAndSendBuffer        (WAVEHDR* WaveInHdr, short int* pWaveIn, bool bOnTalk = false);
-        void  waitAndShowBufferVolume  (WAVEHDR* WaveInHdr, short int* pWaveIn);
-        void  waitForAllInBuffers      ();
-        void  waitForAllTestInBuffers  ();
-        void  waitForAllTestOutBuffers ();
-        void  sendAudioData            (short* pAudio);
-        void  sendAudioDataOnTalk      (short* pAudio);
-        void  sendAudioDataVolume      (short* pAudio);
+        bool  recordPacket             (AudioCaptureStream* pStream, NoiseSuppressor* pNoiseSuppressor, AutomaticGainControl* pAutomaticGainControl,
+                                        AudioFrame& packet, const std::string& sFunctionName);
+        bool  isPushToTalkButtonPressed();
+        void  sendAudioData            (AudioFrame audio);
+        void  sendVoicePacket          (AudioFrame& audio);
+        bool  isVoiceOnTalk            (short* pAudio);
+        void  sendAudioDataVolume      (AudioFrame audio);
         void  testOutputAudio          ();
-
-    // Used in play()
-
-        void  waitForPlayToEnd         (User* pUser, WAVEHDR* pWaveOutHdr, size_t& iLastPlayingPacketIndex);
-        void  waitForPlayOnTestToEnd   (WAVEHDR* pWaveOutHdr);
-        void  waitForAllBuffers        (User* pUser, bool bClearPackets, size_t* iLastPlayingPacketIndex);
-
-    // Used in start()
-
-        int  getInputDeviceID          (std::wstring sDeviceName);
+        void  clearTestAudioPackets    ();
+        void  playNotificationSound    (NOTIFICATION_SOUND sound);
+        void  startSessionRecording    ();
+        void  stopSessionRecording     ();
+        void  printDeviceSwitch        (const AudioDeviceSwitch& deviceSwitch, const std::string& sDeviceType);
+        float getUserGain              (float fUserDefinedVolume) const;
 
     // -------------------------------------------------------------
 
@@ -161,53 +188,72 @@ private:
     SettingsManager* pSettingsManager;
 
 
-    // Waveform-audio input device
-    HWAVEIN          hWaveIn;
-    HWAVEIN          hTestWaveIn; // Used to show the voice meter in the Settings window.
+    // Sound devices
+    AudioBackend*        pAudioBackend;
+    SwitchableCaptureStream* pCapture;  // moved to another device by setInputDevice() (or if the device is lost)
+    std::mutex           mtxCaptureSwitch;  // pCapture is deleted in stop() vs. setInputDevice()
+    AudioCaptureStream*  pTestCapture;  // Used to show the voice meter in the Settings window.
+    AudioPlaybackStream* pTestPlayback;
 
+    // All users are played through it (created in prepareForStart()).
+    AudioMixer*          pMixer;
+    std::mutex           mtxMixer;  // held while pMixer is replaced and by playNotificationSound()
 
-    // Audio format
-    WAVEFORMATEX     Format;
+    // Read once in the constructor, played through pMixer.
+    NotificationSounds*  pNotificationSounds;
+
+    // Taps pMixer from start() to stop() if SettingsFile::iSessionRecording is on.
+    SessionRecorder*     pSessionRecorder;
 
+    // Every voice packet (recorded, received or for the test playback) is taken from it.
+    AudioFramePool*      pFramePool;
 
-    // Audio buffers
-    WAVEHDR          WaveInHdr1;
-    WAVEHDR          WaveInHdr2;
-    WAVEHDR          WaveInHdr3;
-    WAVEHDR          WaveInHdr4;
-    WAVEHDR          TestWaveInHdr1;
-    WAVEHDR          TestWaveInHdr2;
-    WAVEHDR          TestWaveInHdr3;
-    WAVEHDR          TestWaveInHdr4;
+    // Sends the packets of the record thread (from start() to stop()).
+    VoiceSender*         pVoiceSender;
+
+
+    // Push-to-talk button edges (started in start(), watches iPushToTalkButton).
+    InputSource*         pInputSource;
+    int                  iPushToTalkButton;
+
+
+    // Between the capture and everything else (created with pCapture, the test one lives as long as we do).
+    NoiseSuppressor*      pNoiseSuppressor;
+    NoiseSuppressor*      pTestNoiseSuppressor;
+    AutomaticGainControl* pAutomaticGainControl;
+    AutomaticGainControl* pTestAutomaticGainControl;
+
+
+    // Audio format
+    AudioFormat      format;
 
 
     std::promise<bool> promiseFinishTestRecord;
     std::promise<bool> promiseFinishTestOutputAudio;
 
 
-    // "In" buffers
-    short int*       pWaveIn1;
-    short int*       pWaveIn2;
-    short int*       pWaveIn3;
-    short int*       pWaveIn4;
-    short int*       pTestWaveIn1;
-    short int*       pTestWaveIn2;
-    short int*       pTestWaveIn3;
-    short int*       pTestWaveIn4;
+    // recordOnPush()/recordOnTalk(), uses pCapture (joined in stop() before it's deleted).
+    std::thread         recordThread;
 
 
-    // Audio packets
-    std::vector<short*> vAudioPacketsForTest;
-    std::mutex          mtxAudioPacketsForTest;
+    // Written by recordOnPush() (read in stop() after recordThread is joined).
+    PushToTalkStats     pushToTalkStats;
+
 
+    // Capture -> send of our packets (written by the send thread of pVoiceSender).
+    VoiceLatencyStats   outgoingLatency;
+    std::mutex          mtxOutgoingLatency;
 
-    // Waveform-audio output device
-    HWAVEOUT            hTestWaveOut;
+
+    // Audio packets
+    std::vector<AudioFrame> vAudioPacketsForTest;
+    std::mutex              mtxAudioPacketsForTest;
 
 
-    // Audio buffers
-    WAVEHDR             TestWaveOutHdr1;
-    WAVEHDR             TestWaveOutHdr2;
+    // "Talk to Record" (the test one is for the Settings window).
+    // Used by the record threads only: it depends on the previous packets, so they must come in order.
+    VoiceActivityDetector* pVoiceActivityDetector;
+    VoiceActivityDetector* pTestVoiceActivityDetector;
 
 
     // Record quality
@@ -221,16 +267,12 @@ private:
 
     // Voice.
     int              iAudioInputVolume;
-    int              iLowerVoiceStartRecValueInDBFS;
-    int              iTestPacketsNeedToRecordLeft;
-    int              iPacketsNeedToRecordLeft;
+    int              iVoiceStartPeakThreshold;  // peak (SHRT_MAX = 0 dBFS) for the voice start value in dBFS
     float            fMasterVolumeMult;
     bool             bInputReady;
     bool             bTestInputReady;
     bool             bPauseTestInput;
     bool             bOutputTestVoice;
-    bool             bRecordTalk;
-    bool             bRecordedSome;
 
     bool             bMuteMic;
 };
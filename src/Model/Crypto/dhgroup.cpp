@@ -0,0 +1,576 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "dhgroup.h"
+
+
+// STL
+#include <mutex>
+#include <random>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+// Safe primes p = 2q + 1, g = 2.
+
+static const char* pModp2048Prime =
+    "FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+    "020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+    "4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+    "EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+    "98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+    "9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+    "E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF695581718"
+    "3995497CEA956AE515D2261898FA051015728E5A8AACAA68FFFFFFFFFFFFFFFF";
+
+static const char* pModp3072Prime =
+    "FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+    "020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+    "4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+    "EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+    "98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+    "9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+    "E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF695581718"
+    "3995497CEA956AE515D2261898FA051015728E5A8AAAC42DAD33170D04507A33"
+    "A85521ABDF1CBA64ECFB850458DBEF0A8AEA71575D060C7DB3970F85A6E1E4C7"
+    "ABF5AE8CDB0933D71E8C94E04A25619DCEE3D2261AD2EE6BF12FFA06D98A0864"
+    "D87602733EC86A64521F2B18177B200CBBE117577A615D6C770988C0BAD946E2"
+    "08E24FA074E5AB3143DB5BFCE0FD108E4B82D120A93AD2CAFFFFFFFFFFFFFFFF";
+
+static const char* pFfdhe2048Prime =
+    "FFFFFFFFFFFFFFFFADF85458A2BB4A9AAFDC5620273D3CF1D8B9C583CE2D3695"
+    "A9E13641146433FBCC939DCE249B3EF97D2FE363630C75D8F681B202AEC4617A"
+    "D3DF1ED5D5FD65612433F51F5F066ED0856365553DED1AF3B557135E7F57C935"
+    "984F0C70E0E68B77E2A689DAF3EFE8721DF158A136ADE73530ACCA4F483A797A"
+    "BC0AB182B324FB61D108A94BB2C8E3FBB96ADAB760D7F4681D4F42A3DE394DF4"
+    "AE56EDE76372BB190B07A7C8EE0A6D709E02FCE1CDF7E2ECC03404CD28342F61"
+    "9172FE9CE98583FF8E4F1232EEF28183C3FE3B1B4C6FAD733BB5FCBC2EC22005"
+    "C58EF1837D1683B2C6F34A26C1B2EFFA886B423861285C97FFFFFFFFFFFFFFFF";
+
+static const char* pFfdhe3072Prime =
+    "FFFFFFFFFFFFFFFFADF85458A2BB4A9AAFDC5620273D3CF1D8B9C583CE2D3695"
+    "A9E13641146433FBCC939DCE249B3EF97D2FE363630C75D8F681B202AEC4617A"
+    "D3DF1ED5D5FD65612433F51F5F066ED0856365553DED1AF3B557135E7F57C935"
+    "984F0C70E0E68B77E2A689DAF3EFE8721DF158A136ADE73530ACCA4F483A797A"
+    "BC0AB182B324FB61D108A94BB2C8E3FBB96ADAB760D7F4681D4F42A3DE394DF4"
+    "AE56EDE76372BB190B07A7C8EE0A6D709E02FCE1CDF7E2ECC03404CD28342F61"
+    "9172FE9CE98583FF8E4F1232EEF28183C3FE3B1B4C6FAD733BB5FCBC2EC22005"
+    "C58EF1837D1683B2C6F34A26C1B2EFFA886B4238611FCFDCDE355B3B6519035B"
+    "BC34F4DEF99C023861B46FC9D6E6C9077AD91D2691F7F7EE598CB0FAC186D91C"
+    "AEFE130985139270B4130C93BC437944F4FD4452E2D74DD364F2E21E71F54BFF"
+    "5CAE82AB9C9DF69EE86D2BC522363A0DABC521979B0DEADA1DBF9A42D5C4484E"
+    "0ABCD06BFA53DDEF3C1B20EE3FD59D7C25E41D2B66C62E37FFFFFFFFFFFFFFFF";
+
+
+static std::mutex mtxGroups;
+
+
+namespace
+{
+    // a * b + c + d (fits in 128 bits), the high limb goes to hi.
+
+    inline uint64_t mulAdd(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t& hi)
+    {
+#if defined(__SIZEOF_INT128__)
+        const unsigned __int128 p = static_cast<unsigned __int128>(a) * b + c + d;
+        hi = static_cast<uint64_t>(p >> 64);
+        return static_cast<uint64_t>(p);
+#else
+        uint64_t iHigh;
+#if defined(_MSC_VER) && defined(_M_X64)
+        uint64_t iLow = _umul128(a, b, &iHigh);
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+        iHigh = __umulh(a, b);
+        uint64_t iLow = a * b;
+#else
+        // Same as mul_hilo() in integer.cpp.
+        const uint64_t a_lo = a & 0xffffffffULL, a_hi = a >> 32;
+        const uint64_t b_lo = b & 0xffffffffULL, b_hi = b >> 32;
+
+        const uint64_t p0 = a_lo * b_lo;
+        const uint64_t p1 = a_lo * b_hi;
+        const uint64_t p2 = a_hi * b_lo;
+        const uint64_t p3 = a_hi * b_hi;
+
+        const uint64_t mid = (p0 >> 32) + (p1 & 0xffffffffULL) + (p2 & 0xffffffffULL);
+        iHigh = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+        uint64_t iLow = (mid << 32) | (p0 & 0xffffffffULL);
+#endif
+        iLow  += c;
+        iHigh += (iLow < c);
+        iLow  += d;
+        iHigh += (iLow < d);
+
+        hi = iHigh;
+        return iLow;
+#endif
+    }
+
+    // t (iLimbCount + 1 limbs) < 2p, subtracts p once if t >= p.
+
+    inline void subtractPrimeOnce(uint64_t* t, const uint64_t* pPrime, size_t iLimbCount)
+    {
+        bool bSubtract = (t[iLimbCount] != 0);
+
+        if (bSubtract == false)
+        {
+            bSubtract = true; // equal
+
+            for (size_t j = iLimbCount; j-- > 0; )
+            {
+                if (t[j] != pPrime[j])
+                {
+                    bSubtract = (t[j] > pPrime[j]);
+                    break;
+                }
+            }
+        }
+
+        if (bSubtract)
+        {
+            uint64_t iBorrow = 0;
+
+            for (size_t j = 0; j < iLimbCount; j++)
+            {
+                const uint64_t iDifference = t[j] - pPrime[j] - iBorrow;
+
+                iBorrow = (t[j] < pPrime[j]) || ((t[j] == pPrime[j]) && iBorrow);
+
+                t[j] = iDifference;
+            }
+        }
+    }
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+const DHGroup* DHGroup::getGroup(char iGroupId)
+{
+    // Exponent sizes follow RFC 7919 (appendix A): not shorter than the short exponent given there
+    // for the strength of the group (225 bits for 2048-bit groups, 275 bits for 3072-bit groups).
+    // A longer exponent adds nothing to the strength but costs a squaring per bit.
+
+    static DHGroup modp2048  (DGI_MODP_2048,  "MODP-2048 (RFC 3526)", pModp2048Prime,  256);
+    static DHGroup modp3072  (DGI_MODP_3072,  "MODP-3072 (RFC 3526)", pModp3072Prime,  275);
+    static DHGroup ffdhe2048 (DGI_FFDHE_2048, "ffdhe2048 (RFC 7919)", pFfdhe2048Prime, 256);
+    static DHGroup ffdhe3072 (DGI_FFDHE_3072, "ffdhe3072 (RFC 7919)", pFfdhe3072Prime, 275);
+
+
+    DHGroup* pGroup = nullptr;
+
+    switch (iGroupId)
+    {
+    case DGI_MODP_2048:
+        pGroup = &modp2048;
+        break;
+    case DGI_MODP_3072:
+        pGroup = &modp3072;
+        break;
+    case DGI_FFDHE_2048:
+        pGroup = &ffdhe2048;
+        break;
+    case DGI_FFDHE_3072:
+        pGroup = &ffdhe3072;
+        break;
+    default:
+        return nullptr;
+    }
+
+
+    std::lock_guard<std::mutex> lock(mtxGroups);
+
+    if (pGroup->vFixedBaseTable.empty())
+    {
+        pGroup->buildFixedBaseTable();
+    }
+
+    return pGroup;
+}
+
+void DHGroup::precomputeAllGroups()
+{
+    for (char iGroupId : getSupportedGroupIds())
+    {
+        getGroup(iGroupId);
+    }
+}
+
+std::vector<char> DHGroup::getSupportedGroupIds()
+{
+    return {DGI_FFDHE_2048, DGI_MODP_2048, DGI_FFDHE_3072, DGI_MODP_3072};
+}
+
+integer DHGroup::generatePrivateKey() const
+{
+    // std::mt19937_64 is predictable from its output, take the key from the OS generator.
+
+    std::random_device rd;
+
+    integer::REP vLimbs((iPrivateKeySizeInBits + 63) / 64);
+
+    for (size_t i = 0; i < vLimbs.size(); i++)
+    {
+        vLimbs[i] = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+
+    if (iPrivateKeySizeInBits % 64)
+    {
+        vLimbs.back() &= (1ULL << (iPrivateKeySizeInBits % 64)) - 1;
+    }
+
+    // Keep the exponent at full size.
+    vLimbs.back() |= 1ULL << ((iPrivateKeySizeInBits - 1) % 64);
+
+    return integer(vLimbs);
+}
+
+integer DHGroup::computePublicKey(const integer& privateKey) const
+{
+    const size_t iDigitsPerRow = (1 << DH_FIXED_BASE_WINDOW_BITS) - 1;
+    const size_t iRowCount     = vFixedBaseTable.size() / iDigitsPerRow;
+    const size_t iExponentBits = static_cast<size_t>(privateKey.bits());
+
+    if (iExponentBits > iRowCount * DH_FIXED_BASE_WINDOW_BITS)
+    {
+        // Larger than the table, should not happen with our own keys.
+        return computeSharedSecret(generator, privateKey);
+    }
+
+
+    integer::REP vResult = vMontgomeryOne;
+    integer::REP vScratch;
+
+    for (size_t iRow = 0; iRow * DH_FIXED_BASE_WINDOW_BITS < iExponentBits; iRow++)
+    {
+        size_t iDigit = 0;
+
+        for (size_t iBit = 0; iBit < DH_FIXED_BASE_WINDOW_BITS; iBit++)
+        {
+            if (privateKey[iRow * DH_FIXED_BASE_WINDOW_BITS + iBit])
+            {
+                iDigit |= static_cast<size_t>(1) << iBit;
+            }
+        }
+
+        if (iDigit != 0)
+        {
+            montgomeryMul(vResult, vFixedBaseTable[iRow * iDigitsPerRow + iDigit - 1], vResult, vScratch);
+        }
+    }
+
+    return fromMontgomery(vResult);
+}
+
+integer DHGroup::computeSharedSecret(const integer& peerPublicKey, const integer& privateKey) const
+{
+    // Left-to-right sliding window, odd powers precomputed.
+
+    const size_t iOddPowerCount = static_cast<size_t>(1) << (DH_SLIDING_WINDOW_BITS - 1);
+
+    integer::REP vScratch;
+
+    std::vector<integer::REP> vOddPowers(iOddPowerCount);
+    vOddPowers[0] = toMontgomery(peerPublicKey);
+
+    integer::REP vBaseSquared;
+    montgomerySquare(vOddPowers[0], vBaseSquared, vScratch);
+
+    for (size_t i = 1; i < iOddPowerCount; i++)
+    {
+        montgomeryMul(vOddPowers[i - 1], vBaseSquared, vOddPowers[i], vScratch);
+    }
+
+
+    integer::REP vResult = vMontgomeryOne;
+
+    size_t iBit = static_cast<size_t>(privateKey.bits());
+
+    while (iBit > 0)
+    {
+        if (privateKey[iBit - 1] == false)
+        {
+            montgomerySquare(vResult, vResult, vScratch);
+            iBit--;
+            continue;
+        }
+
+
+        // Longest window (up to DH_SLIDING_WINDOW_BITS) that ends with a 1 bit.
+
+        size_t iWindowSize = DH_SLIDING_WINDOW_BITS;
+        if (iWindowSize > iBit)
+        {
+            iWindowSize = iBit;
+        }
+
+        while (privateKey[iBit - iWindowSize] == false)
+        {
+            iWindowSize--;
+        }
+
+        size_t iWindowValue = 0;
+
+        for (size_t i = 0; i < iWindowSize; i++)
+        {
+            iWindowValue = (iWindowValue << 1) | (privateKey[iBit - 1 - i] ? 1 : 0);
+
+            montgomerySquare(vResult, vResult, vScratch);
+        }
+
+        montgomeryMul(vResult, vOddPowers[iWindowValue / 2], vResult, vScratch);
+
+        iBit -= iWindowSize;
+    }
+
+    return fromMontgomery(vResult);
+}
+
+bool DHGroup::isValidPublicKey(const integer& key) const
+{
+    return (key > 1) && (key < prime - 1);
+}
+
+char DHGroup::getGroupId() const
+{
+    return iGroupId;
+}
+
+std::string DHGroup::getGroupName() const
+{
+    return sGroupName;
+}
+
+const integer& DHGroup::getPrime() const
+{
+    return prime;
+}
+
+size_t DHGroup::getPrimeSizeInBytes() const
+{
+    return iPrimeSizeInBytes;
+}
+
+size_t DHGroup::getPrivateKeySizeInBits() const
+{
+    return iPrivateKeySizeInBits;
+}
+
+DHGroup::DHGroup(char iGroupId, const std::string& sGroupName, const char* pPrimeHex, size_t iPrivateKeySizeInBits)
+{
+    this->iGroupId              = iGroupId;
+    this->sGroupName            = sGroupName;
+    this->iPrivateKeySizeInBits = iPrivateKeySizeInBits;
+
+    prime             = integer(pPrimeHex, 16);
+    generator         = 2;
+    iPrimeSizeInBytes = prime.bytes();
+
+
+    // Montgomery constants, R = 2^(64 * n).
+
+    vPrimeLimbs = prime.data();
+
+    const size_t iLimbCount = vPrimeLimbs.size();
+
+    vMontgomeryOne = ( (integer(1) << integer(64 * iLimbCount)) % prime ).data();
+    vMontgomeryOne.resize(iLimbCount, 0);
+
+    vMontgomeryRSquared = ( (integer(1) << integer(128 * iLimbCount)) % prime ).data();
+    vMontgomeryRSquared.resize(iLimbCount, 0);
+
+    // p^(-1) mod 2^64 by Newton's iteration (p is odd, each step doubles the correct bits).
+    uint64_t iInverse = 1;
+    for (int i = 0; i < 6; i++)
+    {
+        iInverse *= 2 - vPrimeLimbs[0] * iInverse;
+    }
+
+    iMontgomeryFactor = 0 - iInverse;
+}
+
+void DHGroup::buildFixedBaseTable()
+{
+    const size_t iDigitsPerRow = (1 << DH_FIXED_BASE_WINDOW_BITS) - 1;
+    const size_t iRowCount     = (iPrivateKeySizeInBits + DH_FIXED_BASE_WINDOW_BITS - 1) / DH_FIXED_BASE_WINDOW_BITS;
+
+    std::vector<integer::REP> vTable(iRowCount * iDigitsPerRow);
+
+    integer::REP vScratch;
+    integer::REP vRowBase = toMontgomery(generator); // g^(2^(w * row))
+
+    for (size_t iRow = 0; iRow < iRowCount; iRow++)
+    {
+        vTable[iRow * iDigitsPerRow] = vRowBase;
+
+        for (size_t iDigit = 2; iDigit <= iDigitsPerRow; iDigit++)
+        {
+            montgomeryMul(vTable[iRow * iDigitsPerRow + iDigit - 2], vRowBase, vTable[iRow * iDigitsPerRow + iDigit - 1], vScratch);
+        }
+
+        // rowBase^(2^w) = rowBase^(2^w - 1) * rowBase
+        montgomeryMul(vTable[iRow * iDigitsPerRow + iDigitsPerRow - 1], vRowBase, vRowBase, vScratch);
+    }
+
+    vFixedBaseTable = std::move(vTable);
+}
+
+void DHGroup::montgomeryMul(const integer::REP& a, const integer::REP& b, integer::REP& vResult, integer::REP& vScratch) const
+{
+    // CIOS (coarsely integrated operand scanning): t = (t + a * b[i] + m * p) / 2^64 for each limb of b.
+
+    const size_t    iLimbCount = vPrimeLimbs.size();
+    const uint64_t* pPrime     = vPrimeLimbs.data();
+
+    vScratch.assign(iLimbCount + 2, 0);
+
+    uint64_t* t = vScratch.data();
+
+    for (size_t i = 0; i < iLimbCount; i++)
+    {
+        uint64_t iCarry = 0;
+
+        for (size_t j = 0; j < iLimbCount; j++)
+        {
+            t[j] = mulAdd(a[j], b[i], t[j], iCarry, iCarry);
+        }
+
+        uint64_t iTop = t[iLimbCount] + iCarry;
+        t[iLimbCount + 1] = (iTop < iCarry);
+        t[iLimbCount]     = iTop;
+
+
+        // Makes the lowest limb 0 so that it can be shifted out.
+
+        const uint64_t m = t[0] * iMontgomeryFactor;
+
+        mulAdd(m, pPrime[0], t[0], 0, iCarry);
+
+        for (size_t j = 1; j < iLimbCount; j++)
+        {
+            t[j - 1] = mulAdd(m, pPrime[j], t[j], iCarry, iCarry);
+        }
+
+        iTop = t[iLimbCount] + iCarry;
+        t[iLimbCount - 1] = iTop;
+        t[iLimbCount]     = t[iLimbCount + 1] + (iTop < iCarry);
+    }
+
+
+    subtractPrimeOnce(t, pPrime, iLimbCount);
+
+    vResult.assign(t, t + iLimbCount);
+}
+
+void DHGroup::montgomerySquare(const integer::REP& a, integer::REP& vResult, integer::REP& vScratch) const
+{
+    // SOS (separated operand scanning): the full square first (each cross product once, then doubled),
+    // then n reduction steps. n^2 / 2 + n^2 multiplications instead of 2 n^2 in montgomeryMul(a, a).
+
+    const size_t    iLimbCount = vPrimeLimbs.size();
+    const uint64_t* pPrime     = vPrimeLimbs.data();
+
+    vScratch.assign(2 * iLimbCount + 1, 0);
+
+    uint64_t* t = vScratch.data();
+
+
+    // a[i] * a[j], i < j.
+
+    for (size_t i = 0; i + 1 < iLimbCount; i++)
+    {
+        uint64_t iCarry = 0;
+
+        for (size_t j = i + 1; j < iLimbCount; j++)
+        {
+            t[i + j] = mulAdd(a[i], a[j], t[i + j], iCarry, iCarry);
+        }
+
+        t[i + iLimbCount] = iCarry;
+    }
+
+    // * 2 (fits: the cross products are less than a^2 / 2).
+
+    uint64_t iHighBit = 0;
+
+    for (size_t k = 0; k < 2 * iLimbCount; k++)
+    {
+        const uint64_t iValue = t[k];
+
+        t[k]     = (iValue << 1) | iHighBit;
+        iHighBit = iValue >> 63;
+    }
+
+    // + a[i]^2.
+
+    uint64_t iCarry = 0;
+
+    for (size_t i = 0; i < iLimbCount; i++)
+    {
+        uint64_t iHigh;
+
+        t[2 * i] = mulAdd(a[i], a[i], t[2 * i], iCarry, iHigh);
+
+        const uint64_t iSum = t[2 * i + 1] + iHigh;
+
+        iCarry       = (iSum < iHigh);
+        t[2 * i + 1] = iSum;
+    }
+
+
+    // t = (t + m * p * 2^(64 * i)) with t[i] becoming 0, then t / R is in the upper limbs (< 2p).
+
+    for (size_t i = 0; i < iLimbCount; i++)
+    {
+        const uint64_t m = t[i] * iMontgomeryFactor;
+
+        iCarry = 0;
+
+        for (size_t j = 0; j < iLimbCount; j++)
+        {
+            t[i + j] = mulAdd(m, pPrime[j], t[i + j], iCarry, iCarry);
+        }
+
+        for (size_t k = i + iLimbCount; iCarry != 0; k++)
+        {
+            t[k]  += iCarry;
+            iCarry = (t[k] < iCarry);
+        }
+    }
+
+    subtractPrimeOnce(t + iLimbCount, pPrime, iLimbCount);
+
+    vResult.assign(t + iLimbCount, t + 2 * iLimbCount);
+}
+
+integer::REP DHGroup::toMontgomery(const integer& value) const
+{
+    integer::REP vValue = (value % prime).data();
+    vValue.resize(vPrimeLimbs.size(), 0);
+
+    integer::REP vScratch;
+
+    montgomeryMul(vValue, vMontgomeryRSquared, vValue, vScratch);
+
+    return vValue;
+}
+
+integer DHGroup::fromMontgomery(const integer::REP& value) const
+{
+    integer::REP vOne(vPrimeLimbs.size(), 0);
+    vOne[0] = 1;
+
+    integer::REP vValue;
+    integer::REP vScratch;
+
+    montgomeryMul(value, vOne, vValue, vScratch);
+
+    return integer(vValue);
+}
@@ -0,0 +1,132 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <string>
+#include <vector>
+
+// External
+#include "integer/integer.h"
+
+
+// Bits of the exponent handled by one fixed-base table row (2^w - 1 entries per row).
+#define DH_FIXED_BASE_WINDOW_BITS   4
+
+// Size of the sliding window used for variable-base exponentiation.
+#define DH_SLIDING_WINDOW_BITS      5
+
+
+// Sent by the server as a single byte during the handshake.
+enum DH_GROUP_ID // also change in server
+{
+    DGI_MODP_2048           = 14,   // RFC 3526, group 14
+    DGI_MODP_3072           = 15,   // RFC 3526, group 15
+    DGI_FFDHE_2048          = 0x20, // RFC 7919, ffdhe2048
+    DGI_FFDHE_3072          = 0x21  // RFC 7919, ffdhe3072
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Diffie-Hellman group with a safe prime and generator 2.
+// The generator powers are precomputed on the first use so that computing
+// our public key only costs a few dozen modular multiplications.
+// All exponentiation is done in the Montgomery form (no division per multiplication).
+
+class DHGroup
+{
+
+public:
+
+    // Returns nullptr if the group is unknown.
+    // Thread-safe, the first call for a group builds its fixed-base table.
+
+    static const DHGroup*  getGroup              (char iGroupId);
+
+    // Builds the tables of all known groups (to hide the cost before the first connect).
+
+    static void            precomputeAllGroups   ();
+
+    static std::vector<char> getSupportedGroupIds ();
+
+
+    // Random exponent of getPrivateKeySizeInBits() bits (uses std::random_device).
+
+    integer        generatePrivateKey     () const;
+
+    // g^x mod p, uses the fixed-base table.
+
+    integer        computePublicKey       (const integer& privateKey) const;
+
+    // peerPublicKey^x mod p, call isValidPublicKey() first.
+
+    integer        computeSharedSecret    (const integer& peerPublicKey, const integer& privateKey) const;
+
+    // 1 < key < p - 1 (with a safe prime this excludes the small subgroups).
+
+    bool           isValidPublicKey       (const integer& key) const;
+
+
+    char           getGroupId             () const;
+    std::string    getGroupName           () const;
+    const integer& getPrime               () const;
+    size_t         getPrimeSizeInBytes    () const;
+    size_t         getPrivateKeySizeInBits() const;
+
+private:
+
+    DHGroup(char iGroupId, const std::string& sGroupName, const char* pPrimeHex, size_t iPrivateKeySizeInBits);
+
+
+    void           buildFixedBaseTable    ();
+
+
+    // vResult = a * b / R mod p (R = 2^(64 * limb count of p)), a and b are < p in the Montgomery form.
+    // vResult may be a or b, vScratch is reused between the calls.
+
+    void           montgomeryMul          (const integer::REP& a, const integer::REP& b, integer::REP& vResult, integer::REP& vScratch) const;
+
+    // Same as montgomeryMul(a, a, ...) but cheaper (used for the squarings of computeSharedSecret()).
+
+    void           montgomerySquare       (const integer::REP& a, integer::REP& vResult, integer::REP& vScratch) const;
+
+    integer::REP   toMontgomery           (const integer& value) const;
+
+    integer        fromMontgomery         (const integer::REP& value) const;
+
+
+    // ---------------------------------------
+
+
+    // vFixedBaseTable[row * (2^w - 1) + (digit - 1)] = g^(digit * 2^(w * row)) mod p (Montgomery form)
+    std::vector<integer::REP> vFixedBaseTable;
+
+
+    integer        prime;
+    integer        generator;
+
+
+    // Montgomery constants.
+    integer::REP   vPrimeLimbs;
+    integer::REP   vMontgomeryOne;      // R mod p
+    integer::REP   vMontgomeryRSquared; // R^2 mod p
+    uint64_t       iMontgomeryFactor;   // -p^(-1) mod 2^64
+
+
+    std::string    sGroupName;
+
+
+    size_t         iPrimeSizeInBytes;
+    size_t         iPrivateKeySizeInBits;
+
+
+    char           iGroupId;
+};
@@ -0,0 +1,93 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "keyschedule.h"
+
+
+// STL
+#include <cstring>
+
+
+KeySchedule::KeySchedule()
+{
+    clearKeys();
+}
+
+void KeySchedule::reset(const unsigned char* pKey)
+{
+    std::lock_guard<std::mutex> lock(mtxKeys);
+
+    clearKeys();
+
+    std::memcpy(vOldKey, pKey, SESSION_KEY_SIZE);
+    std::memcpy(vNewKey, pKey, SESSION_KEY_SIZE);
+}
+
+void KeySchedule::scheduleSwitch(const unsigned char* pNewKey, uint32_t iSwitchSequence)
+{
+    std::lock_guard<std::mutex> lock(mtxKeys);
+
+    if ( bSwitchScheduled && isAtOrAfter(iSwitchSequence, this->iSwitchSequence) )
+    {
+        // The previous switch has happened (or is about to), its new key is the current one.
+
+        std::memcpy(vOldKey, vNewKey, SESSION_KEY_SIZE);
+    }
+
+    std::memcpy(vNewKey, pNewKey, SESSION_KEY_SIZE);
+
+    this->iSwitchSequence = iSwitchSequence;
+    bSwitchScheduled      = true;
+}
+
+void KeySchedule::getKeyForSequence(uint32_t iSequence, unsigned char* pOutKey)
+{
+    std::lock_guard<std::mutex> lock(mtxKeys);
+
+    if ( bSwitchScheduled && (isAtOrAfter(iSequence, iSwitchSequence) == false) )
+    {
+        std::memcpy(pOutKey, vOldKey, SESSION_KEY_SIZE);
+    }
+    else
+    {
+        std::memcpy(pOutKey, vNewKey, SESSION_KEY_SIZE);
+    }
+}
+
+uint32_t KeySchedule::getNextSequence()
+{
+    std::lock_guard<std::mutex> lock(mtxKeys);
+
+    return iNextSequence++;
+}
+
+uint32_t KeySchedule::peekNextSequence()
+{
+    std::lock_guard<std::mutex> lock(mtxKeys);
+
+    return iNextSequence;
+}
+
+KeySchedule::~KeySchedule()
+{
+    clearKeys();
+}
+
+void KeySchedule::clearKeys()
+{
+    memset(vOldKey, 0, SESSION_KEY_SIZE);
+    memset(vNewKey, 0, SESSION_KEY_SIZE);
+
+    iSwitchSequence  = 0;
+    iNextSequence    = 0;
+    bSwitchScheduled = false;
+}
+
+bool KeySchedule::isAtOrAfter(uint32_t iSequence, uint32_t iSwitchSequence)
+{
+    // Serial number arithmetic (RFC 1982), works across the 2^32 wrap.
+
+    return static_cast<int32_t>(iSequence - iSwitchSequence) >= 0;
+}
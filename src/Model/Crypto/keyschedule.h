@@ -0,0 +1,77 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <cstdint>
+#include <mutex>
+
+
+#define SESSION_KEY_SIZE 16
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// AES key of one direction of the voice stream.
+// After a rekey the new key is used for packets with a sequence number
+// starting from the switch sequence, older (late or reordered) packets keep the old key.
+
+class KeySchedule
+{
+
+public:
+
+    KeySchedule();
+
+
+    // Forget everything and use this key for all sequence numbers.
+
+    void     reset             (const unsigned char* pKey);
+
+    // Packets with iSequence >= iSwitchSequence (with wrap-around) use pNewKey.
+    // The key that is current at iSwitchSequence becomes the old key.
+
+    void     scheduleSwitch    (const unsigned char* pNewKey, uint32_t iSwitchSequence);
+
+
+    void     getKeyForSequence (uint32_t iSequence, unsigned char* pOutKey);
+
+    // For the sender: returns iNextSequence and increments it.
+
+    uint32_t getNextSequence   ();
+
+    uint32_t peekNextSequence  ();
+
+
+    ~KeySchedule();
+
+private:
+
+    void     clearKeys         ();
+
+    static bool isAtOrAfter    (uint32_t iSequence, uint32_t iSwitchSequence);
+
+
+    // ---------------------------------------
+
+
+    std::mutex     mtxKeys;
+
+
+    unsigned char  vOldKey[SESSION_KEY_SIZE];
+    unsigned char  vNewKey[SESSION_KEY_SIZE];
+
+
+    uint32_t       iSwitchSequence;
+    uint32_t       iNextSequence;
+
+
+    bool           bSwitchScheduled;
+};
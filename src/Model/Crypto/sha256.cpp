@@ -0,0 +1,308 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "sha256.h"
+
+
+// STL
+#include <cstring>
+#include <stdexcept>
+
+
+static const uint32_t vRoundConstants[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+
+static inline uint32_t rotr(uint32_t x, unsigned int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+SHA256::SHA256()
+{
+    vState[0] = 0x6a09e667;
+    vState[1] = 0xbb67ae85;
+    vState[2] = 0x3c6ef372;
+    vState[3] = 0xa54ff53a;
+    vState[4] = 0x510e527f;
+    vState[5] = 0x9b05688c;
+    vState[6] = 0x1f83d9ab;
+    vState[7] = 0x5be0cd19;
+
+    iTotalSize  = 0;
+    iBufferSize = 0;
+}
+
+void SHA256::update(const unsigned char* pData, size_t iSize)
+{
+    iTotalSize += iSize;
+
+
+    // Fill the partial block first.
+
+    if (iBufferSize > 0)
+    {
+        size_t iCopySize = SHA256_BLOCK_SIZE - iBufferSize;
+        if (iCopySize > iSize)
+        {
+            iCopySize = iSize;
+        }
+
+        std::memcpy(vBuffer + iBufferSize, pData, iCopySize);
+        iBufferSize += iCopySize;
+        pData       += iCopySize;
+        iSize       -= iCopySize;
+
+        if (iBufferSize < SHA256_BLOCK_SIZE)
+        {
+            return;
+        }
+
+        processBlock(vBuffer);
+        iBufferSize = 0;
+    }
+
+
+    // Whole blocks straight from the input.
+
+    while (iSize >= SHA256_BLOCK_SIZE)
+    {
+        processBlock(pData);
+        pData += SHA256_BLOCK_SIZE;
+        iSize -= SHA256_BLOCK_SIZE;
+    }
+
+
+    if (iSize > 0)
+    {
+        std::memcpy(vBuffer, pData, iSize);
+        iBufferSize = iSize;
+    }
+}
+
+void SHA256::finish(unsigned char* pOutDigest)
+{
+    const uint64_t iTotalBits = iTotalSize * 8;
+
+
+    // Padding: 0x80, zeros, then the message length in bits (big-endian).
+
+    unsigned char vPadding[SHA256_BLOCK_SIZE * 2];
+    memset(vPadding, 0, sizeof(vPadding));
+    vPadding[0] = 0x80;
+
+    size_t iPaddingSize = (iBufferSize < 56) ? (56 - iBufferSize) : (120 - iBufferSize);
+
+    for (int i = 0; i < 8; i++)
+    {
+        vPadding[iPaddingSize + i] = static_cast<unsigned char>(iTotalBits >> (56 - 8 * i));
+    }
+
+    update(vPadding, iPaddingSize + 8);
+
+
+    for (int i = 0; i < 8; i++)
+    {
+        pOutDigest[i * 4]     = static_cast<unsigned char>(vState[i] >> 24);
+        pOutDigest[i * 4 + 1] = static_cast<unsigned char>(vState[i] >> 16);
+        pOutDigest[i * 4 + 2] = static_cast<unsigned char>(vState[i] >> 8);
+        pOutDigest[i * 4 + 3] = static_cast<unsigned char>(vState[i]);
+    }
+}
+
+void SHA256::hash(const unsigned char* pData, size_t iSize, unsigned char* pOutDigest)
+{
+    SHA256 sha;
+    sha.update(pData, iSize);
+    sha.finish(pOutDigest);
+}
+
+void SHA256::hmac(const unsigned char* pKey,  size_t iKeySize,
+                  const unsigned char* pData, size_t iDataSize,
+                  unsigned char* pOutDigest)
+{
+    unsigned char vKeyBlock[SHA256_BLOCK_SIZE];
+    memset(vKeyBlock, 0, SHA256_BLOCK_SIZE);
+
+    if (iKeySize > SHA256_BLOCK_SIZE)
+    {
+        hash(pKey, iKeySize, vKeyBlock);
+    }
+    else if (iKeySize > 0)
+    {
+        std::memcpy(vKeyBlock, pKey, iKeySize);
+    }
+
+
+    unsigned char vPad[SHA256_BLOCK_SIZE];
+    unsigned char vInnerDigest[SHA256_DIGEST_SIZE];
+
+
+    // Inner hash.
+
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; i++)
+    {
+        vPad[i] = vKeyBlock[i] ^ 0x36;
+    }
+
+    SHA256 inner;
+    inner.update(vPad, SHA256_BLOCK_SIZE);
+    inner.update(pData, iDataSize);
+    inner.finish(vInnerDigest);
+
+
+    // Outer hash.
+
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; i++)
+    {
+        vPad[i] = vKeyBlock[i] ^ 0x5c;
+    }
+
+    SHA256 outer;
+    outer.update(vPad, SHA256_BLOCK_SIZE);
+    outer.update(vInnerDigest, SHA256_DIGEST_SIZE);
+    outer.finish(pOutDigest);
+
+
+    memset(vKeyBlock, 0, SHA256_BLOCK_SIZE);
+    memset(vPad, 0, SHA256_BLOCK_SIZE);
+}
+
+void SHA256::hkdf(const unsigned char* pSalt, size_t iSaltSize,
+                  const unsigned char* pInputKey, size_t iInputKeySize,
+                  const unsigned char* pInfo, size_t iInfoSize,
+                  unsigned char* pOutKey, size_t iOutSize)
+{
+    if (iOutSize > 255 * SHA256_DIGEST_SIZE)
+    {
+        throw std::length_error("SHA256::hkdf(): requested key is too long");
+    }
+
+
+    // Extract (an empty salt is a string of zeros).
+
+    unsigned char vZeroSalt[SHA256_DIGEST_SIZE];
+    memset(vZeroSalt, 0, SHA256_DIGEST_SIZE);
+
+    if (iSaltSize == 0)
+    {
+        pSalt     = vZeroSalt;
+        iSaltSize = SHA256_DIGEST_SIZE;
+    }
+
+    unsigned char vPseudoRandomKey[SHA256_DIGEST_SIZE];
+    hmac(pSalt, iSaltSize, pInputKey, iInputKeySize, vPseudoRandomKey);
+
+
+    // Expand: T(i) = HMAC(PRK, T(i - 1) | info | i).
+
+    unsigned char* pBlockInput = new unsigned char[SHA256_DIGEST_SIZE + iInfoSize + 1];
+
+    unsigned char vBlock[SHA256_DIGEST_SIZE];
+    size_t        iPreviousSize = 0;
+    size_t        iWritten      = 0;
+
+    for (unsigned char iCounter = 1; iWritten < iOutSize; iCounter++)
+    {
+        std::memcpy(pBlockInput, vBlock, iPreviousSize);
+        if (iInfoSize > 0)
+        {
+            std::memcpy(pBlockInput + iPreviousSize, pInfo, iInfoSize);
+        }
+        pBlockInput[iPreviousSize + iInfoSize] = iCounter;
+
+        hmac(vPseudoRandomKey, SHA256_DIGEST_SIZE, pBlockInput, iPreviousSize + iInfoSize + 1, vBlock);
+        iPreviousSize = SHA256_DIGEST_SIZE;
+
+        size_t iCopySize = iOutSize - iWritten;
+        if (iCopySize > SHA256_DIGEST_SIZE)
+        {
+            iCopySize = SHA256_DIGEST_SIZE;
+        }
+
+        std::memcpy(pOutKey + iWritten, vBlock, iCopySize);
+        iWritten += iCopySize;
+    }
+
+
+    memset(pBlockInput, 0, SHA256_DIGEST_SIZE + iInfoSize + 1);
+    delete[] pBlockInput;
+
+    memset(vPseudoRandomKey, 0, SHA256_DIGEST_SIZE);
+    memset(vBlock, 0, SHA256_DIGEST_SIZE);
+}
+
+void SHA256::processBlock(const unsigned char* pBlock)
+{
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = (static_cast<uint32_t>(pBlock[i * 4])     << 24) |
+               (static_cast<uint32_t>(pBlock[i * 4 + 1]) << 16) |
+               (static_cast<uint32_t>(pBlock[i * 4 + 2]) << 8)  |
+                static_cast<uint32_t>(pBlock[i * 4 + 3]);
+    }
+
+    for (int i = 16; i < 64; i++)
+    {
+        const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19)  ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+
+    uint32_t a = vState[0];
+    uint32_t b = vState[1];
+    uint32_t c = vState[2];
+    uint32_t d = vState[3];
+    uint32_t e = vState[4];
+    uint32_t f = vState[5];
+    uint32_t g = vState[6];
+    uint32_t h = vState[7];
+
+    for (int i = 0; i < 64; i++)
+    {
+        const uint32_t S1    = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+        const uint32_t ch    = (e & f) ^ (~e & g);
+        const uint32_t temp1 = h + S1 + ch + vRoundConstants[i] + w[i];
+        const uint32_t S0    = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+        const uint32_t maj   = (a & b) ^ (a & c) ^ (b & c);
+        const uint32_t temp2 = S0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    vState[0] += a;
+    vState[1] += b;
+    vState[2] += c;
+    vState[3] += d;
+    vState[4] += e;
+    vState[5] += f;
+    vState[6] += g;
+    vState[7] += h;
+}
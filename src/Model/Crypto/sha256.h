@@ -0,0 +1,66 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <cstdint>
+#include <cstddef>
+
+
+#define SHA256_DIGEST_SIZE  32
+#define SHA256_BLOCK_SIZE   64
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// SHA-256 (FIPS 180-4) with HMAC (RFC 2104) and HKDF (RFC 5869) on top of it.
+
+class SHA256
+{
+
+public:
+
+    SHA256();
+
+
+    void         update  (const unsigned char* pData, size_t iSize);
+    void         finish  (unsigned char* pOutDigest);
+
+
+    // pOutDigest must have room for SHA256_DIGEST_SIZE bytes.
+
+    static void  hash    (const unsigned char* pData, size_t iSize, unsigned char* pOutDigest);
+
+    static void  hmac    (const unsigned char* pKey,  size_t iKeySize,
+                          const unsigned char* pData, size_t iDataSize,
+                          unsigned char* pOutDigest);
+
+
+    // Extract-then-expand key derivation, iOutSize must not exceed 255 * SHA256_DIGEST_SIZE.
+
+    static void  hkdf    (const unsigned char* pSalt, size_t iSaltSize,
+                          const unsigned char* pInputKey, size_t iInputKeySize,
+                          const unsigned char* pInfo, size_t iInfoSize,
+                          unsigned char* pOutKey, size_t iOutSize);
+
+private:
+
+    void         processBlock (const unsigned char* pBlock);
+
+
+    // ---------------------------------------
+
+
+    uint32_t      vState[8];
+    unsigned char vBuffer[SHA256_BLOCK_SIZE];
+
+    uint64_t      iTotalSize;
+    size_t        iBufferSize;
+};
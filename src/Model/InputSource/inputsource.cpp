@@ -0,0 +1,181 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "inputsource.h"
+
+
+// STL
+#include <algorithm>
+
+// Custom
+#include "Model/InputSource/windowshookinputsource.h"
+#include "Model/InputSource/scriptedinputsource.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+InputSource* InputSource::create(INPUT_SOURCE_TYPE sourceType)
+{
+    switch (sourceType)
+    {
+    case(IST_DEFAULT):
+    {
+#ifdef _WIN32
+        return new WindowsHookInputSource();
+#else
+        return new ScriptedInputSource();
+#endif
+    }
+    case(IST_WINDOWS_HOOK):
+    {
+#ifdef _WIN32
+        return new WindowsHookInputSource();
+#else
+        return nullptr;
+#endif
+    }
+    case(IST_SCRIPTED):
+    {
+        return new ScriptedInputSource();
+    }
+    }
+
+    return nullptr;
+}
+
+bool InputSource::start(const std::vector<int>& vKeys, std::string& sErrorText)
+{
+    mtxEvents.lock();
+
+    vWatchedKeys = vKeys;
+    vDownKeys.clear();
+    events.clear();
+
+    bStarted = true;
+
+    mtxEvents.unlock();
+
+
+    if ( startWatching(sErrorText) )
+    {
+        mtxEvents.lock();
+        bStarted = false;
+        mtxEvents.unlock();
+
+        return true;
+    }
+
+    return false;
+}
+
+void InputSource::stop()
+{
+    stopWatching();
+
+
+    mtxEvents.lock();
+
+    bStarted = false;
+
+    vDownKeys.clear();
+    events.clear();
+
+    mtxEvents.unlock();
+
+    cvEvents.notify_all();
+}
+
+bool InputSource::waitForEvent(InputEvent& event)
+{
+    std::unique_lock<std::mutex> lock(mtxEvents);
+
+    cvEvents.wait(lock, [this]() { return (bStarted == false) || (events.empty() == false); });
+
+    if (events.empty())
+    {
+        return false;
+    }
+
+    event = events.front();
+    events.pop_front();
+
+    return true;
+}
+
+bool InputSource::popEvent(InputEvent& event)
+{
+    std::lock_guard<std::mutex> lock(mtxEvents);
+
+    if (events.empty())
+    {
+        return false;
+    }
+
+    event = events.front();
+    events.pop_front();
+
+    return true;
+}
+
+bool InputSource::isKeyDown(int iKey)
+{
+    std::lock_guard<std::mutex> lock(mtxEvents);
+
+    return std::find(vDownKeys.begin(), vDownKeys.end(), iKey) != vDownKeys.end();
+}
+
+std::vector<int> InputSource::getWatchedKeys()
+{
+    std::lock_guard<std::mutex> lock(mtxEvents);
+
+    return vWatchedKeys;
+}
+
+void InputSource::pushEdge(int iKey, bool bDown, std::chrono::steady_clock::time_point time)
+{
+    std::unique_lock<std::mutex> lock(mtxEvents);
+
+    if ( (bStarted == false) || (std::find(vWatchedKeys.begin(), vWatchedKeys.end(), iKey) == vWatchedKeys.end()) )
+    {
+        return;
+    }
+
+    std::vector<int>::iterator downIt = std::find(vDownKeys.begin(), vDownKeys.end(), iKey);
+
+    if (bDown)
+    {
+        if (downIt != vDownKeys.end())
+        {
+            // Auto-repeat.
+            return;
+        }
+
+        vDownKeys.push_back(iKey);
+    }
+    else
+    {
+        if (downIt == vDownKeys.end())
+        {
+            return;
+        }
+
+        vDownKeys.erase(downIt);
+    }
+
+
+    InputEvent event;
+    event.time  = time;
+    event.iKey  = iKey;
+    event.bDown = bDown;
+
+    events.push_back(event);
+
+    lock.unlock();
+
+    cvEvents.notify_one();
+}
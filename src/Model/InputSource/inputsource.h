@@ -0,0 +1,114 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+
+enum INPUT_SOURCE_TYPE
+{
+    IST_DEFAULT             = 0,  // low-level hooks on Windows, scripted otherwise
+    IST_WINDOWS_HOOK        = 1,
+    IST_SCRIPTED            = 2
+};
+
+
+// A key (or a mouse button) went down or up.
+// Keys are Windows virtual-key codes (as in SettingsFile::iPushToTalkButton).
+
+struct InputEvent
+{
+    std::chrono::steady_clock::time_point time;  // when the source saw the change
+
+    int                iKey  = 0;
+    bool               bDown = false;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Delivers key-down and key-up edges of the watched keys as they happen,
+// so that the audio thread does not have to poll the keyboard.
+// The events are queued until they are taken by waitForEvent()/popEvent() (one consumer).
+// Functions that return bool return true if failed (except the event functions).
+
+class InputSource
+{
+
+public:
+
+    // Returns nullptr if this source is not available in this build.
+
+    static InputSource*  create                  (INPUT_SOURCE_TYPE sourceType = IST_DEFAULT);
+
+
+    virtual ~InputSource() = default;
+
+
+    virtual std::string  getName                 () const = 0;
+
+
+    // Starts watching these keys (drops the events and the key states from before).
+    // The keys that are already down when started are reported as pressed after the first edge.
+
+    bool                 start                   (const std::vector<int>& vKeys, std::string& sErrorText);
+
+    // Stops watching and wakes up waitForEvent().
+
+    void                 stop                    ();
+
+
+    // Waits for the next event.
+    // Returns false if stopped (or stop() was called while waiting).
+
+    bool                 waitForEvent            (InputEvent& event);
+
+    // Returns false if there are no events right now.
+
+    bool                 popEvent                (InputEvent& event);
+
+
+    // State after the last edge that the source saw (not the last event that was taken).
+
+    bool                 isKeyDown               (int iKey);
+
+protected:
+
+    virtual bool         startWatching           (std::string& sErrorText) = 0;
+
+    virtual void         stopWatching            () = 0;
+
+
+    // Called by the implementations (from any thread).
+    // Repeated key-downs (auto-repeat) and ups of keys that are not down are ignored.
+
+    void                 pushEdge                (int iKey, bool bDown, std::chrono::steady_clock::time_point time);
+
+    std::vector<int>     getWatchedKeys          ();
+
+private:
+
+    std::mutex              mtxEvents;
+    std::condition_variable cvEvents;
+
+    std::deque<InputEvent>  events;
+
+    std::vector<int>        vWatchedKeys;
+    std::vector<int>        vDownKeys;
+
+
+    bool                    bStarted = false;
+};
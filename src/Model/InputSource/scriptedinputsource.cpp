@@ -0,0 +1,93 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "scriptedinputsource.h"
+
+
+ScriptedInputSource::~ScriptedInputSource()
+{
+    stopWatching();
+}
+
+std::string ScriptedInputSource::getName() const
+{
+    return "Scripted";
+}
+
+void ScriptedInputSource::setScript(const std::vector<ScriptedInputStep>& vSteps)
+{
+    std::lock_guard<std::mutex> lock(mtxScript);
+
+    this->vSteps = vSteps;
+}
+
+void ScriptedInputSource::waitForScriptEnd()
+{
+    if (scriptThread.joinable())
+    {
+        scriptThread.join();
+    }
+}
+
+void ScriptedInputSource::pressKey(int iKey)
+{
+    pushEdge(iKey, true, std::chrono::steady_clock::now());
+}
+
+void ScriptedInputSource::releaseKey(int iKey)
+{
+    pushEdge(iKey, false, std::chrono::steady_clock::now());
+}
+
+bool ScriptedInputSource::startWatching(std::string& sErrorText)
+{
+    (void)sErrorText;
+
+    stopWatching();
+
+    mtxScript.lock();
+    bStopScript = false;
+    mtxScript.unlock();
+
+    if (vSteps.empty() == false)
+    {
+        scriptThread = std::thread(&ScriptedInputSource::playScript, this);
+    }
+
+    return false;
+}
+
+void ScriptedInputSource::stopWatching()
+{
+    mtxScript.lock();
+    bStopScript = true;
+    mtxScript.unlock();
+
+    cvScript.notify_all();
+
+    if (scriptThread.joinable())
+    {
+        scriptThread.join();
+    }
+}
+
+void ScriptedInputSource::playScript()
+{
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mtxScript);
+
+    for (size_t i = 0; i < vSteps.size(); i++)
+    {
+        const std::chrono::steady_clock::time_point stepTime = startTime + std::chrono::milliseconds(vSteps[i].iAtMs);
+
+        if ( cvScript.wait_until(lock, stepTime, [this]() { return bStopScript; }) )
+        {
+            return;
+        }
+
+        pushEdge(vSteps[i].iKey, vSteps[i].bDown, std::chrono::steady_clock::now());
+    }
+}
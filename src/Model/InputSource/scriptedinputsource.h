@@ -0,0 +1,78 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <thread>
+
+// Custom
+#include "Model/InputSource/inputsource.h"
+
+
+struct ScriptedInputStep
+{
+    int                iAtMs = 0;  // since start()
+    int                iKey  = 0;
+    bool               bDown = false;
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// No real keyboard: the edges come from a script (played on its own thread after start())
+// or from pressKey()/releaseKey(). For benchmarks and for builds without a keyboard hook.
+
+class ScriptedInputSource : public InputSource
+{
+
+public:
+
+    ScriptedInputSource() = default;
+    ~ScriptedInputSource() override;
+
+
+    std::string  getName                 () const override;
+
+
+    // Used by the next start(), the steps must be sorted by iAtMs.
+
+    void         setScript               (const std::vector<ScriptedInputStep>& vSteps);
+
+    // Waits until the script is played (or stopped).
+
+    void         waitForScriptEnd        ();
+
+
+    // From the calling thread, right now.
+
+    void         pressKey                (int iKey);
+
+    void         releaseKey              (int iKey);
+
+protected:
+
+    bool         startWatching           (std::string& sErrorText) override;
+
+    void         stopWatching            () override;
+
+private:
+
+    void         playScript              ();
+
+
+    std::vector<ScriptedInputStep> vSteps;
+
+    std::thread             scriptThread;
+
+    std::mutex              mtxScript;
+    std::condition_variable cvScript;
+
+    bool                    bStopScript = false;
+};
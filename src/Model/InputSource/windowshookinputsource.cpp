@@ -0,0 +1,230 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "windowshookinputsource.h"
+
+
+#ifdef _WIN32
+
+
+// STL
+#include <future>
+
+// Other
+#define _WINSOCKAPI_    // stops windows.h from including winsock.h
+#include <Windows.h>
+
+
+// for SetWindowsHookEx
+#pragma comment(lib, "user32.lib")
+
+
+namespace
+{
+    // The hooks are called on the thread that installed them.
+    thread_local WindowsHookInputSource* pHookThreadSource = nullptr;
+
+
+    // The settings store the keys as GetAsyncKeyState() wants them (VK_MENU, not VK_LMENU).
+
+    int toSettingsKey(DWORD iVirtualKey)
+    {
+        switch (iVirtualKey)
+        {
+        case(VK_LSHIFT):
+        case(VK_RSHIFT):
+            return VK_SHIFT;
+        case(VK_LCONTROL):
+        case(VK_RCONTROL):
+            return VK_CONTROL;
+        case(VK_LMENU):
+        case(VK_RMENU):
+            return VK_MENU;
+        default:
+            return static_cast<int>(iVirtualKey);
+        }
+    }
+
+    bool isMouseButton(int iKey)
+    {
+        return (iKey == VK_LBUTTON) || (iKey == VK_RBUTTON) || (iKey == VK_MBUTTON) || (iKey == VK_XBUTTON1) || (iKey == VK_XBUTTON2);
+    }
+}
+
+
+// Gives the hooks access to pushEdge().
+
+class WindowsHookInputSourceAccess
+{
+
+public:
+
+    static LRESULT CALLBACK keyboardHook(int iCode, WPARAM wParam, LPARAM lParam)
+    {
+        if ( (iCode == HC_ACTION) && pHookThreadSource )
+        {
+            const KBDLLHOOKSTRUCT* pInfo = reinterpret_cast<const KBDLLHOOKSTRUCT*>(lParam);
+
+            const bool bDown = (wParam == WM_KEYDOWN) || (wParam == WM_SYSKEYDOWN);
+
+            pHookThreadSource->pushEdge( toSettingsKey(pInfo->vkCode), bDown, std::chrono::steady_clock::now() );
+        }
+
+        return CallNextHookEx(nullptr, iCode, wParam, lParam);
+    }
+
+    static LRESULT CALLBACK mouseHook(int iCode, WPARAM wParam, LPARAM lParam)
+    {
+        if ( (iCode == HC_ACTION) && pHookThreadSource )
+        {
+            const MSLLHOOKSTRUCT* pInfo = reinterpret_cast<const MSLLHOOKSTRUCT*>(lParam);
+
+            int  iKey  = 0;
+            bool bDown = false;
+
+            switch (wParam)
+            {
+            case(WM_LBUTTONDOWN): iKey = VK_LBUTTON; bDown = true;  break;
+            case(WM_LBUTTONUP):   iKey = VK_LBUTTON; bDown = false; break;
+            case(WM_RBUTTONDOWN): iKey = VK_RBUTTON; bDown = true;  break;
+            case(WM_RBUTTONUP):   iKey = VK_RBUTTON; bDown = false; break;
+            case(WM_MBUTTONDOWN): iKey = VK_MBUTTON; bDown = true;  break;
+            case(WM_MBUTTONUP):   iKey = VK_MBUTTON; bDown = false; break;
+            case(WM_XBUTTONDOWN):
+            case(WM_XBUTTONUP):
+            {
+                iKey  = (HIWORD(pInfo->mouseData) == XBUTTON1) ? VK_XBUTTON1 : VK_XBUTTON2;
+                bDown = (wParam == WM_XBUTTONDOWN);
+                break;
+            }
+            default:
+                break;
+            }
+
+            if (iKey != 0)
+            {
+                pHookThreadSource->pushEdge( iKey, bDown, std::chrono::steady_clock::now() );
+            }
+        }
+
+        return CallNextHookEx(nullptr, iCode, wParam, lParam);
+    }
+};
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+WindowsHookInputSource::~WindowsHookInputSource()
+{
+    stopWatching();
+}
+
+std::string WindowsHookInputSource::getName() const
+{
+    return "Windows hook";
+}
+
+bool WindowsHookInputSource::startWatching(std::string& sErrorText)
+{
+    stopWatching();
+
+
+    bool bHookMouse = false;
+
+    for (int iKey : getWatchedKeys())
+    {
+        if (isMouseButton(iKey))
+        {
+            // Only then: every mouse move goes through a low-level mouse hook.
+            bHookMouse = true;
+        }
+    }
+
+
+    std::promise<bool> started;
+    std::future<bool>  startedResult = started.get_future();
+
+    hookThreadHandle = std::thread(&WindowsHookInputSource::hookThread, this, bHookMouse, &sErrorText, &started);
+
+    if ( startedResult.get() )
+    {
+        hookThreadHandle.join();
+
+        return true;
+    }
+
+    return false;
+}
+
+void WindowsHookInputSource::stopWatching()
+{
+    if (hookThreadHandle.joinable())
+    {
+        PostThreadMessageW(iHookThreadId, WM_QUIT, 0, 0);
+
+        hookThreadHandle.join();
+    }
+}
+
+void WindowsHookInputSource::hookThread(bool bHookMouse, std::string* pErrorText, std::promise<bool>* pStarted)
+{
+    // Creates the message queue (so that PostThreadMessage() works after we report the start).
+    MSG msg;
+    PeekMessageW(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+
+    iHookThreadId     = GetCurrentThreadId();
+    pHookThreadSource = this;
+
+
+    // The keyboard and the mouse won't wait for us (it's the whole system's input).
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+    HHOOK hKeyboardHook = SetWindowsHookExW(WH_KEYBOARD_LL, &WindowsHookInputSourceAccess::keyboardHook, GetModuleHandleW(nullptr), 0);
+    HHOOK hMouseHook    = nullptr;
+
+    if (bHookMouse && hKeyboardHook)
+    {
+        hMouseHook = SetWindowsHookExW(WH_MOUSE_LL, &WindowsHookInputSourceAccess::mouseHook, GetModuleHandleW(nullptr), 0);
+    }
+
+    if ( (hKeyboardHook == nullptr) || (bHookMouse && (hMouseHook == nullptr)) )
+    {
+        *pErrorText = "SetWindowsHookEx() failed, error: " + std::to_string(GetLastError());
+
+        if (hKeyboardHook)
+        {
+            UnhookWindowsHookEx(hKeyboardHook);
+        }
+
+        pStarted->set_value(true);
+
+        return;
+    }
+
+    pStarted->set_value(false);
+
+
+    while (GetMessageW(&msg, nullptr, 0, 0) > 0)
+    {
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+
+
+    UnhookWindowsHookEx(hKeyboardHook);
+
+    if (hMouseHook)
+    {
+        UnhookWindowsHookEx(hMouseHook);
+    }
+
+    pHookThreadSource = nullptr;
+}
+
+
+#endif // _WIN32
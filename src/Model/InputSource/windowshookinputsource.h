@@ -0,0 +1,60 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+#ifdef _WIN32
+
+
+// STL
+#include <thread>
+#include <future>
+
+// Custom
+#include "Model/InputSource/inputsource.h"
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// Low-level keyboard (and mouse, if a mouse button is watched) hooks.
+// Windows calls the hooks on our own thread (it waits in GetMessage() the rest of the time),
+// the edges come even if the window is not focused.
+
+class WindowsHookInputSource : public InputSource
+{
+
+public:
+
+    WindowsHookInputSource() = default;
+    ~WindowsHookInputSource() override;
+
+
+    std::string  getName                 () const override;
+
+protected:
+
+    bool         startWatching           (std::string& sErrorText) override;
+
+    void         stopWatching            () override;
+
+private:
+
+    friend class WindowsHookInputSourceAccess;
+
+
+    void         hookThread              (bool bHookMouse, std::string* pErrorText, std::promise<bool>* pStarted);
+
+
+    std::thread  hookThreadHandle;
+
+    unsigned long iHookThreadId = 0;
+};
+
+
+#endif // _WIN32
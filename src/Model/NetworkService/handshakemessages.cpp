@@ -0,0 +1,81 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#include "handshakemessages.h"
+
+
+// STL
+#include <cstring>
+#include <algorithm>
+
+// Custom
+#include "Model/Crypto/dhgroup.h"
+#include "Model/Crypto/sha256.h"
+#include "Model/net_params.h"
+
+
+void HandshakeMessages::appendUserInfo(std::vector<char>& vMessage, const std::string& sVersion,
+                                       const std::string& sUserName, const std::wstring& sPassword)
+{
+    vMessage.push_back( static_cast<char>(sVersion.size()) );
+    vMessage.insert(vMessage.end(), sVersion.begin(), sVersion.end());
+
+    vMessage.push_back( static_cast<char>(sUserName.size()) );
+    vMessage.insert(vMessage.end(), sUserName.begin(), sUserName.end());
+
+    // Optional.
+
+    const char* pPassword = reinterpret_cast<const char*>(sPassword.c_str());
+
+    vMessage.push_back( static_cast<char>(sPassword.size()) );
+    vMessage.insert(vMessage.end(), pPassword, pPassword + sPassword.size() * sizeof(wchar_t));
+}
+
+void HandshakeMessages::appendOpenKey(std::vector<char>& vMessage, const DHGroup* pGroup, const integer& privateKey)
+{
+    const std::string sOpenKey = pGroup->computePublicKey(privateKey).str(256, pGroup->getPrimeSizeInBytes());
+
+    const unsigned short iOpenKeySize = static_cast<unsigned short>(sOpenKey.size());
+    const char*          pOpenKeySize = reinterpret_cast<const char*>(&iOpenKeySize);
+
+    vMessage.insert(vMessage.end(), pOpenKeySize, pOpenKeySize + sizeof(iOpenKeySize));
+    vMessage.insert(vMessage.end(), sOpenKey.begin(), sOpenKey.end());
+}
+
+std::vector<char> HandshakeMessages::buildHello(const std::string& sVersion, const std::string& sUserName, const std::wstring& sPassword,
+                                                const DHGroup* pGroup, const integer& privateKey)
+{
+    std::vector<char> vHello;
+    vHello.reserve(3 + MAX_VERSION_STRING_LENGTH + MAX_NAME_LENGTH + sPassword.size() * sizeof(wchar_t)
+                   + 1 + sizeof(unsigned short) + pGroup->getPrimeSizeInBytes());
+
+    appendUserInfo(vHello, sVersion, sUserName, sPassword);
+
+    vHello.push_back( pGroup->getGroupId() );
+
+    appendOpenKey(vHello, pGroup, privateKey);
+
+    return vHello;
+}
+
+bool HandshakeMessages::deriveSessionKey(const DHGroup* pGroup, const integer& openKeyA, const integer& privateKey,
+                                         unsigned char* pOutKey, size_t iKeySize)
+{
+    if (pGroup->isValidPublicKey(openKeyA) == false)
+    {
+        return true;
+    }
+
+    std::string sSecret = pGroup->computeSharedSecret(openKeyA, privateKey).str(256, pGroup->getPrimeSizeInBytes());
+
+    SHA256::hkdf(nullptr, 0,
+                 reinterpret_cast<const unsigned char*>(sSecret.c_str()), sSecret.size(),
+                 reinterpret_cast<const unsigned char*>(DH_KDF_INFO), strlen(DH_KDF_INFO),
+                 pOutKey, iKeySize);
+
+    std::fill(sSecret.begin(), sSecret.end(), '\0');
+
+    return false;
+}
@@ -0,0 +1,52 @@
+﻿// This file is part of the Silent.
+// Copyright Aleksandr "Flone" Tretyakov (github.com/Flone-dnb).
+// Licensed under the ZLib license.
+// Refer to the LICENSE file included.
+
+#pragma once
+
+
+// STL
+#include <string>
+#include <vector>
+
+
+class DHGroup;
+class integer;
+
+
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------
+
+
+// The parts of the connect and rekey messages that don't depend on the socket (note: also change in server).
+// Used by NetworkService and by SilentBench (bench_connect.cpp), so the benchmark talks the same protocol.
+
+class HandshakeMessages
+{
+
+public:
+
+    // Version, user name and password, each after its size in one byte (the password size is in wchar_t).
+
+    static void              appendUserInfo   (std::vector<char>& vMessage, const std::string& sVersion,
+                                               const std::string& sUserName, const std::wstring& sPassword);
+
+    // Size of the open key (unsigned short), then g^x mod p (big-endian, padded to the size of the prime).
+
+    static void              appendOpenKey    (std::vector<char>& vMessage, const DHGroup* pGroup, const integer& privateKey);
+
+    // The first message of the client: user info, id of pGroup and our open key B, so that the server
+    // can answer with its open key A and derive the session key without another round trip.
+
+    static std::vector<char> buildHello       (const std::string& sVersion, const std::string& sUserName, const std::wstring& sPassword,
+                                               const DHGroup* pGroup, const integer& privateKey);
+
+
+    // pOutKey[iKeySize] = HKDF-SHA256(A^x mod p, DH_KDF_INFO).
+    // Returns true if the open key A is not valid in pGroup (see DHGroup::isValidPublicKey()).
+
+    static bool              deriveSessionKey (const DHGroup* pGroup, const integer& openKeyA, const integer& privateKey,
+                                               unsigned char* pOutKey, size_t iKeySize);
+};
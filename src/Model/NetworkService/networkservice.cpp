@@ -9,6 +9,7 @@
 // STL
 #include <thread>
 #include <string_view>
+#include <algorithm>
 
 
 // Sockets and stuff
@@ -28,6 +29,9 @@
 #include "View/CustomList/SListItemUser/slistitemuser.h"
 #include "View/CustomList/SListItemRoom/slistitemroom.h"
 #include "Model/User.h"
+#include "Model/Crypto/dhgroup.h"
+#include "Model/Crypto/sha256.h"
+#include "Model/NetworkService/handshakemessages.h"
 
 
 // External
@@ -72,7 +76,15 @@ enum SERVER_MESSAGE
     SM_USERMESSAGE          = 10,
     SM_KICKED               = 11,
     SM_WRONG_PASSWORD_WAIT  = 12,
-    SM_GLOBAL_MESSAGE       = 13
+    SM_GLOBAL_MESSAGE       = 13,
+    SM_REKEY                = 14  // also change in server
+};
+
+enum REKEY_MESSAGE
+{
+    RK_REQUEST              = 0,  // client -> server: new open key B
+    RK_REPLY                = 1,  // server -> client: switch sequence + new open key A
+    RK_FINISHED             = 2   // client -> server: switch sequence (client uses the new key on TCP after this)
 };
 
 enum VOICE_MESSAGE
@@ -107,6 +119,8 @@ NetworkService::NetworkService(MainWindow* pMainWindow, AudioService* pAudioServ
     this->pAudioService    = pAudioService;
     this->pSettingsManager = pSettingsManager;
     pThisUser              = nullptr;
+    pSessionGroup          = nullptr;
+    pRekeyPrivateKey       = nullptr;
 
     pAES    = new AES(128);
     pRndGen = new std::mt19937_64( std::random_device{}() );
@@ -116,15 +130,35 @@ NetworkService::NetworkService(MainWindow* pMainWindow, AudioService* pAudioServ
 
     clientVersion = CLIENT_VERSION;
 
+
+    // Build the fixed-base tables of the key exchange groups now
+    // so that they are ready when we connect.
+
+    precomputeThread = std::thread(&DHGroup::precomputeAllGroups);
+
+
     bWinSockLaunched = false;
     bTextListen      = false;
     bVoiceListen     = false;
+    bRekeyInProgress = false;
+    bVoiceSocketOpen = false;
+    lastRekeyTime    = 0;
 }
 
 NetworkService::~NetworkService()
 {
+    if (precomputeThread.joinable())
+    {
+        precomputeThread.join();
+    }
+
     delete pAES;
     delete pRndGen;
+
+    if (pRekeyPrivateKey)
+    {
+        delete pRekeyPrivateKey;
+    }
 }
 
 
@@ -196,58 +230,25 @@ void NetworkService::setupChatConnection(std::string address, std::string port,
     }
 
 
-    // Send version, user name and password.
-
-    const size_t iUserInfoBufferSize =
-            sizeof(char) +                // size of the version string
-            MAX_VERSION_STRING_LENGTH +   // version string
-            sizeof(char) +                // size of the user name
-            MAX_NAME_LENGTH +             // user name string
-            sizeof(char) +                // password string size
-            UCHAR_MAX * sizeof(wchar_t);  // password string
-
-    char vUserInfoBuffer[iUserInfoBufferSize];
-    memset(vUserInfoBuffer, 0, iUserInfoBufferSize);
-
-    char byteVariable = 0;
-    int iBufferWritePos = 0;
-
-
-
-    // Version.
+    // Send version, user name, password and our Diffie-Hellman share (open key B),
+    // so that the server can answer with its own share and derive the session key without another round trip.
 
-    byteVariable = static_cast <char> (clientVersion.size());
-    vUserInfoBuffer[iBufferWritePos] = byteVariable;
-    iBufferWritePos += sizeof(byteVariable);
+    const DHGroup* pOfferedGroup = DHGroup::getGroup(DH_PREFERRED_GROUP);
 
-    std::memcpy(vUserInfoBuffer + iBufferWritePos, clientVersion.c_str(), static_cast <size_t> (byteVariable));
-    iBufferWritePos += byteVariable;
+    integer b = pOfferedGroup->generatePrivateKey();
 
+    std::vector<char> vHello = HandshakeMessages::buildHello(clientVersion, userName, sPass, pOfferedGroup, b);
 
+    send(pThisUser->sockUserTCP, vHello.data(), static_cast<int>(vHello.size()), 0);
 
-    // User name.
 
-    byteVariable = static_cast <char> (userName.size());
-    vUserInfoBuffer[iBufferWritePos] = byteVariable;
-    iBufferWritePos += sizeof(byteVariable);
 
-    std::memcpy(vUserInfoBuffer + iBufferWritePos, userName.c_str(), static_cast <size_t> (byteVariable));
-    iBufferWritePos += byteVariable;
+    // Don't wait for the answer to start the voice connection,
+    // the server will answer our UDP "prepare" packet while we receive the room list.
 
+    pThisUser->sUserName = userName;
 
-
-    // Password (optional).
-
-    byteVariable = static_cast <char> (sPass.size());
-    vUserInfoBuffer[iBufferWritePos] = byteVariable;
-    iBufferWritePos += sizeof(byteVariable);
-
-    std::memcpy(vUserInfoBuffer + iBufferWritePos, sPass.c_str(), static_cast <size_t> (byteVariable) * sizeof(wchar_t));
-    iBufferWritePos += static_cast <size_t> (byteVariable) * sizeof(wchar_t);
-
-
-
-    send(pThisUser->sockUserTCP, vUserInfoBuffer, iBufferWritePos, 0);
+    bool bVoiceSocketReady = (setupVoiceConnection() == false);
 
 
 
@@ -272,7 +273,7 @@ void NetworkService::setupChatConnection(std::string address, std::string port,
                                  SilentMessage(false),
                                  true);
 
-        forceStop(pThisUser->sockUserTCP);
+        stopConnecting();
         return;
     }
     else if (vReadBuffer[0] == CM_SERVER_FULL)
@@ -288,7 +289,7 @@ void NetworkService::setupChatConnection(std::string address, std::string port,
                                   SilentMessage(false),
                                   true);
 
-        forceStop(pThisUser->sockUserTCP);
+        stopConnecting();
         return;
     }
     else if (vReadBuffer[0] == CM_WRONG_CLIENT)
@@ -296,6 +297,7 @@ void NetworkService::setupChatConnection(std::string address, std::string port,
         // Wrong client version.
         // Receive the supported client version.
 
+        char byteVariable = 0;
         recv(pThisUser->sockUserTCP, &byteVariable, sizeof(byteVariable), 0);
 
         char vVersionBuffer[MAX_VERSION_STRING_LENGTH + 1];
@@ -317,7 +319,7 @@ void NetworkService::setupChatConnection(std::string address, std::string port,
                                  + " if you want to connect to this server.",
                                  SilentMessage(false), true);
 
-        forceStop(pThisUser->sockUserTCP);
+        stopConnecting();
         return;
     }
     else if (vReadBuffer[0] == CM_NEED_PASSWORD)
@@ -335,11 +337,34 @@ void NetworkService::setupChatConnection(std::string address, std::string port,
                                   SilentMessage(false),
                                   true);
 
-        forceStop(pThisUser->sockUserTCP);
+        stopConnecting();
         return;
     }
     else if (vReadBuffer[0] == CM_SERVER_INFO)
     {
+        // The server's Diffie-Hellman share comes first.
+
+        if (establishSecureConnection(vReadBuffer, pOfferedGroup, b))
+        {
+            return;
+        }
+
+        b = 0;
+
+        pMainWindow->printOutput("A secure connection has been established, the data transmitted over the network is encrypted.\n",
+                                 SilentMessage(false), true);
+
+
+        // Our first UDP "prepare" packet might have reached the server before the hello
+        // (or might have been lost), now the server surely knows us (the server ignores duplicates).
+
+        if (bVoiceSocketReady)
+        {
+            sendVOIPReadyPacket();
+        }
+
+
+
         // Receive packet size.
 
         unsigned short int iPacketSize = 0;
@@ -353,6 +378,9 @@ void NetworkService::setupChatConnection(std::string address, std::string port,
             return;
         }
 
+        // Accepted, the UDP socket is closed by disconnect() from now on.
+        bVoiceSocketOpen = false;
+
         if (pWelcomeRoomMessage != nullptr)
         {
             pMainWindow->printOutput("\n-----------------------------------------------------------------------------\n",
@@ -374,7 +402,6 @@ void NetworkService::setupChatConnection(std::string address, std::string port,
 
         // Save this user.
 
-        pThisUser->sUserName = userName;
         pThisUser->pListWidgetItem = pMainWindow->addUserToRoomIndex(userName, 0);
 
         pAudioService->setupUserAudio( pThisUser );
@@ -398,12 +425,6 @@ void NetworkService::setupChatConnection(std::string address, std::string port,
 
 
 
-        // We can start voice connection.
-
-        setupVoiceConnection();
-
-
-
         // Save user name to settings.
 
         SettingsFile* pUpdatedSettings = pSettingsManager->getCurrentSettings();
@@ -425,6 +446,17 @@ void NetworkService::setupChatConnection(std::string address, std::string port,
         std::thread monitor(&NetworkService::serverMonitor, this);
         monitor.detach();
     }
+    else
+    {
+        // The connection was closed or the answer is unknown.
+
+        pMainWindow->printOutput("\nThe server did not accept the connection (answer: " + std::to_string(static_cast<int>(vReadBuffer[0]))
+                                 + ", received " + std::to_string(iReceivedSize) + " bytes).\nTry again.\n",
+                                 SilentMessage(false),
+                                 true);
+
+        stopConnecting();
+    }
 }
 
 bool NetworkService::processChatInfo(char* pReadBuffer, int iPacketSize, wchar_t*& pWelcomeRoomMessage)
@@ -435,32 +467,13 @@ bool NetworkService::processChatInfo(char* pReadBuffer, int iPacketSize, wchar_t
 
     // Receive chat info.
 
-    int iReceivedSize = recv(pThisUser->sockUserTCP, pReadBuffer, iPacketSize, 0);
+    int iReceivedSize = recv(pThisUser->sockUserTCP, pReadBuffer, iPacketSize, MSG_WAITALL);
 
-    // Don't process this data now.
-
-    pMainWindow->printOutput("Connected.\n"
-                             "You are queued to enter the server, first, the server will process everyone who entered before you.\n"
-                             "Waiting to establish a secure connection, please wait...\n",
+    pMainWindow->printOutput("Received " + std::to_string(iReceivedSize + 3) + " bytes of data from the server.\n"
+                             "Waiting to connect to the text chat...\n",
                              SilentMessage(false), true);
 
 
-    // Establish a secure connection.
-
-
-    if (establishSecureConnection(pReadBuffer))
-    {
-        return true;
-    }
-    else
-    {
-        pMainWindow->printOutput("A secure connection has been established, the data transmitted over the network is encrypted.\n"
-                                 "Received " + std::to_string(iReceivedSize + 3) + " bytes of data from the server.\n"
-                                 "Waiting to connect to the text chat...\n",
-                                 SilentMessage(false), true);
-    }
-
-
 
     // Translate socket to non-blocking mode.
 
@@ -472,7 +485,7 @@ bool NetworkService::processChatInfo(char* pReadBuffer, int iPacketSize, wchar_t
                                  + std::to_string(WSAGetLastError()) + ".\n",
                                  SilentMessage(false), true);
 
-        forceStop(pThisUser->sockUserTCP);
+        stopConnecting();
         return true;
     }
 
@@ -588,68 +601,100 @@ bool NetworkService::processChatInfo(char* pReadBuffer, int iPacketSize, wchar_t
     return false;
 }
 
-bool NetworkService::establishSecureConnection(char* pReadBuffer)
+bool NetworkService::establishSecureConnection(char* pReadBuffer, const DHGroup* pOfferedGroup, const integer& b)
 {
-    // Generate secret key.
+    // We've sent our open key B (in pOfferedGroup) with the hello.
+    // Receive the id of the Diffie-Hellman group (RFC 3526 / RFC 7919) chosen by the server.
+
+    char iGroupId = 0;
 
-#if _DEBUG || DEBUG
-    std::uniform_int_distribution<> uid(50, 100); // also change in server
-#else
-    std::uniform_int_distribution<> uid(500, 1000); // also change in server
-#endif
+    int iResult = recv(pThisUser->sockUserTCP, &iGroupId, sizeof(iGroupId), 0);
+    if (iResult <= 0)
+    {
+        // Something went wrong.
+        // Receive FIN.
 
-    int b = uid(*pRndGen);
+        if ( recv(pThisUser->sockUserTCP, pReadBuffer, sizeof(char), 0) == 0 )
+        {
+            shutdown(pThisUser->sockUserTCP, SD_SEND);
+        }
 
+        pMainWindow->printOutput("\nSomething went wrong on the server side.\n"
+                                  "Try connecting again.",
+                                  SilentMessage(false),
+                                  true);
 
-    // Receive 2 int values: p, g values.
+        stopConnecting();
 
-    char vKeyPGBuffer[sizeof(int) * 2];
-    memset(vKeyPGBuffer, 0, sizeof(int) * 2);
+        return true;
+    }
 
-    recv(pThisUser->sockUserTCP, vKeyPGBuffer, sizeof(int) * 2, 0);
+    const DHGroup* pGroup = DHGroup::getGroup(iGroupId);
+    if (pGroup == nullptr)
+    {
+        pMainWindow->printOutput("Failed to establish a secure connection: the server uses an unknown key exchange group ("
+                                 + std::to_string(static_cast<int>(iGroupId)) + ").\n",
+                                 SilentMessage(false),
+                                 true);
 
-    int p, g;
+        stopConnecting();
 
-    std::memcpy(&p, vKeyPGBuffer, sizeof(p));
-    std::memcpy(&g, vKeyPGBuffer + sizeof(p), sizeof(g));
+        return true;
+    }
 
+    const size_t iKeySize = pGroup->getPrimeSizeInBytes();
 
 
-    // Calculate the open key B.
 
-    integer B = pow(integer(g), b) % p;
+    // The server does not support the group we offered:
+    // make a new open key B in the server's group, it costs one more round trip.
 
+    const integer* pPrivateKey = &b;
+    integer        fallbackPrivateKey;
 
+    if (pGroup != pOfferedGroup)
+    {
+        fallbackPrivateKey = pGroup->generatePrivateKey();
+        pPrivateKey        = &fallbackPrivateKey;
+    }
 
-    // Receive the open key A.
 
-    size_t iMaxKeyLength = 1000; // also change in server code
-    short iStringSize = 0;
 
-    char* pOpenKeyString = new char[sizeof(iStringSize) + iMaxKeyLength + 1];
-    memset(pOpenKeyString, 0, sizeof(iStringSize) + iMaxKeyLength + 1);
+    // Receive the open key A (big-endian, padded to the size of the prime).
 
+    unsigned short iKeyStringSize = 0;
 
+    char* pOpenKeyString = new char[sizeof(iKeyStringSize) + DH_MAX_OPEN_KEY_SIZE];
+    memset(pOpenKeyString, 0, sizeof(iKeyStringSize) + DH_MAX_OPEN_KEY_SIZE);
 
-    // Receive open key A string size.
 
-    int iResult = recv(pThisUser->sockUserTCP, reinterpret_cast<char*>(&iStringSize), sizeof(iStringSize), 0);
-    if (iResult <= 0)
+    iResult = recv(pThisUser->sockUserTCP, reinterpret_cast<char*>(&iKeyStringSize), sizeof(iKeyStringSize), MSG_WAITALL);
+    if ( (iResult <= 0) || (iKeyStringSize != iKeySize) || (iKeyStringSize > DH_MAX_OPEN_KEY_SIZE) )
     {
-        // Something went wrong.
-        // Receive FIN.
+        pMainWindow->printOutput("\nFailed to establish a secure connection (wrong open key size).\n"
+                                  "Try connecting again.",
+                                  SilentMessage(false),
+                                  true);
 
-        if ( recv(pThisUser->sockUserTCP, pReadBuffer, sizeof(char), 0) == 0 )
-        {
-            shutdown(pThisUser->sockUserTCP, SD_SEND);
-        }
+        stopConnecting();
 
-        pMainWindow->printOutput("\nSomething went wrong on the server side.\n"
+        delete[] pOpenKeyString;
+
+        return true;
+    }
+
+    iResult = recv(pThisUser->sockUserTCP, pOpenKeyString, iKeyStringSize, MSG_WAITALL);
+
+    integer A(std::string(pOpenKeyString, iKeyStringSize), 256);
+
+    if ( (iResult != iKeyStringSize) || (pGroup->isValidPublicKey(A) == false) )
+    {
+        pMainWindow->printOutput("\nFailed to establish a secure connection (the server sent an invalid open key).\n"
                                   "Try connecting again.",
                                   SilentMessage(false),
                                   true);
 
-        forceStop(pThisUser->sockUserTCP);
+        stopConnecting();
 
         delete[] pOpenKeyString;
 
@@ -658,117 +703,310 @@ bool NetworkService::establishSecureConnection(char* pReadBuffer)
 
 
 
-    // Receive open key A.
+    delete[] pOpenKeyString;
+
+
+
+    // Send open key B (only if the server did not accept the one from the hello).
+
+    if (pGroup != pOfferedGroup)
+    {
+        std::vector<char> vOpenKeyB;
+        HandshakeMessages::appendOpenKey(vOpenKeyB, pGroup, fallbackPrivateKey);
+
+        send(pThisUser->sockUserTCP, vOpenKeyB.data(), static_cast<int>(vOpenKeyB.size()), 0);
+    }
 
-    recv(pThisUser->sockUserTCP, pOpenKeyString, iStringSize, 0);
 
 
-    integer A(pOpenKeyString, 10);
+    // Calculate the secret key.
+    // Derive vSecretAESKey[16] from it with HKDF-SHA256 (also change in server).
+
+    HandshakeMessages::deriveSessionKey(pGroup, A, *pPrivateKey, reinterpret_cast<unsigned char*>(vSecretAESKey), sizeof(vSecretAESKey));
 
+    fallbackPrivateKey = 0;
 
-    // Prepare to send open key B.
 
-    if (B.str().size() > iMaxKeyLength) // should not happen
+    // Voice uses the same key until the first rekey.
+
+    voiceSendKeys   .reset( reinterpret_cast<unsigned char*>(vSecretAESKey) );
+    voiceReceiveKeys.reset( reinterpret_cast<unsigned char*>(vSecretAESKey) );
+
+    pSessionGroup    = pGroup;
+
+    mtxSessionKey.lock();
+
+    if (pRekeyPrivateKey)
     {
-        pMainWindow->printOutput("Failed to establish a secure connection (client error).\nTry again.\n",
-                                 SilentMessage(false),
-                                 true);
+        // Left from the previous connection.
+        delete pRekeyPrivateKey;
+        pRekeyPrivateKey = nullptr;
+    }
 
-        forceStop(pThisUser->sockUserTCP);
+    bRekeyInProgress = false;
+    lastRekeyTime    = clock();
 
-        delete[] pOpenKeyString;
+    mtxSessionKey.unlock();
 
-        return true;
+
+    // No "finished connecting" sync here: the server derived the key before sending its answer.
+
+    return false;
+}
+
+bool NetworkService::isRekeyDue()
+{
+    // Called from serverMonitor().
+
+    std::lock_guard<std::mutex> keyLock(mtxSessionKey);
+
+    const float timeSinceRekeyInSeconds = static_cast <float> (clock() - lastRekeyTime) / CLOCKS_PER_SEC;
+
+    if (bRekeyInProgress == false)
+    {
+        return timeSinceRekeyInSeconds > REKEY_INTERVAL_SEC;
     }
 
+    if (timeSinceRekeyInSeconds <= REKEY_REPLY_TIMEOUT_SEC)
+    {
+        return false;
+    }
 
 
-    // Send open key B.
+    // The server did not answer, a late RK_REPLY will be ignored (see receiveRekey()).
 
-    iStringSize = static_cast<short>(B.str().size());
+    if (pRekeyPrivateKey)
+    {
+        delete pRekeyPrivateKey;
+        pRekeyPrivateKey = nullptr;
+    }
 
-    memset(pOpenKeyString, 0, sizeof(iStringSize) + iMaxKeyLength + 1);
+    bRekeyInProgress = false;
 
-    std::memcpy(pOpenKeyString, &iStringSize, sizeof(iStringSize));
-    std::memcpy(pOpenKeyString + sizeof(iStringSize), B.str().c_str(), B.str().size());
+    pMainWindow->printOutput("\nWARNING:\nThe server did not answer the rekey request, trying again.\n",
+                             SilentMessage(false), true);
 
-    send(pThisUser->sockUserTCP, pOpenKeyString, sizeof(iStringSize) + B.str().size(), 0);
+    return true;
+}
 
+void NetworkService::startRekey()
+{
+    // The next key is derived from the current one and a fresh DH exchange in the session's group,
+    // see receiveRekey().
 
+    if (pSessionGroup == nullptr)
+    {
+        return;
+    }
 
-    // Calculate the secret key.
-    // Save the key to vSecretAESKey[16] array.
+    // Computed before taking mtxSessionKey (the TCP sends wait for it).
+
+    integer* pNewPrivateKey = new integer( pSessionGroup->generatePrivateKey() );
+
+
+
+    // Send: SM_REKEY, RK_REQUEST, open key size, open key B.
+
+    std::vector<char> vSendBuffer = {SM_REKEY, RK_REQUEST};
+
+    HandshakeMessages::appendOpenKey(vSendBuffer, pSessionGroup, *pNewPrivateKey);
 
-    integer secret = pow(integer(A), b) % p;
 
-    if (secret.str().size() >= 16)
+    std::lock_guard<std::mutex> keyLock(mtxSessionKey);
+
+    if (pRekeyPrivateKey)
+    {
+        delete pRekeyPrivateKey;
+    }
+
+    pRekeyPrivateKey = pNewPrivateKey;
+    bRekeyInProgress = true;
+    lastRekeyTime    = clock();
+
+    if (send(pThisUser->sockUserTCP, vSendBuffer.data(), static_cast<int>(vSendBuffer.size()), 0) != static_cast<int>(vSendBuffer.size()))
     {
-        // Save only first 16 numbers.
+        // Keep the current key, try again after REKEY_INTERVAL_SEC.
 
-        std::memcpy(vSecretAESKey, secret.str().c_str(), 16);
+        delete pRekeyPrivateKey;
+        pRekeyPrivateKey = nullptr;
+
+        bRekeyInProgress = false;
     }
-    else
+}
+
+void NetworkService::receiveRekey()
+{
+    // Called from listenTCPFromServer() under mtxTCPRead.
+
+    // A short read leaves the rest of the message in the stream and every next message would be read wrong,
+    // so the connection is dropped (the same as in establishSecureConnection()).
+
+    char cRekeyMessage = 0;
+
+    int iResult = recv(pThisUser->sockUserTCP, &cRekeyMessage, sizeof(cRekeyMessage), MSG_WAITALL);
+    if (iResult != sizeof(cRekeyMessage))
     {
-        // Repeat the key until vSecretAESKey is full.
+        dropRekey();
+        lostConnection();
 
-        std::string sSecret = secret.str();
+        return;
+    }
+
+    if (cRekeyMessage != RK_REPLY)
+    {
+        // Only the client starts a rekey.
+        return;
+    }
 
-        size_t iFilledCount = 0;
-        size_t iCurrentIndex = 0;
 
-        while (iFilledCount != 16)
-        {
-            vSecretAESKey[iFilledCount] = sSecret[iCurrentIndex];
+    // Receive: server's switch sequence, open key size, open key A.
 
-            iFilledCount++;
+    uint32_t       iServerSwitchSequence = 0;
+    unsigned short iKeyStringSize        = 0;
 
-            if (iCurrentIndex == sSecret.size() - 1)
-            {
-                iCurrentIndex = 0;
-            }
-            else
-            {
-                iCurrentIndex++;
-            }
-        }
+    iResult = recv(pThisUser->sockUserTCP, reinterpret_cast<char*>(&iServerSwitchSequence), sizeof(iServerSwitchSequence), MSG_WAITALL);
+    if (iResult != sizeof(iServerSwitchSequence))
+    {
+        dropRekey();
+        lostConnection();
+
+        return;
     }
 
-    delete[] pOpenKeyString;
+    iResult = recv(pThisUser->sockUserTCP, reinterpret_cast<char*>(&iKeyStringSize), sizeof(iKeyStringSize), MSG_WAITALL);
+    if (iResult != sizeof(iKeyStringSize))
+    {
+        dropRekey();
+        lostConnection();
 
+        return;
+    }
 
+    if ( (iKeyStringSize == 0) || (iKeyStringSize > DH_MAX_OPEN_KEY_SIZE) )
+    {
+        // We don't know where this message ends.
 
-    // Sync with the server.
+        pMainWindow->printOutput("\nWARNING:\nThe server sent an invalid rekey message.\n",
+                                 SilentMessage(false), true);
 
-    // Translate socket to blocking mode.
+        dropRekey();
+        lostConnection();
 
-    u_long arg = false;
-    ioctlsocket(pThisUser->sockUserTCP, static_cast <long> (FIONBIO), &arg);
+        return;
+    }
 
-    // Send "finished connecting" message.
-    char message = 99;
-    if (send(pThisUser->sockUserTCP, &message, sizeof(message), 0) <= 0)
+    std::vector<char> vOpenKeyA(iKeyStringSize);
+
+    iResult = recv(pThisUser->sockUserTCP, vOpenKeyA.data(), iKeyStringSize, MSG_WAITALL);
+    if (iResult != iKeyStringSize)
     {
-        pMainWindow->printOutput("NetworkService::connectTo()::ioctsocket() (non-blocking mode) failed and returned: "
-                                  + std::to_string(WSAGetLastError()) + ".\n",
-                                  SilentMessage(false), true);
+        dropRekey();
+        lostConnection();
 
-        forceStop(pThisUser->sockUserTCP);
-        return true;
+        return;
     }
 
-    // Receive "finished connecting" message.
-    if (recv(pThisUser->sockUserTCP, &message, sizeof(message), 0) == 0)
+
+    // Take our private key (serverMonitor() may drop it if the reply is late, see isRekeyDue()).
+
+    integer* pPrivateKey = nullptr;
+
+    mtxSessionKey.lock();
+
+    if (bRekeyInProgress)
     {
-        pMainWindow->printOutput("NetworkService::connectTo()::recv(): "
-                                  "the server waits too long for our response and therefore closes the connection.\n",
-                                  SilentMessage(false), true);
+        pPrivateKey      = pRekeyPrivateKey;
+        pRekeyPrivateKey = nullptr;
+    }
 
-        forceStop(pThisUser->sockUserTCP);
-        return true;
+    mtxSessionKey.unlock();
+
+    if (pPrivateKey == nullptr)
+    {
+        // We did not ask for it (or gave up waiting).
+        return;
     }
 
+    integer A(std::string(vOpenKeyA.data(), vOpenKeyA.size()), 256);
 
-    return false;
+    if ( (iKeyStringSize != pSessionGroup->getPrimeSizeInBytes()) || (pSessionGroup->isValidPublicKey(A) == false) )
+    {
+        pMainWindow->printOutput("\nWARNING:\nThe server sent an invalid open key for the rekey, the session key was not changed.\n",
+                                 SilentMessage(false), true);
+
+        delete pPrivateKey;
+
+        mtxSessionKey.lock();
+        bRekeyInProgress = false;
+        mtxSessionKey.unlock();
+
+        return;
+    }
+
+
+
+    // New key = HKDF-SHA256(salt: current key, input: new DH secret) (also change in server).
+
+    std::string sSecret = pSessionGroup->computeSharedSecret(A, *pPrivateKey).str(256, pSessionGroup->getPrimeSizeInBytes());
+
+    delete pPrivateKey;
+
+
+    std::lock_guard<std::mutex> keyLock(mtxSessionKey);
+
+    unsigned char vNewKey[SESSION_KEY_SIZE];
+
+    SHA256::hkdf(reinterpret_cast<const unsigned char*>(vSecretAESKey), sizeof(vSecretAESKey),
+                 reinterpret_cast<const unsigned char*>(sSecret.c_str()), sSecret.size(),
+                 reinterpret_cast<const unsigned char*>(DH_REKEY_KDF_INFO), strlen(DH_REKEY_KDF_INFO),
+                 vNewKey, SESSION_KEY_SIZE);
+
+    std::fill(sSecret.begin(), sSecret.end(), '\0');
+
+
+
+    // Voice: both sides switch a little later at a sequence number boundary,
+    // so that packets already in flight are still decrypted with the old key and no packet waits for the rekey.
+
+    voiceReceiveKeys.scheduleSwitch(vNewKey, iServerSwitchSequence);
+
+    uint32_t iClientSwitchSequence = voiceSendKeys.peekNextSequence() + REKEY_SWITCH_MARGIN_PACKETS;
+
+    voiceSendKeys.scheduleSwitch(vNewKey, iClientSwitchSequence);
+
+
+
+    // Text: the server already uses the new key for everything after RK_REPLY,
+    // we use it for everything after RK_FINISHED.
+
+    char vFinishedBuffer[2 + sizeof(iClientSwitchSequence)];
+    vFinishedBuffer[0] = SM_REKEY;
+    vFinishedBuffer[1] = RK_FINISHED;
+    std::memcpy(vFinishedBuffer + 2, &iClientSwitchSequence, sizeof(iClientSwitchSequence));
+
+    send(pThisUser->sockUserTCP, vFinishedBuffer, sizeof(vFinishedBuffer), 0);
+
+    std::memcpy(vSecretAESKey, vNewKey, SESSION_KEY_SIZE);
+    memset(vNewKey, 0, SESSION_KEY_SIZE);
+
+
+    bRekeyInProgress = false;
+    lastRekeyTime    = clock();
+}
+
+void NetworkService::dropRekey()
+{
+    // Keep the current key.
+
+    std::lock_guard<std::mutex> keyLock(mtxSessionKey);
+
+    if (pRekeyPrivateKey)
+    {
+        delete pRekeyPrivateKey;
+        pRekeyPrivateKey = nullptr;
+    }
+
+    bRekeyInProgress = false;
 }
 
 void NetworkService::eraseDisconnectedUser(std::string sUserName, char cDisconnectType)
@@ -940,6 +1178,8 @@ void NetworkService::connectTo(std::string address, std::string port, std::strin
 
     // Connect.
 
+    connectStartTime = std::chrono::steady_clock::now();
+
     returnCode = connect(pThisUser->sockUserTCP, result->ai_addr, result->ai_addrlen);
 
     freeaddrinfo(result);
@@ -981,7 +1221,7 @@ void NetworkService::connectTo(std::string address, std::string port, std::strin
     }
 }
 
-void NetworkService::setupVoiceConnection()
+bool NetworkService::setupVoiceConnection()
 {
     // Create UDP socket
 
@@ -994,7 +1234,7 @@ void NetworkService::setupVoiceConnection()
                                   + std::to_string(WSAGetLastError()),
                                   SilentMessage(false),
                                   true );
-        return;
+        return true;
     }
     else
     {
@@ -1013,11 +1253,11 @@ void NetworkService::setupVoiceConnection()
 
             closesocket(pThisUser->sockUserUDP);
 
-            return;
+            return true;
         }
         else
         {
-            if ( sendVOIPReadyPacket() ) return;
+            if ( sendVOIPReadyPacket() ) return true;
 
             // Translate socket to non-blocking mode
 
@@ -1033,10 +1273,14 @@ void NetworkService::setupVoiceConnection()
 
                 closesocket(pThisUser->sockUserUDP);
 
-                return;
+                return true;
             }
+
+            bVoiceSocketOpen = true;
         }
     }
+
+    return false;
 }
 
 void NetworkService::serverMonitor()
@@ -1055,6 +1299,14 @@ void NetworkService::serverMonitor()
             return;
         }
 
+
+        // Renew the session key from time to time (and start again if the server did not answer).
+
+        if ( bVoiceListen && isRekeyDue() )
+        {
+            startRekey();
+        }
+
         std::this_thread::sleep_for( std::chrono::milliseconds(CHECK_IF_SERVER_DIED_EVERY_MS) );
 
     } while (bTextListen);
@@ -1124,6 +1376,7 @@ bool NetworkService::sendVOIPReadyPacket()
                                       true );
 
             closesocket(pThisUser->sockUserUDP);
+            bVoiceSocketOpen = false;
 
             return true;
         }
@@ -1136,6 +1389,7 @@ bool NetworkService::sendVOIPReadyPacket()
                                       SilentMessage(false), true );
 
             closesocket(pThisUser->sockUserUDP);
+            bVoiceSocketOpen = false;
 
             return true;
         }
@@ -1242,6 +1496,12 @@ void NetworkService::listenTCPFromServer()
 
                     break;
                 }
+                case(SM_REKEY):
+                {
+                    receiveRekey();
+
+                    break;
+                }
                 case(RC_CAN_ENTER_ROOM):
                 {
                     canMoveToRoom();
@@ -1328,7 +1588,9 @@ void NetworkService::listenUDPFromServer()
 
     if ( pAudioService->start() )
     {
-        pMainWindow->printOutput( "Connected to the voice chat.\n",
+        long long iTimeToVoiceMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - connectStartTime).count();
+
+        pMainWindow->printOutput( "Connected to the voice chat (" + std::to_string(iTimeToVoiceMs) + " ms after connect).\n",
                                   SilentMessage(false),
                                   true );
         bVoiceListen = true;
@@ -1390,12 +1652,18 @@ void NetworkService::listenUDPFromServer()
 
     char readBuffer[MAX_BUFFER_SIZE + 60];
 
+    // The voice is decrypted here (a whole AES block past the received bytes), then the mixer copies it to the speaker's ring.
+    alignas(short) unsigned char vDecryptedBuffer[MAX_BUFFER_SIZE + 60 + 16];
+
     while (bVoiceListen)
     {
         int iSize = recv(pThisUser->sockUserUDP, readBuffer, MAX_BUFFER_SIZE + 60, 0);
 
         while (iSize > 0)
         {
+            VoiceTimestamps timestamps;
+            timestamps.mark(VLP_RECEIVED);
+
             mtxUDPRead.lock();
 
             if ( (readBuffer[0] == UDP_SM_PING || readBuffer[0] == UDP_SM_FIRST_PING) && (bVoiceListen) )
@@ -1431,9 +1699,7 @@ void NetworkService::listenUDPFromServer()
                 {
                     // Last audio packet.
 
-                    std::thread lastVoiceThread(&AudioService::playAudioData, pAudioService, nullptr,
-                                                std::string(userNameBuffer), true);
-                    lastVoiceThread.detach();
+                    pAudioService->playAudioData(nullptr, std::string(userNameBuffer), true);
                 }
                 else
                 {
@@ -1442,32 +1708,40 @@ void NetworkService::listenUDPFromServer()
 
                     // Decrypt message.
 
+                    uint32_t       iSequence             = 0;
                     unsigned short iEncryptedMessageSize = 0;
 
                     int iCurrentReadIndex = 1 + readBuffer[0] + 1;
 
+                    std::memcpy(&iSequence, readBuffer + iCurrentReadIndex, sizeof(iSequence));
+                    iCurrentReadIndex += sizeof(iSequence);
+
                     std::memcpy(&iEncryptedMessageSize, readBuffer + iCurrentReadIndex, sizeof(iEncryptedMessageSize));
                     iCurrentReadIndex += sizeof(iEncryptedMessageSize);
 
 
-                    char* pEncryptedMessageBytes = new char[iEncryptedMessageSize];
-                    memset(pEncryptedMessageBytes, 0, iEncryptedMessageSize);
+                    // Packets sent before the server's switch sequence still use the old key.
 
-                    std::memcpy(pEncryptedMessageBytes, readBuffer + iCurrentReadIndex, iEncryptedMessageSize);
+                    unsigned char vVoiceKey[SESSION_KEY_SIZE];
+                    voiceReceiveKeys.getKeyForSequence(iSequence, vVoiceKey);
 
-                    unsigned char* pDecryptedMessageBytes = pAES->DecryptECB(reinterpret_cast<unsigned char*>(pEncryptedMessageBytes), iEncryptedMessageSize,
-                                                                             reinterpret_cast<unsigned char*>(vSecretAESKey));
 
+                    const size_t iPacketSizeInBytes = static_cast<size_t>(pAudioService->getAudioPacketSizeInSamples()) * 2;
 
-                    short int* pAudio = new short int[ static_cast<size_t>(pAudioService->getAudioPacketSizeInSamples()) ];
-                    std::memcpy( pAudio, pDecryptedMessageBytes, static_cast<size_t>(pAudioService->getAudioPacketSizeInSamples()) * 2 );
+                    // Broken packets are skipped, and the packets of the speakers that are not mixed now (too many talk at once).
 
-                    std::thread voiceThread(&AudioService::playAudioData, pAudioService, pAudio,
-                                            std::string(userNameBuffer), false);
-                    voiceThread.detach();
+                    if ( (iCurrentReadIndex + iEncryptedMessageSize <= iSize) && (iEncryptedMessageSize >= iPacketSizeInBytes)
+                         && (pAudioService->skipAudioData(std::string(userNameBuffer)) == false) )
+                    {
+                        pAES->DecryptECB(reinterpret_cast<unsigned char*>(readBuffer + iCurrentReadIndex), iEncryptedMessageSize,
+                                         vVoiceKey, vDecryptedBuffer);
+
+                        timestamps.mark(VLP_DECRYPTED);
 
-                    delete[] pEncryptedMessageBytes;
-                    delete[] pDecryptedMessageBytes;
+                        // Not in a new thread so the packets of one user are queued in the order they came.
+
+                        pAudioService->playAudioData(reinterpret_cast<short*>(vDecryptedBuffer), std::string(userNameBuffer), false, timestamps);
+                    }
                 }
             }
 
@@ -1789,6 +2063,9 @@ void NetworkService::sendMessage(std::wstring message)
 
 
     // Encrypt message.
+    // Hold the key until the message is sent, so that a rekey can't switch it in between.
+
+    std::lock_guard<std::mutex> keyLock(mtxSessionKey);
 
     char* pRawMessage = new char[message.length() * 2 + 1];
     memset(pRawMessage, 0, message.length() * 2 + 1);
@@ -1936,12 +2213,17 @@ void NetworkService::sendVoiceMessage(char *pVoiceMessage, int iMessageSize, boo
 
 
 
-            // Encrypt voice message.
+            // Encrypt voice message (with the key for this sequence number, see startRekey()).
+
+            uint32_t iSequence = voiceSendKeys.getNextSequence();
+
+            unsigned char vVoiceKey[SESSION_KEY_SIZE];
+            voiceSendKeys.getKeyForSequence(iSequence, vVoiceKey);
 
             unsigned int iEncryptedMessageSize = 0;
             unsigned char* pEncryptedMessageBytes = pAES->EncryptECB(reinterpret_cast<unsigned char*>(pVoiceMessage),
                                                                      static_cast<unsigned int>(iMessageSize),
-                                                                     reinterpret_cast<unsigned char*>(vSecretAESKey),
+                                                                     vVoiceKey,
                                                                      iEncryptedMessageSize);
 
             unsigned short iEncryptedDataSize = static_cast<unsigned short>(iEncryptedMessageSize);
@@ -1949,11 +2231,19 @@ void NetworkService::sendVoiceMessage(char *pVoiceMessage, int iMessageSize, boo
 
 
             // Send to the server.
+            // Format: type, sequence, size, data (also change in server).
+
+            int iWritePos = 1;
+
+            std::memcpy(vSend + iWritePos, &iSequence, sizeof(iSequence));
+            iWritePos += sizeof(iSequence);
 
-            std::memcpy(vSend + 1, &iEncryptedDataSize, sizeof(iEncryptedDataSize));
-            std::memcpy(vSend + 1 + sizeof(iEncryptedDataSize), pEncryptedMessageBytes, iEncryptedDataSize);
+            std::memcpy(vSend + iWritePos, &iEncryptedDataSize, sizeof(iEncryptedDataSize));
+            iWritePos += sizeof(iEncryptedDataSize);
 
-            iMessageSize = 1 + sizeof(iEncryptedDataSize) + iEncryptedDataSize;
+            std::memcpy(vSend + iWritePos, pEncryptedMessageBytes, iEncryptedDataSize);
+
+            iMessageSize = iWritePos + iEncryptedDataSize;
 
             iSize = sendto(pThisUser->sockUserUDP, vSend, iMessageSize, 0,
                            reinterpret_cast<sockaddr*>(&pThisUser->addrServer), sizeof(pThisUser->addrServer));
@@ -1992,11 +2282,6 @@ void NetworkService::sendVoiceMessage(char *pVoiceMessage, int iMessageSize, boo
             }
         }
     }
-
-    if (pVoiceMessage)
-    {
-        delete[] pVoiceMessage;
-    }
 }
 
 void NetworkService::disconnect()
@@ -2143,6 +2428,8 @@ void NetworkService::lostConnection()
     {
         bVoiceListen = false;
         closesocket(pThisUser->sockUserUDP);
+        // stop() keeps the mixer, so the sound is played to the end
+        // (and the mixer waits for it if it's deleted, see ~AudioMixer()).
         pAudioService->playLostConnectionSound();
         pAudioService->stop();
     }
@@ -2282,6 +2569,20 @@ void NetworkService::cleanUp()
     mtxOtherUsers.unlock();
 }
 
+void NetworkService::stopConnecting()
+{
+    // The UDP socket is opened before the server accepts us (see setupChatConnection()).
+
+    if (bVoiceSocketOpen)
+    {
+        closesocket(pThisUser->sockUserUDP);
+
+        bVoiceSocketOpen = false;
+    }
+
+    forceStop(pThisUser->sockUserTCP);
+}
+
 void NetworkService::forceStop(UINT_PTR socketToStop)
 {
     if (socketToStop != 0)
@@ -11,11 +11,16 @@
 #include <vector>
 #include <ctime>
 #include <mutex>
+#include <thread>
 #include <random>
+#include <chrono>
 
 // Other
 #include "basetsd.h"
 
+// Custom
+#include "Model/Crypto/keyschedule.h"
+
 
 class MainWindow;
 class AudioService;
@@ -25,6 +30,8 @@ class User;
 class SListItemRoom;
 
 class AES;
+class DHGroup;
+class integer;
 
 
 
@@ -96,7 +103,15 @@ private:
 
         void  setupChatConnection              (std::string address, std::string port, std::string userName, std::wstring sPass = L"");
         bool  processChatInfo                  (char* pReadBuffer, int iPacketSize, wchar_t*& pWelcomeRoomMessage);
-        bool  establishSecureConnection        (char* pReadBuffer);
+        bool  establishSecureConnection        (char* pReadBuffer, const DHGroup* pOfferedGroup, const integer& b);
+
+
+    // Session rekey
+
+        bool  isRekeyDue                       ();
+        void  startRekey                       ();
+        void  receiveRekey                     ();
+        void  dropRekey                        ();
 
 
     // Receive
@@ -113,6 +128,7 @@ private:
         void  clearWinsockAndThisUser          ();
         void  cleanUp                          ();
         void  forceStop                        (UINT_PTR socketToStop = 0);
+        void  stopConnecting                   ();
 
 
     // Checks if the server is dead.
@@ -137,7 +153,7 @@ private:
 
     // VOIP
 
-        void setupVoiceConnection              ();
+        bool setupVoiceConnection              ();
         bool sendVOIPReadyPacket               ();
 
 
@@ -151,25 +167,37 @@ private:
     User*              pThisUser;
     AES*               pAES;
     std::mt19937_64*   pRndGen;
+    const DHGroup*     pSessionGroup;
+    integer*           pRekeyPrivateKey;  // under mtxSessionKey
 
 
     std::vector<User*> vOtherUsers;
 
 
+    std::thread        precomputeThread;  // DHGroup::precomputeAllGroups(), joined in the destructor
+
+
     std::mutex         mtxOtherUsers;
     std::mutex         mtxTCPRead;
     std::mutex         mtxUDPRead;
     std::mutex         mtxRooms;
+    std::mutex         mtxSessionKey;  // vSecretAESKey, the rekey state and sends on the TCP socket during a rekey
 
 
     clock_t            lastTimeServerKeepAliveCame;
+    clock_t            lastRekeyTime;  // under mtxSessionKey (when the last rekey was started or finished)
+    std::chrono::steady_clock::time_point connectStartTime;
 
 
     std::string        clientVersion;
-    char               vSecretAESKey[16];
+    char               vSecretAESKey[16];  // text messages (TCP)
+    KeySchedule        voiceSendKeys;
+    KeySchedule        voiceReceiveKeys;
 
 
     bool               bWinSockLaunched;
     bool               bTextListen;
     bool               bVoiceListen;
+    bool               bRekeyInProgress;  // under mtxSessionKey
+    bool               bVoiceSocketOpen;  // from setupVoiceConnection() until the server accepts us or stopConnecting()
 };
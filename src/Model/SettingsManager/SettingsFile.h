@@ -10,7 +10,7 @@
 #include <string>
 
 #define SILENT_MAGIC_NUMBER 51337
-#define SILENT_SETTINGS_FILE_VERSION 2
+#define SILENT_SETTINGS_FILE_VERSION 10
 
 class SettingsFile
 {
@@ -33,7 +33,16 @@ public:
                  bool bPlayTextMessageSound       = true,
                  bool bPlayConnectDisconnectSound = true,
                  bool bShowConnectDisconnectMessage = true,
-                 int iMuteMicrophoneButton = 0)
+                 int iMuteMicrophoneButton = 0,
+                 int iCaptureBufferCount   = 4     /* AUDIO_CAPTURE_BUFFER_COUNT */,
+                 int iVoiceHangoverMs      = 250   /* VAD_DEFAULT_HANGOVER_MS */,
+                 bool bNoiseSuppression    = false,
+                 bool bAutomaticGainControl = false,
+                 int iAGCTargetDBFS        = -20   /* AGC_DEFAULT_TARGET_DBFS */,
+                 unsigned int iDeviceSampleRate = 48000 /* AUDIO_DEVICE_SAMPLE_RATE */,
+                 int iPushToTalkPreRollMs  = 0,
+                 int iMaxSpeakersInMix     = 4     /* AUDIO_MIXER_DEFAULT_MAX_SPEAKERS */,
+                 int iSessionRecording     = 0     /* SRM_OFF */)
     {
         this->iPushToTalkButton    = iPushToTalkButton;
         this->iMasterVolume        = iMasterVolume;
@@ -52,6 +61,15 @@ public:
         this->bPlayConnectDisconnectSound = bPlayConnectDisconnectSound;
         this->bShowConnectDisconnectMessage = bShowConnectDisconnectMessage;
         this->iMuteMicrophoneButton = iMuteMicrophoneButton;
+        this->iCaptureBufferCount = iCaptureBufferCount;
+        this->iVoiceHangoverMs    = iVoiceHangoverMs;
+        this->bNoiseSuppression   = bNoiseSuppression;
+        this->bAutomaticGainControl = bAutomaticGainControl;
+        this->iAGCTargetDBFS      = iAGCTargetDBFS;
+        this->iDeviceSampleRate   = iDeviceSampleRate;
+        this->iPushToTalkPreRollMs = iPushToTalkPreRollMs;
+        this->iMaxSpeakersInMix   = iMaxSpeakersInMix;
+        this->iSessionRecording   = iSessionRecording;
     }
 
 
@@ -134,7 +152,14 @@ public:
     int                iInputVolumeMultiplier;
     int                iVoiceStartRecValueInDBFS;
     int                iMuteMicrophoneButton;
+    int                iCaptureBufferCount;
+    int                iVoiceHangoverMs;
+    int                iAGCTargetDBFS;
+    int                iPushToTalkPreRollMs;  // 0 - the microphone is started on the button press
+    int                iMaxSpeakersInMix;     // 0 - everyone is heard
+    int                iSessionRecording;     // SESSION_RECORDING_MODE
     unsigned short int iMasterVolume;
+    unsigned int       iDeviceSampleRate;  // 0 - the system converts
 
 
     unsigned short int iPort;
@@ -146,4 +171,6 @@ public:
     bool               bPlayTextMessageSound;
     bool               bPlayConnectDisconnectSound;
     bool               bShowConnectDisconnectMessage;
+    bool               bNoiseSuppression;
+    bool               bAutomaticGainControl;
 };
@@ -224,6 +224,39 @@ void SettingsManager::saveCurrentSettings()
     newSettingsFile.write( reinterpret_cast<char*>(&pCurrentSettingsFile->iMuteMicrophoneButton), sizeof(pCurrentSettingsFile->iMuteMicrophoneButton));
 
 
+    // Write capture buffer count.
+    newSettingsFile.write( reinterpret_cast<char*>(&pCurrentSettingsFile->iCaptureBufferCount), sizeof(pCurrentSettingsFile->iCaptureBufferCount));
+
+
+    // Write voice hangover.
+    newSettingsFile.write( reinterpret_cast<char*>(&pCurrentSettingsFile->iVoiceHangoverMs), sizeof(pCurrentSettingsFile->iVoiceHangoverMs));
+
+
+    // Write noise suppression.
+    newSettingsFile.write( reinterpret_cast<char*>(&pCurrentSettingsFile->bNoiseSuppression), sizeof(pCurrentSettingsFile->bNoiseSuppression));
+
+
+    // Write automatic gain control.
+    newSettingsFile.write( reinterpret_cast<char*>(&pCurrentSettingsFile->bAutomaticGainControl), sizeof(pCurrentSettingsFile->bAutomaticGainControl));
+    newSettingsFile.write( reinterpret_cast<char*>(&pCurrentSettingsFile->iAGCTargetDBFS), sizeof(pCurrentSettingsFile->iAGCTargetDBFS));
+
+
+    // Write device sample rate.
+    newSettingsFile.write( reinterpret_cast<char*>(&pCurrentSettingsFile->iDeviceSampleRate), sizeof(pCurrentSettingsFile->iDeviceSampleRate));
+
+
+    // Write push-to-talk pre-roll.
+    newSettingsFile.write( reinterpret_cast<char*>(&pCurrentSettingsFile->iPushToTalkPreRollMs), sizeof(pCurrentSettingsFile->iPushToTalkPreRollMs));
+
+
+    // Write max speakers in mix.
+    newSettingsFile.write( reinterpret_cast<char*>(&pCurrentSettingsFile->iMaxSpeakersInMix), sizeof(pCurrentSettingsFile->iMaxSpeakersInMix));
+
+
+    // Write session recording.
+    newSettingsFile.write( reinterpret_cast<char*>(&pCurrentSettingsFile->iSessionRecording), sizeof(pCurrentSettingsFile->iSessionRecording));
+
+
     // NEW SETTINGS GO HERE
     // Don't forget to update "readSettings()".
 
@@ -487,6 +520,135 @@ SettingsFile *SettingsManager::readSettings()
         settingsFile.read( reinterpret_cast<char*>(&pSettingsFile->iMuteMicrophoneButton), sizeof(pSettingsFile->iMuteMicrophoneButton));
 
 
+        if (iSettingsVersion == 2)
+        {
+            // End of file.
+            settingsFile.close();
+
+            // Used to show the Settings Window on start.
+            bReadOldSettingsFile = true;
+
+            goto link_read_end;
+        }
+
+
+        // Read capture buffer count.
+        settingsFile.read( reinterpret_cast<char*>(&pSettingsFile->iCaptureBufferCount), sizeof(pSettingsFile->iCaptureBufferCount));
+
+
+        if (iSettingsVersion == 3)
+        {
+            // End of file.
+            settingsFile.close();
+
+            // Used to show the Settings Window on start.
+            bReadOldSettingsFile = true;
+
+            goto link_read_end;
+        }
+
+
+        // Read voice hangover.
+        settingsFile.read( reinterpret_cast<char*>(&pSettingsFile->iVoiceHangoverMs), sizeof(pSettingsFile->iVoiceHangoverMs));
+
+
+        if (iSettingsVersion == 4)
+        {
+            // End of file.
+            settingsFile.close();
+
+            // Used to show the Settings Window on start.
+            bReadOldSettingsFile = true;
+
+            goto link_read_end;
+        }
+
+
+        // Read noise suppression.
+        settingsFile.read( reinterpret_cast<char*>(&pSettingsFile->bNoiseSuppression), sizeof(pSettingsFile->bNoiseSuppression));
+
+
+        if (iSettingsVersion == 5)
+        {
+            // End of file.
+            settingsFile.close();
+
+            // Used to show the Settings Window on start.
+            bReadOldSettingsFile = true;
+
+            goto link_read_end;
+        }
+
+
+        // Read automatic gain control.
+        settingsFile.read( reinterpret_cast<char*>(&pSettingsFile->bAutomaticGainControl), sizeof(pSettingsFile->bAutomaticGainControl));
+        settingsFile.read( reinterpret_cast<char*>(&pSettingsFile->iAGCTargetDBFS), sizeof(pSettingsFile->iAGCTargetDBFS));
+
+
+        if (iSettingsVersion == 6)
+        {
+            // End of file.
+            settingsFile.close();
+
+            // Used to show the Settings Window on start.
+            bReadOldSettingsFile = true;
+
+            goto link_read_end;
+        }
+
+
+        // Read device sample rate.
+        settingsFile.read( reinterpret_cast<char*>(&pSettingsFile->iDeviceSampleRate), sizeof(pSettingsFile->iDeviceSampleRate));
+
+
+        if (iSettingsVersion == 7)
+        {
+            // End of file.
+            settingsFile.close();
+
+            // Used to show the Settings Window on start.
+            bReadOldSettingsFile = true;
+
+            goto link_read_end;
+        }
+
+
+        // Read push-to-talk pre-roll.
+        settingsFile.read( reinterpret_cast<char*>(&pSettingsFile->iPushToTalkPreRollMs), sizeof(pSettingsFile->iPushToTalkPreRollMs));
+
+
+        if (iSettingsVersion == 8)
+        {
+            // End of file.
+            settingsFile.close();
+
+            // Used to show the Settings Window on start.
+            bReadOldSettingsFile = true;
+
+            goto link_read_end;
+        }
+
+
+        // Read max speakers in mix.
+        settingsFile.read( reinterpret_cast<char*>(&pSettingsFile->iMaxSpeakersInMix), sizeof(pSettingsFile->iMaxSpeakersInMix));
+
+
+        if (iSettingsVersion == 9)
+        {
+            // End of file.
+            settingsFile.close();
+
+            // Used to show the Settings Window on start.
+            bReadOldSettingsFile = true;
+
+            goto link_read_end;
+        }
+
+
+        // Read session recording.
+        settingsFile.read( reinterpret_cast<char*>(&pSettingsFile->iSessionRecording), sizeof(pSettingsFile->iSessionRecording));
+
+
         // ----------------------------------------------------------------
         // Don't forget to handle OLD version using the 'iSettingsVersion'!
         // ----------------------------------------------------------------
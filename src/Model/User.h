@@ -22,19 +22,13 @@
 #pragma comment(lib,"Ws2_32.lib")
 
 
-// for mmsystem
-#pragma comment(lib,"Winmm.lib")
-// for GetAsyncKeyState
-#pragma comment(lib, "user32.lib")
-
-
 // Other
 #include <Windows.h>
-#include "Mmsystem.h"
 
 
 
 class SListItemUser;
+struct MixerSpeaker;
 
 
 // ------------------------------------------------------------------------------------------------
@@ -52,6 +46,7 @@ public:
         this ->iPing           = iPing;
         this ->pListWidgetItem = pListWidgetItem;
         bTalking               = false;
+        pMixerSpeaker          = nullptr;
     }
 
 
@@ -79,20 +74,8 @@ public:
     /////////////////////////////////////////////
 
 
-    // Audio packets
-    std::vector<short*> vAudioPackets;
-    bool                bPacketsArePlaying;
-    bool                bDeletePacketsAtLast;
-    bool                bLastPacketCame;
-
-
-    // Waveform-audio output device
-    HWAVEOUT            hWaveOut;
-
-
-    // Audio buffers
-    WAVEHDR             WaveOutHdr1;
-    WAVEHDR             WaveOutHdr2;
+    // Audio packets go to the mixer (see AudioService::setupUserAudio())
+    MixerSpeaker*       pMixerSpeaker;
 
 
     float               fUserDefinedVolume;
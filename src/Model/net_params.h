@@ -6,7 +6,7 @@
 #pragma once
 
 
-#define  CLIENT_VERSION "3.5.1"
+#define  CLIENT_VERSION "3.7.0"
 
 
 // Limits.
@@ -17,12 +17,21 @@
 #define  MAX_MESSAGE_LENGTH             1000  // note: actual size is "MAX_MESSAGE_LENGTH * 2" because we use std::wstring.
 
 
+// Key exchange.
+#define  DH_PREFERRED_GROUP             0x20 // ffdhe2048, offered in the hello (note: also change in server)
+#define  DH_MAX_OPEN_KEY_SIZE           512  // note: also change in server (fits 4096-bit groups)
+#define  DH_KDF_INFO                    "Silent AES-128 session key" // note: also change in server
+#define  DH_REKEY_KDF_INFO              "Silent AES-128 rekey"       // note: also change in server
+#define  REKEY_INTERVAL_SEC             1800
+#define  REKEY_REPLY_TIMEOUT_SEC        30   // no RK_REPLY for this long - the rekey is dropped and started again
+#define  REKEY_SWITCH_MARGIN_PACKETS    32   // new voice key is used this many packets after the rekey (~1.1 sec.)
+
+
 // TCP / UDP
 #define  INTERVAL_TCP_MESSAGE_MS        120
 #define  INTERVAL_UDP_MESSAGE_MS        2
 #define  INTERVAL_KEEPALIVE_SEC         20   // note: also change in server
 #define  CHECK_IF_SERVER_DIED_EVERY_MS  800  // note: also used in disconnect() and answerToFIN(): "Wait for serverMonitor() to end".
-#define  INTERVAL_AUDIO_RECORD_MS       15
 #define  ATTEMPTS_TO_DISCONNECT_COUNT   5
 
 
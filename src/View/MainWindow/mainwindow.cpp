@@ -346,6 +346,11 @@ void MainWindow::slotApplyMasterVolume()
     pController->applyNewMasterVolumeFromSettings();
 }
 
+void MainWindow::slotApplyInputDevice()
+{
+    pController->applyInputDeviceFromSettings();
+}
+
 void MainWindow::slotSettingsWindowClosed()
 {
     pController->pauseTestRecording();
@@ -870,6 +875,7 @@ void MainWindow::showSettingsWindow()
     connect(pSettingsWindow, &SettingsWindow::signalSetVoiceStartValue, this, &MainWindow::slotApplyVoiceStartValue);
     connect(pSettingsWindow, &SettingsWindow::signalSetShouldHearTestVoice, this, &MainWindow::slotApplyShouldHearTestVoice);
     connect(pSettingsWindow, &SettingsWindow::signalRegisterMuteMicButton, this, &MainWindow::slotRegisterMuteMicButton);
+    connect(pSettingsWindow, &SettingsWindow::signalApplyInputDevice, this, &MainWindow::slotApplyInputDevice);
 
     pController->unpauseTestRecording();
     pSettingsWindow->setWindowModality(Qt::ApplicationModal);
@@ -942,6 +948,7 @@ void MainWindow::on_actionSettings_triggered()
     connect(pSettingsWindow, &SettingsWindow::signalSetVoiceStartValue, this, &MainWindow::slotApplyVoiceStartValue);
     connect(pSettingsWindow, &SettingsWindow::signalSetShouldHearTestVoice, this, &MainWindow::slotApplyShouldHearTestVoice);
     connect(pSettingsWindow, &SettingsWindow::signalRegisterMuteMicButton, this, &MainWindow::slotRegisterMuteMicButton);
+    connect(pSettingsWindow, &SettingsWindow::signalApplyInputDevice, this, &MainWindow::slotApplyInputDevice);
     pController->unpauseTestRecording();
     pSettingsWindow->setWindowModality(Qt::ApplicationModal);
     pSettingsWindow->show();
@@ -208,6 +208,7 @@ private slots:
         void  slotApplyShouldHearTestVoice      (bool bHear);
         void  slotApplyTheme                    ();
         void  slotApplyMasterVolume             ();
+        void  slotApplyInputDevice              ();
         void  slotSettingsWindowClosed          ();
         void  slotAddRoom                       (QString sRoomName, QString sPassword, size_t iMaxUsers, bool bFirstRoom, std::promise<int>* promiseRoomCount);
         void  slotDeleteRoom                    (QString sRoomName, std::promise<int>* promiseRoomCount);
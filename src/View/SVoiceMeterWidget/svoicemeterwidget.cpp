@@ -11,6 +11,8 @@ SVoiceMeterWidget::SVoiceMeterWidget(QWidget *parent) :
     ui(new Ui::SVoiceMeterWidget)
 {
     ui->setupUi(this);
+
+    lastLevelTime = std::chrono::steady_clock::now();
 }
 
 void SVoiceMeterWidget::setStartValueInDBFS(int iValue)
@@ -18,6 +20,22 @@ void SVoiceMeterWidget::setStartValueInDBFS(int iValue)
     iWidthScale = (100.0 - (abs(iValue) * 100 / 60.0)) / 100;
 }
 
+void SVoiceMeterWidget::setLevelInDBFS(int iLevelDBFS)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    levelMeter.update( iLevelDBFS, std::chrono::duration<double, std::milli>(now - lastLevelTime).count() );
+
+    lastLevelTime = now;
+
+
+    // setValue() only repaints if the value changed, the peak marker may have moved.
+
+    setValue( static_cast<int>(levelMeter.getLevelDBFS()) );
+
+    update();
+}
+
 void SVoiceMeterWidget::paintEvent(QPaintEvent *event)
 {
     QSlider::paintEvent(event);
@@ -37,6 +55,26 @@ void SVoiceMeterWidget::paintEvent(QPaintEvent *event)
     painter.setPen(pen);
 
     painter.drawRect( QRect(0, 0, width() * iWidthScale, height()) );
+
+
+    // Peak hold marker.
+
+    double dPeakDBFS = levelMeter.getPeakHoldDBFS();
+
+    if (dPeakDBFS > minimum())
+    {
+        if (dPeakDBFS > maximum())
+        {
+            dPeakDBFS = maximum();
+        }
+
+        int iPeakX = static_cast<int>( width() * (dPeakDBFS - minimum()) / (maximum() - minimum()) );
+
+        pen.setColor(QColor(255, 255, 255, 200));
+        painter.setPen(pen);
+
+        painter.drawLine(iPeakX - 1, 0, iPeakX - 1, height());
+    }
 }
 
 SVoiceMeterWidget::~SVoiceMeterWidget()
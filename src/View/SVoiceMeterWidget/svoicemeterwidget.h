@@ -9,6 +9,10 @@
 #include <QSlider>
 #include <QPainter>
 
+#include <chrono>
+
+#include "Model/AudioService/DSP/levelmeter.h"
+
 namespace Ui
 {
     class SVoiceMeterWidget;
@@ -24,6 +28,9 @@ public:
 
     void setStartValueInDBFS(int iValue);
 
+    // Shows the frame level with the meter ballistics (slow fall + peak hold marker).
+    void setLevelInDBFS(int iLevelDBFS);
+
     ~SVoiceMeterWidget() override;
 
 protected:
@@ -35,4 +42,8 @@ private:
     Ui::SVoiceMeterWidget *ui;
 
     double iWidthScale = 0.333;
+
+    LevelMeter levelMeter;
+
+    std::chrono::steady_clock::time_point lastLevelTime;
 };
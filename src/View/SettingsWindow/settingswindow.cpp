@@ -17,6 +17,7 @@
 #include "View/StyleAndInfoPaths.h"
 #include "Model/SettingsManager/settingsmanager.h"
 #include "Model/SettingsManager/SettingsFile.h"
+#include "Model/AudioService/Recorder/sessionrecorder.h"
 
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -196,7 +197,7 @@ void SettingsWindow::closeEvent(QCloseEvent *event)
 
 void SettingsWindow::slotSetVoiceVolume(int iVolume)
 {
-    ui->voiceVolumeMeter->setValue(iVolume);
+    ui->voiceVolumeMeter->setLevelInDBFS(iVolume);
 }
 
 void SettingsWindow::on_pushButton_pushtotalk_clicked()
@@ -260,6 +261,8 @@ void SettingsWindow::on_pushButton_apply_clicked()
 
     pSettingsFile->bPlayPushToTalkSound = ui->checkBox_pushToTalkSound->isChecked();
 
+    const std::wstring sOldInputDeviceName = pSettingsFile->sInputDeviceName;
+
     if (ui->comboBox_input->currentIndex() != 0)
     {
         pSettingsFile->sInputDeviceName = ui->comboBox_input->currentText().toStdWString();
@@ -288,6 +291,15 @@ void SettingsWindow::on_pushButton_apply_clicked()
     pSettingsFile->bPlayTextMessageSound = ui->checkBox_textMessageSound->isChecked();
     pSettingsFile->bPlayConnectDisconnectSound = ui->checkBox_connectDisconnectSound->isChecked();
     pSettingsFile->bShowConnectDisconnectMessage = ui->checkBox_connectDisconnectMessage->isChecked();
+    pSettingsFile->iCaptureBufferCount = ui->spinBox_capture_buffers->value();
+    pSettingsFile->iVoiceHangoverMs    = ui->spinBox_voice_hold->value();
+    pSettingsFile->bNoiseSuppression   = ui->checkBox_noise_suppression->isChecked();
+    pSettingsFile->bAutomaticGainControl = ui->checkBox_agc->isChecked();
+    pSettingsFile->iAGCTargetDBFS      = ui->spinBox_agc_target->value();
+    pSettingsFile->iDeviceSampleRate   = ui->comboBox_device_rate->currentData().toUInt();
+    pSettingsFile->iPushToTalkPreRollMs = ui->spinBox_preroll->value();
+    pSettingsFile->iMaxSpeakersInMix   = ui->spinBox_max_speakers->value();
+    pSettingsFile->iSessionRecording   = ui->comboBox_session_recording->currentData().toInt();
 
     pSettingsManager->saveCurrentSettings();
 
@@ -295,6 +307,12 @@ void SettingsWindow::on_pushButton_apply_clicked()
 
     emit signalRegisterMuteMicButton(iMuteMicButton);
 
+    if (pSettingsFile->sInputDeviceName != sOldInputDeviceName)
+    {
+        // Switched right away if we are connected.
+        emit signalApplyInputDevice();
+    }
+
     close();
 }
 
@@ -366,6 +384,33 @@ void SettingsWindow::updateUIToSettings(std::vector<QString> vInputDevices)
     ui->checkBox_connectDisconnectSound->setChecked(pSettingsFile->bPlayConnectDisconnectSound);
 
     ui->checkBox_connectDisconnectMessage->setChecked(pSettingsFile->bShowConnectDisconnectMessage);
+
+    ui->spinBox_capture_buffers->setValue(pSettingsFile->iCaptureBufferCount);
+    ui->spinBox_voice_hold->setValue(pSettingsFile->iVoiceHangoverMs);
+    ui->checkBox_noise_suppression->setChecked(pSettingsFile->bNoiseSuppression);
+    ui->checkBox_agc->setChecked(pSettingsFile->bAutomaticGainControl);
+    ui->spinBox_agc_target->setValue(pSettingsFile->iAGCTargetDBFS);
+
+    ui->comboBox_device_rate->addItem("48000 Hz", 48000u);
+    ui->comboBox_device_rate->addItem("44100 Hz", 44100u);
+    ui->comboBox_device_rate->addItem("Converted by the system", 0u);
+
+    if (ui->comboBox_device_rate->findData(pSettingsFile->iDeviceSampleRate) != -1)
+    {
+        ui->comboBox_device_rate->setCurrentIndex( ui->comboBox_device_rate->findData(pSettingsFile->iDeviceSampleRate) );
+    }
+
+    ui->spinBox_preroll->setValue(pSettingsFile->iPushToTalkPreRollMs);
+    ui->spinBox_max_speakers->setValue(pSettingsFile->iMaxSpeakersInMix);
+
+    ui->comboBox_session_recording->addItem("Off", static_cast<int>(SRM_OFF));
+    ui->comboBox_session_recording->addItem("What I Hear", static_cast<int>(SRM_MIX));
+    ui->comboBox_session_recording->addItem("What I Hear + Each Speaker", static_cast<int>(SRM_MIX_AND_SPEAKERS));
+
+    if (ui->comboBox_session_recording->findData(pSettingsFile->iSessionRecording) != -1)
+    {
+        ui->comboBox_session_recording->setCurrentIndex( ui->comboBox_session_recording->findData(pSettingsFile->iSessionRecording) );
+    }
 }
 
 void SettingsWindow::showThemes()
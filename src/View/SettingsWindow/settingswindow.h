@@ -43,6 +43,7 @@ signals:
     void  signalSetVoiceStartValue                 (int iValue);
     void  signalSetShouldHearTestVoice             (bool bHear);
     void  signalRegisterMuteMicButton              (int iButton);
+    void  signalApplyInputDevice                   ();
 
 protected:
 